@@ -0,0 +1,84 @@
+#include "../src/bson/aggregate/aggregate.hpp"
+#include "../src/bson/bson.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace bsona = pot::bson::aggregate;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kValues = 4096;
+static constexpr size_t kRounds = 2000;
+
+template <typename Fn> static double best_ns(Fn fn) {
+  double best = 0;
+  for (size_t round = 0; round < 5; round++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRounds; i++) {
+      fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                kRounds;
+    if (round == 0 || ns < best) {
+      best = ns;
+    }
+  }
+
+  return best;
+}
+
+static void run(const char name[], const bsond::Array &arr) {
+  bsona::Stats reference;
+  double iter_ns = best_ns([&]() {
+    reference = bsona::Stats();
+    for (auto el : arr) {
+      reference.add(el);
+    }
+  });
+
+  bsona::Stats stats;
+  double block_ns = best_ns([&]() {
+    stats = bsona::Stats();
+    bsona::aggregate(arr, stats);
+  });
+
+  if (stats.getSum() != reference.getSum() ||
+      stats.getMin() != reference.getMin() ||
+      stats.getMax() != reference.getMax()) {
+    printf("aggregate: %s doesn't match the reference\n", name);
+    return;
+  }
+
+  printf("  %-7s iterator %7.0f ns, blocks %7.0f ns, %.1fx\n", name, iter_ns,
+         block_ns, iter_ns / block_ns);
+}
+
+int main() {
+  std::vector<uint8_t> buf(kValues * 32);
+  printf("aggregate: %zu values per array\n", kValues);
+
+  const char *names[] = { "double", "int32", "mixed" };
+  for (size_t kind = 0; kind < 3; kind++) {
+    bsons::Result res = bsons::Document::build(
+        buf.data(), buf.size(), [kind](bsons::Document &doc) {
+          doc.appendArr("values", [kind](bsons::Array &arr) {
+            for (size_t i = 0; i < kValues; i++) {
+              if (kind == 0 || (kind == 2 && i % 3 == 0)) {
+                arr.appendDouble(20.0 + (i % 97) * 0.01);
+              } else {
+                arr.appendInt32(i % 1000);
+              }
+            }
+          });
+        });
+
+    bsond::DocumentElement el;
+    bsond::Document(buf.data(), res.len).getElByName("values", el);
+    run(names[kind], el.getArr());
+  }
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/compress/dictionary.hpp"
+#include "../src/bson/compress/frame.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonz = pot::bson::compress;
+
+static constexpr size_t kBufSize = 1024;
+static constexpr size_t kMessages = 100000;
+static constexpr size_t kTrainingMessages = 100;
+static constexpr size_t kDictSize = 1024;
+
+/**
+ * Builds the nth telemetry message of a simulated device, like the delta
+ * bench.
+ */
+size_t build_telemetry(uint8_t buf[], size_t n) {
+  return bsons::Document::build(
+             buf, kBufSize,
+             [n](bsons::Document &doc) {
+               doc.appendStr("deviceId", "edge-gw-0042")
+                   .appendStr("firmware", "2.14.1")
+                   .appendInt64("timestamp", 1700000000000 + n * 1000)
+                   .appendInt32("seq", n)
+                   .appendDouble("temperature", 21.0 + (n / 50) * 0.1)
+                   .appendDouble("humidity", 40.0 + (n / 200) * 0.5)
+                   .appendInt32("battery", 100 - n / 5000)
+                   .appendStr("status", (n / 1000) % 2 ? "ok" : "idle")
+                   .appendDoc("gps",
+                              [](bsons::Document &ndoc) {
+                                ndoc.appendDouble("lat", 51.5072)
+                                    .appendDouble("lon", -0.1276)
+                                    .appendDouble("alt", 35.0);
+                              })
+                   .appendArr("readings", [n](bsons::Array &arr) {
+                     for (size_t i = 0; i < 16; i++) {
+                       arr.appendDouble(i + ((n + i) / 10) * 0.01);
+                     }
+                   });
+             })
+      .len;
+}
+
+struct Totals {
+  size_t frame_bytes = 0;
+  double write_ns = 0;
+  double read_ns = 0;
+};
+
+bool run(const bsonz::Dictionary *dict, Totals &totals) {
+  static uint8_t doc[kBufSize];
+  static uint8_t frame[kBufSize];
+  static uint8_t out[kBufSize];
+
+  for (size_t n = 0; n < kMessages; n++) {
+    size_t len = build_telemetry(doc, n);
+
+    auto start = std::chrono::steady_clock::now();
+    bsonz::Result res = bsonz::write_frame(doc, len, frame, kBufSize, dict);
+    auto mid = std::chrono::steady_clock::now();
+    bsond::Document read;
+    bsonz::Result read_res =
+        bsonz::read_frame(frame, res.len, out, kBufSize, read, dict);
+    auto end = std::chrono::steady_clock::now();
+
+    if (res.status != bsonz::Status::Ok ||
+        read_res.status != bsonz::Status::Ok || read_res.len != len ||
+        memcmp(read.getRef(), doc, len) != 0) {
+      printf("compress: round trip mismatch at message %zu\n", n);
+      return false;
+    }
+
+    totals.frame_bytes += res.len;
+    totals.write_ns +=
+        std::chrono::duration<double, std::nano>(mid - start).count();
+    totals.read_ns +=
+        std::chrono::duration<double, std::nano>(end - mid).count();
+  }
+
+  return true;
+}
+
+int main() {
+  static uint8_t doc[kBufSize];
+  static uint8_t dict_buf[kDictSize];
+
+  size_t full_bytes = 0;
+  for (size_t n = 0; n < kMessages; n++) {
+    full_bytes += build_telemetry(doc, n);
+  }
+
+  // Trained on messages from well before the ones being sent.
+  bsonz::DictionaryTrainer trainer;
+  for (size_t n = 0; n < kTrainingMessages; n++) {
+    trainer.add(doc, build_telemetry(doc, n * 997));
+  }
+  bsonz::Dictionary dict = bsonz::make_dictionary(
+      dict_buf, trainer.build(dict_buf, sizeof(dict_buf)));
+
+  Totals plain;
+  Totals with_dict;
+  if (!run(nullptr, plain) || !run(&dict, with_dict)) {
+    return 1;
+  }
+
+  printf("compress: %zu messages, %zu byte dictionary\n", kMessages, dict.len);
+  printf("  raw:        %.1f bytes per message\n",
+         static_cast<double>(full_bytes) / kMessages);
+  const Totals *totals[] = { &plain, &with_dict };
+  const char *names[] = { "lz:        ", "lz + dict: " };
+  for (size_t i = 0; i < 2; i++) {
+    printf("  %s %.1f bytes per message (%.1f%%), write %.0f ns, "
+           "read %.0f ns\n",
+           names[i], static_cast<double>(totals[i]->frame_bytes) / kMessages,
+           100.0 * totals[i]->frame_bytes / full_bytes,
+           totals[i]->write_ns / kMessages, totals[i]->read_ns / kMessages);
+  }
+
+  return 0;
+}
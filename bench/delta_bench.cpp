@@ -0,0 +1,96 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/delta/delta.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsondelta = pot::bson::delta;
+
+static constexpr size_t kBufSize = 1024;
+static constexpr size_t kMessages = 100000;
+static constexpr size_t kReadings = 16;
+
+/**
+ * Builds the nth telemetry message of a simulated device: a few counters tick
+ * every message, readings drift slowly and the rest stays constant.
+ */
+size_t build_telemetry(uint8_t buf[], size_t n) {
+  return bsons::Document::build(
+             buf, kBufSize,
+             [n](bsons::Document &doc) {
+               doc.appendStr("deviceId", "edge-gw-0042")
+                   .appendStr("firmware", "2.14.1")
+                   .appendInt64("timestamp", 1700000000000 + n * 1000)
+                   .appendInt32("seq", n)
+                   .appendDouble("temperature", 21.0 + (n / 50) * 0.1)
+                   .appendDouble("humidity", 40.0 + (n / 200) * 0.5)
+                   .appendInt32("battery", 100 - n / 5000)
+                   .appendStr("status", (n / 1000) % 2 ? "ok" : "idle")
+                   .appendDoc("gps",
+                              [](bsons::Document &ndoc) {
+                                ndoc.appendDouble("lat", 51.5072)
+                                    .appendDouble("lon", -0.1276)
+                                    .appendDouble("alt", 35.0);
+                              })
+                   .appendArr("readings", [n](bsons::Array &arr) {
+                     for (size_t i = 0; i < kReadings; i++) {
+                       arr.appendDouble(i + ((n + i) / 10) * 0.01);
+                     }
+                   });
+             })
+      .len;
+}
+
+int main() {
+  static uint8_t prev[kBufSize];
+  static uint8_t next[kBufSize];
+  static uint8_t patch[kBufSize];
+  static uint8_t out[kBufSize];
+
+  size_t prev_len = build_telemetry(prev, 0);
+  size_t full_bytes = 0;
+  size_t patch_bytes = 0;
+  double diff_ns = 0;
+  double apply_ns = 0;
+
+  for (size_t n = 1; n <= kMessages; n++) {
+    size_t next_len = build_telemetry(next, n);
+    bsond::Document prev_doc(prev, prev_len);
+    bsond::Document next_doc(next, next_len);
+
+    auto start = std::chrono::steady_clock::now();
+    bsondelta::Result diff_res =
+        bsondelta::diff(prev_doc, next_doc, patch, kBufSize);
+    auto mid = std::chrono::steady_clock::now();
+    bsondelta::Result apply_res = bsondelta::apply(
+        prev_doc, bsond::Document(patch, diff_res.len), out, kBufSize);
+    auto end = std::chrono::steady_clock::now();
+
+    if (apply_res.status != bsondelta::Status::Ok ||
+        apply_res.len != next_len || memcmp(out, next, next_len) != 0) {
+      printf("delta: round trip mismatch at message %zu\n", n);
+      return 1;
+    }
+
+    diff_ns += std::chrono::duration<double, std::nano>(mid - start).count();
+    apply_ns += std::chrono::duration<double, std::nano>(end - mid).count();
+    full_bytes += next_len;
+    patch_bytes += diff_res.len;
+
+    memcpy(prev, next, next_len);
+    prev_len = next_len;
+  }
+
+  printf("delta: %zu messages\n", kMessages);
+  printf("  full:  %zu bytes (%.1f per message)\n", full_bytes,
+         static_cast<double>(full_bytes) / kMessages);
+  printf("  patch: %zu bytes (%.1f per message, %.1f%% saved)\n", patch_bytes,
+         static_cast<double>(patch_bytes) / kMessages,
+         100.0 * (full_bytes - patch_bytes) / full_bytes);
+  printf("  diff:  %.0f ns per message\n", diff_ns / kMessages);
+  printf("  apply: %.0f ns per message\n", apply_ns / kMessages);
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/parallel/encode.hpp"
+#include "../src/bson/parallel/thread_pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace bsons = pot::bson::serializer;
+namespace bsonp = pot::bson::parallel;
+
+static constexpr size_t kRecords = 200000;
+static constexpr size_t kRounds = 5;
+
+struct Record {
+  int64_t timestamp;
+  int32_t seq;
+  double temperature;
+  double readings[16];
+};
+
+int main() {
+  // An archive batch of telemetry records.
+  std::vector<Record> records(kRecords);
+  for (size_t n = 0; n < kRecords; n++) {
+    records[n].timestamp = 1700000000000 + n * 1000;
+    records[n].seq = n;
+    records[n].temperature = 21.0 + (n % 50) * 0.1;
+    for (size_t i = 0; i < 16; i++) {
+      records[n].readings[i] = i + n * 0.01;
+    }
+  }
+
+  auto builder = [&records](size_t n, bsons::Document &doc) {
+    const Record &record = records[n];
+    doc.appendStr("deviceId", "edge-gw-0042")
+        .appendInt64("timestamp", record.timestamp)
+        .appendInt32("seq", record.seq)
+        .appendDouble("temperature", record.temperature)
+        .appendArr("readings", [&record](bsons::Array &arr) {
+          for (size_t i = 0; i < 16; i++) {
+            arr.appendDouble(record.readings[i]);
+          }
+        });
+  };
+
+  std::vector<uint8_t> out(kRecords * 512);
+
+  // Sequential baseline, encoding each record in turn.
+  double seq_ns = 0;
+  size_t len = 0;
+  for (size_t round = 0; round < kRounds; round++) {
+    auto start = std::chrono::steady_clock::now();
+    len = 0;
+    for (size_t n = 0; n < kRecords; n++) {
+      len += bsons::Document::build(
+                 &out[len], out.size() - len,
+                 [&](bsons::Document &doc) { builder(n, doc); })
+                 .len;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (round == 0 || ns < seq_ns) {
+      seq_ns = ns;
+    }
+  }
+
+  size_t max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+
+  printf("encode: %zu records, %.1f MB\n", kRecords, len / 1e6);
+  printf("  sequential: %7.2f ms, %6.0f MB/s\n", seq_ns / 1e6,
+         len / seq_ns * 1e3);
+
+  for (size_t threads = 1;; threads *= 2) {
+    if (threads > max_threads) {
+      threads = max_threads;
+    }
+
+    bsonp::ThreadPool pool(threads);
+    bsonp::BatchEncoder encoder(pool);
+    double best_ns = 0;
+
+    for (size_t round = 0; round < kRounds; round++) {
+      auto start = std::chrono::steady_clock::now();
+      bsons::Result res =
+          encoder.encode(kRecords, builder, out.data(), out.size());
+      auto end = std::chrono::steady_clock::now();
+
+      if (res.status != bsons::Status::Ok || res.len != len) {
+        printf("encode: batch failed\n");
+        return 1;
+      }
+
+      double ns = std::chrono::duration<double, std::nano>(end - start).count();
+      if (round == 0 || ns < best_ns) {
+        best_ns = ns;
+      }
+    }
+
+    printf("  %2zu threads: %7.2f ms, %6.0f MB/s, %.2fx\n", threads,
+           best_ns / 1e6, len / best_ns * 1e3, seq_ns / best_ns);
+
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/io/document_stream.hpp"
+#include "../src/bson/io/journal.hpp"
+#include "../src/bson/io/mapped_file.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+
+static constexpr size_t kDocs = 500000;
+
+double mb_per_s(const size_t bytes,
+                const std::chrono::steady_clock::duration elapsed) {
+  return bytes / std::chrono::duration<double>(elapsed).count() / 1e6;
+}
+
+bool write_journal(const char path[], const bsonio::JournalBackend backend,
+                   size_t &bytes) {
+  bsonio::JournalWriter writer;
+  if (!writer.open(path, backend)) {
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < kDocs; n++) {
+    writer.append([n](bsons::Document &doc) {
+      doc.appendStr("deviceId", "edge-gw-0042")
+          .appendInt64("timestamp", 1700000000000 + n * 1000)
+          .appendInt32("seq", n)
+          .appendDouble("temperature", 21.0 + (n / 50) * 0.1)
+          .appendArr("readings", [n](bsons::Array &arr) {
+            for (size_t i = 0; i < 16; i++) {
+              arr.appendDouble(i + ((n + i) / 10) * 0.01);
+            }
+          });
+    });
+  }
+  bytes = writer.size();
+  bool ok = writer.close();
+  auto end = std::chrono::steady_clock::now();
+
+  printf("journal: write %-6s %8.1f MB/s\n",
+         backend == bsonio::JournalBackend::Uring ? "uring" : "sync",
+         mb_per_s(bytes, end - start));
+  return ok;
+}
+
+bool read_journal(const char path[], const bsonio::JournalBackend backend) {
+  bsonio::JournalReader reader(bsonio::kJournalChunkSize,
+                               bsonio::kJournalQueueDepth, true);
+  if (!reader.open(path, backend)) {
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  bsond::Document doc;
+  size_t count = 0;
+  while (reader.next(doc)) {
+    count++;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  printf("journal: read  %-6s %8.1f MB/s\n",
+         backend == bsonio::JournalBackend::Uring ? "uring" : "sync",
+         mb_per_s(reader.size(), end - start));
+  return count == kDocs && reader.status() == bsonio::StreamStatus::End;
+}
+
+bool read_mapped(const char path[]) {
+  auto start = std::chrono::steady_clock::now();
+  bsonio::MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+
+  bsonio::DocumentStream stream(file.data(), file.size(), true);
+  bsond::Document doc;
+  while (stream.next(doc)) {
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  printf("journal: read  mmap   %8.1f MB/s\n",
+         mb_per_s(file.size(), end - start));
+  return stream.count() == kDocs;
+}
+
+int main() {
+  char path[] = "/tmp/pot_bson_journal_bench_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    return 1;
+  }
+  close(fd);
+
+  bsonio::Uring uring;
+  bool have_uring = uring.open(1);
+  uring.close();
+  if (!have_uring) {
+    printf("journal: io_uring unavailable, sync only\n");
+  }
+
+  // Reads come from the page cache after the write, so this measures the
+  // per-request overhead of each backend rather than the disk.
+  size_t bytes;
+  bool ok = write_journal(path, bsonio::JournalBackend::Sync, bytes);
+  if (have_uring) {
+    ok = ok && write_journal(path, bsonio::JournalBackend::Uring, bytes);
+  }
+  printf("journal: %zu documents, %zu bytes\n", kDocs, bytes);
+
+  ok = ok && read_journal(path, bsonio::JournalBackend::Sync);
+  if (have_uring) {
+    ok = ok && read_journal(path, bsonio::JournalBackend::Uring);
+  }
+  ok = ok && read_mapped(path);
+
+  unlink(path);
+  if (!ok) {
+    printf("journal: round trip failed\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/json/parser.hpp"
+#include "../src/bson/json/writer.hpp"
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsonj = pot::bson::json;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kReadings = 512;
+static constexpr size_t kRounds = 200;
+
+template <typename Fn> static double best_ns(Fn fn) {
+  double best = 0;
+  for (size_t round = 0; round < 5; round++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRounds; i++) {
+      fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                kRounds;
+    if (round == 0 || ns < best) {
+      best = ns;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * The iterator and snprintf based conversion that the writer replaces.
+ */
+static size_t printf_json(const bsond::Document &doc, char buf[], size_t len);
+
+static size_t printf_value(const bsond::DocumentElement &el, char buf[],
+                           size_t len) {
+  switch (el.type()) {
+    case pot::bson::Element::Double:
+      return snprintf(buf, len, "%.17g", el.getDouble());
+    case pot::bson::Element::Int32:
+      return snprintf(buf, len, "%d", el.getInt32());
+    case pot::bson::Element::Int64:
+      return snprintf(buf, len, "%" PRId64, el.getInt64());
+    case pot::bson::Element::Boolean:
+      return snprintf(buf, len, "%s", el.getBool() ? "true" : "false");
+    case pot::bson::Element::String: {
+      size_t pos = snprintf(buf, len, "\"");
+      const char *str = el.getStrRef();
+      for (int64_t i = 0; i < el.getStrLen(); i++) {
+        if (str[i] == '"' || str[i] == '\\') {
+          pos += snprintf(&buf[pos], len - pos, "\\%c", str[i]);
+        } else {
+          pos += snprintf(&buf[pos], len - pos, "%c", str[i]);
+        }
+      }
+      return pos + snprintf(&buf[pos], len - pos, "\"");
+    }
+    case pot::bson::Element::Document:
+      return printf_json(el.getDoc(), buf, len);
+    default:
+      return snprintf(buf, len, "null");
+  }
+}
+
+static size_t printf_json(const bsond::Document &doc, char buf[], size_t len) {
+  size_t pos = snprintf(buf, len, "{");
+  bool first = true;
+  for (auto el : doc) {
+    pos += snprintf(&buf[pos], len - pos, "%s\"%s\":", first ? "" : ",",
+                    el.getNameRef());
+    pos += printf_value(el, &buf[pos], len - pos);
+    first = false;
+  }
+  return pos + snprintf(&buf[pos], len - pos, "}");
+}
+
+int main() {
+  std::vector<uint8_t> buf(kReadings * 256);
+  bsons::Result res = bsons::Document::build(
+      buf.data(), buf.size(), [](bsons::Document &doc) {
+        for (size_t i = 0; i < kReadings; i++) {
+          char key[16];
+          snprintf(key, sizeof(key), "r%zu", i);
+          doc.appendDoc(key, [i](bsons::Document &rdoc) {
+            rdoc.appendInt64("ts", 1700000000000 + i * 1000)
+                .appendDouble("temp", 20.0 + (i % 97) * 0.01)
+                .appendInt32("rssi", -40 - static_cast<int32_t>(i % 50))
+                .appendBool("alarm", i % 7 == 0)
+                .appendStr("msg", "sensor reading within the expected range");
+          });
+        }
+      });
+  bsond::Document doc(buf.data(), res.len);
+
+  std::vector<char> out(buf.size() * 2);
+  size_t writer_len = 0;
+  double writer_ns = best_ns([&]() {
+    writer_len = bsonj::to_json(doc, out.data(), out.size()).len;
+  });
+
+  size_t printf_len = 0;
+  double printf_ns = best_ns(
+      [&]() { printf_len = printf_json(doc, out.data(), out.size()); });
+
+  printf("json: %zu byte document, %zu bytes of JSON\n", res.len, writer_len);
+  printf("  snprintf %8.0f ns, %.2f GB/s\n", printf_ns, printf_len / printf_ns);
+  printf("  writer   %8.0f ns, %.2f GB/s, %.1fx\n", writer_ns,
+         writer_len / writer_ns, printf_ns / writer_ns);
+
+  // The snprintf run reused the output buffer.
+  bsonj::to_json(doc, out.data(), out.size());
+  std::vector<uint8_t> parsed(buf.size());
+  size_t parsed_len = 0;
+  double parse_ns = best_ns([&]() {
+    parsed_len = bsonj::parse(out.data(), writer_len, parsed.data(),
+                              parsed.size())
+                     .len;
+  });
+
+  if (parsed_len != res.len ||
+      memcmp(parsed.data(), buf.data(), parsed_len) != 0) {
+    printf("json: parsing the output doesn't match the document\n");
+    return 1;
+  }
+  printf("  parser   %8.0f ns, %.2f GB/s\n", parse_ns, writer_len / parse_ns);
+
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/series/series.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kSamples = 4096;
+static constexpr size_t kBufSize = 128 * 1024;
+static constexpr size_t kIterations = 500;
+
+static int64_t timestamps[kSamples];
+static double readings[kSamples];
+static int64_t int_out[kSamples];
+static double dbl_out[kSamples];
+
+/**
+ * One sample a second with some jitter, and a temperature that changes in
+ * 0.1 steps every few samples.
+ */
+void make_samples() {
+  for (size_t i = 0; i < kSamples; i++) {
+    timestamps[i] = 1700000000000 + i * 1000 + (i * 7919) % 13;
+    readings[i] = 21.0 + ((i / 25) % 40) * 0.1;
+  }
+}
+
+size_t build_plain(uint8_t buf[]) {
+  return bsons::Document::build(buf, kBufSize,
+                                [](bsons::Document &doc) {
+                                  doc.appendArr("ts", [](bsons::Array &arr) {
+                                    for (size_t i = 0; i < kSamples; i++) {
+                                      arr.appendInt64(timestamps[i]);
+                                    }
+                                  });
+                                  doc.appendArr("temp", [](bsons::Array &arr) {
+                                    for (size_t i = 0; i < kSamples; i++) {
+                                      arr.appendDouble(readings[i]);
+                                    }
+                                  });
+                                })
+      .len;
+}
+
+size_t build_series(uint8_t buf[]) {
+  return bsons::Document::build(buf, kBufSize,
+                                [](bsons::Document &doc) {
+                                  doc.appendSeriesInt64("ts", timestamps,
+                                                        kSamples)
+                                      .appendSeriesDouble("temp", readings,
+                                                          kSamples);
+                                })
+      .len;
+}
+
+bool read_plain(const uint8_t buf[], size_t len) {
+  bsond::Document doc(buf, len);
+  bsond::DocumentElement el;
+
+  if (!doc.getElByName("ts", el)) {
+    return false;
+  }
+  size_t i = 0;
+  for (auto const &item : el.getArr()) {
+    int_out[i++] = item.getInt64();
+  }
+
+  if (!doc.getElByName("temp", el)) {
+    return false;
+  }
+  i = 0;
+  for (auto const &item : el.getArr()) {
+    dbl_out[i++] = item.getDouble();
+  }
+
+  return i == kSamples;
+}
+
+bool read_series(const uint8_t buf[], size_t len) {
+  bsond::Document doc(buf, len);
+  bsond::DocumentElement el;
+
+  if (!doc.getElByName("ts", el) || !el.tryGetSeriesInt64(int_out, kSamples)) {
+    return false;
+  }
+
+  return doc.getElByName("temp", el) &&
+         el.tryGetSeriesDouble(dbl_out, kSamples);
+}
+
+bool check() {
+  return memcmp(int_out, timestamps, sizeof(timestamps)) == 0 &&
+         memcmp(dbl_out, readings, sizeof(readings)) == 0;
+}
+
+template <typename F> double time_ns(F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kIterations; i++) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         kIterations;
+}
+
+int main() {
+  static uint8_t plain[kBufSize];
+  static uint8_t series[kBufSize];
+  make_samples();
+
+  size_t plain_len = 0;
+  size_t series_len = 0;
+  double plain_build = time_ns([&] { plain_len = build_plain(plain); });
+  double series_build = time_ns([&] { series_len = build_series(series); });
+
+  bool ok = true;
+  double plain_read = time_ns([&] { ok &= read_plain(plain, plain_len); });
+  ok &= check();
+  memset(int_out, 0, sizeof(int_out));
+  memset(dbl_out, 0, sizeof(dbl_out));
+  double series_read = time_ns([&] { ok &= read_series(series, series_len); });
+  ok &= check();
+
+  if (!ok) {
+    printf("series: round trip mismatch\n");
+    return 1;
+  }
+
+  printf("series: %zu timestamps and %zu readings\n", kSamples, kSamples);
+  printf("  array:  %zu bytes, build %.1f us, read %.1f us\n", plain_len,
+         plain_build / 1000, plain_read / 1000);
+  printf("  series: %zu bytes (%.1f%% of array), build %.1f us, "
+         "read %.1f us\n",
+         series_len, 100.0 * series_len / plain_len, series_build / 1000,
+         series_read / 1000);
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/transcode/cbor.hpp"
+#include "../src/bson/transcode/msgpack.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsont = pot::bson::transcode;
+
+static constexpr size_t kPayloadSize = 1 << 20;
+static constexpr size_t kRounds = 200;
+
+template <typename Fn> static double best_ns(Fn fn) {
+  double best = 0;
+  for (size_t round = 0; round < 5; round++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRounds; i++) {
+      fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                kRounds;
+    if (round == 0 || ns < best) {
+      best = ns;
+    }
+  }
+
+  return best;
+}
+
+int main() {
+  std::vector<uint8_t> payload(kPayloadSize, 0xA5);
+  std::vector<uint8_t> buf(kPayloadSize + 256);
+  const uint8_t *data = payload.data();
+  bsons::Result res = bsons::Document::build(
+      buf.data(), buf.size(), [data](bsons::Document &doc) {
+        doc.appendStr("name", "frame")
+            .appendInt64("ts", 1700000000000)
+            .appendBin("payload", data, kPayloadSize);
+      });
+  bsond::Document doc(buf.data(), res.len);
+
+  std::vector<uint8_t> mid(buf.size());
+  std::vector<uint8_t> back(buf.size());
+
+  double memcpy_ns =
+      best_ns([&]() { memcpy(mid.data(), buf.data(), res.len); });
+
+  size_t cbor_len = 0;
+  double to_cbor_ns = best_ns([&]() {
+    cbor_len = bsont::bson_to_cbor(doc, mid.data(), mid.size()).len;
+  });
+  double from_cbor_ns = best_ns([&]() {
+    bsont::cbor_to_bson(mid.data(), cbor_len, back.data(), back.size());
+  });
+
+  size_t msgpack_len = 0;
+  double to_msgpack_ns = best_ns([&]() {
+    msgpack_len = bsont::bson_to_msgpack(doc, mid.data(), mid.size()).len;
+  });
+  double from_msgpack_ns = best_ns([&]() {
+    bsont::msgpack_to_bson(mid.data(), msgpack_len, back.data(), back.size());
+  });
+
+  printf("transcode: %zu byte document with a 1 MiB binary\n", res.len);
+  printf("  memcpy        %8.0f ns, %.2f GB/s\n", memcpy_ns,
+         res.len / memcpy_ns);
+  printf("  to cbor       %8.0f ns, %.2f GB/s\n", to_cbor_ns,
+         res.len / to_cbor_ns);
+  printf("  from cbor     %8.0f ns, %.2f GB/s\n", from_cbor_ns,
+         res.len / from_cbor_ns);
+  printf("  to msgpack    %8.0f ns, %.2f GB/s\n", to_msgpack_ns,
+         res.len / to_msgpack_ns);
+  printf("  from msgpack  %8.0f ns, %.2f GB/s\n", from_msgpack_ns,
+         res.len / from_msgpack_ns);
+
+  return 0;
+}
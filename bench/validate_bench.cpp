@@ -0,0 +1,99 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/io/document_stream.hpp"
+#include "../src/bson/parallel/thread_pool.hpp"
+#include "../src/bson/parallel/validate.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+namespace bsonp = pot::bson::parallel;
+
+static constexpr size_t kDocs = 200000;
+static constexpr size_t kRounds = 5;
+
+int main() {
+  // A reconnect backlog of buffered telemetry documents.
+  std::vector<uint8_t> region(kDocs * 512);
+  size_t len = 0;
+  for (size_t n = 0; n < kDocs; n++) {
+    bsons::Result res = bsons::Document::build(
+        &region[len], region.size() - len, [n](bsons::Document &doc) {
+          doc.appendStr("deviceId", "edge-gw-0042")
+              .appendInt64("timestamp", 1700000000000 + n * 1000)
+              .appendInt32("seq", n)
+              .appendDouble("temperature", 21.0 + (n % 50) * 0.1)
+              .appendDoc("gps",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendDouble("lat", 51.5072)
+                               .appendDouble("lon", -0.1276);
+                         })
+              .appendArr("readings", [n](bsons::Array &arr) {
+                for (size_t i = 0; i < 16; i++) {
+                  arr.appendDouble(i + n * 0.01);
+                }
+              });
+        });
+    len += res.len;
+  }
+
+  std::vector<bsond::Document> docs(kDocs);
+  std::unique_ptr<bool[]> results(new bool[kDocs]);
+  bsonio::DocumentStream stream(region.data(), len);
+  size_t count = 0;
+  while (count < kDocs && stream.next(docs[count])) {
+    count++;
+  }
+
+  size_t max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+
+  printf("validate: %zu documents, %.1f MB\n", count, len / 1e6);
+
+  double base_ns = 0;
+  for (size_t threads = 1;; threads *= 2) {
+    if (threads > max_threads) {
+      threads = max_threads;
+    }
+
+    bsonp::ThreadPool pool(threads);
+    double best_ns = 0;
+
+    for (size_t round = 0; round < kRounds; round++) {
+      auto start = std::chrono::steady_clock::now();
+      size_t valid =
+          bsonp::validate_batch(pool, docs.data(), count, results.get());
+      auto end = std::chrono::steady_clock::now();
+
+      if (valid != count) {
+        printf("validate: %zu of %zu documents invalid\n", count - valid,
+               count);
+        return 1;
+      }
+
+      double ns = std::chrono::duration<double, std::nano>(end - start).count();
+      if (round == 0 || ns < best_ns) {
+        best_ns = ns;
+      }
+    }
+
+    if (threads == 1) {
+      base_ns = best_ns;
+    }
+
+    printf("  %2zu threads: %7.2f ms, %6.0f MB/s, %.2fx\n", threads,
+           best_ns / 1e6, len / best_ns * 1e3, base_ns / best_ns);
+
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  return 0;
+}
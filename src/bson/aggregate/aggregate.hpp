@@ -0,0 +1,439 @@
+#ifndef POT_BSON_AGGREGATE_AGGREGATE_H_
+#define POT_BSON_AGGREGATE_AGGREGATE_H_
+
+#include "../consts.hpp"
+#include "../deserializer/array.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace pot {
+namespace bson {
+namespace aggregate {
+
+static constexpr uint8_t kCount = 1 << 0;
+static constexpr uint8_t kSum = 1 << 1;
+static constexpr uint8_t kMin = 1 << 2;
+static constexpr uint8_t kMax = 1 << 3;
+static constexpr uint8_t kMean = 1 << 4;
+static constexpr uint8_t kAll = kCount | kSum | kMin | kMax | kMean;
+
+// The most values gathered from an array before they are folded together.
+static constexpr size_t kAggregateBlock = 64;
+
+/**
+ * Running statistics over numeric values.
+ *
+ * Integers are summed exactly as an Int64. Doubles are summed separately in
+ * the order they're added, and if the integer sum would overflow it is moved
+ * over to the double sum first. While no double has been added (and no
+ * overflow has happened), the results are `integral` and can be read exactly
+ * with the `getInt*` getters.
+ *
+ * Only the requested operations are kept up to date; the others read as 0.
+ */
+class Stats {
+public:
+  explicit Stats(const uint8_t ops = kAll) : ops_(ops) {}
+
+  size_t count() const {
+    return this->count_;
+  }
+
+  /**
+   * The number of values that weren't numbers and so were left out.
+   */
+  size_t skipped() const {
+    return this->skipped_;
+  }
+
+  bool integral() const {
+    return !this->has_double_ && !this->overflowed_;
+  }
+
+  double getSum() const {
+    if (this->integral()) {
+      return this->int_sum_;
+    }
+
+    return this->double_sum_ + this->int_sum_;
+  }
+
+  int64_t getIntSum() const {
+    return this->int_sum_;
+  }
+
+  double getMin() const {
+    if (!(this->ops_ & kMin)) {
+      return 0;
+    } else if (!this->has_double_) {
+      return this->getIntMin();
+    } else if (this->has_int_ && this->int_min_ < this->double_min_) {
+      return this->int_min_;
+    }
+
+    return this->count_ > 0 ? this->double_min_ : 0;
+  }
+
+  int64_t getIntMin() const {
+    return (this->ops_ & kMin) && this->has_int_ ? this->int_min_ : 0;
+  }
+
+  double getMax() const {
+    if (!(this->ops_ & kMax)) {
+      return 0;
+    } else if (!this->has_double_) {
+      return this->getIntMax();
+    } else if (this->has_int_ && this->int_max_ > this->double_max_) {
+      return this->int_max_;
+    }
+
+    return this->count_ > 0 ? this->double_max_ : 0;
+  }
+
+  int64_t getIntMax() const {
+    return (this->ops_ & kMax) && this->has_int_ ? this->int_max_ : 0;
+  }
+
+  double getMean() const {
+    return this->count_ > 0 ? this->getSum() / this->count_ : 0;
+  }
+
+  void add(const int64_t value) {
+    this->count_++;
+    this->has_int_ = true;
+
+    if (this->ops_ & (kSum | kMean)) {
+      this->addToSum(value);
+    }
+
+    if ((this->ops_ & kMin) && value < this->int_min_) {
+      this->int_min_ = value;
+    }
+
+    if ((this->ops_ & kMax) && value > this->int_max_) {
+      this->int_max_ = value;
+    }
+  }
+
+  void add(const double value) {
+    this->count_++;
+    this->has_double_ = true;
+
+    if (this->ops_ & (kSum | kMean)) {
+      this->double_sum_ += value;
+    }
+
+    if ((this->ops_ & kMin) && value < this->double_min_) {
+      this->double_min_ = value;
+    }
+
+    if ((this->ops_ & kMax) && value > this->double_max_) {
+      this->double_max_ = value;
+    }
+  }
+
+  /**
+   * Adds a numeric element, or counts it as skipped.
+   */
+  void add(const deserializer::DocumentElement &el) {
+    switch (el.type()) {
+      case Element::Int32:
+      case Element::Int64:
+        this->add(el.getInt());
+        break;
+      case Element::Double:
+        this->add(el.getDouble());
+        break;
+      default:
+        this->skipped_++;
+        break;
+    }
+  }
+
+  void skip() {
+    this->skipped_++;
+  }
+
+  /**
+   * Adds `count` Int32 values that are `stride` bytes apart. The values are
+   * gathered into a block first, and the block is folded with loops over
+   * plain integers that the compiler can vectorise.
+   */
+  void addInt32s(const uint8_t first[], const size_t stride,
+                 const size_t count) {
+    int32_t values[kAggregateBlock];
+    for (size_t i = 0; i < count; i++) {
+      values[i] = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(
+          first, i * stride);
+    }
+
+    // A block of Int32s can't move the sum by more than 2^38, so well away
+    // from the limits no partial sum can overflow and the block can be summed
+    // on its own. Otherwise add them one at a time to keep every overflow
+    // where a one-by-one fold would have it.
+    static constexpr int64_t kSafeSum = static_cast<int64_t>(1) << 62;
+    if (this->int_sum_ <= -kSafeSum || this->int_sum_ >= kSafeSum) {
+      for (size_t i = 0; i < count; i++) {
+        this->add(static_cast<int64_t>(values[i]));
+      }
+      return;
+    }
+
+    this->count_ += count;
+    this->has_int_ = true;
+
+    if (this->ops_ & (kSum | kMean)) {
+      int64_t sum = 0;
+      for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+      }
+      this->int_sum_ += sum;
+    }
+
+    if (this->ops_ & kMin) {
+      int32_t min = std::numeric_limits<int32_t>::max();
+      for (size_t i = 0; i < count; i++) {
+        min = values[i] < min ? values[i] : min;
+      }
+      this->int_min_ = min < this->int_min_ ? min : this->int_min_;
+    }
+
+    if (this->ops_ & kMax) {
+      int32_t max = std::numeric_limits<int32_t>::min();
+      for (size_t i = 0; i < count; i++) {
+        max = values[i] > max ? values[i] : max;
+      }
+      this->int_max_ = max > this->int_max_ ? max : this->int_max_;
+    }
+  }
+
+  void addInt64s(const uint8_t first[], const size_t stride,
+                 const size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      this->add(endian::buffer_to_primitive<int64_t, TypeSize::Int64>(
+          first, i * stride));
+    }
+  }
+
+  /**
+   * Adds `count` Double values that are `stride` bytes apart. The sum is kept
+   * in order so that it rounds the same as a one-by-one fold.
+   */
+  void addDoubles(const uint8_t first[], const size_t stride,
+                  const size_t count) {
+    double values[kAggregateBlock];
+    for (size_t i = 0; i < count; i++) {
+      values[i] = endian::buffer_to_primitive<double, TypeSize::Double>(
+          first, i * stride);
+    }
+
+    this->count_ += count;
+    this->has_double_ = true;
+
+    if (this->ops_ & (kSum | kMean)) {
+      double sum = this->double_sum_;
+      for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+      }
+      this->double_sum_ = sum;
+    }
+
+    if (this->ops_ & kMin) {
+      double min = this->double_min_;
+      for (size_t i = 0; i < count; i++) {
+        min = values[i] < min ? values[i] : min;
+      }
+      this->double_min_ = min;
+    }
+
+    if (this->ops_ & kMax) {
+      double max = this->double_max_;
+      for (size_t i = 0; i < count; i++) {
+        max = values[i] > max ? values[i] : max;
+      }
+      this->double_max_ = max;
+    }
+  }
+
+private:
+  uint8_t ops_;
+  size_t count_ = 0;
+  size_t skipped_ = 0;
+  bool has_int_ = false;
+  bool has_double_ = false;
+  bool overflowed_ = false;
+
+  int64_t int_sum_ = 0;
+  int64_t int_min_ = std::numeric_limits<int64_t>::max();
+  int64_t int_max_ = std::numeric_limits<int64_t>::min();
+
+  double double_sum_ = 0;
+  double double_min_ = std::numeric_limits<double>::infinity();
+  double double_max_ = -std::numeric_limits<double>::infinity();
+
+  void addToSum(const int64_t value) {
+    if ((value > 0 &&
+         this->int_sum_ > std::numeric_limits<int64_t>::max() - value) ||
+        (value < 0 &&
+         this->int_sum_ < std::numeric_limits<int64_t>::min() - value)) {
+      this->double_sum_ += this->int_sum_;
+      this->int_sum_ = value;
+      this->overflowed_ = true;
+      return;
+    }
+
+    this->int_sum_ += value;
+  }
+};
+
+/**
+ * Folds the numbers in an array into `stats`. Other values are skipped.
+ *
+ * Runs of elements with the same numeric type are read straight from the
+ * buffer, using the index keys to work out how far apart they are rather
+ * than parsing each element, so the array should already have been
+ * validated.
+ */
+inline void aggregate(const deserializer::Array &arr, Stats &stats) {
+  const uint8_t *buf = arr.getRef();
+  const uint8_t *end =
+      buf + arr.len() - static_cast<uint8_t>(TypeSize::Byte);
+  const uint8_t *cur = buf + static_cast<uint8_t>(TypeSize::Int32);
+
+  size_t index = 0;
+  size_t digits = 1;
+  size_t next_digit = 10;
+
+  while (cur < end) {
+    uint8_t type = *cur;
+    // The type byte, then the index key and its terminator.
+    size_t header = static_cast<uint8_t>(TypeSize::Byte) + digits + 1;
+
+    size_t size;
+    switch (type) {
+      case static_cast<uint8_t>(Element::Int32):
+        size = static_cast<uint8_t>(TypeSize::Int32);
+        break;
+      case static_cast<uint8_t>(Element::Int64):
+        size = static_cast<uint8_t>(TypeSize::Int64);
+        break;
+      case static_cast<uint8_t>(Element::Double):
+        size = static_cast<uint8_t>(TypeSize::Double);
+        break;
+      default:
+        size = 0;
+        break;
+    }
+
+    if (size == 0) {
+      stats.skip();
+      cur += deserializer::DocumentElement(cur, 0, end - cur).size();
+      index++;
+    } else {
+      // Extend the run for as long as the type and key width stay the same.
+      size_t stride = header + size;
+      size_t limit = next_digit - index < kAggregateBlock ? next_digit - index
+                                                          : kAggregateBlock;
+      size_t count = 1;
+      while (count < limit && cur + count * stride < end &&
+             cur[count * stride] == type) {
+        count++;
+      }
+
+      if (type == static_cast<uint8_t>(Element::Int32)) {
+        stats.addInt32s(cur + header, stride, count);
+      } else if (type == static_cast<uint8_t>(Element::Int64)) {
+        stats.addInt64s(cur + header, stride, count);
+      } else {
+        stats.addDoubles(cur + header, stride, count);
+      }
+
+      cur += count * stride;
+      index += count;
+    }
+
+    if (index == next_digit) {
+      digits++;
+      next_digit *= 10;
+    }
+  }
+}
+
+inline Stats aggregate(const deserializer::Array &arr, const uint8_t ops) {
+  Stats stats(ops);
+  aggregate(arr, stats);
+  return stats;
+}
+
+/**
+ * Finds the element at a dot separated path, e.g. "state.temp".
+ */
+inline bool find_path(const deserializer::Document &doc, const char path[],
+                      deserializer::DocumentElement &out) {
+  const uint8_t *buf = doc.getRef();
+
+  while (true) {
+    size_t len = 0;
+    while (path[len] != '\0' && path[len] != '.') {
+      len++;
+    }
+
+    int32_t doc_len =
+        endian::buffer_to_primitive<int32_t, TypeSize::Int32>(buf, 0);
+    const uint8_t *end = buf + doc_len - static_cast<uint8_t>(TypeSize::Byte);
+    const uint8_t *cur = buf + static_cast<uint8_t>(TypeSize::Int32);
+
+    bool found = false;
+    while (cur < end) {
+      out = deserializer::DocumentElement(cur, 0, end - cur);
+      if (out.nameSize() == len + 1 &&
+          memcmp(out.getNameRef(), path, len) == 0) {
+        found = true;
+        break;
+      }
+      cur += out.size();
+    }
+
+    if (!found) {
+      return false;
+    } else if (path[len] == '\0') {
+      return true;
+    } else if (out.type() != Element::Document &&
+               out.type() != Element::Array) {
+      return false;
+    }
+
+    buf = out.getDataRef();
+    path += len + 1;
+  }
+}
+
+/**
+ * Folds one field across a batch of documents. Documents where the field is
+ * missing or isn't a number are counted as skipped.
+ */
+inline Stats aggregate(const deserializer::Document docs[], const size_t count,
+                       const char path[], const uint8_t ops) {
+  Stats stats(ops);
+  deserializer::DocumentElement el;
+
+  for (size_t i = 0; i < count; i++) {
+    if (find_path(docs[i], path, el)) {
+      stats.add(el);
+    } else {
+      stats.skip();
+    }
+  }
+
+  return stats;
+}
+
+} // namespace aggregate
+} // namespace bson
+} // namespace pot
+
+#endif
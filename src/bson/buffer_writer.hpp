@@ -0,0 +1,130 @@
+#ifndef POT_BSON_BUFFER_WRITER_H_
+#define POT_BSON_BUFFER_WRITER_H_
+
+#include "./consts.hpp"
+#include "./endian.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+
+/**
+ * A forward-only writer over a caller-owned buffer, used by modules that
+ * splice raw BSON ranges rather than building values one at a time.
+ * Like `serializer::Document`, it keeps counting once the buffer is full so
+ * that the required length can still be reported.
+ */
+class BufferWriter {
+public:
+  BufferWriter(uint8_t buf[], const size_t len) :
+      buffer_(buf), buffer_length_(len) {}
+
+  size_t position() const {
+    return this->current_;
+  }
+
+  /**
+   * Moves the write position back to `pos`, discarding anything written after
+   * it.
+   */
+  void rewind(const size_t pos) {
+    this->current_ = pos;
+  }
+
+  bool overflowed() const {
+    return this->current_ > this->buffer_length_;
+  }
+
+  void writeByte(uint8_t byte) {
+    if (this->current_ < this->buffer_length_) {
+      this->buffer_[this->current_] = byte;
+    }
+    this->current_++;
+  }
+
+  void writeByte(Element type) {
+    this->writeByte(static_cast<uint8_t>(type));
+  }
+
+  void writeByte(BinaryElementSubtype bin_type) {
+    this->writeByte(static_cast<uint8_t>(bin_type));
+  }
+
+  void writeBuf(const uint8_t buf[], const size_t len) {
+    if (this->fits(len)) {
+      memcpy(&this->buffer_[this->current_], buf, len);
+    }
+    this->current_ += len;
+  }
+
+  /**
+   * Writes `len` characters of `str` followed by a null terminator.
+   */
+  void writeStr(const char str[], const size_t len) {
+    this->writeBuf(reinterpret_cast<const uint8_t *>(str), len);
+    this->writeByte(0);
+  }
+
+  void writeInt32(int32_t value) {
+    if (this->fits(static_cast<uint8_t>(TypeSize::Int32))) {
+      endian::primitive_to_buffer<int32_t, TypeSize::Int32>(
+          &this->buffer_[this->current_], value);
+    }
+    this->current_ += static_cast<uint8_t>(TypeSize::Int32);
+  }
+
+  void writeInt64(int64_t value) {
+    if (this->fits(static_cast<uint8_t>(TypeSize::Int64))) {
+      endian::primitive_to_buffer<int64_t, TypeSize::Int64>(
+          &this->buffer_[this->current_], value);
+    }
+    this->current_ += static_cast<uint8_t>(TypeSize::Int64);
+  }
+
+  void writeDouble(double value) {
+    if (this->fits(static_cast<uint8_t>(TypeSize::Double))) {
+      endian::primitive_to_buffer<double, TypeSize::Double>(
+          &this->buffer_[this->current_], value);
+    }
+    this->current_ += static_cast<uint8_t>(TypeSize::Double);
+  }
+
+  /**
+   * Writes a placeholder length and returns its position, to be filled in
+   * with `endDoc` once the document's contents have been written.
+   */
+  size_t startDoc() {
+    size_t pos = this->current_;
+    this->writeInt32(0);
+    return pos;
+  }
+
+  /**
+   * Writes the terminator of the document started at `pos` and patches its
+   * length header.
+   */
+  void endDoc(const size_t pos) {
+    this->writeByte(Element::Terminator);
+
+    size_t len = this->current_ - pos;
+    if (pos + static_cast<uint8_t>(TypeSize::Int32) <= this->buffer_length_) {
+      endian::primitive_to_buffer<int32_t, TypeSize::Int32>(
+          &this->buffer_[pos], static_cast<int32_t>(len));
+    }
+  }
+
+private:
+  uint8_t *buffer_;
+  size_t buffer_length_;
+  size_t current_ = 0;
+
+  bool fits(const size_t len) const {
+    return this->current_ + len <= this->buffer_length_;
+  }
+};
+
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef POT_BSON_CODEC_CODEC_H_
+#define POT_BSON_CODEC_CODEC_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include "../hash.hpp"
+#include "../serializer/result.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace codec {
+
+/**
+ * The generated encoder and decoder for a struct, specialised by
+ * `POT_BSON_CODEC`.
+ */
+template <typename T> struct Codec;
+
+/**
+ * How a struct member is written and read. Members of other structs with a
+ * codec are nested documents.
+ */
+template <typename T> struct FieldTraits {
+  static constexpr bool kFixed = Codec<T>::kFixed;
+  static constexpr size_t kSize = Codec<T>::kSize;
+
+  static void write(BufferWriter &writer, const char key[],
+                    const size_t key_size, const T &value) {
+    writer.writeByte(Element::Document);
+    writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+    Codec<T>::write(writer, value);
+  }
+
+  static bool read(const deserializer::DocumentElement &el, T &out) {
+    return el.type() == Element::Document &&
+           Codec<T>::read(el.getDataRef(), out);
+  }
+};
+
+template <> struct FieldTraits<double> {
+  static constexpr bool kFixed = true;
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Double);
+
+  static void write(BufferWriter &writer, const char key[],
+                    const size_t key_size, const double value) {
+    writer.writeByte(Element::Double);
+    writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+    writer.writeDouble(value);
+  }
+
+  /**
+   * Integers are widened, so that whole numbers written by other encoders
+   * still decode.
+   */
+  static bool read(const deserializer::DocumentElement &el, double &out) {
+    return el.tryGetNumber(out);
+  }
+};
+
+template <> struct FieldTraits<int32_t> {
+  static constexpr bool kFixed = true;
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Int32);
+
+  static void write(BufferWriter &writer, const char key[],
+                    const size_t key_size, const int32_t value) {
+    writer.writeByte(Element::Int32);
+    writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+    writer.writeInt32(value);
+  }
+
+  static bool read(const deserializer::DocumentElement &el, int32_t &out) {
+    return el.tryGetInt32(out);
+  }
+};
+
+template <> struct FieldTraits<int64_t> {
+  static constexpr bool kFixed = true;
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Int64);
+
+  static void write(BufferWriter &writer, const char key[],
+                    const size_t key_size, const int64_t value) {
+    writer.writeByte(Element::Int64);
+    writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+    writer.writeInt64(value);
+  }
+
+  static bool read(const deserializer::DocumentElement &el, int64_t &out) {
+    return el.tryGetInt(out);
+  }
+};
+
+template <> struct FieldTraits<bool> {
+  static constexpr bool kFixed = true;
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Byte);
+
+  static void write(BufferWriter &writer, const char key[],
+                    const size_t key_size, const bool value) {
+    writer.writeByte(Element::Boolean);
+    writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+    writer.writeByte(static_cast<uint8_t>(
+        value ? BooleanElementValue::True : BooleanElementValue::False));
+  }
+
+  static bool read(const deserializer::DocumentElement &el, bool &out) {
+    return el.tryGetBool(out);
+  }
+};
+
+/**
+ * Strings are written from, and decoded to, null-terminated strings. Decoded
+ * strings point into the document's buffer. A null pointer is a Null element.
+ */
+template <> struct FieldTraits<const char *> {
+  static constexpr bool kFixed = false;
+  // The smallest possible value is a null.
+  static constexpr size_t kSize = 0;
+
+  static void write(BufferWriter &writer, const char key[],
+                    const size_t key_size, const char *value) {
+    if (value == nullptr) {
+      writer.writeByte(Element::Null);
+      writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+      return;
+    }
+
+    size_t len = strlen(value);
+    writer.writeByte(Element::String);
+    writer.writeBuf(reinterpret_cast<const uint8_t *>(key), key_size);
+    writer.writeInt32(len + 1);
+    writer.writeStr(value, len);
+  }
+
+  static bool read(const deserializer::DocumentElement &el,
+                   const char *&out) {
+    if (el.type() == Element::Null) {
+      out = nullptr;
+      return true;
+    } else if (el.type() != Element::String) {
+      return false;
+    }
+
+    out = el.getStrRef();
+    return true;
+  }
+};
+
+/**
+ * Encodes a struct with a codec into `buf`. Like `serializer::Document`, the
+ * length is still accurate if the buffer overflows.
+ */
+template <typename T>
+serializer::Result encode(const T &value, uint8_t buf[], const size_t len) {
+  BufferWriter writer(buf, len);
+  Codec<T>::write(writer, value);
+
+  return { writer.overflowed() ? serializer::Status::BufferOverflow
+                               : serializer::Status::Ok,
+           writer.position() };
+}
+
+/**
+ * Decodes a document into a struct in a single pass over its elements. Keys
+ * that aren't part of the struct are ignored. Returns false if a field was
+ * missing or had the wrong type; the other fields are still filled in.
+ */
+template <typename T>
+bool decode(const deserializer::Document &doc, T &out) {
+  return Codec<T>::read(doc.getRef(), out);
+}
+
+} // namespace codec
+} // namespace bson
+} // namespace pot
+
+#define __POT_BSON_CODEC_FIELD_TYPE(name) decltype(type::name)
+
+#define __POT_BSON_CODEC_COUNT(name) +1
+
+#define __POT_BSON_CODEC_INDEX(name) kField_##name,
+
+#define __POT_BSON_CODEC_FIXED(name) \
+  &&::pot::bson::codec::FieldTraits<__POT_BSON_CODEC_FIELD_TYPE(name)>::kFixed
+
+#define __POT_BSON_CODEC_SIZE(name)                              \
+  +1 + sizeof(#name) +                                           \
+      ::pot::bson::codec::FieldTraits<__POT_BSON_CODEC_FIELD_TYPE( \
+          name)>::kSize
+
+#define __POT_BSON_CODEC_WRITE(name)                                          \
+  ::pot::bson::codec::FieldTraits<__POT_BSON_CODEC_FIELD_TYPE(name)>::write( \
+      writer, #name, sizeof(#name), value.name);
+
+#define __POT_BSON_CODEC_READ(name)                                          \
+  case ::pot::bson::hash::fnv1a_str(#name):                                  \
+    if (name_len == sizeof(#name) - 1 &&                                     \
+        memcmp(el.getNameRef(), #name, name_len) == 0) {                     \
+      uint64_t bit = static_cast<uint64_t>(1) << kField_##name;              \
+      ok = (seen & bit) == 0 &&                                              \
+           ::pot::bson::codec::FieldTraits<__POT_BSON_CODEC_FIELD_TYPE(      \
+               name)>::read(el, out.name) &&                                 \
+           ok;                                                               \
+      seen |= bit;                                                           \
+    }                                                                        \
+    break;
+
+/**
+ * Generates the codec for a struct from a list of its members, given as a
+ * macro that applies its argument to each member name, e.g.
+ *
+ *     #define READING_FIELDS(F) F(ts) F(temp) F(alarm)
+ *     POT_BSON_CODEC(Reading, READING_FIELDS)
+ *
+ * Members are encoded in that order with their own names as keys, which are
+ * compile-time constants. `Codec<T>::kSize` is the exact encoded size when
+ * `Codec<T>::kFixed` is true (every member is a number, boolean or a fixed
+ * nested struct), and the smallest possible size otherwise. Decoding hashes
+ * each key once and switches on it, so a duplicated key hash is a compile
+ * error rather than a silent mismatch. A document that repeats one of the
+ * struct's keys fails to decode, as does one missing any of them. At most 64
+ * members are supported.
+ *
+ * Has to be used outside of any namespace.
+ */
+#define POT_BSON_CODEC(Type, FIELDS)                                        \
+  namespace pot {                                                           \
+  namespace bson {                                                          \
+  namespace codec {                                                         \
+  template <> struct Codec<Type> {                                          \
+    using type = Type;                                                      \
+                                                                            \
+    static constexpr size_t kFields = 0 FIELDS(__POT_BSON_CODEC_COUNT);     \
+    static_assert(kFields <= 64, "too many codec fields");                  \
+    enum Field : size_t { FIELDS(__POT_BSON_CODEC_INDEX) };                 \
+    static constexpr uint64_t kAllFields =                                  \
+        kFields == 64 ? ~static_cast<uint64_t>(0)                           \
+                      : (static_cast<uint64_t>(1) << kFields) - 1;          \
+    static constexpr bool kFixed = true FIELDS(__POT_BSON_CODEC_FIXED);     \
+    static constexpr size_t kSize = static_cast<size_t>(TypeSize::Int32) + \
+                                    1 FIELDS(__POT_BSON_CODEC_SIZE);        \
+                                                                            \
+    static void write(BufferWriter &writer, const type &value) {            \
+      size_t start = writer.startDoc();                                     \
+      FIELDS(__POT_BSON_CODEC_WRITE)                                        \
+      writer.endDoc(start);                                                 \
+    }                                                                       \
+                                                                            \
+    static bool read(const uint8_t doc[], type &out) {                      \
+      int32_t len =                                                         \
+          endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);    \
+      const uint8_t *end = doc + len - 1;                                   \
+      const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);     \
+                                                                            \
+      /* A bit for each member read, by its position. */                  \
+      uint64_t seen = 0;                                                    \
+      bool ok = true;                                                       \
+      while (cur < end) {                                                   \
+        deserializer::DocumentElement el(cur, 0, end - cur);                \
+        size_t name_len = el.nameSize() - 1;                                \
+                                                                            \
+        switch (hash::fnv1a(hash::kFnvOffset,                               \
+                            reinterpret_cast<const uint8_t *>(              \
+                                el.getNameRef()),                           \
+                            name_len)) {                                    \
+          FIELDS(__POT_BSON_CODEC_READ)                                     \
+          default:                                                          \
+            break;                                                          \
+        }                                                                   \
+                                                                            \
+        cur += el.size();                                                   \
+      }                                                                     \
+                                                                            \
+      return ok && seen == kAllFields;                                      \
+    }                                                                       \
+  };                                                                        \
+  }                                                                         \
+  }                                                                         \
+  }
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef POT_BSON_COLUMNAR_COLUMN_H_
+#define POT_BSON_COLUMNAR_COLUMN_H_
+
+#include "../consts.hpp"
+#include "../deserializer/document_element.hpp"
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace columnar {
+
+/**
+ * The number of bytes needed for a bitmap with one bit per row.
+ */
+inline size_t bitmap_size(const size_t rows) {
+  return (rows + 7) / 8;
+}
+
+inline bool bitmap_get(const uint8_t bits[], const size_t row) {
+  return (bits[row / 8] >> (row % 8)) & 1;
+}
+
+inline void bitmap_set(uint8_t bits[], const size_t row, const bool value) {
+  uint8_t mask = 1 << (row % 8);
+  if (value) {
+    bits[row / 8] |= mask;
+  } else {
+    bits[row / 8] &= ~mask;
+  }
+}
+
+/**
+ * A typed column of values for one field across a batch of rows, addressed by
+ * a dot separated path, e.g. "gps.lat". Array elements are addressed by their
+ * index.
+ *
+ * The `present` bitmap has a bit set for every row that has a value of the
+ * column's type, and the optional `nulls` bitmap for every row where the
+ * field is null. A row with neither bit set is missing the field. Strings
+ * reference the documents' buffers.
+ */
+struct Column {
+  const char *path;
+  Element type;
+  double *dbl;
+  int32_t *int32;
+  int64_t *int64;
+  bool *boolean;
+  deserializer::data_type::Str *str;
+  uint8_t *present;
+  uint8_t *nulls;
+
+  static Column ofDouble(const char path[], double values[],
+                         uint8_t present[], uint8_t nulls[] = nullptr) {
+    return { path,    Element::Double, values,  nullptr, nullptr,
+             nullptr, nullptr,         present, nulls };
+  }
+
+  static Column ofInt32(const char path[], int32_t values[],
+                        uint8_t present[], uint8_t nulls[] = nullptr) {
+    return { path,    Element::Int32, nullptr, values, nullptr,
+             nullptr, nullptr,        present, nulls };
+  }
+
+  static Column ofInt64(const char path[], int64_t values[],
+                        uint8_t present[], uint8_t nulls[] = nullptr) {
+    return { path,    Element::Int64, nullptr, nullptr, values,
+             nullptr, nullptr,        present, nulls };
+  }
+
+  static Column ofBool(const char path[], bool values[], uint8_t present[],
+                       uint8_t nulls[] = nullptr) {
+    return { path,   Element::Boolean, nullptr, nullptr, nullptr,
+             values, nullptr,          present, nulls };
+  }
+
+  static Column ofStr(const char path[], deserializer::data_type::Str values[],
+                      uint8_t present[], uint8_t nulls[] = nullptr) {
+    return { path,    Element::String, nullptr, nullptr, nullptr,
+             nullptr, values,          present, nulls };
+  }
+};
+
+} // namespace columnar
+} // namespace bson
+} // namespace pot
+
+#endif
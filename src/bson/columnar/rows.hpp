@@ -0,0 +1,278 @@
+#ifndef POT_BSON_COLUMNAR_ROWS_H_
+#define POT_BSON_COLUMNAR_ROWS_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../serializer/result.hpp"
+#include "./column.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace columnar {
+
+/**
+ * Serializes columns back into BSON, either as one document per row or as a
+ * single document holding an array per column.
+ *
+ * The layout is worked out once from the column paths: every element header
+ * (type byte, key and terminator) is prepared up front, so writing a row is
+ * a copy of each header followed by the value. Dot separated paths become
+ * nested documents, and columns that share a parent should be next to each
+ * other, otherwise the parent is written more than once.
+ *
+ * Rows where a column is neither present nor null leave the field out, or
+ * write null in its array so that the indices stay in step. Parent documents
+ * are always written, even when all of their fields are left out.
+ */
+class RowEncoder {
+public:
+  /**
+   * `columns` must outlive the encoder.
+   */
+  RowEncoder(const Column columns[], const size_t count) : columns_(columns) {
+    std::vector<Component> open;
+
+    for (size_t c = 0; c < count; c++) {
+      const char *path = columns[c].path;
+      size_t depth = 0;
+
+      while (true) {
+        const char *dot = strchr(path, '.');
+        if (dot == nullptr) {
+          break;
+        }
+
+        Component component = { path, static_cast<size_t>(dot - path) };
+        if (depth < open.size() && !open[depth].equals(component)) {
+          this->close(open, depth);
+        }
+
+        if (depth == open.size()) {
+          open.push_back(component);
+          this->push(StepKind::Open, c, Element::Document, component);
+        }
+
+        path = dot + 1;
+        depth++;
+      }
+
+      this->close(open, depth);
+      this->push(StepKind::Field, c, columns[c].type, { path, strlen(path) });
+    }
+
+    this->close(open, 0);
+  }
+
+  /**
+   * Writes `count` documents, one per row, one after another.
+   */
+  serializer::Result encodeRows(const size_t count, uint8_t buf[],
+                                const size_t len) {
+    BufferWriter writer(buf, len);
+
+    for (size_t row = 0; row < count; row++) {
+      this->starts_.push_back(writer.startDoc());
+
+      for (const Step &step : this->steps_) {
+        switch (step.kind) {
+          case StepKind::Open:
+            this->writeHeader(writer, step);
+            this->starts_.push_back(writer.startDoc());
+            break;
+          case StepKind::Close:
+            writer.endDoc(this->starts_.back());
+            this->starts_.pop_back();
+            break;
+          case StepKind::Field: {
+            const Column &col = this->columns_[step.column];
+            if (bitmap_get(col.present, row)) {
+              this->writeHeader(writer, step);
+              this->writeValue(writer, col, row);
+            } else if (col.nulls != nullptr && bitmap_get(col.nulls, row)) {
+              this->writeHeader(writer, step, Element::Null);
+            }
+            break;
+          }
+        }
+      }
+
+      writer.endDoc(this->starts_.back());
+      this->starts_.pop_back();
+    }
+
+    return this->result(writer);
+  }
+
+  /**
+   * Writes a single document with an array of `count` values per column.
+   */
+  serializer::Result encodeColumns(const size_t count, uint8_t buf[],
+                                   const size_t len) {
+    BufferWriter writer(buf, len);
+    this->starts_.push_back(writer.startDoc());
+
+    for (const Step &step : this->steps_) {
+      switch (step.kind) {
+        case StepKind::Open:
+          this->writeHeader(writer, step);
+          this->starts_.push_back(writer.startDoc());
+          break;
+        case StepKind::Close:
+          writer.endDoc(this->starts_.back());
+          this->starts_.pop_back();
+          break;
+        case StepKind::Field: {
+          const Column &col = this->columns_[step.column];
+          this->writeHeader(writer, step, Element::Array);
+          size_t start = writer.startDoc();
+
+          IndexKey index;
+          for (size_t row = 0; row < count; row++, index.next()) {
+            if (bitmap_get(col.present, row)) {
+              writer.writeByte(col.type);
+              writer.writeStr(index.str, index.len);
+              this->writeValue(writer, col, row);
+            } else {
+              writer.writeByte(Element::Null);
+              writer.writeStr(index.str, index.len);
+            }
+          }
+
+          writer.endDoc(start);
+          break;
+        }
+      }
+    }
+
+    writer.endDoc(this->starts_.back());
+    this->starts_.pop_back();
+
+    return this->result(writer);
+  }
+
+private:
+  enum struct StepKind : uint8_t {
+    Open,
+    Close,
+    Field,
+  };
+
+  struct Component {
+    const char *name;
+    size_t len;
+
+    bool equals(const Component &other) const {
+      return this->len == other.len &&
+             memcmp(this->name, other.name, this->len) == 0;
+    }
+  };
+
+  struct Step {
+    StepKind kind;
+    size_t column;
+    // The element's type, key and terminator, within `headers_`.
+    size_t header;
+    size_t header_len;
+  };
+
+  /**
+   * An array index kept as decimal text, so that consecutive keys don't need
+   * to be formatted from scratch.
+   */
+  struct IndexKey {
+    char str[kIntKeySize] = { '0' };
+    size_t len = 1;
+
+    void next() {
+      size_t i = this->len;
+      while (i > 0 && this->str[i - 1] == '9') {
+        this->str[--i] = '0';
+      }
+
+      if (i > 0) {
+        this->str[i - 1]++;
+      } else {
+        memmove(&this->str[1], this->str, this->len++);
+        this->str[0] = '1';
+      }
+    }
+  };
+
+  const Column *columns_;
+  std::vector<Step> steps_;
+  std::vector<uint8_t> headers_;
+  std::vector<size_t> starts_;
+
+  void push(const StepKind kind, const size_t column, const Element type,
+            const Component &key) {
+    Step step = { kind, column, this->headers_.size(), 0 };
+
+    if (kind != StepKind::Close) {
+      this->headers_.push_back(static_cast<uint8_t>(type));
+      this->headers_.insert(this->headers_.end(), key.name,
+                            key.name + key.len);
+      this->headers_.push_back(0);
+      step.header_len = this->headers_.size() - step.header;
+    }
+
+    this->steps_.push_back(step);
+  }
+
+  void close(std::vector<Component> &open, const size_t depth) {
+    while (open.size() > depth) {
+      open.pop_back();
+      this->push(StepKind::Close, 0, Element::Terminator, { nullptr, 0 });
+    }
+  }
+
+  void writeHeader(BufferWriter &writer, const Step &step) const {
+    writer.writeBuf(&this->headers_[step.header], step.header_len);
+  }
+
+  void writeHeader(BufferWriter &writer, const Step &step,
+                   const Element type) const {
+    writer.writeByte(type);
+    writer.writeBuf(&this->headers_[step.header + 1], step.header_len - 1);
+  }
+
+  void writeValue(BufferWriter &writer, const Column &col,
+                  const size_t row) const {
+    switch (col.type) {
+      case Element::Double:
+        writer.writeDouble(col.dbl[row]);
+        break;
+      case Element::Int32:
+        writer.writeInt32(col.int32[row]);
+        break;
+      case Element::Int64:
+        writer.writeInt64(col.int64[row]);
+        break;
+      case Element::Boolean:
+        writer.writeByte(static_cast<uint8_t>(
+            col.boolean[row] ? BooleanElementValue::True
+                             : BooleanElementValue::False));
+        break;
+      case Element::String:
+        writer.writeInt32(col.str[row].len + 1);
+        writer.writeStr(col.str[row].str, col.str[row].len);
+        break;
+      default:
+        break;
+    }
+  }
+
+  serializer::Result result(const BufferWriter &writer) const {
+    return { writer.overflowed() ? serializer::Status::BufferOverflow
+                                 : serializer::Status::Ok,
+             writer.position() };
+  }
+};
+
+} // namespace columnar
+} // namespace bson
+} // namespace pot
+
+#endif
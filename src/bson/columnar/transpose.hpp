@@ -0,0 +1,227 @@
+#ifndef POT_BSON_COLUMNAR_TRANSPOSE_H_
+#define POT_BSON_COLUMNAR_TRANSPOSE_H_
+
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include "../parallel/thread_pool.hpp"
+#include "./column.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace columnar {
+
+static constexpr size_t kTransposeGrain = 256;
+
+/**
+ * Fills columns from a batch of documents, one row per document.
+ *
+ * Each document is walked once, matching every element against the paths
+ * that are still unresolved at that depth, and descending only into the
+ * documents and arrays that some path continues through. The walk stops as
+ * soon as every column has been resolved.
+ *
+ * Double columns also take Int32 and Int64 values, and Int64 columns take
+ * Int32 values. Any other type is a mismatch and the row is left missing.
+ * Values of missing and null rows are zeroed. Documents should already have
+ * been validated.
+ */
+template <size_t max_columns = 32> class Transposer {
+public:
+  /**
+   * `columns` must outlive the transposer. At most `max_columns` columns are
+   * filled.
+   */
+  Transposer(const Column columns[], const size_t count) :
+      columns_(columns), count_(count < max_columns ? count : max_columns) {}
+
+  /**
+   * Fills row `row` of every column from `doc`. Returns the number of fields
+   * that had a value of the wrong type.
+   */
+  size_t row(const deserializer::Document &doc, const size_t row) const {
+    size_t cols[max_columns];
+    const char *paths[max_columns];
+    for (size_t c = 0; c < this->count_; c++) {
+      this->reset(c, row);
+      cols[c] = c;
+      paths[c] = this->columns_[c].path;
+    }
+
+    size_t mismatches = 0;
+    this->scan(doc.getRef(), row, cols, paths, this->count_, mismatches);
+    return mismatches;
+  }
+
+  /**
+   * Fills `count` rows from `docs`. Returns the number of fields that had a
+   * value of the wrong type.
+   */
+  size_t transpose(const deserializer::Document docs[],
+                   const size_t count) const {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+      mismatches += this->row(docs[i], i);
+    }
+
+    return mismatches;
+  }
+
+  /**
+   * Fills `count` rows from `docs` on the pool. Rows are handed out in
+   * multiples of 8 so that no two workers write to the same bitmap byte.
+   */
+  size_t transpose(parallel::ThreadPool &pool,
+                   const deserializer::Document docs[], const size_t count,
+                   const size_t grain = kTransposeGrain) const {
+    std::atomic<size_t> mismatches(0);
+
+    parallel::parallel_for(
+        pool, bitmap_size(count), bitmap_size(grain),
+        [&](size_t begin, size_t end) {
+          size_t chunk_mismatches = 0;
+          size_t last = end * 8 < count ? end * 8 : count;
+          for (size_t i = begin * 8; i < last; i++) {
+            chunk_mismatches += this->row(docs[i], i);
+          }
+          mismatches.fetch_add(chunk_mismatches, std::memory_order_relaxed);
+        });
+
+    return mismatches.load();
+  }
+
+private:
+  const Column *columns_;
+  size_t count_;
+
+  void reset(const size_t c, const size_t row) const {
+    const Column &col = this->columns_[c];
+    switch (col.type) {
+      case Element::Double:
+        col.dbl[row] = 0;
+        break;
+      case Element::Int32:
+        col.int32[row] = 0;
+        break;
+      case Element::Int64:
+        col.int64[row] = 0;
+        break;
+      case Element::Boolean:
+        col.boolean[row] = false;
+        break;
+      case Element::String:
+        col.str[row] = { nullptr, 0 };
+        break;
+      default:
+        break;
+    }
+
+    bitmap_set(col.present, row, false);
+    if (col.nulls != nullptr) {
+      bitmap_set(col.nulls, row, false);
+    }
+  }
+
+  bool store(const size_t c, const size_t row,
+             const deserializer::DocumentElement &el) const {
+    const Column &col = this->columns_[c];
+    Element type = el.type();
+
+    if (type == Element::Null) {
+      if (col.nulls != nullptr) {
+        bitmap_set(col.nulls, row, true);
+      }
+      return true;
+    }
+
+    bool ok = false;
+    switch (col.type) {
+      case Element::Double:
+        ok = el.isNumber();
+        if (ok) {
+          col.dbl[row] = el.getNumber();
+        }
+        break;
+      case Element::Int32:
+        ok = el.tryGetInt32(col.int32[row]);
+        break;
+      case Element::Int64:
+        ok = el.tryGetInt(col.int64[row]);
+        break;
+      case Element::Boolean:
+        ok = el.tryGetBool(col.boolean[row]);
+        break;
+      case Element::String:
+        ok = el.tryGetStr(col.str[row]);
+        break;
+      default:
+        break;
+    }
+
+    if (ok) {
+      bitmap_set(col.present, row, true);
+    }
+
+    return ok;
+  }
+
+  void scan(const uint8_t *doc, const size_t row, size_t cols[],
+            const char *paths[], size_t n, size_t &mismatches) const {
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);
+    const uint8_t *end = doc + len - static_cast<uint8_t>(TypeSize::Byte);
+    const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);
+
+    while (cur < end && n > 0) {
+      deserializer::DocumentElement el(cur, 0, end - cur);
+      const char *name = el.getNameRef();
+      size_t name_len = el.nameSize() - 1;
+      bool container =
+          el.type() == Element::Document || el.type() == Element::Array;
+
+      size_t child_cols[max_columns];
+      const char *child_paths[max_columns];
+      size_t child_n = 0;
+
+      for (size_t i = 0; i < n;) {
+        const char *path = paths[i];
+        if (strncmp(path, name, name_len) != 0 ||
+            (path[name_len] != '\0' && path[name_len] != '.')) {
+          i++;
+          continue;
+        }
+
+        if (path[name_len] == '\0') {
+          if (!this->store(cols[i], row, el)) {
+            mismatches++;
+          }
+        } else if (container) {
+          child_cols[child_n] = cols[i];
+          child_paths[child_n] = &path[name_len + 1];
+          child_n++;
+        }
+
+        // Resolved here either way, so stop looking for it.
+        n--;
+        cols[i] = cols[n];
+        paths[i] = paths[n];
+      }
+
+      if (child_n > 0) {
+        this->scan(el.getDataRef(), row, child_cols, child_paths, child_n,
+                   mismatches);
+      }
+
+      cur += el.size();
+    }
+  }
+};
+
+} // namespace columnar
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef POT_BSON_COMPRESS_DICTIONARY_H_
+#define POT_BSON_COMPRESS_DICTIONARY_H_
+
+#include "../consts.hpp"
+#include "../deserializer/array.hpp"
+#include "../deserializer/array_iter.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_iter.hpp"
+#include "./lz.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace compress {
+
+/**
+ * Short strings are likely to be enum-like values, e.g. a status, that are
+ * worth having in a dictionary. Longer ones are left out.
+ */
+static constexpr size_t kDictMaxStrLen = 32;
+
+/**
+ * Builds a dictionary out of the parts of sample messages that repeat across
+ * them: the type byte and name that start each element, which is the bulk of
+ * the redundancy in a small message, and short string values.
+ *
+ * This is meant to run offline or at startup, not per message, so it
+ * allocates.
+ */
+class DictionaryTrainer {
+public:
+  /**
+   * Adds a sample document, which has to be valid.
+   */
+  void add(const uint8_t doc[], const size_t len) {
+    this->addDoc(deserializer::Document(doc, len));
+  }
+
+  /**
+   * Writes the dictionary into `out`, filling at most `cap` bytes, and
+   * returns its length.
+   *
+   * Fragments are ranked by the number of bytes they'd save over all the
+   * samples, and the best are written last, so that they're the closest to
+   * the data and the first that the compressor's table keeps.
+   */
+  size_t build(uint8_t out[], const size_t cap) const {
+    std::vector<std::pair<size_t, const std::string *>> ranked;
+    for (auto const &entry : this->counts_) {
+      // A fragment seen once won't repeat in other messages.
+      if (entry.second > 1) {
+        ranked.emplace_back(entry.second * entry.first.size(), &entry.first);
+      }
+    }
+    std::sort(ranked.begin(), ranked.end(),
+              [](const std::pair<size_t, const std::string *> &a,
+                 const std::pair<size_t, const std::string *> &b) {
+                return a.first != b.first ? a.first > b.first
+                                          : *a.second < *b.second;
+              });
+
+    size_t len = 0;
+    size_t picked = 0;
+    for (; picked < ranked.size(); picked++) {
+      size_t size = ranked[picked].second->size();
+      if (len + size > cap) {
+        break;
+      }
+      len += size;
+    }
+
+    size_t pos = len;
+    for (size_t i = 0; i < picked; i++) {
+      const std::string &fragment = *ranked[i].second;
+      pos -= fragment.size();
+      memcpy(&out[pos], fragment.data(), fragment.size());
+    }
+
+    return len;
+  }
+
+private:
+  std::unordered_map<std::string, size_t> counts_;
+
+  template <typename Container> void addDoc(const Container &doc) {
+    for (auto const &el : doc) {
+      const char *start = reinterpret_cast<const char *>(el.getRef());
+      // The type byte, the name and its terminator.
+      size_t header = 1 + el.nameSize();
+      this->counts_[std::string(start, header)]++;
+
+      switch (el.type()) {
+        case Element::String: {
+          if (static_cast<size_t>(el.getStrLen()) <= kDictMaxStrLen) {
+            this->counts_[std::string(start, el.size())]++;
+          }
+          break;
+        }
+        case Element::Document: {
+          this->addDoc(el.getDoc());
+          break;
+        }
+        case Element::Array: {
+          this->addDoc(el.getArr());
+          break;
+        }
+        default: {
+          break;
+        }
+      }
+    }
+  }
+};
+
+} // namespace compress
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef POT_BSON_COMPRESS_FRAME_H_
+#define POT_BSON_COMPRESS_FRAME_H_
+
+#include "../deserializer/document.hpp"
+#include "../endian.hpp"
+#include "./lz.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace compress {
+
+/**
+ * A frame wraps one compressed document:
+ * - the codec's id,
+ * - the id of the dictionary it was compressed with, or 0 for none, as a
+ *   little-endian 32-bit integer,
+ * - the document's length, as a little-endian 32-bit integer,
+ * - the compressed document, up to the end of the frame.
+ *
+ * The codec is a template parameter, so others can be plugged in. A codec is
+ * a type with:
+ *
+ *     static constexpr uint8_t kId;
+ *     static size_t compress(const uint8_t src[], size_t len, uint8_t dst[],
+ *                            size_t cap, const Dictionary *dict);
+ *     static bool decompress(const uint8_t src[], size_t len, uint8_t dst[],
+ *                            size_t dst_len, const Dictionary *dict);
+ *
+ * where `compress` returns the full compressed length even when it's more
+ * than `cap`.
+ */
+
+static constexpr size_t kFrameHeaderSize = 9;
+
+enum struct Status : uint8_t {
+  Ok,
+  BufferOverflow,
+  // The frame is truncated, or its data doesn't decompress to its length.
+  Malformed,
+  UnknownCodec,
+  // The frame needs a different dictionary than the one given.
+  DictionaryMismatch,
+};
+
+/**
+ * Like `serializer::Result`, the length is the required length when the
+ * output buffer overflowed.
+ */
+struct Result {
+  Status status;
+  size_t len;
+};
+
+/**
+ * Stores the document as is, for messages that don't compress. Reading it
+ * doesn't need a copy.
+ */
+struct Stored {
+  static constexpr uint8_t kId = 0;
+
+  static size_t compress(const uint8_t src[], const size_t len, uint8_t dst[],
+                         const size_t cap, const Dictionary *) {
+    if (len <= cap) {
+      memcpy(dst, src, len);
+    }
+    return len;
+  }
+
+  static bool decompress(const uint8_t src[], const size_t len, uint8_t dst[],
+                         const size_t dst_len, const Dictionary *) {
+    if (len != dst_len) {
+      return false;
+    }
+    memcpy(dst, src, len);
+    return true;
+  }
+};
+
+struct Lz {
+  static constexpr uint8_t kId = 1;
+
+  static size_t compress(const uint8_t src[], const size_t len, uint8_t dst[],
+                         const size_t cap, const Dictionary *dict) {
+    return lz_compress(src, len, dst, cap, dict);
+  }
+
+  static bool decompress(const uint8_t src[], const size_t len, uint8_t dst[],
+                         const size_t dst_len, const Dictionary *dict) {
+    return lz_decompress(src, len, dst, dst_len, dict);
+  }
+};
+
+inline void write_frame_header(uint8_t out[], const uint8_t codec,
+                               const uint32_t dict_id, const size_t len) {
+  out[0] = codec;
+  endian::primitive_to_buffer<uint32_t, TypeSize::Int32>(&out[1], dict_id);
+  endian::primitive_to_buffer<uint32_t, TypeSize::Int32>(&out[5], len);
+}
+
+/**
+ * Writes a frame for the `len` bytes of a serialized document into `out`.
+ * Falls back to storing the document when the codec doesn't make it smaller.
+ */
+template <typename Codec = Lz>
+Result write_frame(const uint8_t doc[], const size_t len, uint8_t out[],
+                   const size_t cap, const Dictionary *dict = nullptr) {
+  size_t room = cap > kFrameHeaderSize ? cap - kFrameHeaderSize : 0;
+  uint8_t *data = out + kFrameHeaderSize;
+
+  size_t packed = Codec::compress(doc, len, data, room, dict);
+  uint8_t codec = Codec::kId;
+  uint32_t dict_id = dict ? dict->id : 0;
+
+  if (packed >= len) {
+    packed = Stored::compress(doc, len, data, room, nullptr);
+    codec = Stored::kId;
+    dict_id = 0;
+  }
+
+  size_t frame_len = kFrameHeaderSize + packed;
+  if (frame_len > cap) {
+    return { Status::BufferOverflow, frame_len };
+  }
+
+  write_frame_header(out, codec, dict_id, len);
+  return { Status::Ok, frame_len };
+}
+
+/**
+ * Returns the length of the document in a frame, to size the buffer for
+ * `read_frame`, or 0 if the frame is truncated.
+ */
+inline size_t frame_doc_len(const uint8_t frame[], const size_t len) {
+  if (len < kFrameHeaderSize) {
+    return 0;
+  }
+
+  return endian::buffer_to_primitive<uint32_t, TypeSize::Int32>(frame, 5);
+}
+
+/**
+ * Reads the document out of a frame into `doc`, decompressing it into `out`.
+ * A stored document is read straight from the frame, and `out` is left
+ * untouched. The length is the document's.
+ *
+ * The document isn't validated.
+ */
+template <typename Codec = Lz>
+Result read_frame(const uint8_t frame[], const size_t len, uint8_t out[],
+                  const size_t cap, deserializer::Document &doc,
+                  const Dictionary *dict = nullptr) {
+  if (len < kFrameHeaderSize) {
+    return { Status::Malformed, 0 };
+  }
+
+  uint8_t codec = frame[0];
+  uint32_t dict_id =
+      endian::buffer_to_primitive<uint32_t, TypeSize::Int32>(frame, 1);
+  size_t doc_len = frame_doc_len(frame, len);
+  const uint8_t *data = frame + kFrameHeaderSize;
+  size_t data_len = len - kFrameHeaderSize;
+
+  if (codec == Stored::kId) {
+    if (data_len != doc_len) {
+      return { Status::Malformed, doc_len };
+    }
+
+    doc = deserializer::Document(data, doc_len);
+    return { Status::Ok, doc_len };
+  }
+
+  if (codec != Codec::kId) {
+    return { Status::UnknownCodec, doc_len };
+  }
+  if (dict_id != (dict ? dict->id : 0)) {
+    return { Status::DictionaryMismatch, doc_len };
+  }
+  if (doc_len > cap) {
+    return { Status::BufferOverflow, doc_len };
+  }
+  if (!Codec::decompress(data, data_len, out, doc_len,
+                         dict_id ? dict : nullptr)) {
+    return { Status::Malformed, doc_len };
+  }
+
+  doc = deserializer::Document(out, doc_len);
+  return { Status::Ok, doc_len };
+}
+
+} // namespace compress
+} // namespace bson
+} // namespace pot
+
+#endif
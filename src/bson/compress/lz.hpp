@@ -0,0 +1,360 @@
+#ifndef POT_BSON_COMPRESS_LZ_H_
+#define POT_BSON_COMPRESS_LZ_H_
+
+#include "../endian.hpp"
+#include "../hash.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace compress {
+
+/**
+ * A byte-oriented LZ77 codec in the style of LZ4's block format. It has no
+ * entropy coding, so decoding is little more than copies.
+ *
+ * The input is a series of sequences, each made of:
+ * - a token, whose high nibble is the number of literals and low nibble the
+ *   match length minus `kLzMinMatch`, where 15 means that more bytes follow,
+ *   each adding up to 255 until one is less than 255,
+ * - the literals,
+ * - the match's offset back from the current position, as a little-endian
+ *   16-bit integer, which is left out of the last sequence.
+ *
+ * Matches may reach back past the start of the data into a dictionary, which
+ * is treated as if it came right before it.
+ */
+
+static constexpr size_t kLzMinMatch = 4;
+static constexpr size_t kLzMaxOffset = 65535;
+static constexpr size_t kLzHashBits = 12;
+static constexpr uint8_t kLzRunMask = 15;
+
+/**
+ * Content that's shared by the compressor and decompressor ahead of time,
+ * usually built by `DictionaryTrainer`. The id lets a frame record which
+ * dictionary it needs.
+ */
+struct Dictionary {
+  const uint8_t *data;
+  size_t len;
+  uint32_t id;
+};
+
+inline Dictionary make_dictionary(const uint8_t data[], const size_t len) {
+  uint32_t id =
+      static_cast<uint32_t>(hash::fnv1a(hash::kFnvOffset, data, len));
+  // Zero is reserved for no dictionary.
+  return { data, len, id == 0 ? 1 : id };
+}
+
+/**
+ * The most that `lz_compress` can write for `len` bytes of input.
+ */
+inline size_t lz_bound(const size_t len) {
+  return len + len / 255 + 16;
+}
+
+/**
+ * Appends to a buffer of fixed capacity, counting the bytes that don't fit.
+ */
+class LzOutput {
+public:
+  LzOutput(uint8_t buf[], const size_t cap) : buf_(buf), cap_(cap) {}
+
+  void put(const uint8_t byte) {
+    if (this->pos_ < this->cap_) {
+      this->buf_[this->pos_] = byte;
+    }
+    this->pos_++;
+  }
+
+  void putBuf(const uint8_t buf[], const size_t len) {
+    if (this->pos_ + len <= this->cap_) {
+      memcpy(&this->buf_[this->pos_], buf, len);
+    }
+    this->pos_ += len;
+  }
+
+  void putRun(size_t len) {
+    while (len >= 255) {
+      this->put(255);
+      len -= 255;
+    }
+    this->put(static_cast<uint8_t>(len));
+  }
+
+  size_t position() const {
+    return this->pos_;
+  }
+
+private:
+  uint8_t *buf_;
+  size_t cap_;
+  size_t pos_ = 0;
+};
+
+/**
+ * Reads the dictionary and the input as one contiguous window.
+ */
+class LzWindow {
+public:
+  LzWindow(const uint8_t src[], const size_t len, const Dictionary *dict) :
+      src_(src), dict_(dict ? dict->data : nullptr),
+      dict_len_(dict ? dict->len : 0), end_(dict_len_ + len) {}
+
+  size_t start() const {
+    return this->dict_len_;
+  }
+
+  size_t end() const {
+    return this->end_;
+  }
+
+  const uint8_t *at(const size_t pos) const {
+    return pos < this->dict_len_ ? &this->dict_[pos]
+                                 : &this->src_[pos - this->dict_len_];
+  }
+
+  uint32_t read32(const size_t pos) const {
+    uint32_t value;
+    if (pos >= this->dict_len_ || pos + 4 <= this->dict_len_) {
+      memcpy(&value, this->at(pos), sizeof(value));
+      return value;
+    }
+
+    // Straddles the end of the dictionary.
+    uint8_t buf[sizeof(value)];
+    for (size_t i = 0; i < sizeof(value); i++) {
+      buf[i] = *this->at(pos + i);
+    }
+    memcpy(&value, buf, sizeof(value));
+    return value;
+  }
+
+  /**
+   * The number of bytes that match from `cand` and `cur`, where `cand` comes
+   * before `cur`, up to the end of the input.
+   */
+  size_t extend(const size_t cand, const size_t cur) const {
+    size_t n = 0;
+
+    // Eight bytes at a time while both are in the input.
+    while (cand + n >= this->dict_len_ && cur + n + 8 <= this->end_) {
+      uint64_t a, b;
+      memcpy(&a, this->at(cand + n), sizeof(a));
+      memcpy(&b, this->at(cur + n), sizeof(b));
+      uint64_t diff = a ^ b;
+
+      if (diff != 0) {
+        return n + (endian::is_big_endian() ? __builtin_clzll(diff)
+                                            : __builtin_ctzll(diff)) /
+                       8;
+      }
+      n += 8;
+    }
+
+    while (cur + n < this->end_ && *this->at(cand + n) == *this->at(cur + n)) {
+      n++;
+    }
+    return n;
+  }
+
+private:
+  const uint8_t *src_;
+  const uint8_t *dict_;
+  size_t dict_len_;
+  size_t end_;
+};
+
+inline uint32_t lz_hash(const uint32_t seq, const unsigned bits) {
+  return (seq * 2654435761u) >> (32 - bits);
+}
+
+/**
+ * The size of the hash table for a window, which is kept small for small
+ * messages since clearing it would otherwise cost more than compressing them.
+ */
+inline unsigned lz_hash_bits(const size_t window) {
+  unsigned bits = 8;
+  while (bits < kLzHashBits && (static_cast<size_t>(1) << bits) < window) {
+    bits++;
+  }
+  return bits;
+}
+
+inline void lz_write_sequence(LzOutput &out, const uint8_t literals[],
+                              const size_t lit_len, const size_t offset,
+                              const size_t match_len) {
+  size_t match_run = match_len - kLzMinMatch;
+  uint8_t token =
+      (lit_len < kLzRunMask ? lit_len : kLzRunMask) << 4 |
+      (match_len == 0 ? 0 : match_run < kLzRunMask ? match_run : kLzRunMask);
+
+  out.put(token);
+  if (lit_len >= kLzRunMask) {
+    out.putRun(lit_len - kLzRunMask);
+  }
+  out.putBuf(literals, lit_len);
+
+  if (match_len == 0) {
+    return;
+  }
+
+  out.put(offset & 0xFF);
+  out.put(offset >> 8);
+  if (match_run >= kLzRunMask) {
+    out.putRun(match_run - kLzRunMask);
+  }
+}
+
+/**
+ * Compresses `len` bytes of `src` into `dst`, writing at most `cap` bytes,
+ * and returns the compressed length. `dst` overflowed if that's more than
+ * `cap`; `lz_bound` is always enough.
+ */
+inline size_t lz_compress(const uint8_t src[], const size_t len, uint8_t dst[],
+                          const size_t cap,
+                          const Dictionary *dict = nullptr) {
+  LzWindow window(src, len, dict);
+  LzOutput out(dst, cap);
+
+  // Positions plus one, so that zero is empty.
+  uint32_t table[1 << kLzHashBits];
+  unsigned bits = lz_hash_bits(window.end());
+  memset(table, 0, sizeof(table[0]) << bits);
+
+  // Only the end of the dictionary is in reach of the input.
+  size_t dict_from =
+      window.start() > kLzMaxOffset ? window.start() - kLzMaxOffset : 0;
+  for (size_t pos = dict_from; pos + kLzMinMatch <= window.start(); pos++) {
+    table[lz_hash(window.read32(pos), bits)] = pos + 1;
+  }
+
+  size_t anchor = window.start();
+  size_t pos = window.start();
+  size_t misses = 0;
+
+  while (pos + kLzMinMatch <= window.end()) {
+    uint32_t seq = window.read32(pos);
+    uint32_t &slot = table[lz_hash(seq, bits)];
+    size_t cand = slot;
+    slot = pos + 1;
+
+    if (cand == 0 || pos - (cand - 1) > kLzMaxOffset ||
+        window.read32(cand - 1) != seq) {
+      // Skip ahead faster through data that doesn't compress.
+      pos += 1 + (misses++ >> 5);
+      continue;
+    }
+
+    cand--;
+    size_t match_len = kLzMinMatch + window.extend(cand + kLzMinMatch,
+                                                   pos + kLzMinMatch);
+    lz_write_sequence(out, window.at(anchor), pos - anchor, pos - cand,
+                      match_len);
+
+    pos += match_len;
+    anchor = pos;
+    misses = 0;
+  }
+
+  if (anchor < window.end()) {
+    lz_write_sequence(out, window.at(anchor), window.end() - anchor, 0, 0);
+  }
+
+  return out.position();
+}
+
+inline bool lz_read_run(const uint8_t src[], const size_t len, size_t &pos,
+                        size_t &out) {
+  uint8_t byte;
+  do {
+    if (pos >= len) {
+      return false;
+    }
+    byte = src[pos++];
+    out += byte;
+  } while (byte == 255);
+
+  return true;
+}
+
+/**
+ * Decompresses `len` bytes of `src` into exactly `dst_len` bytes of `dst`,
+ * with the same dictionary that it was compressed with. Returns false if the
+ * input is malformed or doesn't decompress to `dst_len` bytes.
+ */
+inline bool lz_decompress(const uint8_t src[], const size_t len, uint8_t dst[],
+                          const size_t dst_len,
+                          const Dictionary *dict = nullptr) {
+  size_t dict_len = dict ? dict->len : 0;
+  size_t ip = 0;
+  size_t op = 0;
+
+  while (ip < len) {
+    uint8_t token = src[ip++];
+
+    size_t lit_len = token >> 4;
+    if (lit_len == kLzRunMask && !lz_read_run(src, len, ip, lit_len)) {
+      return false;
+    }
+    if (lit_len > len - ip || lit_len > dst_len - op) {
+      return false;
+    }
+    memcpy(&dst[op], &src[ip], lit_len);
+    ip += lit_len;
+    op += lit_len;
+
+    if (ip == len) {
+      break;
+    }
+
+    if (len - ip < 2) {
+      return false;
+    }
+    size_t offset = src[ip] | static_cast<size_t>(src[ip + 1]) << 8;
+    ip += 2;
+
+    size_t match_len = token & kLzRunMask;
+    if (match_len == kLzRunMask && !lz_read_run(src, len, ip, match_len)) {
+      return false;
+    }
+    match_len += kLzMinMatch;
+
+    if (offset == 0 || offset > op + dict_len || match_len > dst_len - op) {
+      return false;
+    }
+
+    if (offset > op) {
+      // Starts in the dictionary, and may carry on into the output.
+      size_t from = dict_len - (offset - op);
+      size_t in_dict = dict_len - from;
+      size_t take = match_len < in_dict ? match_len : in_dict;
+      memcpy(&dst[op], &dict->data[from], take);
+      op += take;
+      match_len -= take;
+      offset = op;
+    }
+
+    if (offset >= match_len) {
+      memcpy(&dst[op], &dst[op - offset], match_len);
+      op += match_len;
+    } else {
+      // Overlapping, which repeats the last `offset` bytes.
+      for (size_t i = 0; i < match_len; i++, op++) {
+        dst[op] = dst[op - offset];
+      }
+    }
+  }
+
+  return op == dst_len;
+}
+
+} // namespace compress
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef POT_BSON_CONSTS_H_
 #define POT_BSON_CONSTS_H_
 
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 
@@ -36,8 +37,91 @@ enum struct Element : uint8_t {
 
 enum struct BinaryElementSubtype : uint8_t {
   Generic = 0x00,
+  Vector = 0x09,
+  // The first of the user defined subtypes.
+  Series = 0x80,
 };
 
+/**
+ * The element type of a Vector binary, its first byte. The second byte is
+ * the number of unused bits at the end of a packed bit vector, and 0 for the
+ * others.
+ */
+enum struct VectorDType : uint8_t {
+  Int8 = 0x03,
+  PackedBit = 0x10,
+  Float32 = 0x27,
+};
+
+static constexpr size_t kVectorHeaderSize = 2;
+
+/**
+ * Checks a Vector binary's header against its length.
+ */
+inline bool is_valid_vector(const uint8_t bin[], const size_t len) {
+  if (len < kVectorHeaderSize) {
+    return false;
+  }
+
+  uint8_t padding = bin[1];
+  size_t data_len = len - kVectorHeaderSize;
+  switch (static_cast<VectorDType>(bin[0])) {
+    case VectorDType::Int8:
+      return padding == 0;
+    case VectorDType::Float32:
+      return padding == 0 && data_len % 4 == 0;
+    case VectorDType::PackedBit:
+      return padding < 8 && (padding == 0 || data_len > 0);
+  }
+
+  return false;
+}
+
+/**
+ * How a Series binary packs its values. It starts with this byte, followed by
+ * the number of values as a little-endian 32-bit integer.
+ */
+enum struct SeriesEncoding : uint8_t {
+  // Int64 values as zigzag varints of the difference from the previous one.
+  DeltaInt64 = 0x01,
+  // Doubles XORed with the previous one, Gorilla style.
+  XorDouble = 0x02,
+};
+
+static constexpr size_t kSeriesHeaderSize = 5;
+
+inline bool is_valid_series(const uint8_t bin[], const size_t len) {
+  if (len < kSeriesHeaderSize) {
+    return false;
+  }
+
+  switch (static_cast<SeriesEncoding>(bin[0])) {
+    case SeriesEncoding::DeltaInt64:
+    case SeriesEncoding::XorDouble:
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * Whether a binary's subtype is supported, and its contents are valid for
+ * that subtype.
+ */
+inline bool is_valid_binary(const uint8_t subtype, const uint8_t bin[],
+                            const size_t len) {
+  switch (static_cast<BinaryElementSubtype>(subtype)) {
+    case BinaryElementSubtype::Generic:
+      return true;
+    case BinaryElementSubtype::Vector:
+      return is_valid_vector(bin, len);
+    case BinaryElementSubtype::Series:
+      return is_valid_series(bin, len);
+  }
+
+  return false;
+}
+
 enum struct BooleanElementValue : uint8_t {
   False = 0x00,
   True = 0x01,
@@ -0,0 +1,384 @@
+#ifndef POT_BSON_DELTA_DELTA_H_
+#define POT_BSON_DELTA_DELTA_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace delta {
+
+enum struct Status {
+  /**
+   * The operation completed without errors.
+   */
+  Ok,
+  /**
+   * The output would have overflowed the buffer. The length in the result is
+   * still accurate and can be used to size a new buffer.
+   */
+  BufferOverflow,
+  /**
+   * The patch doesn't apply to the given document, e.g. it references a key
+   * that doesn't exist or was produced from a different base document.
+   */
+  InvalidPatch,
+};
+
+struct Result {
+  Status status;
+  size_t len;
+};
+
+/**
+ * A patch is a BSON document with one entry per change, in the order of the
+ * target document. The first character of each entry's key is its kind and the
+ * rest is the name of the field it applies to:
+ *
+ * - "+name": value -- replace the field, or insert it if it doesn't exist.
+ * - "-name": null -- remove the field.
+ * - "=name": null -- copy all fields up to and including this one unchanged.
+ *   Only emitted to position an insertion in the middle of a document.
+ * - "~name": document -- a nested patch for a sub-document or array.
+ *
+ * Fields that aren't mentioned are copied from the base document as-is, so
+ * applying a patch reproduces the target document byte-for-byte.
+ */
+enum struct Change : char {
+  Set = '+',
+  Remove = '-',
+  Keep = '=',
+  Diff = '~',
+};
+
+/**
+ * A view over the elements of a document, from the first element up to (but
+ * excluding) the terminator.
+ */
+struct Range {
+  const uint8_t *begin;
+  const uint8_t *end;
+
+  static Range of(const deserializer::Document &doc) {
+    const uint8_t *ref = doc.getRef();
+    return { ref + static_cast<uint8_t>(TypeSize::Int32),
+             ref + doc.len() - static_cast<uint8_t>(TypeSize::Byte) };
+  }
+
+  static Range of(const deserializer::DocumentElement &el) {
+    const uint8_t *ref = el.getDataRef();
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(ref, 0);
+    return { ref + static_cast<uint8_t>(TypeSize::Int32),
+             ref + len - static_cast<uint8_t>(TypeSize::Byte) };
+  }
+};
+
+inline deserializer::DocumentElement element_at(const uint8_t *ptr,
+                                                const uint8_t *end) {
+  return deserializer::DocumentElement(ptr, 0, end - ptr);
+}
+
+inline bool element_named(const deserializer::DocumentElement &el,
+                          const char name[], const size_t name_len) {
+  return el.nameSize() - 1 == name_len &&
+         memcmp(el.getNameRef(), name, name_len) == 0;
+}
+
+/**
+ * Returns the first element in `[from, end)` with the given name, or nullptr.
+ */
+inline const uint8_t *find_element(const uint8_t *from, const uint8_t *end,
+                                   const char name[], const size_t name_len) {
+  while (from < end) {
+    deserializer::DocumentElement el = element_at(from, end);
+    if (element_named(el, name, name_len)) {
+      return from;
+    }
+    from += el.size();
+  }
+
+  return nullptr;
+}
+
+class Differ {
+public:
+  Differ(uint8_t out[], const size_t out_len) : writer_(out, out_len) {}
+
+  Result diff(const deserializer::Document &prev,
+              const deserializer::Document &next) {
+    this->diffLevel(Range::of(prev), Range::of(next));
+
+    Result res;
+    res.len = this->writer_.position();
+    res.status =
+        this->writer_.overflowed() ? Status::BufferOverflow : Status::Ok;
+    return res;
+  }
+
+private:
+  BufferWriter writer_;
+
+  void writeKey(const Change kind, const deserializer::DocumentElement &el) {
+    this->writer_.writeByte(static_cast<uint8_t>(kind));
+    this->writer_.writeStr(el.getNameRef(), el.nameSize() - 1);
+  }
+
+  void writeMarker(const Change kind, const deserializer::DocumentElement &el) {
+    this->writer_.writeByte(Element::Null);
+    this->writeKey(kind, el);
+  }
+
+  void writeSet(const deserializer::DocumentElement &el) {
+    this->writer_.writeByte(el.type());
+    this->writeKey(Change::Set, el);
+    this->writer_.writeBuf(el.getDataRef(), el.dataSize());
+  }
+
+  /**
+   * Writes a nested patch if it's smaller than replacing the whole value.
+   */
+  void writeChange(const deserializer::DocumentElement &prev_el,
+                   const deserializer::DocumentElement &next_el) {
+    Element type = next_el.type();
+    if (prev_el.type() == type &&
+        (type == Element::Document || type == Element::Array)) {
+      size_t pos = this->writer_.position();
+      this->writer_.writeByte(Element::Document);
+      this->writeKey(Change::Diff, next_el);
+      this->diffLevel(Range::of(prev_el), Range::of(next_el));
+
+      size_t set_size = static_cast<uint8_t>(TypeSize::Byte) +
+                        next_el.nameSize() + 1 + next_el.dataSize();
+      if (this->writer_.position() - pos < set_size) {
+        return;
+      }
+
+      this->writer_.rewind(pos);
+    }
+
+    this->writeSet(next_el);
+  }
+
+  void diffLevel(const Range prev, const Range next) {
+    size_t pos = this->writer_.startDoc();
+
+    // The next element of `prev` that hasn't been matched yet.
+    const uint8_t *prev_cur = prev.begin;
+    // The element before `prev_cur`, used to anchor insertions.
+    const uint8_t *prev_last = nullptr;
+    // Where a patcher's cursor will be after the entries written so far.
+    const uint8_t *applied = prev.begin;
+
+    const uint8_t *next_cur = next.begin;
+    while (next_cur < next.end) {
+      deserializer::DocumentElement next_el = element_at(next_cur, next.end);
+      next_cur += next_el.size();
+
+      const char *name = next_el.getNameRef();
+      size_t name_len = next_el.nameSize() - 1;
+
+      const uint8_t *found = find_element(prev_cur, prev.end, name, name_len);
+      if (found == nullptr) {
+        if (find_element(prev.begin, prev_cur, name, name_len) != nullptr) {
+          // The shared fields have been reordered, so fall back to rebuilding
+          // this document from scratch.
+          this->writer_.rewind(pos);
+          this->replaceLevel(prev, next);
+          return;
+        }
+
+        if (applied != prev_cur) {
+          this->writeMarker(Change::Keep, element_at(prev_last, prev.end));
+          applied = prev_cur;
+        }
+
+        this->writeSet(next_el);
+        continue;
+      }
+
+      while (prev_cur < found) {
+        deserializer::DocumentElement removed = element_at(prev_cur, prev.end);
+        this->writeMarker(Change::Remove, removed);
+        prev_cur += removed.size();
+        applied = prev_cur;
+      }
+
+      deserializer::DocumentElement prev_el = element_at(found, prev.end);
+      size_t prev_size = prev_el.size();
+      prev_last = prev_cur;
+      prev_cur += prev_size;
+
+      if (prev_size == next_el.size() &&
+          memcmp(prev_el.getRef(), next_el.getRef(), prev_size) == 0) {
+        continue;
+      }
+
+      this->writeChange(prev_el, next_el);
+      applied = prev_cur;
+    }
+
+    while (prev_cur < prev.end) {
+      deserializer::DocumentElement removed = element_at(prev_cur, prev.end);
+      this->writeMarker(Change::Remove, removed);
+      prev_cur += removed.size();
+    }
+
+    this->writer_.endDoc(pos);
+  }
+
+  void replaceLevel(const Range prev, const Range next) {
+    size_t pos = this->writer_.startDoc();
+
+    for (const uint8_t *cur = prev.begin; cur < prev.end;) {
+      deserializer::DocumentElement el = element_at(cur, prev.end);
+      this->writeMarker(Change::Remove, el);
+      cur += el.size();
+    }
+
+    for (const uint8_t *cur = next.begin; cur < next.end;) {
+      deserializer::DocumentElement el = element_at(cur, next.end);
+      this->writeSet(el);
+      cur += el.size();
+    }
+
+    this->writer_.endDoc(pos);
+  }
+};
+
+class Patcher {
+public:
+  Patcher(uint8_t out[], const size_t out_len) : writer_(out, out_len) {}
+
+  Result apply(const deserializer::Document &prev,
+               const deserializer::Document &patch) {
+    Result res;
+
+    if (!this->applyLevel(Range::of(prev), Range::of(patch))) {
+      res.status = Status::InvalidPatch;
+      res.len = 0;
+      return res;
+    }
+
+    res.len = this->writer_.position();
+    res.status =
+        this->writer_.overflowed() ? Status::BufferOverflow : Status::Ok;
+    return res;
+  }
+
+private:
+  BufferWriter writer_;
+
+  void copy(const uint8_t *from, const uint8_t *to) {
+    if (to > from) {
+      this->writer_.writeBuf(from, to - from);
+    }
+  }
+
+  bool applyLevel(const Range prev, const Range patch) {
+    size_t pos = this->writer_.startDoc();
+    const uint8_t *cur = prev.begin;
+
+    for (const uint8_t *entry = patch.begin; entry < patch.end;) {
+      deserializer::DocumentElement el = element_at(entry, patch.end);
+      entry += el.size();
+
+      size_t name_len = el.nameSize() - 1;
+      if (name_len == 0) {
+        return false;
+      }
+
+      const char *name = el.getNameRef();
+      Change kind = static_cast<Change>(name[0]);
+      const char *key = name + 1;
+      size_t key_len = name_len - 1;
+
+      const uint8_t *found = find_element(cur, prev.end, key, key_len);
+      const uint8_t *after = nullptr;
+      if (found != nullptr) {
+        this->copy(cur, found);
+        after = found + element_at(found, prev.end).size();
+      }
+
+      switch (kind) {
+        case Change::Keep: {
+          if (found == nullptr) {
+            return false;
+          }
+          this->copy(found, after);
+          break;
+        }
+        case Change::Remove: {
+          if (found == nullptr) {
+            return false;
+          }
+          break;
+        }
+        case Change::Set: {
+          this->writer_.writeByte(el.type());
+          this->writer_.writeStr(key, key_len);
+          this->writer_.writeBuf(el.getDataRef(), el.dataSize());
+          break;
+        }
+        case Change::Diff: {
+          if (found == nullptr || el.type() != Element::Document) {
+            return false;
+          }
+
+          deserializer::DocumentElement prev_el = element_at(found, prev.end);
+          Element type = prev_el.type();
+          if (type != Element::Document && type != Element::Array) {
+            return false;
+          }
+
+          this->writer_.writeByte(type);
+          this->writer_.writeStr(key, key_len);
+          if (!this->applyLevel(Range::of(prev_el), Range::of(el))) {
+            return false;
+          }
+          break;
+        }
+        default:
+          return false;
+      }
+
+      if (after != nullptr) {
+        cur = after;
+      }
+    }
+
+    this->copy(cur, prev.end);
+    this->writer_.endDoc(pos);
+    return true;
+  }
+};
+
+/**
+ * Writes a patch that turns `prev` into `next`. Identical documents produce
+ * an empty patch document.
+ */
+inline Result diff(const deserializer::Document &prev,
+                   const deserializer::Document &next, uint8_t out[],
+                   const size_t out_len) {
+  Differ differ(out, out_len);
+  return differ.diff(prev, next);
+}
+
+/**
+ * Rebuilds the document a patch was produced from, given the same `prev`.
+ */
+inline Result apply(const deserializer::Document &prev,
+                    const deserializer::Document &patch, uint8_t out[],
+                    const size_t out_len) {
+  Patcher patcher(out, out_len);
+  return patcher.apply(prev, patch);
+}
+
+} // namespace delta
+} // namespace bson
+} // namespace pot
+
+#endif
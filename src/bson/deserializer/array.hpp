@@ -28,6 +28,14 @@ public:
   Array() {}
   Array(const uint8_t buf[], const size_t len) : Document::Document(buf, len) {}
 
+  /**
+   * Validates the array, including that its keys are consecutive indices.
+   */
+  template <size_t elm_name_buf_size = 50> bool valid() const {
+    size_t current = this->offset_;
+    return Document::valid<elm_name_buf_size>(current, true);
+  }
+
   // Implemented in array_iter.hpp
   iterator begin() const;
   iterator end() const;
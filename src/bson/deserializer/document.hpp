@@ -3,6 +3,7 @@
 
 #include "../consts.hpp"
 #include "../endian.hpp"
+#include "../key.hpp"
 #include "./array_element.hpp"
 #include "./document_element.hpp"
 #include <cstdlib>
@@ -49,7 +50,7 @@ public:
       buffer_(buf), offset_(0), buffer_length_(len) {}
 
   template <size_t elm_name_buf_size = 50> bool valid() const {
-    size_t current = 0;
+    size_t current = this->offset_;
     return valid<elm_name_buf_size>(current);
   }
 
@@ -57,6 +58,26 @@ public:
   iterator begin() const;
   iterator end() const;
   bool getElByName(const char name[], DocumentElement &out) const;
+  bool getElByName(const Key &key, DocumentElement &out) const;
+
+  /**
+   * Returns the length of the document in bytes, as stored in its header.
+   */
+  int32_t len() const {
+    return endian::buffer_to_primitive<int32_t, TypeSize::Int32>(this->buffer_,
+                                                                 this->offset_);
+  }
+
+  /**
+   * Returns the pointer reference to the start of the document's bytes
+   * (its length header). Use
+   *     Document::len()
+   * to get the length of the document.
+   * The pointer is only valid for as long as the buffer data is.
+   */
+  const uint8_t *getRef() const {
+    return &this->buffer_[this->offset_];
+  }
 
 protected:
   const uint8_t *buffer_;
@@ -66,11 +87,6 @@ protected:
   Document(const uint8_t buf[], const size_t len, const size_t offset) :
       buffer_(buf), offset_(offset), buffer_length_(len) {}
 
-  int32_t len() const {
-    return endian::buffer_to_primitive<int32_t, TypeSize::Int32>(this->buffer_,
-                                                                 this->offset_);
-  }
-
   template <size_t elm_name_buf_size>
   bool valid(size_t &current, const bool array_doc = false) const {
     size_t start = current;
@@ -180,16 +196,16 @@ protected:
                   this->buffer_, current);
           current += static_cast<uint8_t>(TypeSize::Int32);
 
-          // We only support generic binary types right now.
+          // The supported subtypes, and their checks, are in is_valid_binary.
           __POT_BSON_VALID_TYPESIZE_CHECK(this->buffer_length_, current,
                                           TypeSize::Byte);
-          if (this->buffer_[current] !=
-              static_cast<uint8_t>(BinaryElementSubtype::Generic)) {
-            return false;
-          }
+          uint8_t subtype = this->buffer_[current];
           current += static_cast<uint8_t>(TypeSize::Byte);
 
           __POT_BSON_VALID_SIZE_CHECK(this->buffer_length_, current, bin_len)
+          if (!is_valid_binary(subtype, &this->buffer_[current], bin_len)) {
+            return false;
+          }
           current += bin_len;
           break;
         }
@@ -3,7 +3,10 @@
 
 #include "../consts.hpp"
 #include "../endian.hpp"
+#include "../key.hpp"
+#include "../series/series.hpp"
 #include <cstdlib>
+#include <cstring>
 
 namespace pot {
 namespace bson {
@@ -66,6 +69,17 @@ struct Bin {
   int64_t len;
 };
 
+/**
+ * A Vector binary. `data` points past the dtype and padding bytes, and `len`
+ * is its length in bytes.
+ */
+struct Vector {
+  VectorDType dtype;
+  uint8_t padding;
+  const uint8_t *data;
+  int64_t len;
+};
+
 } // namespace data_type
 
 #define __POT_BSON_DOCUMENT_ELEMENT_NAME_OFFSET \
@@ -115,6 +129,18 @@ public:
                            __POT_BSON_DOCUMENT_ELEMENT_NAME_OFFSET);
   }
 
+  /**
+   * Compares the name against a prepared key, checking its length before any
+   * of its characters: the name has to end exactly where the key does. Keys
+   * never contain a null, so a name that ends earlier fails the comparison.
+   */
+  bool nameEquals(const Key &key) const {
+    size_t name = __POT_BSON_DOCUMENT_ELEMENT_NAME_OFFSET;
+    return name + key.len() < this->buffer_length_ &&
+           this->buffer_[name + key.len()] == '\0' &&
+           memcmp(&this->buffer_[name], key.str(), key.len()) == 0;
+  }
+
   double getDouble() const {
     return endian::buffer_to_primitive<double, TypeSize::Double>(
         this->buffer_, __POT_BSON_DOCUMENT_ELEMENT_DATA_OFFSET);
@@ -239,6 +265,183 @@ public:
     return true;
   }
 
+  BinaryElementSubtype getBinSubtype() const {
+    return static_cast<BinaryElementSubtype>(this->getBinRef()[-1]);
+  }
+
+  bool isVector() const {
+    return this->type() == Element::Binary &&
+           this->getBinSubtype() == BinaryElementSubtype::Vector;
+  }
+
+  /**
+   * Gets the vector without copying it. A document that passed validation
+   * has a well-formed header for every vector in it.
+   */
+  bool tryGetVector(data_type::Vector &out) const {
+    if (!this->isVector()) {
+      return false;
+    }
+
+    const uint8_t *bin = this->getBinRef();
+    int64_t len = this->getBinLen();
+    if (!is_valid_vector(bin, len)) {
+      return false;
+    }
+
+    out = { .dtype = static_cast<VectorDType>(bin[0]),
+            .padding = bin[1],
+            .data = &bin[kVectorHeaderSize],
+            .len = len - static_cast<int64_t>(kVectorHeaderSize) };
+    return true;
+  }
+
+  /**
+   * Returns the number of values in the vector, which for packed bits is the
+   * number of bits excluding the padding.
+   */
+  int64_t getVectorSize() const {
+    const uint8_t *bin = this->getBinRef();
+    int64_t len =
+        this->getBinLen() - static_cast<int64_t>(kVectorHeaderSize);
+
+    switch (static_cast<VectorDType>(bin[0])) {
+      case VectorDType::Int8:
+        return len;
+      case VectorDType::Float32:
+        return len / 4;
+      case VectorDType::PackedBit:
+        return len * 8 - bin[1];
+    }
+
+    return 0;
+  }
+
+  /**
+   * Returns the pointer reference to an int8 vector's values.
+   * The pointer is only valid for as long as the buffer data is.
+   */
+  const int8_t *getVectorI8Ref() const {
+    return reinterpret_cast<const int8_t *>(this->getBinRef() +
+                                            kVectorHeaderSize);
+  }
+
+  /**
+   * Copies up to `len` values into `out`, converting int8 values and bits to
+   * floats, and returns how many were copied.
+   */
+  size_t getVectorF32(float out[], const size_t len) const {
+    const uint8_t *bin = this->getBinRef();
+    const uint8_t *data = bin + kVectorHeaderSize;
+    size_t size = this->getVectorSize();
+    size_t count = size < len ? size : len;
+
+    switch (static_cast<VectorDType>(bin[0])) {
+      case VectorDType::Float32: {
+        if (!endian::is_big_endian()) {
+          memcpy(out, data, count * sizeof(float));
+          break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+          out[i] = endian::buffer_to_primitive<float, TypeSize::Int32>(
+              data, i * sizeof(float));
+        }
+        break;
+      }
+      case VectorDType::Int8: {
+        const int8_t *values = reinterpret_cast<const int8_t *>(data);
+        for (size_t i = 0; i < count; i++) {
+          out[i] = values[i];
+        }
+        break;
+      }
+      case VectorDType::PackedBit: {
+        for (size_t i = 0; i < count; i++) {
+          out[i] = (data[i / 8] >> (7 - i % 8)) & 1;
+        }
+        break;
+      }
+    }
+
+    return count;
+  }
+
+  /**
+   * Unpacks up to `len` bits of a packed bit vector into `out`, one 0 or 1
+   * per byte, most significant bit first, and returns how many were copied.
+   */
+  size_t getVectorBits(uint8_t out[], const size_t len) const {
+    const uint8_t *data = this->getBinRef() + kVectorHeaderSize;
+    size_t size = this->getVectorSize();
+    size_t count = size < len ? size : len;
+
+    // Whole bytes first so the inner loop has a fixed trip count.
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      uint8_t byte = data[i / 8];
+      for (size_t bit = 0; bit < 8; bit++) {
+        out[i + bit] = (byte >> (7 - bit)) & 1;
+      }
+    }
+    for (; i < count; i++) {
+      out[i] = (data[i / 8] >> (7 - i % 8)) & 1;
+    }
+
+    return count;
+  }
+
+  bool isSeries() const {
+    return this->type() == Element::Binary &&
+           this->getBinSubtype() == BinaryElementSubtype::Series;
+  }
+
+  SeriesEncoding getSeriesEncoding() const {
+    return static_cast<SeriesEncoding>(this->getBinRef()[0]);
+  }
+
+  /**
+   * Returns the number of values in the series.
+   */
+  uint32_t getSeriesSize() const {
+    return endian::buffer_to_primitive<uint32_t, TypeSize::Int32>(
+        this->getBinRef(), static_cast<uint8_t>(TypeSize::Byte));
+  }
+
+  /**
+   * Decodes an integer series into `out`, which has to have room for
+   * `getSeriesSize()` values. Returns false if this isn't an integer series,
+   * it doesn't fit or it's malformed.
+   */
+  bool tryGetSeriesInt64(int64_t out[], const size_t len) const {
+    if (!this->isSeries() ||
+        this->getBinLen() < static_cast<int64_t>(kSeriesHeaderSize) ||
+        this->getSeriesEncoding() != SeriesEncoding::DeltaInt64 ||
+        this->getSeriesSize() > len) {
+      return false;
+    }
+
+    return series::decode_int64(this->getBinRef() + kSeriesHeaderSize,
+                                this->getBinLen() - kSeriesHeaderSize, out,
+                                this->getSeriesSize());
+  }
+
+  /**
+   * Decodes a double series into `out`, like `tryGetSeriesInt64`.
+   */
+  bool tryGetSeriesDouble(double out[], const size_t len) const {
+    if (!this->isSeries() ||
+        this->getBinLen() < static_cast<int64_t>(kSeriesHeaderSize) ||
+        this->getSeriesEncoding() != SeriesEncoding::XorDouble ||
+        this->getSeriesSize() > len) {
+      return false;
+    }
+
+    return series::decode_double(this->getBinRef() + kSeriesHeaderSize,
+                                 this->getBinLen() - kSeriesHeaderSize, out,
+                                 this->getSeriesSize());
+  }
+
   bool getBool() const {
     uint8_t val = this->buffer_[__POT_BSON_DOCUMENT_ELEMENT_DATA_OFFSET];
 
@@ -299,6 +502,37 @@ public:
     return true;
   }
 
+  /**
+   * Returns the pointer reference to the start of the element (its type
+   * byte). Use
+   *     DocumentElement::size()
+   * to get the length of the whole element.
+   * The pointer is only valid for as long as the buffer data is.
+   */
+  const uint8_t *getRef() const {
+    return &this->buffer_[this->start_];
+  }
+
+  /**
+   * Returns the pointer reference to the start of the element's value.
+   * Use
+   *     DocumentElement::dataSize()
+   * to get the length of the value.
+   * The pointer is only valid for as long as the buffer data is.
+   */
+  const uint8_t *getDataRef() const {
+    return &this->buffer_[__POT_BSON_DOCUMENT_ELEMENT_DATA_OFFSET];
+  }
+
+  /**
+   * Returns the total size of the element in bytes, including the type byte
+   * and name.
+   */
+  size_t size() const {
+    return static_cast<uint8_t>(TypeSize::Byte) + this->nameSize() +
+           this->dataSize();
+  }
+
   size_t nameSize() const {
     if (this->name_size_ > 0) {
       return this->name_size_;
@@ -66,6 +66,17 @@ bool Document::getElByName(const char name[], DocumentElement &out) const {
   return false;
 }
 
+bool Document::getElByName(const Key &key, DocumentElement &out) const {
+  for (auto const &el : *this) {
+    if (el.nameEquals(key)) {
+      out = el;
+      return true;
+    }
+  }
+
+  return false;
+}
+
 } // namespace deserializer
 } // namespace bson
 } // namespace pot
@@ -0,0 +1,247 @@
+#ifndef POT_BSON_DESERIALIZER_SHAPE_INDEX_H_
+#define POT_BSON_DESERIALIZER_SHAPE_INDEX_H_
+
+#include "../consts.hpp"
+#include "../hash.hpp"
+#include "../key.hpp"
+#include "./document.hpp"
+#include "./document_element.hpp"
+#include "./document_iter.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace deserializer {
+
+inline bool is_fixed_width(const Element type) {
+  switch (type) {
+    case Element::Double:
+    case Element::Boolean:
+    case Element::Null:
+    case Element::Int32:
+    case Element::Int64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * An offset index for a fixed set of keys that is reused across documents
+ * with the same layout.
+ *
+ * The shape of a document is the type and name of its leading elements, up
+ * to and including the first variable-width one. Within that prefix every
+ * element's offset is determined by the shape alone, so when the next
+ * document has the same type and name bytes at the cached offsets, the cached
+ * offsets are reused as-is. Those bytes are compared against a copy taken
+ * when the index was built, which stops at the first difference.
+ * Keys past the prefix are resolved with a scan of the remaining elements, and
+ * a document with a different shape rebuilds the index with a full scan.
+ */
+template <size_t max_fields = 32> class ShapeIndex {
+public:
+  /**
+   * `keys` must outlive the index. At most `max_fields` keys are indexed.
+   */
+  ShapeIndex(const char *const keys[], const size_t keys_len) :
+      keys_(keys), keys_len_(keys_len < max_fields ? keys_len : max_fields) {
+    for (size_t k = 0; k < this->keys_len_; k++) {
+      this->key_lens_[k] = strlen(keys[k]);
+      this->key_hashes_[k] =
+          hash::fnv1a(hash::kFnvOffset,
+                      reinterpret_cast<const uint8_t *>(keys[k]),
+                      this->key_lens_[k]);
+    }
+  }
+
+  /**
+   * Resolves the keys for a new document. Returns true if the cached shape
+   * was reused. The document's buffer must stay valid while it's bound.
+   */
+  bool bind(const Document &doc) {
+    this->base_ = doc.getRef();
+    this->len_ = doc.len();
+
+    if (this->shape_len_ > 0 && this->matches()) {
+      this->hits_++;
+      this->resolveTail();
+      return true;
+    }
+
+    this->misses_++;
+    this->rebuild();
+    return false;
+  }
+
+  /**
+   * Gets the element for the key at position `key` of the indexed keys.
+   */
+  bool getElByKey(const size_t key, DocumentElement &out) const {
+    if (key >= this->keys_len_ || this->offsets_[key] == 0) {
+      return false;
+    }
+
+    out = DocumentElement(this->base_, this->offsets_[key], this->len_);
+    return true;
+  }
+
+  /**
+   * Looks up indexed keys without touching the document, and falls back to
+   * a normal scan for any other key.
+   */
+  bool getElByName(const char name[], DocumentElement &out) const {
+    for (size_t i = 0; i < this->keys_len_; i++) {
+      if (strcmp(this->keys_[i], name) == 0) {
+        return this->getElByKey(i, out);
+      }
+    }
+
+    return Document(this->base_, this->len_).getElByName(name, out);
+  }
+
+  /**
+   * Like `getElByName`, but matches the indexed keys on their hash first.
+   */
+  bool getElByName(const Key &key, DocumentElement &out) const {
+    for (size_t i = 0; i < this->keys_len_; i++) {
+      if (this->key_hashes_[i] == key.hash() &&
+          this->key_lens_[i] == key.len() &&
+          memcmp(this->keys_[i], key.str(), key.len()) == 0) {
+        return this->getElByKey(i, out);
+      }
+    }
+
+    return Document(this->base_, this->len_).getElByName(key, out);
+  }
+
+  size_t hits() const {
+    return this->hits_;
+  }
+
+  size_t misses() const {
+    return this->misses_;
+  }
+
+private:
+  const char *const *keys_;
+  size_t keys_len_;
+  size_t key_lens_[max_fields];
+  uint64_t key_hashes_[max_fields];
+
+  const uint8_t *base_ = nullptr;
+  size_t len_ = 0;
+
+  // The shape's type and name bytes, back to back.
+  std::vector<uint8_t> shape_bytes_;
+  size_t shape_len_ = 0;
+  size_t shape_offsets_[max_fields];
+  size_t shape_name_sizes_[max_fields];
+
+  // Offsets within the shape prefix, or 0 if the key lies outside it.
+  size_t cached_[max_fields];
+  // Offsets in the bound document, or 0 if the key is missing.
+  size_t offsets_[max_fields];
+
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+
+  size_t end() const {
+    return this->len_ - static_cast<uint8_t>(TypeSize::Byte);
+  }
+
+  bool matches() const {
+    size_t last = this->shape_len_ - 1;
+    if (this->shape_offsets_[last] + static_cast<uint8_t>(TypeSize::Byte) +
+            this->shape_name_sizes_[last] >
+        this->end()) {
+      return false;
+    }
+
+    const uint8_t *expected = this->shape_bytes_.data();
+    for (size_t i = 0; i < this->shape_len_; i++) {
+      size_t size =
+          static_cast<uint8_t>(TypeSize::Byte) + this->shape_name_sizes_[i];
+      if (memcmp(&this->base_[this->shape_offsets_[i]], expected, size) != 0) {
+        return false;
+      }
+      expected += size;
+    }
+    return true;
+  }
+
+  void resolve(const DocumentElement &el, const size_t offset,
+               const bool in_shape) {
+    for (size_t k = 0; k < this->keys_len_; k++) {
+      if (this->offsets_[k] == 0 &&
+          el.nameEquals(Key(this->keys_[k], this->key_lens_[k],
+                            this->key_hashes_[k]))) {
+        this->offsets_[k] = offset;
+        if (in_shape) {
+          this->cached_[k] = offset;
+        }
+        return;
+      }
+    }
+  }
+
+  void resolveTail() {
+    bool complete = true;
+    for (size_t k = 0; k < this->keys_len_; k++) {
+      this->offsets_[k] = this->cached_[k];
+      complete = complete && this->cached_[k] != 0;
+    }
+
+    if (complete) {
+      return;
+    }
+
+    size_t cur = this->shape_offsets_[this->shape_len_ - 1];
+    cur += DocumentElement(this->base_, cur, this->len_).size();
+    while (cur < this->end()) {
+      DocumentElement el(this->base_, cur, this->len_);
+      this->resolve(el, cur, false);
+      cur += el.size();
+    }
+  }
+
+  void rebuild() {
+    for (size_t k = 0; k < this->keys_len_; k++) {
+      this->cached_[k] = 0;
+      this->offsets_[k] = 0;
+    }
+
+    this->shape_len_ = 0;
+    this->shape_bytes_.clear();
+    bool stable = true;
+
+    size_t cur = static_cast<uint8_t>(TypeSize::Int32);
+    while (cur < this->end()) {
+      DocumentElement el(this->base_, cur, this->len_);
+      bool in_shape = stable && this->shape_len_ < max_fields;
+
+      if (in_shape) {
+        size_t name_size = el.nameSize();
+        this->shape_offsets_[this->shape_len_] = cur;
+        this->shape_name_sizes_[this->shape_len_] = name_size;
+        this->shape_len_++;
+
+        size_t size = static_cast<uint8_t>(TypeSize::Byte) + name_size;
+        this->shape_bytes_.insert(this->shape_bytes_.end(), &this->base_[cur],
+                                  &this->base_[cur] + size);
+      }
+      stable = in_shape && is_fixed_width(el.type());
+
+      this->resolve(el, cur, in_shape);
+      cur += el.size();
+    }
+  }
+};
+
+} // namespace deserializer
+} // namespace bson
+} // namespace pot
+
+#endif
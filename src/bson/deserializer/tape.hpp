@@ -0,0 +1,241 @@
+#ifndef POT_BSON_DESERIALIZER_TAPE_H_
+#define POT_BSON_DESERIALIZER_TAPE_H_
+
+#include "../consts.hpp"
+#include "../endian.hpp"
+#include "../key.hpp"
+#include "./document.hpp"
+#include "./document_element.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace deserializer {
+
+static constexpr size_t kTapeNone = static_cast<size_t>(-1);
+
+/**
+ * A single decoded element. Keys and values point into the original buffer,
+ * which has to outlive the tape.
+ *
+ * Documents and arrays are followed by their descendants, so the children of
+ * the entry at `i` are the entries `[i + 1, next)`, and `next` skips the whole
+ * subtree in one hop.
+ */
+struct TapeEntry {
+  Element type;
+  uint32_t key_len;
+  uint32_t next;
+  const char *key;
+  const uint8_t *value;
+
+  bool keyEquals(const char name[], const size_t len) const {
+    return this->key_len == len && memcmp(this->key, name, len) == 0;
+  }
+
+  bool isNumber() const {
+    return this->type == Element::Int32 || this->type == Element::Int64 ||
+           this->type == Element::Double;
+  }
+
+  double getDouble() const {
+    return endian::buffer_to_primitive<double, TypeSize::Double>(this->value,
+                                                                  0);
+  }
+
+  double getNumber() const {
+    if (this->type == Element::Int32) {
+      return this->getInt32();
+    } else if (this->type == Element::Int64) {
+      return this->getInt64();
+    }
+
+    return this->getDouble();
+  }
+
+  const char *getStrRef() const {
+    return reinterpret_cast<const char *>(
+        &this->value[static_cast<uint8_t>(TypeSize::Int32)]);
+  }
+
+  int64_t getStrLen() const {
+    // Exclude the null-terminator
+    return this->getDataLen() - 1;
+  }
+
+  const uint8_t *getBinRef() const {
+    return &this->value[static_cast<uint8_t>(TypeSize::Int32) +
+                        static_cast<uint8_t>(TypeSize::Byte)];
+  }
+
+  int64_t getBinLen() const {
+    return this->getDataLen();
+  }
+
+  bool getBool() const {
+    return this->value[0] == static_cast<uint8_t>(BooleanElementValue::True);
+  }
+
+  int32_t getInt32() const {
+    return endian::buffer_to_primitive<int32_t, TypeSize::Int32>(this->value,
+                                                                  0);
+  }
+
+  int64_t getInt64() const {
+    return endian::buffer_to_primitive<int64_t, TypeSize::Int64>(this->value,
+                                                                  0);
+  }
+
+  int64_t getInt() const {
+    if (this->type == Element::Int32) {
+      return this->getInt32();
+    }
+
+    return this->getInt64();
+  }
+
+  int32_t getDataLen() const {
+    return endian::buffer_to_primitive<int32_t, TypeSize::Int32>(this->value,
+                                                                 0);
+  }
+};
+
+/**
+ * A flat decoding of a whole document tree into caller-provided entries, for
+ * documents that are queried many times. Entry 0 is the root document.
+ * Lookups are only valid after a successful `parse`.
+ */
+class Tape {
+public:
+  Tape(TapeEntry entries[], const size_t capacity) :
+      entries_(entries), capacity_(capacity) {}
+
+  /**
+   * Decodes a document, which should already have been validated. Returns
+   * false if there wasn't enough room for every entry, in which case `size()`
+   * is the number of entries required.
+   */
+  bool parse(const Document &doc) {
+    this->size_ = 0;
+    this->push(Element::Document, "", 0, doc.getRef());
+    this->decode(0, doc.getRef());
+
+    return this->size_ <= this->capacity_;
+  }
+
+  size_t size() const {
+    return this->size_;
+  }
+
+  const TapeEntry &operator[](const size_t index) const {
+    return this->entries_[index];
+  }
+
+  /**
+   * Returns the index of the child of `parent` with the given name, or
+   * `kTapeNone`.
+   */
+  size_t find(const size_t parent, const char name[],
+              const size_t name_len) const {
+    size_t end = this->entries_[parent].next;
+    for (size_t i = parent + 1; i < end; i = this->entries_[i].next) {
+      if (this->entries_[i].keyEquals(name, name_len)) {
+        return i;
+      }
+    }
+
+    return kTapeNone;
+  }
+
+  size_t find(const size_t parent, const char name[]) const {
+    return this->find(parent, name, strlen(name));
+  }
+
+  size_t find(const size_t parent, const Key &key) const {
+    return this->find(parent, key.str(), key.len());
+  }
+
+  /**
+   * Returns the index of the nth child of `parent`, or `kTapeNone`.
+   */
+  size_t at(const size_t parent, size_t index) const {
+    size_t end = this->entries_[parent].next;
+    for (size_t i = parent + 1; i < end; i = this->entries_[i].next) {
+      if (index-- == 0) {
+        return i;
+      }
+    }
+
+    return kTapeNone;
+  }
+
+  /**
+   * Resolves a dot separated path from the root, e.g. "net.wifi.ssid".
+   */
+  size_t path(const char path[]) const {
+    size_t current = 0;
+    while (true) {
+      size_t len = 0;
+      while (path[len] != '\0' && path[len] != '.') {
+        len++;
+      }
+
+      current = this->find(current, path, len);
+      if (current == kTapeNone || path[len] == '\0') {
+        return current;
+      }
+
+      path += len + 1;
+    }
+  }
+
+private:
+  TapeEntry *entries_;
+  size_t capacity_;
+  size_t size_ = 0;
+
+  size_t push(const Element type, const char key[], const size_t key_len,
+              const uint8_t *value) {
+    size_t index = this->size_++;
+    if (index < this->capacity_) {
+      TapeEntry &entry = this->entries_[index];
+      entry.type = type;
+      entry.key_len = key_len;
+      entry.next = index + 1;
+      entry.key = key;
+      entry.value = value;
+    }
+
+    return index;
+  }
+
+  void decode(const size_t parent, const uint8_t *doc) {
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);
+    const uint8_t *end = doc + len - static_cast<uint8_t>(TypeSize::Byte);
+    const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);
+
+    while (cur < end) {
+      DocumentElement el(cur, 0, end - cur);
+      Element type = el.type();
+      size_t index = this->push(type, el.getNameRef(), el.nameSize() - 1,
+                                el.getDataRef());
+
+      if (type == Element::Document || type == Element::Array) {
+        this->decode(index, el.getDataRef());
+      }
+
+      cur += el.size();
+    }
+
+    if (parent < this->capacity_) {
+      this->entries_[parent].next = this->size_;
+    }
+  }
+};
+
+} // namespace deserializer
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef POT_BSON_HASH_H_
+#define POT_BSON_HASH_H_
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace hash {
+
+static constexpr uint64_t kFnvOffset = 0xCBF29CE484222325;
+static constexpr uint64_t kFnvPrime = 0x100000001B3;
+
+/**
+ * Folds `len` bytes into a 64-bit FNV-1a hash. Start with `kFnvOffset`.
+ */
+inline uint64_t fnv1a(uint64_t hash, const uint8_t buf[], const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ buf[i]) * kFnvPrime;
+  }
+
+  return hash;
+}
+
+/**
+ * The FNV-1a hash of a null-terminated string, excluding the terminator.
+ * Usable in constant expressions, e.g. as a case label.
+ */
+constexpr uint64_t fnv1a_str(const char str[],
+                             const uint64_t hash = kFnvOffset) {
+  return *str == '\0'
+             ? hash
+             : fnv1a_str(str + 1,
+                         (hash ^ static_cast<uint8_t>(*str)) * kFnvPrime);
+}
+
+} // namespace hash
+} // namespace bson
+} // namespace pot
+
+#endif
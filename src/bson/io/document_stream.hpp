@@ -0,0 +1,124 @@
+#ifndef POT_BSON_IO_DOCUMENT_STREAM_H_
+#define POT_BSON_IO_DOCUMENT_STREAM_H_
+
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../endian.hpp"
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+enum struct StreamStatus {
+  /**
+   * The last document was read successfully.
+   */
+  Ok,
+  /**
+   * Every document in the region has been read.
+   */
+  End,
+  /**
+   * The region ends part way through a document, e.g. because the writer was
+   * interrupted. `DocumentStream::offset()` is the end of the last complete
+   * document.
+   */
+  Truncated,
+  /**
+   * A document had an impossible length or failed validation. The stream
+   * can't continue past it, since the next document's start is unknown.
+   */
+  Invalid,
+  /**
+   * Reading failed. Only from streams that read a file themselves, such as
+   * `JournalReader`.
+   */
+  IoError,
+};
+
+/**
+ * Iterates over back-to-back documents in a memory region, such as a
+ * mongodump-style file mapped with `MappedFile`. Each document is a zero-copy
+ * view into the region.
+ */
+class DocumentStream {
+public:
+  DocumentStream(const uint8_t buf[], const size_t len,
+                 const bool validate = false) :
+      buffer_(buf),
+      buffer_length_(len), validate_(validate) {}
+
+  bool next(deserializer::Document &out) {
+    if (this->status_ != StreamStatus::Ok) {
+      return false;
+    }
+
+    size_t remaining = this->buffer_length_ - this->offset_;
+    if (remaining == 0) {
+      this->status_ = StreamStatus::End;
+      return false;
+    }
+
+    if (remaining < static_cast<uint8_t>(TypeSize::Int32)) {
+      this->status_ = StreamStatus::Truncated;
+      return false;
+    }
+
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(
+        this->buffer_, this->offset_);
+    if (len < static_cast<uint8_t>(TypeSize::Int32) +
+                  static_cast<uint8_t>(TypeSize::Byte)) {
+      this->status_ = StreamStatus::Invalid;
+      return false;
+    }
+
+    if (static_cast<size_t>(len) > remaining) {
+      this->status_ = StreamStatus::Truncated;
+      return false;
+    }
+
+    deserializer::Document doc(&this->buffer_[this->offset_], len);
+    if (this->validate_ && !doc.valid()) {
+      this->status_ = StreamStatus::Invalid;
+      return false;
+    }
+
+    out = doc;
+    this->offset_ += len;
+    this->count_++;
+    return true;
+  }
+
+  StreamStatus status() const {
+    return this->status_;
+  }
+
+  /**
+   * The offset just past the last document that was read.
+   */
+  size_t offset() const {
+    return this->offset_;
+  }
+
+  /**
+   * The number of documents read so far.
+   */
+  size_t count() const {
+    return this->count_;
+  }
+
+private:
+  const uint8_t *buffer_;
+  size_t buffer_length_;
+  bool validate_;
+  size_t offset_ = 0;
+  size_t count_ = 0;
+  StreamStatus status_ = StreamStatus::Ok;
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef POT_BSON_IO_FRAME_H_
+#define POT_BSON_IO_FRAME_H_
+
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../endian.hpp"
+#include "../serializer/array.hpp"
+#include "../serializer/document.hpp"
+#include "../serializer/result.hpp"
+#include "./ring.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+enum struct FrameStatus {
+  /**
+   * The last frame was read successfully.
+   */
+  Ok,
+  /**
+   * The ring doesn't hold a whole frame yet.
+   */
+  NeedMore,
+  /**
+   * A frame's length is more than the maximum frame size. The stream can't
+   * continue past it.
+   */
+  TooLarge,
+  /**
+   * A frame had an impossible length or failed validation. The stream can't
+   * continue past it.
+   */
+  Invalid,
+};
+
+/**
+ * Splits a byte stream, e.g. from a socket or serial port, into documents by
+ * their leading length. Bytes are received straight into a `MirroredRing`,
+ * and documents are zero-copy views into it, even when they wrap around.
+ *
+ * A document stays valid until the next call to `next` or `release`, which
+ * hand its space back to the ring.
+ */
+class FrameReader {
+public:
+  FrameReader(MirroredRing &ring, const size_t max_frame_size,
+              const bool validate = false) :
+      ring_(ring),
+      max_frame_size_(max_frame_size < ring.capacity() ? max_frame_size
+                                                       : ring.capacity()),
+      validate_(validate) {}
+
+  /**
+   * Where to receive more bytes, and how many fit. Call `commit` with the
+   * number received.
+   */
+  uint8_t *space() {
+    return this->ring_.writePtr();
+  }
+
+  size_t spaceLen() const {
+    return this->ring_.writable();
+  }
+
+  void commit(const size_t len) {
+    this->ring_.commit(len);
+  }
+
+  /**
+   * Receives whatever is available from a file descriptor, releasing the
+   * last document first to make room. Returns the result of `read(2)`.
+   */
+  ssize_t fill(const int fd) {
+    this->release();
+
+    ssize_t n;
+    do {
+      n = ::read(fd, this->space(), this->spaceLen());
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+      this->commit(n);
+    }
+    return n;
+  }
+
+  bool next(deserializer::Document &out) {
+    this->release();
+
+    if (this->status_ == FrameStatus::TooLarge ||
+        this->status_ == FrameStatus::Invalid) {
+      return false;
+    }
+
+    size_t readable = this->ring_.readable();
+    if (readable < static_cast<uint8_t>(TypeSize::Int32)) {
+      this->status_ = FrameStatus::NeedMore;
+      return false;
+    }
+
+    const uint8_t *frame = this->ring_.readPtr();
+    int32_t len =
+        endian::buffer_to_primitive<int32_t, TypeSize::Int32>(frame, 0);
+    if (len < static_cast<uint8_t>(TypeSize::Int32) +
+                  static_cast<uint8_t>(TypeSize::Byte)) {
+      this->status_ = FrameStatus::Invalid;
+      return false;
+    }
+    if (static_cast<size_t>(len) > this->max_frame_size_) {
+      this->status_ = FrameStatus::TooLarge;
+      return false;
+    }
+    if (static_cast<size_t>(len) > readable) {
+      this->status_ = FrameStatus::NeedMore;
+      return false;
+    }
+
+    deserializer::Document doc(frame, len);
+    if (this->validate_ && !doc.valid()) {
+      this->status_ = FrameStatus::Invalid;
+      return false;
+    }
+
+    out = doc;
+    this->pending_ = len;
+    this->count_++;
+    this->status_ = FrameStatus::Ok;
+    return true;
+  }
+
+  /**
+   * Hands the last document's space back to the ring.
+   */
+  void release() {
+    this->ring_.consume(this->pending_);
+    this->pending_ = 0;
+  }
+
+  FrameStatus status() const {
+    return this->status_;
+  }
+
+  size_t maxFrameSize() const {
+    return this->max_frame_size_;
+  }
+
+  /**
+   * The number of documents read so far.
+   */
+  size_t count() const {
+    return this->count_;
+  }
+
+private:
+  MirroredRing &ring_;
+  size_t max_frame_size_;
+  bool validate_;
+  size_t pending_ = 0;
+  size_t count_ = 0;
+  FrameStatus status_ = FrameStatus::NeedMore;
+};
+
+/**
+ * Queues documents for sending by serializing them straight into the free
+ * space of a `MirroredRing`, so that the bytes that go out are the ones that
+ * were built.
+ */
+class FrameWriter {
+public:
+  FrameWriter(MirroredRing &ring, const size_t max_frame_size) :
+      ring_(ring),
+      max_frame_size_(max_frame_size < ring.capacity() ? max_frame_size
+                                                       : ring.capacity()) {}
+
+  /**
+   * Builds a document into the ring. On overflow nothing is queued, and the
+   * length is what the document needs: once that's more than the maximum
+   * frame size it can never be written, otherwise it fits after a flush.
+   */
+  serializer::Result
+  write(std::function<void(serializer::Document &)> builder) {
+    size_t room = this->ring_.writable();
+    serializer::Result res = serializer::Document::build(
+        this->ring_.writePtr(),
+        room < this->max_frame_size_ ? room : this->max_frame_size_, builder);
+
+    if (res.status == serializer::Status::Ok) {
+      this->ring_.commit(res.len);
+    }
+    return res;
+  }
+
+  /**
+   * Queues an already serialized document.
+   */
+  serializer::Result write(const uint8_t doc[], const size_t len) {
+    if (len > this->max_frame_size_ || len > this->ring_.writable()) {
+      return { serializer::Status::BufferOverflow, len };
+    }
+
+    memcpy(this->ring_.writePtr(), doc, len);
+    this->ring_.commit(len);
+    return { serializer::Status::Ok, len };
+  }
+
+  /**
+   * The queued bytes, contiguous from `data()`. Call `consume` with the
+   * number sent.
+   */
+  const uint8_t *data() const {
+    return this->ring_.readPtr();
+  }
+
+  size_t pending() const {
+    return this->ring_.readable();
+  }
+
+  void consume(const size_t len) {
+    this->ring_.consume(len);
+  }
+
+  /**
+   * Sends as much as a file descriptor takes. Returns the result of
+   * `write(2)`.
+   */
+  ssize_t flush(const int fd) {
+    if (this->pending() == 0) {
+      return 0;
+    }
+
+    ssize_t n;
+    do {
+      n = ::write(fd, this->data(), this->pending());
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0) {
+      this->consume(n);
+    }
+    return n;
+  }
+
+private:
+  MirroredRing &ring_;
+  size_t max_frame_size_;
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,686 @@
+#ifndef POT_BSON_IO_JOURNAL_H_
+#define POT_BSON_IO_JOURNAL_H_
+
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../endian.hpp"
+#include "../serializer/document.hpp"
+#include "../serializer/result.hpp"
+#include "./document_stream.hpp"
+#include "./ring.hpp"
+#include "./uring.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+/**
+ * Reading and writing files of back-to-back documents, such as mongodump
+ * output or a device's backlog, with several chunk-sized requests in flight
+ * at once.
+ *
+ * Both sides stage data in a `MirroredRing` divided into chunk-sized slots.
+ * With io_uring, the ring is registered as a fixed buffer, so the kernel
+ * doesn't have to map it for every request. Without it, or when it's
+ * disabled, they fall back to `pread` and `pwrite` on the same ring, one
+ * request at a time.
+ */
+
+enum struct JournalBackend {
+  // io_uring if it's available, or else plain system calls.
+  Auto,
+  Uring,
+  Sync,
+};
+
+static constexpr size_t kJournalChunkSize = 256 * 1024;
+static constexpr size_t kJournalQueueDepth = 8;
+
+/**
+ * Shared by the reader and writer: the ring, the backend, and the file.
+ */
+class JournalFile {
+public:
+  JournalFile(const size_t chunk_size, const size_t queue_depth) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    this->chunk_ = chunk_size < page ? page
+                                     : (chunk_size + page - 1) / page * page;
+    this->depth_ = queue_depth > 0 ? queue_depth : 1;
+  }
+
+  JournalFile(const JournalFile &) = delete;
+  void operator=(const JournalFile &) = delete;
+
+  ~JournalFile() {
+    this->closeFile();
+  }
+
+  /**
+   * The backend in use once open, which is never `Auto`.
+   */
+  JournalBackend backend() const {
+    return this->backend_;
+  }
+
+  size_t chunkSize() const {
+    return this->chunk_;
+  }
+
+  size_t queueDepth() const {
+    return this->depth_;
+  }
+
+  /**
+   * The `errno` of the first failed request, or zero.
+   */
+  int error() const {
+    return this->error_;
+  }
+
+protected:
+  int fd_ = -1;
+  size_t chunk_;
+  size_t depth_;
+  // A slot more than the queue depth, so that a whole queue of requests can
+  // be in flight while a partly consumed slot is still in use.
+  MirroredRing ring_;
+  Uring uring_;
+  bool fixed_ = false;
+  JournalBackend backend_ = JournalBackend::Sync;
+  size_t inflight_ = 0;
+  int error_ = 0;
+
+  bool openFile(const char path[], const int flags,
+                const JournalBackend backend) {
+    this->closeFile();
+
+    if (!this->ring_.open((this->depth_ + 1) * this->chunk_)) {
+      return false;
+    }
+
+    this->backend_ = JournalBackend::Sync;
+    if (backend != JournalBackend::Sync) {
+      if (this->uring_.open(this->depth_)) {
+        this->backend_ = JournalBackend::Uring;
+        this->fixed_ = this->uring_.registerBuffer(this->ring_.data(),
+                                                   this->ring_.capacity());
+      } else if (backend == JournalBackend::Uring) {
+        this->ring_.close();
+        return false;
+      }
+    }
+
+    this->fd_ = ::open(path, flags | O_CLOEXEC, 0644);
+    if (this->fd_ < 0) {
+      this->uring_.close();
+      this->ring_.close();
+      return false;
+    }
+    return true;
+  }
+
+  void closeFile() {
+    // Requests still in flight would land in the ring after it's unmapped.
+    while (this->inflight_ > 0 && this->uring_.submit(1)) {
+      io_uring_cqe cqe;
+      while (this->uring_.reap(cqe)) {
+        this->inflight_--;
+      }
+    }
+    this->inflight_ = 0;
+
+    this->uring_.close();
+    this->ring_.close();
+    if (this->fd_ >= 0) {
+      ::close(this->fd_);
+    }
+    this->fd_ = -1;
+    this->fixed_ = false;
+    this->error_ = 0;
+  }
+
+  uint8_t *at(const uint64_t offset) {
+    return &this->ring_.data()[offset % this->ring_.capacity()];
+  }
+
+  /**
+   * Queues a read or write of part of a slot, which never crosses the end of
+   * the ring. Returns false if the submission queue is full.
+   */
+  bool queue(const uint8_t op, const uint64_t offset, const size_t len,
+             const uint64_t tag) {
+    io_uring_sqe *sqe = this->uring_.sqe();
+    if (sqe == nullptr) {
+      return false;
+    }
+
+    // Older kernel headers define the opcodes as macros, not an enum.
+    uint8_t plain = op == IORING_OP_READ_FIXED
+                        ? static_cast<uint8_t>(IORING_OP_READ)
+                        : static_cast<uint8_t>(IORING_OP_WRITE);
+    sqe->opcode = this->fixed_ ? op : plain;
+    sqe->fd = this->fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(this->at(offset));
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = 0;
+    sqe->user_data = tag;
+    return true;
+  }
+
+  void fail(const int error) {
+    if (this->error_ == 0) {
+      this->error_ = error;
+    }
+  }
+};
+
+/**
+ * Reads the documents in a file in order, as zero-copy views into the ring,
+ * with up to the queue depth of chunks read ahead. Documents can be at most
+ * `maxDocumentSize()`, the queue depth times the chunk size.
+ */
+class JournalReader : public JournalFile {
+public:
+  JournalReader(const size_t chunk_size = kJournalChunkSize,
+                const size_t queue_depth = kJournalQueueDepth,
+                const bool validate = false) :
+      JournalFile(chunk_size, queue_depth),
+      validate_(validate) {}
+
+  bool open(const char path[],
+            const JournalBackend backend = JournalBackend::Auto) {
+    this->close();
+    if (!this->openFile(path, O_RDONLY, backend)) {
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(this->fd_, &st) != 0) {
+      this->close();
+      return false;
+    }
+    this->size_ = st.st_size;
+    this->slots_.assign(this->ring_.capacity() / this->chunk_, Slot());
+    this->status_ = StreamStatus::Ok;
+    return true;
+  }
+
+  void close() {
+    this->closeFile();
+    this->size_ = 0;
+    this->head_ = 0;
+    this->pending_ = 0;
+    this->queued_ = 0;
+    this->ready_ = 0;
+    this->status_ = StreamStatus::End;
+  }
+
+  bool next(deserializer::Document &out) {
+    this->head_ += this->pending_;
+    this->pending_ = 0;
+
+    while (this->status_ == StreamStatus::Ok) {
+      size_t avail = this->ready_ - this->head_;
+      if (avail >= static_cast<uint8_t>(TypeSize::Int32)) {
+        const uint8_t *frame = this->at(this->head_);
+        int32_t len =
+            endian::buffer_to_primitive<int32_t, TypeSize::Int32>(frame, 0);
+        if (len < static_cast<uint8_t>(TypeSize::Int32) +
+                      static_cast<uint8_t>(TypeSize::Byte) ||
+            static_cast<size_t>(len) > this->maxDocumentSize()) {
+          this->status_ = StreamStatus::Invalid;
+          break;
+        }
+
+        if (static_cast<size_t>(len) <= avail) {
+          deserializer::Document doc(frame, len);
+          if (this->validate_ && !doc.valid()) {
+            this->status_ = StreamStatus::Invalid;
+            break;
+          }
+
+          // Keep the next chunks coming while this one is processed.
+          this->readAhead();
+          out = doc;
+          this->pending_ = len;
+          return true;
+        }
+      }
+
+      if (this->ready_ == this->size_) {
+        this->status_ =
+            avail == 0 ? StreamStatus::End : StreamStatus::Truncated;
+        break;
+      }
+      if (!this->readAhead() || !this->await()) {
+        this->status_ = StreamStatus::IoError;
+      }
+    }
+
+    return false;
+  }
+
+  StreamStatus status() const {
+    return this->status_;
+  }
+
+  /**
+   * The end of the last complete document.
+   */
+  size_t offset() const {
+    return this->head_ + this->pending_;
+  }
+
+  size_t size() const {
+    return this->size_;
+  }
+
+  size_t maxDocumentSize() const {
+    return this->ring_.capacity() - this->chunk_;
+  }
+
+private:
+  struct Slot {
+    size_t want = 0;
+    size_t done = 0;
+  };
+
+  bool validate_;
+  uint64_t size_ = 0;
+  // The start of the current document, and its length once handed out.
+  uint64_t head_ = 0;
+  size_t pending_ = 0;
+  // Everything before `queued_` has been requested, and everything before
+  // `ready_` has arrived.
+  uint64_t queued_ = 0;
+  uint64_t ready_ = 0;
+  std::vector<Slot> slots_;
+  StreamStatus status_ = StreamStatus::End;
+
+  Slot &slotAt(const uint64_t offset) {
+    return this->slots_[(offset / this->chunk_) % this->slots_.size()];
+  }
+
+  /**
+   * Requests every chunk that has a free slot, up to the queue depth.
+   */
+  bool readAhead() {
+    bool queued = false;
+    while (this->queued_ < this->size_ &&
+           this->queued_ + this->chunk_ - this->head_ <=
+               this->ring_.capacity() &&
+           (this->backend_ == JournalBackend::Sync ||
+            this->inflight_ < this->depth_)) {
+      size_t len = this->chunk_;
+      if (this->size_ - this->queued_ < len) {
+        len = this->size_ - this->queued_;
+      }
+
+      // Synchronous reads complete straight away, so count it first.
+      uint64_t offset = this->queued_;
+      Slot &slot = this->slotAt(offset);
+      slot.want = len;
+      slot.done = 0;
+      this->queued_ += len;
+      if (!this->request(offset, len)) {
+        return false;
+      }
+      queued = true;
+    }
+
+    if (queued && this->backend_ == JournalBackend::Uring &&
+        !this->uring_.submit()) {
+      this->fail(errno);
+      return false;
+    }
+    return this->error_ == 0;
+  }
+
+  bool request(const uint64_t offset, const size_t len) {
+    if (this->backend_ == JournalBackend::Uring) {
+      if (!this->queue(IORING_OP_READ_FIXED, offset, len, offset)) {
+        return false;
+      }
+      this->inflight_++;
+      return true;
+    }
+
+    ssize_t n;
+    do {
+      n = pread(this->fd_, this->at(offset), len, offset);
+    } while (n < 0 && errno == EINTR);
+    return this->complete(offset, n < 0 ? -errno : n);
+  }
+
+  /**
+   * Records a read of `res` bytes, or an error, at `offset`, asking again
+   * for the rest of a short read.
+   */
+  bool complete(const uint64_t offset, const ssize_t res) {
+    Slot &slot = this->slotAt(offset);
+    if (res == -EINTR || res == -EAGAIN) {
+      return this->request(offset, slot.want - slot.done);
+    }
+    if (res <= 0) {
+      // A zero-length read means the file shrank since it was opened.
+      this->fail(res < 0 ? -res : EIO);
+      return false;
+    }
+
+    slot.done += res;
+    if (slot.done < slot.want) {
+      return this->request(offset + res, slot.want - slot.done);
+    }
+
+    while (this->ready_ < this->queued_) {
+      Slot &next = this->slotAt(this->ready_);
+      if (next.done < next.want) {
+        break;
+      }
+      this->ready_ += next.want;
+    }
+    return true;
+  }
+
+  /**
+   * Waits for at least one read to finish, and takes every finished one.
+   */
+  bool await() {
+    if (this->backend_ == JournalBackend::Sync) {
+      return this->error_ == 0;
+    }
+
+    if (!this->uring_.submit(1)) {
+      this->fail(errno);
+      return false;
+    }
+
+    io_uring_cqe cqe;
+    while (this->uring_.reap(cqe)) {
+      this->inflight_--;
+      // Resubmitting the rest of a short read can't fail, since it reuses
+      // the entry just freed.
+      this->complete(cqe.user_data, cqe.res);
+    }
+    return this->uring_.submit() && this->error_ == 0;
+  }
+};
+
+/**
+ * Appends documents to a file, serializing them straight into the ring.
+ * Chunks are written as they fill, up to the queue depth at once, and
+ * `flush` writes whatever's left.
+ */
+class JournalWriter : public JournalFile {
+public:
+  JournalWriter(const size_t chunk_size = kJournalChunkSize,
+                const size_t queue_depth = kJournalQueueDepth) :
+      JournalFile(chunk_size, queue_depth) {}
+
+  ~JournalWriter() {
+    this->close();
+  }
+
+  /**
+   * Creates or truncates a file.
+   */
+  bool open(const char path[],
+            const JournalBackend backend = JournalBackend::Auto) {
+    this->close();
+    if (!this->openFile(path, O_WRONLY | O_CREAT | O_TRUNC, backend)) {
+      return false;
+    }
+
+    this->writes_.assign(this->depth_, Write());
+    return true;
+  }
+
+  /**
+   * Flushes and closes the file. Returns false if any write failed.
+   */
+  bool close() {
+    bool ok = this->fd_ < 0 || this->flush();
+    this->closeFile();
+    this->tail_ = 0;
+    this->submitted_ = 0;
+    return ok;
+  }
+
+  /**
+   * Like `FrameWriter::write`, fails with a buffer overflow, and the length
+   * the document needs, when it's larger than `maxDocumentSize()`. Also
+   * fails once a write has, with `error()` set.
+   */
+  serializer::Result
+  append(std::function<void(serializer::Document &)> builder) {
+    if (this->fd_ < 0 || this->error_ != 0) {
+      return { serializer::Status::BufferOverflow, 0 };
+    }
+
+    serializer::Result res = this->build(builder);
+    if (res.status != serializer::Status::Ok &&
+        res.len <= this->maxDocumentSize() && this->makeRoom(res.len)) {
+      res = this->build(builder);
+    }
+
+    if (res.status == serializer::Status::Ok) {
+      this->tail_ += res.len;
+      this->writeFull();
+    }
+    return res;
+  }
+
+  serializer::Result append(const uint8_t doc[], const size_t len) {
+    if (this->fd_ < 0 || this->error_ != 0 ||
+        len > this->maxDocumentSize() || !this->makeRoom(len)) {
+      return { serializer::Status::BufferOverflow, len };
+    }
+
+    memcpy(this->at(this->tail_), doc, len);
+    this->tail_ += len;
+    this->writeFull();
+    return { serializer::Status::Ok, len };
+  }
+
+  /**
+   * Writes everything appended so far, and waits for it. It's then in the
+   * page cache; call `fdatasync` for it to survive a crash.
+   */
+  bool flush() {
+    while (this->error_ == 0 &&
+           (this->submitted_ < this->tail_ || this->inflight_ > 0)) {
+      this->writeSome(true);
+      if (this->inflight_ > 0) {
+        this->await();
+      }
+    }
+    return this->error_ == 0;
+  }
+
+  /**
+   * The number of bytes appended.
+   */
+  size_t size() const {
+    return this->tail_;
+  }
+
+  size_t maxDocumentSize() const {
+    return this->ring_.capacity() - this->chunk_;
+  }
+
+private:
+  struct Write {
+    uint64_t offset = 0;
+    size_t len = 0;
+    size_t done = 0;
+    bool busy = false;
+  };
+
+  // Everything before `submitted_` has been requested, and up to `tail_`
+  // has been appended.
+  uint64_t submitted_ = 0;
+  uint64_t tail_ = 0;
+  std::vector<Write> writes_;
+
+  /**
+   * The start of the oldest unfinished write, before which the ring is free.
+   */
+  uint64_t written() const {
+    uint64_t written = this->submitted_;
+    for (auto const &write : this->writes_) {
+      if (write.busy && write.offset < written) {
+        written = write.offset;
+      }
+    }
+    return written;
+  }
+
+  size_t room() const {
+    return this->ring_.capacity() - (this->tail_ - this->written());
+  }
+
+  serializer::Result
+  build(const std::function<void(serializer::Document &)> &builder) {
+    size_t room = this->room();
+    if (room > this->maxDocumentSize()) {
+      room = this->maxDocumentSize();
+    }
+    return serializer::Document::build(this->at(this->tail_), room, builder);
+  }
+
+  bool makeRoom(const size_t len) {
+    while (this->error_ == 0 && this->room() < len) {
+      this->writeSome(true);
+      this->await();
+    }
+    return this->error_ == 0;
+  }
+
+  void writeFull() {
+    if (this->tail_ - this->submitted_ >= this->chunk_) {
+      this->writeSome(false);
+    }
+  }
+
+  /**
+   * Requests writes of the appended data up to the end of each slot, so
+   * that none crosses the end of the ring, and only of whole slots unless
+   * `partial`.
+   */
+  void writeSome(const bool partial) {
+    if (this->backend_ == JournalBackend::Sync) {
+      // Everything at once, which the mirroring keeps contiguous.
+      size_t len = this->tail_ - this->submitted_;
+      if (!partial) {
+        len -= (this->submitted_ + len) % this->chunk_;
+      }
+      if (len > 0) {
+        this->writeSync(this->submitted_, len);
+        this->submitted_ += len;
+      }
+      return;
+    }
+
+    bool queued = false;
+    while (this->submitted_ < this->tail_ && this->inflight_ < this->depth_) {
+      size_t len = this->chunk_ - this->submitted_ % this->chunk_;
+      if (this->tail_ - this->submitted_ < len) {
+        if (!partial) {
+          break;
+        }
+        len = this->tail_ - this->submitted_;
+      }
+
+      size_t index = 0;
+      while (this->writes_[index].busy) {
+        index++;
+      }
+      Write &write = this->writes_[index];
+      write.offset = this->submitted_;
+      write.len = len;
+      write.done = 0;
+      write.busy = true;
+      if (!this->queue(IORING_OP_WRITE_FIXED, write.offset, len, index)) {
+        write.busy = false;
+        break;
+      }
+      this->inflight_++;
+      this->submitted_ += len;
+      queued = true;
+    }
+
+    if (queued && !this->uring_.submit()) {
+      this->fail(errno);
+    }
+  }
+
+  void writeSync(uint64_t offset, size_t len) {
+    while (len > 0) {
+      ssize_t n = pwrite(this->fd_, this->at(offset), len, offset);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        this->fail(errno);
+        return;
+      }
+      offset += n;
+      len -= n;
+    }
+  }
+
+  void await() {
+    if (this->inflight_ == 0) {
+      return;
+    }
+    if (!this->uring_.submit(1)) {
+      this->fail(errno);
+      return;
+    }
+
+    io_uring_cqe cqe;
+    bool queued = false;
+    while (this->uring_.reap(cqe)) {
+      this->inflight_--;
+      Write &write = this->writes_[cqe.user_data];
+
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+        cqe.res = 0;
+      } else if (cqe.res < 0) {
+        write.busy = false;
+        this->fail(-cqe.res);
+        continue;
+      }
+
+      // Ask again for the rest of a short write, in the entry just freed.
+      write.done += cqe.res;
+      if (write.done < write.len) {
+        this->queue(IORING_OP_WRITE_FIXED, write.offset + write.done,
+                    write.len - write.done, cqe.user_data);
+        this->inflight_++;
+        queued = true;
+      } else {
+        write.busy = false;
+      }
+    }
+
+    if (queued && !this->uring_.submit()) {
+      this->fail(errno);
+    }
+  }
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,417 @@
+#ifndef POT_BSON_IO_LOOP_H_
+#define POT_BSON_IO_LOOP_H_
+
+#include "../deserializer/document.hpp"
+#include "../serializer/document.hpp"
+#include "../serializer/result.hpp"
+#include "./frame.hpp"
+#include "./ring.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+static constexpr size_t kLoopMaxEvents = 256;
+
+/**
+ * Counters for one connection. Latency is from the loop being woken for a
+ * connection to the handler for one of its documents returning, so it
+ * includes the time spent on the documents before it in the same batch.
+ */
+struct ConnectionStats {
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  uint64_t docs_in = 0;
+  uint64_t docs_out = 0;
+  // Wakeups that dispatched at least one document.
+  uint64_t batches = 0;
+  uint64_t latency_ns_total = 0;
+  uint64_t latency_ns_max = 0;
+
+  uint64_t meanLatencyNs() const {
+    return this->docs_in == 0 ? 0 : this->latency_ns_total / this->docs_in;
+  }
+};
+
+/**
+ * Why a connection was closed.
+ */
+enum struct CloseReason {
+  Requested,
+  PeerClosed,
+  // A read or write failed.
+  Error,
+  // The peer sent a frame that was too large or invalid.
+  BadFrame,
+};
+
+/**
+ * A single-threaded, edge-triggered epoll loop over many stream sockets
+ * carrying back-to-back BSON documents.
+ *
+ * Each connection has a `MirroredRing` in each direction. Reads drain the
+ * socket into the input ring and dispatch every complete document to the
+ * connection's handler in a batch, as zero-copy views. Documents sent with
+ * `send` are serialized straight into the output ring, and everything queued
+ * during one `poll` goes out in as few syscalls as the socket allows.
+ *
+ * Linux only. Connections are identified by their file descriptor, which the
+ * loop owns once added.
+ */
+class Loop {
+public:
+  using Handler =
+      std::function<void(Loop &, int, const deserializer::Document &)>;
+  using CloseHandler =
+      std::function<void(int, CloseReason, const ConnectionStats &)>;
+
+  Loop(const size_t ring_size, const size_t max_frame_size,
+       const bool validate = false) :
+      ring_size_(ring_size),
+      max_frame_size_(max_frame_size), validate_(validate) {}
+
+  Loop(const Loop &) = delete;
+  void operator=(const Loop &) = delete;
+
+  ~Loop() {
+    for (auto &entry : this->conns_) {
+      ::close(entry.first);
+    }
+    if (this->epfd_ >= 0) {
+      ::close(this->epfd_);
+    }
+  }
+
+  bool open() {
+    if (this->epfd_ < 0) {
+      this->epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    }
+    return this->epfd_ >= 0;
+  }
+
+  /**
+   * Called with every connection as it's closed, with its final stats.
+   */
+  void onClose(CloseHandler handler) {
+    this->on_close_ = std::move(handler);
+  }
+
+  /**
+   * Takes ownership of a connected socket and makes it non-blocking. On
+   * failure the socket is left open and still belongs to the caller.
+   */
+  bool add(const int fd, Handler handler) {
+    if (this->epfd_ < 0 || this->conns_.count(fd) != 0) {
+      return false;
+    }
+
+    std::unique_ptr<Connection> conn(new Connection(fd, std::move(handler)));
+    if (!conn->in.open(this->ring_size_) ||
+        !conn->out.open(this->ring_size_)) {
+      return false;
+    }
+    conn->reader.reset(
+        new FrameReader(conn->in, this->max_frame_size_, this->validate_));
+    conn->writer.reset(new FrameWriter(conn->out, this->max_frame_size_));
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+      return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(this->epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      return false;
+    }
+
+    this->conns_[fd] = std::move(conn);
+    return true;
+  }
+
+  /**
+   * Queues a document for a connection. It's sent by the end of the current
+   * or next `poll`. Fails with a buffer overflow, without queueing anything,
+   * if the output ring is too full, or the document is larger than the
+   * maximum frame size.
+   */
+  serializer::Result
+  send(const int fd, std::function<void(serializer::Document &)> builder) {
+    Connection *conn = this->find(fd);
+    if (conn == nullptr) {
+      return { serializer::Status::BufferOverflow, 0 };
+    }
+
+    serializer::Result res = conn->writer->write(builder);
+    this->queued(*conn, res);
+    return res;
+  }
+
+  serializer::Result send(const int fd, const uint8_t doc[],
+                          const size_t len) {
+    Connection *conn = this->find(fd);
+    if (conn == nullptr) {
+      return { serializer::Status::BufferOverflow, len };
+    }
+
+    serializer::Result res = conn->writer->write(doc, len);
+    this->queued(*conn, res);
+    return res;
+  }
+
+  /**
+   * Closes a connection. From inside a handler this takes effect once the
+   * handler returns, and the rest of the batch is dropped.
+   */
+  void close(const int fd) {
+    Connection *conn = this->find(fd);
+    if (conn != nullptr) {
+      this->shut(*conn, CloseReason::Requested);
+      if (!this->dispatching_) {
+        this->reap();
+      }
+    }
+  }
+
+  /**
+   * Waits up to `timeout_ms` for activity, handles it, and flushes queued
+   * output. Returns the number of connections woken, or -1 on error.
+   */
+  int poll(const int timeout_ms) {
+    this->flushQueued();
+
+    epoll_event events[kLoopMaxEvents];
+    int n;
+    do {
+      n = epoll_wait(this->epfd_, events, kLoopMaxEvents, timeout_ms);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+      return -1;
+    }
+
+    Clock::time_point woken = Clock::now();
+    this->dispatching_ = true;
+    for (int i = 0; i < n; i++) {
+      Connection *conn = this->find(events[i].data.fd);
+      if (conn == nullptr || conn->close) {
+        continue;
+      }
+
+      if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        this->receive(*conn, woken);
+      }
+      // Output that was blocked can go now that the socket has drained.
+      if (events[i].events & EPOLLOUT && conn->writer->pending() > 0) {
+        this->markDirty(*conn);
+      }
+    }
+    this->dispatching_ = false;
+
+    this->flushQueued();
+    this->reap();
+    return n;
+  }
+
+  size_t size() const {
+    return this->conns_.size();
+  }
+
+  const ConnectionStats *stats(const int fd) const {
+    auto it = this->conns_.find(fd);
+    return it == this->conns_.end() ? nullptr : &it->second->stats;
+  }
+
+  /**
+   * Bytes queued but not yet sent on a connection.
+   */
+  size_t pending(const int fd) const {
+    auto it = this->conns_.find(fd);
+    return it == this->conns_.end() ? 0 : it->second->writer->pending();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Connection {
+    Connection(const int fd, Handler handler) :
+        fd(fd), handler(std::move(handler)) {}
+
+    int fd;
+    Handler handler;
+    MirroredRing in;
+    MirroredRing out;
+    std::unique_ptr<FrameReader> reader;
+    std::unique_ptr<FrameWriter> writer;
+    ConnectionStats stats;
+    bool dirty = false;
+    bool close = false;
+    CloseReason closing = CloseReason::Requested;
+  };
+
+  size_t ring_size_;
+  size_t max_frame_size_;
+  bool validate_;
+  int epfd_ = -1;
+  bool dispatching_ = false;
+  std::unordered_map<int, std::unique_ptr<Connection>> conns_;
+  // Connections with output queued since they were last flushed.
+  std::vector<int> dirty_;
+  std::vector<int> closed_;
+  CloseHandler on_close_;
+
+  Connection *find(const int fd) {
+    auto it = this->conns_.find(fd);
+    return it == this->conns_.end() ? nullptr : it->second.get();
+  }
+
+  void queued(Connection &conn, const serializer::Result &res) {
+    if (res.status != serializer::Status::Ok) {
+      return;
+    }
+
+    conn.stats.docs_out++;
+    this->markDirty(conn);
+  }
+
+  void markDirty(Connection &conn) {
+    if (!conn.dirty) {
+      conn.dirty = true;
+      this->dirty_.push_back(conn.fd);
+    }
+  }
+
+  void shut(Connection &conn, const CloseReason reason) {
+    if (!conn.close) {
+      conn.close = true;
+      conn.closing = reason;
+      this->closed_.push_back(conn.fd);
+    }
+  }
+
+  /**
+   * Reads until the socket would block, as edge-triggering requires,
+   * dispatching after every read so that the ring never stays full.
+   */
+  void receive(Connection &conn, const Clock::time_point woken) {
+    bool dispatched = false;
+
+    while (!conn.close) {
+      ssize_t n = conn.reader->fill(conn.fd);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          this->shut(conn, CloseReason::Error);
+        }
+        break;
+      }
+
+      conn.stats.bytes_in += n;
+      dispatched |= this->dispatch(conn, woken);
+
+      if (n == 0) {
+        this->shut(conn, CloseReason::PeerClosed);
+      }
+    }
+
+    if (dispatched) {
+      conn.stats.batches++;
+    }
+  }
+
+  bool dispatch(Connection &conn, const Clock::time_point woken) {
+    bool any = false;
+    deserializer::Document doc;
+
+    while (!conn.close && conn.reader->next(doc)) {
+      conn.handler(*this, conn.fd, doc);
+      any = true;
+
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - woken)
+                        .count();
+      conn.stats.docs_in++;
+      conn.stats.latency_ns_total += ns;
+      if (ns > conn.stats.latency_ns_max) {
+        conn.stats.latency_ns_max = ns;
+      }
+    }
+
+    FrameStatus status = conn.reader->status();
+    if (status == FrameStatus::TooLarge || status == FrameStatus::Invalid) {
+      this->shut(conn, CloseReason::BadFrame);
+    }
+    return any;
+  }
+
+  void flushQueued() {
+    // Flushing never queues more, so the list can't change under us.
+    for (int fd : this->dirty_) {
+      Connection *conn = this->find(fd);
+      if (conn == nullptr) {
+        continue;
+      }
+      conn->dirty = false;
+      if (!conn->close) {
+        this->flush(*conn);
+      }
+    }
+    this->dirty_.clear();
+  }
+
+  /**
+   * Sends until the socket would block. What's left waits for the next
+   * `EPOLLOUT` edge, which marks the connection dirty again.
+   */
+  void flush(Connection &conn) {
+    while (conn.writer->pending() > 0) {
+      ssize_t n;
+      do {
+        n = ::send(conn.fd, conn.writer->data(), conn.writer->pending(),
+                   MSG_NOSIGNAL);
+      } while (n < 0 && errno == EINTR);
+
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          this->shut(conn, CloseReason::Error);
+        }
+        return;
+      }
+
+      conn.writer->consume(n);
+      conn.stats.bytes_out += n;
+    }
+  }
+
+  void reap() {
+    for (int fd : this->closed_) {
+      auto it = this->conns_.find(fd);
+      Connection &conn = *it->second;
+
+      epoll_ctl(this->epfd_, EPOLL_CTL_DEL, fd, nullptr);
+      ::close(fd);
+      if (this->on_close_) {
+        this->on_close_(fd, conn.closing, conn.stats);
+      }
+      this->conns_.erase(it);
+    }
+    this->closed_.clear();
+  }
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef POT_BSON_IO_MAPPED_FILE_H_
+#define POT_BSON_IO_MAPPED_FILE_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+/**
+ * A read-only memory mapping of a whole file, advised for sequential access.
+ * POSIX only.
+ */
+class MappedFile {
+public:
+  MappedFile() {}
+
+  MappedFile(const MappedFile &) = delete;
+  void operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    this->close();
+  }
+
+  bool open(const char path[]) {
+    this->close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+
+    this->size_ = st.st_size;
+    if (this->size_ == 0) {
+      // Empty files can't be mapped, but are still a valid empty stream.
+      ::close(fd);
+      return true;
+    }
+
+    void *data = mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      this->size_ = 0;
+      return false;
+    }
+
+    madvise(data, this->size_, MADV_SEQUENTIAL);
+    this->data_ = static_cast<uint8_t *>(data);
+    return true;
+  }
+
+  void close() {
+    if (this->data_ != nullptr) {
+      munmap(this->data_, this->size_);
+    }
+
+    this->data_ = nullptr;
+    this->size_ = 0;
+  }
+
+  const uint8_t *data() const {
+    return this->data_;
+  }
+
+  size_t size() const {
+    return this->size_;
+  }
+
+private:
+  uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
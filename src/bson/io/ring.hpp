@@ -0,0 +1,147 @@
+#ifndef POT_BSON_IO_RING_H_
+#define POT_BSON_IO_RING_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+/**
+ * A byte ring buffer whose memory is mapped twice, back to back, so that any
+ * run of up to `capacity()` bytes starting anywhere in it is contiguous, even
+ * when it wraps around the end. Data can then be read into it, and documents
+ * read out of it, without ever being copied to straighten them out.
+ *
+ * Linux only, since it relies on `memfd_create`. It isn't thread-safe.
+ */
+class MirroredRing {
+public:
+  MirroredRing() {}
+
+  MirroredRing(const MirroredRing &) = delete;
+  void operator=(const MirroredRing &) = delete;
+
+  ~MirroredRing() {
+    this->close();
+  }
+
+  /**
+   * Maps a ring of at least `capacity` bytes, rounded up to whole pages.
+   */
+  bool open(const size_t capacity) {
+    this->close();
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (capacity + page - 1) / page * page;
+    if (size == 0) {
+      return false;
+    }
+
+    int fd = memfd_create("pot-bson-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    if (ftruncate(fd, size) != 0) {
+      ::close(fd);
+      return false;
+    }
+
+    // Reserve both halves at once so that they're adjacent, then map the
+    // same pages over each.
+    void *base = mmap(nullptr, 2 * size, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+
+    uint8_t *data = static_cast<uint8_t *>(base);
+    bool mapped =
+        mmap(data, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+             0) != MAP_FAILED &&
+        mmap(data + size, size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+    ::close(fd);
+    if (!mapped) {
+      munmap(base, 2 * size);
+      return false;
+    }
+
+    this->data_ = data;
+    this->capacity_ = size;
+    return true;
+  }
+
+  void close() {
+    if (this->data_ != nullptr) {
+      munmap(this->data_, 2 * this->capacity_);
+    }
+
+    this->data_ = nullptr;
+    this->capacity_ = 0;
+    this->head_ = 0;
+    this->tail_ = 0;
+  }
+
+  size_t capacity() const {
+    return this->capacity_;
+  }
+
+  /**
+   * The start of the first mapping, for callers that track positions
+   * themselves. `data()[i]` and `data()[i + capacity()]` are the same byte.
+   */
+  uint8_t *data() {
+    return this->data_;
+  }
+
+  /**
+   * The bytes written but not yet consumed, contiguous from `readPtr()`.
+   */
+  size_t readable() const {
+    return this->tail_ - this->head_;
+  }
+
+  const uint8_t *readPtr() const {
+    return &this->data_[this->head_ % this->capacity_];
+  }
+
+  void consume(const size_t len) {
+    this->head_ += len;
+  }
+
+  /**
+   * The free space, contiguous from `writePtr()`.
+   */
+  size_t writable() const {
+    return this->capacity_ - this->readable();
+  }
+
+  uint8_t *writePtr() {
+    return &this->data_[this->tail_ % this->capacity_];
+  }
+
+  /**
+   * Makes `len` bytes written at `writePtr()` readable.
+   */
+  void commit(const size_t len) {
+    this->tail_ += len;
+  }
+
+private:
+  uint8_t *data_ = nullptr;
+  size_t capacity_ = 0;
+  // Total bytes consumed and committed, which never wrap in practice.
+  uint64_t head_ = 0;
+  uint64_t tail_ = 0;
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef POT_BSON_IO_URING_H_
+#define POT_BSON_IO_URING_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace pot {
+namespace bson {
+namespace io {
+
+/**
+ * A minimal io_uring instance, driven through the raw system calls so that
+ * liburing isn't needed. Only what the journal reader and writer use is
+ * here: queueing SQEs, submitting them, optionally waiting, and reaping
+ * CQEs, plus registering a fixed buffer.
+ *
+ * Linux 5.1 or later. `open` fails where io_uring is missing or disabled, so
+ * that callers can fall back to plain system calls.
+ */
+class Uring {
+public:
+  Uring() {}
+
+  Uring(const Uring &) = delete;
+  void operator=(const Uring &) = delete;
+
+  ~Uring() {
+    this->close();
+  }
+
+  bool open(const unsigned entries) {
+    this->close();
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+      return false;
+    }
+    this->fd_ = fd;
+
+    size_t sq_len = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cq_len =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && cq_len > sq_len) {
+      sq_len = cq_len;
+    }
+
+    this->sq_ring_ = map(fd, sq_len, IORING_OFF_SQ_RING);
+    this->sq_len_ = sq_len;
+    if (this->sq_ring_ == nullptr) {
+      this->close();
+      return false;
+    }
+
+    if (single) {
+      this->cq_ring_ = this->sq_ring_;
+    } else {
+      this->cq_ring_ = map(fd, cq_len, IORING_OFF_CQ_RING);
+      this->cq_len_ = cq_len;
+      if (this->cq_ring_ == nullptr) {
+        this->close();
+        return false;
+      }
+    }
+
+    this->sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+    this->sqes_ = reinterpret_cast<io_uring_sqe *>(
+        map(fd, this->sqes_len_, IORING_OFF_SQES));
+    if (this->sqes_ == nullptr) {
+      this->close();
+      return false;
+    }
+
+    uint8_t *sq = this->sq_ring_;
+    this->sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    this->sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    this->sq_mask_ =
+        *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    this->sq_entries_ = params.sq_entries;
+    this->sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    uint8_t *cq = this->cq_ring_;
+    this->cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    this->cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    this->cq_mask_ =
+        *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    this->cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  void close() {
+    if (this->sqes_ != nullptr) {
+      munmap(this->sqes_, this->sqes_len_);
+    }
+    if (this->cq_ring_ != nullptr && this->cq_ring_ != this->sq_ring_) {
+      munmap(this->cq_ring_, this->cq_len_);
+    }
+    if (this->sq_ring_ != nullptr) {
+      munmap(this->sq_ring_, this->sq_len_);
+    }
+    if (this->fd_ >= 0) {
+      ::close(this->fd_);
+    }
+
+    this->fd_ = -1;
+    this->sq_ring_ = nullptr;
+    this->cq_ring_ = nullptr;
+    this->sqes_ = nullptr;
+    this->unpublished_ = 0;
+    this->queued_ = 0;
+  }
+
+  bool isOpen() const {
+    return this->fd_ >= 0;
+  }
+
+  /**
+   * Registers one buffer, as index 0, for `IORING_OP_READ_FIXED` and
+   * `IORING_OP_WRITE_FIXED`. The pages stay pinned until the ring is closed.
+   */
+  bool registerBuffer(void *addr, const size_t len) {
+    iovec iov = { addr, len };
+    return syscall(__NR_io_uring_register, this->fd_,
+                   IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+  }
+
+  /**
+   * Returns a zeroed SQE to fill in, which goes to the kernel with the next
+   * `submit`, or null if the submission queue is full.
+   */
+  io_uring_sqe *sqe() {
+    unsigned head = __atomic_load_n(this->sq_head_, __ATOMIC_ACQUIRE);
+    unsigned tail = *this->sq_tail_ + this->unpublished_;
+    if (tail - head >= this->sq_entries_) {
+      return nullptr;
+    }
+
+    unsigned index = tail & this->sq_mask_;
+    io_uring_sqe *sqe = &this->sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    this->sq_array_[index] = index;
+    this->unpublished_++;
+    return sqe;
+  }
+
+  /**
+   * Submits the queued SQEs, and waits until at least `wait` completions are
+   * ready. Returns false, with `errno` set, on failure.
+   */
+  bool submit(const unsigned wait = 0) {
+    // Filled in SQEs only become visible to the kernel here.
+    if (this->unpublished_ > 0) {
+      __atomic_store_n(this->sq_tail_, *this->sq_tail_ + this->unpublished_,
+                       __ATOMIC_RELEASE);
+      this->queued_ += this->unpublished_;
+      this->unpublished_ = 0;
+    }
+
+    while (this->queued_ > 0 || wait > 0) {
+      int n = syscall(__NR_io_uring_enter, this->fd_, this->queued_, wait,
+                      wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+
+      this->queued_ -= n;
+      if (this->queued_ == 0 || wait > 0) {
+        break;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Takes the next completion, if there is one.
+   */
+  bool reap(io_uring_cqe &out) {
+    unsigned head = *this->cq_head_;
+    if (head == __atomic_load_n(this->cq_tail_, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+
+    out = this->cqes_[head & this->cq_mask_];
+    __atomic_store_n(this->cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+private:
+  int fd_ = -1;
+  // SQEs handed out but not yet published, and published but not yet taken.
+  unsigned unpublished_ = 0;
+  unsigned queued_ = 0;
+
+  uint8_t *sq_ring_ = nullptr;
+  size_t sq_len_ = 0;
+  unsigned *sq_head_ = nullptr;
+  unsigned *sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned *sq_array_ = nullptr;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqes_len_ = 0;
+
+  uint8_t *cq_ring_ = nullptr;
+  size_t cq_len_ = 0;
+  unsigned *cq_head_ = nullptr;
+  unsigned *cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+
+  static uint8_t *map(const int fd, const size_t len, const off_t offset) {
+    void *ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? nullptr : static_cast<uint8_t *>(ptr);
+  }
+};
+
+} // namespace io
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef POT_BSON_JSON_CHARS_H_
+#define POT_BSON_JSON_CHARS_H_
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace json {
+
+static constexpr char kHexDigits[] = "0123456789abcdef";
+
+/**
+ * Flags the bytes of an 8-byte word that need escaping in a JSON string:
+ * control characters, quotes and backslashes. A flag can only be wrong in a
+ * byte above one that is correctly flagged, so a zero mask means the whole
+ * word can be copied as is.
+ */
+inline uint64_t escape_mask(const uint64_t word) {
+  static constexpr uint64_t kOnes = 0x0101010101010101;
+  static constexpr uint64_t kHigh = 0x8080808080808080;
+
+  uint64_t quote = word ^ (kOnes * '"');
+  uint64_t backslash = word ^ (kOnes * '\\');
+
+  return (((word - kOnes * 0x20) & ~word) | ((quote - kOnes) & ~quote) |
+          ((backslash - kOnes) & ~backslash)) &
+         kHigh;
+}
+
+} // namespace json
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef POT_BSON_JSON_DTOA_H_
+#define POT_BSON_JSON_DTOA_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace json {
+
+/**
+ * Enough room for any double formatted by `format_double`.
+ */
+static constexpr size_t kDoubleBufSize = 32;
+
+/**
+ * A double as a 64-bit significand and binary exponent, `f * 2^e`.
+ */
+struct DiyFp {
+  uint64_t f;
+  int e;
+
+  DiyFp sub(const DiyFp &other) const {
+    return { this->f - other.f, this->e };
+  }
+
+  /**
+   * The product rounded to the upper 64 bits.
+   */
+  DiyFp mul(const DiyFp &other) const {
+    uint64_t a_lo = this->f & 0xFFFFFFFF;
+    uint64_t a_hi = this->f >> 32;
+    uint64_t b_lo = other.f & 0xFFFFFFFF;
+    uint64_t b_hi = other.f >> 32;
+
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t hi_hi = a_hi * b_hi;
+
+    uint64_t mid = (lo_lo >> 32) + (lo_hi & 0xFFFFFFFF) +
+                   (hi_lo & 0xFFFFFFFF) + (static_cast<uint64_t>(1) << 31);
+
+    return { hi_hi + (lo_hi >> 32) + (hi_lo >> 32) + (mid >> 32),
+             this->e + other.e + 64 };
+  }
+
+  DiyFp normalize() const {
+    DiyFp out = *this;
+    while ((out.f >> 63) == 0) {
+      out.f <<= 1;
+      out.e--;
+    }
+    return out;
+  }
+};
+
+struct CachedPower {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+// Normalized powers of ten, 10^k ~= f * 2^e, every 8th from 10^-300.
+static constexpr int kCachedPowersMinK = -300;
+static constexpr int kCachedPowersStep = 8;
+static constexpr CachedPower kCachedPowers[] = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C, -980, -276 },
+    { 0xD3515C2831559A83, -954, -268 },
+    { 0x9D71AC8FADA6C9B5, -927, -260 },
+    { 0xEA9C227723EE8BCB, -901, -252 },
+    { 0xAECC49914078536D, -874, -244 },
+    { 0x823C12795DB6CE57, -847, -236 },
+    { 0xC21094364DFB5637, -821, -228 },
+    { 0x9096EA6F3848984F, -794, -220 },
+    { 0xD77485CB25823AC7, -768, -212 },
+    { 0xA086CFCD97BF97F4, -741, -204 },
+    { 0xEF340A98172AACE5, -715, -196 },
+    { 0xB23867FB2A35B28E, -688, -188 },
+    { 0x84C8D4DFD2C63F3B, -661, -180 },
+    { 0xC5DD44271AD3CDBA, -635, -172 },
+    { 0x936B9FCEBB25C996, -608, -164 },
+    { 0xDBAC6C247D62A584, -582, -156 },
+    { 0xA3AB66580D5FDAF6, -555, -148 },
+    { 0xF3E2F893DEC3F126, -529, -140 },
+    { 0xB5B5ADA8AAFF80B8, -502, -132 },
+    { 0x87625F056C7C4A8B, -475, -124 },
+    { 0xC9BCFF6034C13053, -449, -116 },
+    { 0x964E858C91BA2655, -422, -108 },
+    { 0xDFF9772470297EBD, -396, -100 },
+    { 0xA6DFBD9FB8E5B88F, -369, -92 },
+    { 0xF8A95FCF88747D94, -343, -84 },
+    { 0xB94470938FA89BCF, -316, -76 },
+    { 0x8A08F0F8BF0F156B, -289, -68 },
+    { 0xCDB02555653131B6, -263, -60 },
+    { 0x993FE2C6D07B7FAC, -236, -52 },
+    { 0xE45C10C42A2B3B06, -210, -44 },
+    { 0xAA242499697392D3, -183, -36 },
+    { 0xFD87B5F28300CA0E, -157, -28 },
+    { 0xBCE5086492111AEB, -130, -20 },
+    { 0x8CBCCC096F5088CC, -103, -12 },
+    { 0xD1B71758E219652C, -77, -4 },
+    { 0x9C40000000000000, -50, 4 },
+    { 0xE8D4A51000000000, -24, 12 },
+    { 0xAD78EBC5AC620000, 3, 20 },
+    { 0x813F3978F8940984, 30, 28 },
+    { 0xC097CE7BC90715B3, 56, 36 },
+    { 0x8F7E32CE7BEA5C70, 83, 44 },
+    { 0xD5D238A4ABE98068, 109, 52 },
+    { 0x9F4F2726179A2245, 136, 60 },
+    { 0xED63A231D4C4FB27, 162, 68 },
+    { 0xB0DE65388CC8ADA8, 189, 76 },
+    { 0x83C7088E1AAB65DB, 216, 84 },
+    { 0xC45D1DF942711D9A, 242, 92 },
+    { 0x924D692CA61BE758, 269, 100 },
+    { 0xDA01EE641A708DEA, 295, 108 },
+    { 0xA26DA3999AEF774A, 322, 116 },
+    { 0xF209787BB47D6B85, 348, 124 },
+    { 0xB454E4A179DD1877, 375, 132 },
+    { 0x865B86925B9BC5C2, 402, 140 },
+    { 0xC83553C5C8965D3D, 428, 148 },
+    { 0x952AB45CFA97A0B3, 455, 156 },
+    { 0xDE469FBD99A05FE3, 481, 164 },
+    { 0xA59BC234DB398C25, 508, 172 },
+    { 0xF6C69A72A3989F5C, 534, 180 },
+    { 0xB7DCBF5354E9BECE, 561, 188 },
+    { 0x88FCF317F22241E2, 588, 196 },
+    { 0xCC20CE9BD35C78A5, 614, 204 },
+    { 0x98165AF37B2153DF, 641, 212 },
+    { 0xE2A0B5DC971F303A, 667, 220 },
+    { 0xA8D9D1535CE3B396, 694, 228 },
+    { 0xFB9B7CD9A4A7443C, 720, 236 },
+    { 0xBB764C4CA7A44410, 747, 244 },
+    { 0x8BAB8EEFB6409C1A, 774, 252 },
+    { 0xD01FEF10A657842C, 800, 260 },
+    { 0x9B10A4E5E9913129, 827, 268 },
+    { 0xE7109BFBA19C0C9D, 853, 276 },
+    { 0xAC2820D9623BF429, 880, 284 },
+    { 0x80444B5E7AA7CF85, 907, 292 },
+    { 0xBF21E44003ACDD2D, 933, 300 },
+    { 0x8E679C2F5E44FF8F, 960, 308 },
+    { 0xD433179D9C8CB841, 986, 316 },
+    { 0x9E19DB92B4E31BA9, 1013, 324 },
+};
+
+// The digits are generated from a scaled value whose exponent is in this
+// range, so that the integral part fits in 32 bits.
+static constexpr int kGrisuAlpha = -60;
+static constexpr int kGrisuGamma = -32;
+
+inline CachedPower cached_power(const int e) {
+  // ceil((alpha - e - 1) * log10(2))
+  int f = kGrisuAlpha - e - 1;
+  int k = (f * 78913) / (1 << 18) + (f > 0);
+  int index = (-kCachedPowersMinK + k + (kCachedPowersStep - 1)) /
+              kCachedPowersStep;
+  return kCachedPowers[index];
+}
+
+inline int largest_pow10(const uint32_t n, uint32_t &pow10) {
+  static constexpr uint32_t kPowers[] = { 1,      10,      100,      1000,
+                                          10000,  100000,  1000000,  10000000,
+                                          100000000, 1000000000 };
+  int k = 10;
+  while (k > 1 && n < kPowers[k - 1]) {
+    k--;
+  }
+  pow10 = kPowers[k - 1];
+  return k;
+}
+
+/**
+ * Moves the last digit towards the exact value while it stays inside the
+ * rounding interval.
+ */
+inline void grisu_round(char digits[], const size_t len, const uint64_t dist,
+                        const uint64_t delta, uint64_t rest,
+                        const uint64_t ten_k) {
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    digits[len - 1]--;
+    rest += ten_k;
+  }
+}
+
+/**
+ * Generates the digits of the shortest number within (`low`, `high`),
+ * closest to `w`, as `digits * 10^exp`.
+ */
+inline size_t grisu_digits(char digits[], int &exp, const DiyFp &low,
+                           const DiyFp &w, const DiyFp &high) {
+  uint64_t delta = high.sub(low).f;
+  uint64_t dist = high.sub(w).f;
+
+  int shift = -high.e;
+  uint64_t one = static_cast<uint64_t>(1) << shift;
+  uint32_t integral = static_cast<uint32_t>(high.f >> shift);
+  uint64_t fraction = high.f & (one - 1);
+
+  size_t len = 0;
+  uint32_t pow10;
+  int n = largest_pow10(integral, pow10);
+
+  while (n > 0) {
+    digits[len++] = static_cast<char>('0' + integral / pow10);
+    integral %= pow10;
+    n--;
+
+    uint64_t rest = (static_cast<uint64_t>(integral) << shift) + fraction;
+    if (rest <= delta) {
+      exp += n;
+      grisu_round(digits, len, dist, delta, rest,
+                  static_cast<uint64_t>(pow10) << shift);
+      return len;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  while (true) {
+    fraction *= 10;
+    digits[len++] = static_cast<char>('0' + (fraction >> shift));
+    fraction &= one - 1;
+    m++;
+    delta *= 10;
+    dist *= 10;
+    if (fraction <= delta) {
+      break;
+    }
+  }
+
+  exp -= m;
+  grisu_round(digits, len, dist, delta, fraction, one);
+  return len;
+}
+
+/**
+ * The decimal digits of a positive, finite double, as `digits * 10^exp`.
+ * This is Grisu2: the digits always read back as the same double, and are
+ * the shortest such digits for all but a tiny fraction of values.
+ */
+inline size_t shortest_digits(const double value, char digits[], int &exp) {
+  static constexpr uint64_t kHiddenBit = static_cast<uint64_t>(1) << 52;
+  static constexpr int kBias = 1023 + 52;
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint64_t fraction = bits & (kHiddenBit - 1);
+  int biased = static_cast<int>(bits >> 52);
+
+  DiyFp v = biased == 0 ? DiyFp{ fraction, 1 - kBias }
+                        : DiyFp{ fraction + kHiddenBit, biased - kBias };
+
+  // The boundaries halfway to the neighbouring doubles. The lower one is
+  // closer at powers of two.
+  DiyFp high = DiyFp{ 2 * v.f + 1, v.e - 1 }.normalize();
+  DiyFp low = fraction == 0 && biased > 1 ? DiyFp{ 4 * v.f - 1, v.e - 2 }
+                                          : DiyFp{ 2 * v.f - 1, v.e - 1 };
+  low = { low.f << (low.e - high.e), high.e };
+  v = v.normalize();
+
+  CachedPower cached = cached_power(high.e);
+  DiyFp c = { cached.f, cached.e };
+  DiyFp w = v.mul(c);
+  DiyFp w_low = low.mul(c);
+  DiyFp w_high = high.mul(c);
+
+  exp = -cached.k;
+  return grisu_digits(digits, exp, { w_low.f + 1, w_low.e }, w,
+                      { w_high.f - 1, w_high.e });
+}
+
+/**
+ * Formats a finite double so that it reads back as the same double, with the
+ * shortest digits for all but a tiny fraction of values, e.g. `21.5`,
+ * `1e+300` or `-0.0`. Whole numbers keep a `.0` so that they read back as
+ * doubles. Returns the number of characters written, which is always less
+ * than `kDoubleBufSize`; no null-terminator is written.
+ */
+inline size_t format_double(double value, char buf[]) {
+  static constexpr int kMinExp = -4;
+  static constexpr int kMaxExp = 15;
+
+  size_t pos = 0;
+  if (std::signbit(value)) {
+    buf[pos++] = '-';
+    value = -value;
+  }
+
+  if (value == 0) {
+    memcpy(&buf[pos], "0.0", 3);
+    return pos + 3;
+  }
+
+  char digits[20];
+  int exp;
+  int len = static_cast<int>(shortest_digits(value, digits, exp));
+  // The position of the decimal point relative to the digits.
+  int point = len + exp;
+
+  if (len <= point && point <= kMaxExp) {
+    memcpy(&buf[pos], digits, len);
+    memset(&buf[pos + len], '0', point - len);
+    pos += point;
+    memcpy(&buf[pos], ".0", 2);
+    return pos + 2;
+  }
+
+  if (0 < point && point <= kMaxExp) {
+    memcpy(&buf[pos], digits, point);
+    buf[pos + point] = '.';
+    memcpy(&buf[pos + point + 1], &digits[point], len - point);
+    return pos + len + 1;
+  }
+
+  if (kMinExp < point && point <= 0) {
+    memcpy(&buf[pos], "0.", 2);
+    memset(&buf[pos + 2], '0', -point);
+    pos += 2 - point;
+    memcpy(&buf[pos], digits, len);
+    return pos + len;
+  }
+
+  buf[pos++] = digits[0];
+  if (len > 1) {
+    buf[pos++] = '.';
+    memcpy(&buf[pos], &digits[1], len - 1);
+    pos += len - 1;
+  }
+
+  int e = point - 1;
+  buf[pos++] = 'e';
+  buf[pos++] = e < 0 ? '-' : '+';
+  e = e < 0 ? -e : e;
+  if (e >= 100) {
+    buf[pos++] = static_cast<char>('0' + e / 100);
+  }
+  if (e >= 10) {
+    buf[pos++] = static_cast<char>('0' + e / 10 % 10);
+  }
+  buf[pos++] = static_cast<char>('0' + e % 10);
+
+  return pos;
+}
+
+} // namespace json
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,635 @@
+#ifndef POT_BSON_JSON_PARSER_H_
+#define POT_BSON_JSON_PARSER_H_
+
+#include "../serializer/array.hpp"
+#include "../serializer/document.hpp"
+#include "../serializer/result.hpp"
+#include "./chars.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace json {
+
+/**
+ * How deeply objects and arrays may be nested.
+ */
+static constexpr size_t kJsonMaxDepth = 64;
+
+/**
+ * Numbers that need `strtod` are copied into a buffer of this size to be
+ * null-terminated, and rejected if they don't fit.
+ */
+static constexpr size_t kNumberBufSize = 64;
+
+enum struct ParseStatus : uint8_t {
+  Ok,
+  BufferOverflow,
+  // Not well-formed JSON, or not an object at the top level.
+  Syntax,
+  TooDeep,
+  // A key or an escaped string didn't fit the parser's buffers, or a key
+  // contained a null character.
+  TooLong,
+};
+
+struct ParseResult {
+  ParseStatus status;
+  // The size of the BSON document. Like `serializer::Result::len`, it's the
+  // required size when the buffer overflowed.
+  size_t len;
+  // Where parsing stopped in the JSON.
+  size_t offset;
+};
+
+/**
+ * Parses JSON straight into the serializer, without building a tree first.
+ *
+ * Strings are scanned eight bytes at a time for the quotes, backslashes and
+ * control characters that end or interrupt them, and strings without escapes
+ * are copied straight from the input. Keys are copied into a buffer of
+ * `name_buf_size` to null-terminate them, and strings with escapes are
+ * decoded into a buffer of `str_buf_size`.
+ *
+ * Numbers without a fraction or exponent become Int32 when they fit, Int64
+ * when they don't, and Double beyond that. Numbers with a fraction or an
+ * exponent are always Double, so `1.0` stays a double. Doubles with up to 15
+ * digits and a small exponent are computed exactly in place, longer ones go
+ * through `strtod`.
+ */
+template <size_t name_buf_size = 64, size_t str_buf_size = 1024>
+class Parser {
+public:
+  /**
+   * Parses a JSON object into a new document in `buf`.
+   */
+  ParseResult parse(const char json[], const size_t json_len, uint8_t buf[],
+                    const size_t len) {
+    serializer::Document doc(buf, len);
+    ParseResult res = this->parse(json, json_len, doc);
+    serializer::Result end = doc.end();
+
+    res.len = end.len;
+    if (res.status == ParseStatus::Ok &&
+        end.status == serializer::Status::BufferOverflow) {
+      res.status = ParseStatus::BufferOverflow;
+    }
+    return res;
+  }
+
+  /**
+   * Appends the members of a JSON object to `doc`. The result's length is
+   * left at 0; the document's own result has the size.
+   */
+  ParseResult parse(const char json[], const size_t json_len,
+                    serializer::Document &doc) {
+    this->cur_ = json;
+    this->end_ = json + json_len;
+    this->status_ = ParseStatus::Ok;
+
+    this->skipSpace();
+    if (this->expect('{') && this->members(doc, 1)) {
+      this->skipSpace();
+      if (this->cur_ != this->end_) {
+        this->fail(ParseStatus::Syntax);
+      }
+    }
+
+    return { this->status_, 0, static_cast<size_t>(this->cur_ - json) };
+  }
+
+private:
+  const char *cur_;
+  const char *end_;
+  ParseStatus status_;
+  char name_[name_buf_size];
+  char str_[str_buf_size];
+
+  bool fail(const ParseStatus status) {
+    if (this->status_ == ParseStatus::Ok) {
+      this->status_ = status;
+    }
+    return false;
+  }
+
+  void skipSpace() {
+    while (this->cur_ < this->end_ &&
+           (*this->cur_ == ' ' || *this->cur_ == '\n' || *this->cur_ == '\r' ||
+            *this->cur_ == '\t')) {
+      this->cur_++;
+    }
+  }
+
+  bool expect(const char chr) {
+    if (this->cur_ == this->end_ || *this->cur_ != chr) {
+      return this->fail(ParseStatus::Syntax);
+    }
+    this->cur_++;
+    return true;
+  }
+
+  bool literal(const char word[], const size_t len) {
+    if (static_cast<size_t>(this->end_ - this->cur_) < len ||
+        memcmp(this->cur_, word, len) != 0) {
+      return this->fail(ParseStatus::Syntax);
+    }
+    this->cur_ += len;
+    return true;
+  }
+
+  /**
+   * Parses the rest of an object, after its opening brace.
+   */
+  bool members(serializer::Document &doc, const size_t depth) {
+    this->skipSpace();
+    if (this->cur_ < this->end_ && *this->cur_ == '}') {
+      this->cur_++;
+      return true;
+    }
+
+    while (true) {
+      this->skipSpace();
+      if (!this->key()) {
+        return false;
+      }
+
+      this->skipSpace();
+      if (!this->expect(':')) {
+        return false;
+      }
+
+      this->skipSpace();
+      if (!this->value(doc, depth)) {
+        return false;
+      }
+
+      this->skipSpace();
+      if (this->cur_ < this->end_ && *this->cur_ == ',') {
+        this->cur_++;
+        continue;
+      }
+      return this->expect('}');
+    }
+  }
+
+  /**
+   * Parses the rest of an array, after its opening bracket.
+   */
+  bool items(serializer::Array &arr, const size_t depth) {
+    this->skipSpace();
+    if (this->cur_ < this->end_ && *this->cur_ == ']') {
+      this->cur_++;
+      return true;
+    }
+
+    while (true) {
+      this->skipSpace();
+      if (!this->value(arr, depth)) {
+        return false;
+      }
+
+      this->skipSpace();
+      if (this->cur_ < this->end_ && *this->cur_ == ',') {
+        this->cur_++;
+        continue;
+      }
+      return this->expect(']');
+    }
+  }
+
+  template <typename Target>
+  bool value(Target &target, const size_t depth) {
+    if (this->cur_ == this->end_) {
+      return this->fail(ParseStatus::Syntax);
+    }
+
+    switch (*this->cur_) {
+      case '{':
+        if (depth >= kJsonMaxDepth) {
+          return this->fail(ParseStatus::TooDeep);
+        }
+        this->cur_++;
+        return this->document(target, depth + 1);
+      case '[':
+        if (depth >= kJsonMaxDepth) {
+          return this->fail(ParseStatus::TooDeep);
+        }
+        this->cur_++;
+        return this->array(target, depth + 1);
+      case '"': {
+        const char *str;
+        size_t len;
+        if (!this->string(str, len)) {
+          return false;
+        }
+        this->appendStr(target, str, len);
+        return true;
+      }
+      case 't':
+        if (!this->literal("true", 4)) {
+          return false;
+        }
+        this->appendBool(target, true);
+        return true;
+      case 'f':
+        if (!this->literal("false", 5)) {
+          return false;
+        }
+        this->appendBool(target, false);
+        return true;
+      case 'n':
+        if (!this->literal("null", 4)) {
+          return false;
+        }
+        this->appendNull(target);
+        return true;
+      default:
+        return this->number(target);
+    }
+  }
+
+  /**
+   * Parses a key into `name_`.
+   */
+  bool key() {
+    const char *str;
+    size_t len;
+    if (!this->string(str, len)) {
+      return false;
+    }
+
+    if (len >= name_buf_size || memchr(str, '\0', len) != nullptr) {
+      return this->fail(ParseStatus::TooLong);
+    }
+    memcpy(this->name_, str, len);
+    this->name_[len] = '\0';
+    return true;
+  }
+
+  /**
+   * Parses a string, pointing `str` either into the JSON or, if it had
+   * escapes, at its decoded form in `str_`.
+   */
+  bool string(const char *&str, size_t &len) {
+    if (!this->expect('"')) {
+      return false;
+    }
+
+    const char *start = this->cur_;
+    bool escaped = false;
+    while (true) {
+      if (this->end_ - this->cur_ >= 8) {
+        uint64_t word;
+        memcpy(&word, this->cur_, sizeof(word));
+        if (escape_mask(word) == 0) {
+          this->cur_ += 8;
+          continue;
+        }
+      }
+
+      if (this->cur_ == this->end_) {
+        return this->fail(ParseStatus::Syntax);
+      }
+
+      uint8_t chr = *this->cur_;
+      if (chr == '"') {
+        break;
+      } else if (chr == '\\') {
+        escaped = true;
+        this->cur_ += 2;
+        if (this->cur_ > this->end_) {
+          this->cur_ = this->end_;
+          return this->fail(ParseStatus::Syntax);
+        }
+      } else if (chr < 0x20) {
+        return this->fail(ParseStatus::Syntax);
+      } else {
+        this->cur_++;
+      }
+    }
+
+    const char *stop = this->cur_++;
+    if (!escaped) {
+      str = start;
+      len = stop - start;
+      return true;
+    }
+
+    str = this->str_;
+    return this->unescape(start, stop, len);
+  }
+
+  bool unescape(const char *from, const char *to, size_t &len) {
+    len = 0;
+    while (from < to) {
+      // Leave room for the longest sequence, a 4 byte UTF-8 character.
+      if (len + 4 > str_buf_size) {
+        return this->fail(ParseStatus::TooLong);
+      }
+
+      if (*from != '\\') {
+        this->str_[len++] = *from++;
+        continue;
+      }
+
+      from++;
+      switch (*from++) {
+        case '"':
+          this->str_[len++] = '"';
+          break;
+        case '\\':
+          this->str_[len++] = '\\';
+          break;
+        case '/':
+          this->str_[len++] = '/';
+          break;
+        case 'b':
+          this->str_[len++] = '\b';
+          break;
+        case 'f':
+          this->str_[len++] = '\f';
+          break;
+        case 'n':
+          this->str_[len++] = '\n';
+          break;
+        case 'r':
+          this->str_[len++] = '\r';
+          break;
+        case 't':
+          this->str_[len++] = '\t';
+          break;
+        case 'u': {
+          uint32_t code;
+          if (!this->hex4(from, to, code)) {
+            return false;
+          }
+
+          if (code >= 0xD800 && code < 0xDC00) {
+            uint32_t low;
+            if (to - from < 2 || from[0] != '\\' || from[1] != 'u') {
+              return this->fail(ParseStatus::Syntax);
+            }
+            from += 2;
+            if (!this->hex4(from, to, low) || low < 0xDC00 || low >= 0xE000) {
+              return this->fail(ParseStatus::Syntax);
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          } else if (code >= 0xDC00 && code < 0xE000) {
+            return this->fail(ParseStatus::Syntax);
+          }
+
+          len += this->utf8(code, &this->str_[len]);
+          break;
+        }
+        default:
+          return this->fail(ParseStatus::Syntax);
+      }
+    }
+
+    return true;
+  }
+
+  bool hex4(const char *&from, const char *to, uint32_t &code) {
+    if (to - from < 4) {
+      return this->fail(ParseStatus::Syntax);
+    }
+
+    code = 0;
+    for (size_t i = 0; i < 4; i++) {
+      char chr = *from++;
+      code <<= 4;
+      if (chr >= '0' && chr <= '9') {
+        code |= chr - '0';
+      } else if (chr >= 'a' && chr <= 'f') {
+        code |= chr - 'a' + 10;
+      } else if (chr >= 'A' && chr <= 'F') {
+        code |= chr - 'A' + 10;
+      } else {
+        return this->fail(ParseStatus::Syntax);
+      }
+    }
+    return true;
+  }
+
+  size_t utf8(const uint32_t code, char out[]) const {
+    if (code < 0x80) {
+      out[0] = static_cast<char>(code);
+      return 1;
+    } else if (code < 0x800) {
+      out[0] = static_cast<char>(0xC0 | (code >> 6));
+      out[1] = static_cast<char>(0x80 | (code & 0x3F));
+      return 2;
+    } else if (code < 0x10000) {
+      out[0] = static_cast<char>(0xE0 | (code >> 12));
+      out[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      out[2] = static_cast<char>(0x80 | (code & 0x3F));
+      return 3;
+    }
+
+    out[0] = static_cast<char>(0xF0 | (code >> 18));
+    out[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (code & 0x3F));
+    return 4;
+  }
+
+  template <typename Target> bool number(Target &target) {
+    static constexpr double kExactPowers[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    // Below 2^53 every integer is an exact double.
+    static constexpr uint64_t kMaxExactMantissa = static_cast<uint64_t>(1)
+                                                  << 53;
+
+    const char *start = this->cur_;
+    bool negative = this->cur_ < this->end_ && *this->cur_ == '-';
+    if (negative) {
+      this->cur_++;
+    }
+
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    bool overflow = false;
+    if (this->cur_ < this->end_ && *this->cur_ == '0') {
+      this->cur_++;
+      digits++;
+    } else {
+      while (this->cur_ < this->end_ && *this->cur_ >= '0' &&
+             *this->cur_ <= '9') {
+        uint64_t digit = *this->cur_++ - '0';
+        overflow = overflow || mantissa > (UINT64_MAX - digit) / 10;
+        mantissa = mantissa * 10 + digit;
+        digits++;
+      }
+    }
+    if (digits == 0) {
+      return this->fail(ParseStatus::Syntax);
+    }
+
+    int exp = 0;
+    bool integral = true;
+    if (this->cur_ < this->end_ && *this->cur_ == '.') {
+      integral = false;
+      this->cur_++;
+      const char *fraction = this->cur_;
+      while (this->cur_ < this->end_ && *this->cur_ >= '0' &&
+             *this->cur_ <= '9') {
+        uint64_t digit = *this->cur_++ - '0';
+        overflow = overflow || mantissa > (UINT64_MAX - digit) / 10;
+        mantissa = mantissa * 10 + digit;
+        exp--;
+      }
+      if (this->cur_ == fraction) {
+        return this->fail(ParseStatus::Syntax);
+      }
+    }
+
+    if (this->cur_ < this->end_ && (*this->cur_ == 'e' || *this->cur_ == 'E')) {
+      integral = false;
+      this->cur_++;
+      bool exp_negative = false;
+      if (this->cur_ < this->end_ &&
+          (*this->cur_ == '+' || *this->cur_ == '-')) {
+        exp_negative = *this->cur_++ == '-';
+      }
+
+      const char *exp_start = this->cur_;
+      int exp_value = 0;
+      while (this->cur_ < this->end_ && *this->cur_ >= '0' &&
+             *this->cur_ <= '9') {
+        if (exp_value < 10000) {
+          exp_value = exp_value * 10 + (*this->cur_ - '0');
+        }
+        this->cur_++;
+      }
+      if (this->cur_ == exp_start) {
+        return this->fail(ParseStatus::Syntax);
+      }
+      exp += exp_negative ? -exp_value : exp_value;
+    }
+
+    if (integral && !overflow) {
+      if (!negative && mantissa <= INT32_MAX) {
+        this->appendInt32(target, static_cast<int32_t>(mantissa));
+        return true;
+      } else if (negative && mantissa <= static_cast<uint64_t>(INT32_MAX) + 1) {
+        this->appendInt32(target, static_cast<int32_t>(0 - mantissa));
+        return true;
+      } else if (!negative && mantissa <= INT64_MAX) {
+        this->appendInt64(target, static_cast<int64_t>(mantissa));
+        return true;
+      } else if (negative && mantissa <= static_cast<uint64_t>(INT64_MAX) + 1) {
+        this->appendInt64(target, static_cast<int64_t>(0 - mantissa));
+        return true;
+      }
+    }
+
+    double value;
+    if (!overflow && mantissa <= kMaxExactMantissa && exp >= -22 && exp <= 22) {
+      value = static_cast<double>(mantissa);
+      value = exp < 0 ? value / kExactPowers[-exp] : value * kExactPowers[exp];
+      value = negative ? -value : value;
+    } else {
+      char buf[kNumberBufSize];
+      size_t len = this->cur_ - start;
+      if (len >= kNumberBufSize) {
+        return this->fail(ParseStatus::TooLong);
+      }
+      memcpy(buf, start, len);
+      buf[len] = '\0';
+      value = strtod(buf, nullptr);
+    }
+
+    this->appendDouble(target, value);
+    return true;
+  }
+
+  // The same appends, for members of a document and items of an array.
+
+  bool document(serializer::Document &doc, const size_t depth) {
+    serializer::Document child(this->name_, &doc);
+    return this->members(child, depth);
+  }
+
+  bool document(serializer::Array &arr, const size_t depth) {
+    serializer::Document child(arr);
+    return this->members(child, depth);
+  }
+
+  bool array(serializer::Document &doc, const size_t depth) {
+    serializer::Array child(this->name_, &doc);
+    return this->items(child, depth);
+  }
+
+  bool array(serializer::Array &arr, const size_t depth) {
+    serializer::Array child(arr);
+    return this->items(child, depth);
+  }
+
+  void appendStr(serializer::Document &doc, const char str[],
+                 const size_t len) {
+    doc.appendStr(this->name_, str, len);
+  }
+
+  void appendStr(serializer::Array &arr, const char str[], const size_t len) {
+    arr.appendStr(str, len);
+  }
+
+  void appendBool(serializer::Document &doc, const bool value) {
+    doc.appendBool(this->name_, value);
+  }
+
+  void appendBool(serializer::Array &arr, const bool value) {
+    arr.appendBool(value);
+  }
+
+  void appendNull(serializer::Document &doc) {
+    doc.appendNull(this->name_);
+  }
+
+  void appendNull(serializer::Array &arr) {
+    arr.appendNull();
+  }
+
+  void appendInt32(serializer::Document &doc, const int32_t value) {
+    doc.appendInt32(this->name_, value);
+  }
+
+  void appendInt32(serializer::Array &arr, const int32_t value) {
+    arr.appendInt32(value);
+  }
+
+  void appendInt64(serializer::Document &doc, const int64_t value) {
+    doc.appendInt64(this->name_, value);
+  }
+
+  void appendInt64(serializer::Array &arr, const int64_t value) {
+    arr.appendInt64(value);
+  }
+
+  void appendDouble(serializer::Document &doc, const double value) {
+    doc.appendDouble(this->name_, value);
+  }
+
+  void appendDouble(serializer::Array &arr, const double value) {
+    arr.appendDouble(value);
+  }
+};
+
+/**
+ * Parses a JSON object into a BSON document in `buf`.
+ */
+inline ParseResult parse(const char json[], const size_t json_len,
+                         uint8_t buf[], const size_t len) {
+  Parser<> parser;
+  return parser.parse(json, json_len, buf, len);
+}
+
+} // namespace json
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,442 @@
+#ifndef POT_BSON_JSON_WRITER_H_
+#define POT_BSON_JSON_WRITER_H_
+
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include "../serializer/result.hpp"
+#include "./chars.hpp"
+#include "./dtoa.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace json {
+
+/**
+ * The Extended JSON flavour to write. Relaxed writes numbers as plain JSON
+ * numbers, canonical wraps them so that their BSON type survives.
+ */
+enum struct Mode : uint8_t {
+  Relaxed,
+  Canonical,
+};
+
+/**
+ * The size of the staging buffer used when writing to a sink.
+ */
+static constexpr size_t kJsonChunkSize = 512;
+
+static constexpr size_t kIntBufSize = 20;
+
+static constexpr char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+static constexpr char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Formats an integer in decimal, two digits at a time. Returns the number of
+ * characters written; no null-terminator is written.
+ */
+inline size_t format_int(const int64_t value, char buf[]) {
+  char tmp[kIntBufSize];
+  size_t pos = kIntBufSize;
+  uint64_t n = value < 0 ? 0 - static_cast<uint64_t>(value)
+                         : static_cast<uint64_t>(value);
+
+  while (n >= 100) {
+    size_t pair = (n % 100) * 2;
+    n /= 100;
+    tmp[--pos] = kDigitPairs[pair + 1];
+    tmp[--pos] = kDigitPairs[pair];
+  }
+  if (n >= 10) {
+    tmp[--pos] = kDigitPairs[n * 2 + 1];
+    tmp[--pos] = kDigitPairs[n * 2];
+  } else {
+    tmp[--pos] = static_cast<char>('0' + n);
+  }
+
+  size_t len = 0;
+  if (value < 0) {
+    buf[len++] = '-';
+  }
+  memcpy(&buf[len], &tmp[pos], kIntBufSize - pos);
+  return len + kIntBufSize - pos;
+}
+
+/**
+ * Writes into a caller-owned buffer. Like `BufferWriter`, it keeps counting
+ * once the buffer is full so that the required length can be reported.
+ */
+class BufferOutput {
+public:
+  BufferOutput(char buf[], const size_t len) :
+      buffer_(buf), buffer_length_(len) {}
+
+  size_t position() const {
+    return this->current_;
+  }
+
+  bool overflowed() const {
+    return this->current_ > this->buffer_length_;
+  }
+
+  void put(const char chr) {
+    if (this->current_ < this->buffer_length_) {
+      this->buffer_[this->current_] = chr;
+    }
+    this->current_++;
+  }
+
+  void write(const char str[], const size_t len) {
+    if (this->current_ + len <= this->buffer_length_) {
+      memcpy(&this->buffer_[this->current_], str, len);
+    } else if (this->current_ < this->buffer_length_) {
+      memcpy(&this->buffer_[this->current_], str,
+             this->buffer_length_ - this->current_);
+    }
+    this->current_ += len;
+  }
+
+  void flush() {}
+
+private:
+  char *buffer_;
+  size_t buffer_length_;
+  size_t current_ = 0;
+};
+
+/**
+ * Stages output in a fixed chunk and hands it to `sink(const char *, size_t)`
+ * whenever the chunk fills up.
+ */
+template <typename Sink> class SinkOutput {
+public:
+  explicit SinkOutput(Sink &sink) : sink_(sink) {}
+
+  size_t position() const {
+    return this->flushed_ + this->used_;
+  }
+
+  bool overflowed() const {
+    return false;
+  }
+
+  void put(const char chr) {
+    if (this->used_ == kJsonChunkSize) {
+      this->flush();
+    }
+    this->chunk_[this->used_++] = chr;
+  }
+
+  void write(const char str[], const size_t len) {
+    if (this->used_ + len > kJsonChunkSize) {
+      this->flush();
+      if (len > kJsonChunkSize) {
+        this->sink_(str, len);
+        this->flushed_ += len;
+        return;
+      }
+    }
+
+    memcpy(&this->chunk_[this->used_], str, len);
+    this->used_ += len;
+  }
+
+  void flush() {
+    if (this->used_ > 0) {
+      this->sink_(this->chunk_, this->used_);
+      this->flushed_ += this->used_;
+      this->used_ = 0;
+    }
+  }
+
+private:
+  Sink &sink_;
+  char chunk_[kJsonChunkSize];
+  size_t used_ = 0;
+  size_t flushed_ = 0;
+};
+
+/**
+ * Writes BSON as Extended JSON in a single pass over the raw elements, with
+ * no allocation. Strings are scanned eight bytes at a time and copied in
+ * runs between the characters that need escaping, doubles are written so
+ * that they round-trip (see `format_double`) and binaries are base64
+ * encoded. Documents should already have been validated.
+ */
+template <typename Output> class Writer {
+public:
+  Writer(Output &out, const Mode mode) : out_(out), mode_(mode) {}
+
+  void document(const uint8_t doc[]) {
+    this->container(doc, false);
+  }
+
+  void array(const uint8_t arr[]) {
+    this->container(arr, true);
+  }
+
+  void string(const char str[], const size_t len) {
+    this->out_.put('"');
+
+    size_t start = 0;
+    size_t i = 0;
+    while (i < len) {
+      if (i + 8 <= len) {
+        uint64_t word;
+        memcpy(&word, &str[i], sizeof(word));
+        if (escape_mask(word) == 0) {
+          i += 8;
+          continue;
+        }
+      }
+
+      uint8_t chr = str[i];
+      if (chr >= 0x20 && chr != '"' && chr != '\\') {
+        i++;
+        continue;
+      }
+
+      this->out_.write(&str[start], i - start);
+      this->escape(chr);
+      start = ++i;
+    }
+
+    this->out_.write(&str[start], len - start);
+    this->out_.put('"');
+  }
+
+  void binary(const uint8_t bin[], const size_t len, const uint8_t subtype) {
+    this->out_.write("{\"$binary\":{\"base64\":\"", 22);
+    this->base64(bin, len);
+    this->out_.write("\",\"subType\":\"", 13);
+    this->out_.put(kHexDigits[subtype >> 4]);
+    this->out_.put(kHexDigits[subtype & 0xF]);
+    this->out_.write("\"}}", 3);
+  }
+
+  void number(const double value) {
+    char buf[kDoubleBufSize];
+    size_t len;
+    if (std::isnan(value)) {
+      len = 3;
+      memcpy(buf, "NaN", len);
+    } else if (std::isinf(value)) {
+      len = value < 0 ? 9 : 8;
+      memcpy(buf, value < 0 ? "-Infinity" : "Infinity", len);
+    } else {
+      len = format_double(value, buf);
+      if (this->mode_ == Mode::Relaxed) {
+        this->out_.write(buf, len);
+        return;
+      }
+    }
+
+    this->out_.write("{\"$numberDouble\":\"", 18);
+    this->out_.write(buf, len);
+    this->out_.write("\"}", 2);
+  }
+
+  void number(const int64_t value, const bool int64) {
+    char buf[kIntBufSize + 1];
+    size_t len = format_int(value, buf);
+    if (this->mode_ == Mode::Relaxed) {
+      this->out_.write(buf, len);
+      return;
+    }
+
+    if (int64) {
+      this->out_.write("{\"$numberLong\":\"", 16);
+    } else {
+      this->out_.write("{\"$numberInt\":\"", 15);
+    }
+    this->out_.write(buf, len);
+    this->out_.write("\"}", 2);
+  }
+
+private:
+  Output &out_;
+  Mode mode_;
+
+  void container(const uint8_t doc[], const bool array) {
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);
+    const uint8_t *end = doc + len - static_cast<uint8_t>(TypeSize::Byte);
+    const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);
+
+    this->out_.put(array ? '[' : '{');
+    bool first = true;
+    while (cur < end) {
+      deserializer::DocumentElement el(cur, 0, end - cur);
+      if (!first) {
+        this->out_.put(',');
+      }
+      first = false;
+
+      if (!array) {
+        this->string(el.getNameRef(), el.nameSize() - 1);
+        this->out_.put(':');
+      }
+      this->value(el);
+
+      cur += el.size();
+    }
+    this->out_.put(array ? ']' : '}');
+  }
+
+  void value(const deserializer::DocumentElement &el) {
+    switch (el.type()) {
+      case Element::Double:
+        this->number(el.getDouble());
+        break;
+      case Element::String:
+        this->string(el.getStrRef(), el.getStrLen());
+        break;
+      case Element::Document:
+        this->document(el.getDataRef());
+        break;
+      case Element::Array:
+        this->array(el.getDataRef());
+        break;
+      case Element::Binary:
+        this->binary(el.getBinRef(), el.getBinLen(), el.getBinRef()[-1]);
+        break;
+      case Element::Boolean:
+        if (el.getBool()) {
+          this->out_.write("true", 4);
+        } else {
+          this->out_.write("false", 5);
+        }
+        break;
+      case Element::Int32:
+        this->number(el.getInt32(), false);
+        break;
+      case Element::Int64:
+        this->number(el.getInt64(), true);
+        break;
+      default:
+        this->out_.write("null", 4);
+        break;
+    }
+  }
+
+  void escape(const uint8_t chr) {
+    char buf[6] = { '\\', 'u', '0', '0' };
+    switch (chr) {
+      case '"':
+      case '\\':
+        buf[1] = chr;
+        break;
+      case '\b':
+        buf[1] = 'b';
+        break;
+      case '\f':
+        buf[1] = 'f';
+        break;
+      case '\n':
+        buf[1] = 'n';
+        break;
+      case '\r':
+        buf[1] = 'r';
+        break;
+      case '\t':
+        buf[1] = 't';
+        break;
+      default:
+        buf[4] = kHexDigits[chr >> 4];
+        buf[5] = kHexDigits[chr & 0xF];
+        this->out_.write(buf, 6);
+        return;
+    }
+    this->out_.write(buf, 2);
+  }
+
+  /**
+   * Encodes six bytes to eight characters per step, staging the output so
+   * that it reaches the sink in large writes.
+   */
+  void base64(const uint8_t bin[], const size_t len) {
+    char block[kJsonChunkSize / 4];
+    size_t used = 0;
+    size_t i = 0;
+
+    for (; i + 6 <= len; i += 6) {
+      uint64_t bits = static_cast<uint64_t>(bin[i]) << 40 |
+                      static_cast<uint64_t>(bin[i + 1]) << 32 |
+                      static_cast<uint64_t>(bin[i + 2]) << 24 |
+                      static_cast<uint64_t>(bin[i + 3]) << 16 |
+                      static_cast<uint64_t>(bin[i + 4]) << 8 |
+                      static_cast<uint64_t>(bin[i + 5]);
+      for (size_t c = 0; c < 8; c++) {
+        block[used + c] = kBase64Chars[(bits >> (42 - 6 * c)) & 0x3F];
+      }
+
+      used += 8;
+      if (used == sizeof(block)) {
+        this->out_.write(block, used);
+        used = 0;
+      }
+    }
+
+    for (; i < len; i += 3) {
+      uint32_t bits = static_cast<uint32_t>(bin[i]) << 16;
+      if (i + 1 < len) {
+        bits |= static_cast<uint32_t>(bin[i + 1]) << 8;
+      }
+      if (i + 2 < len) {
+        bits |= bin[i + 2];
+      }
+
+      block[used++] = kBase64Chars[bits >> 18];
+      block[used++] = kBase64Chars[(bits >> 12) & 0x3F];
+      block[used++] = i + 1 < len ? kBase64Chars[(bits >> 6) & 0x3F] : '=';
+      block[used++] = i + 2 < len ? kBase64Chars[bits & 0x3F] : '=';
+    }
+
+    this->out_.write(block, used);
+  }
+};
+
+/**
+ * Writes `doc` as JSON into `buf`. No null-terminator is written. If the
+ * buffer overflows, the result's length is still the full length of the
+ * JSON.
+ */
+inline serializer::Result to_json(const deserializer::Document &doc,
+                                  char buf[], const size_t len,
+                                  const Mode mode = Mode::Relaxed) {
+  BufferOutput out(buf, len);
+  Writer<BufferOutput>(out, mode).document(doc.getRef());
+
+  return { out.overflowed() ? serializer::Status::BufferOverflow
+                            : serializer::Status::Ok,
+           out.position() };
+}
+
+/**
+ * Writes `doc` as JSON to `sink(const char *, size_t)`, in chunks of up to
+ * `kJsonChunkSize` characters. Returns the length of the JSON.
+ */
+template <typename Sink>
+size_t to_json(const deserializer::Document &doc, Sink sink,
+               const Mode mode = Mode::Relaxed) {
+  SinkOutput<Sink> out(sink);
+  Writer<SinkOutput<Sink>>(out, mode).document(doc.getRef());
+  out.flush();
+
+  return out.position();
+}
+
+} // namespace json
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef POT_BSON_KEY_H_
+#define POT_BSON_KEY_H_
+
+#include "./hash.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+namespace pot {
+namespace bson {
+
+/**
+ * An element name with its length and FNV-1a hash worked out ahead of time,
+ * so that comparisons can check the length first and indices can filter on
+ * the hash. Use `POT_BSON_KEY("name")` for keys known at compile time, which
+ * computes everything as a constant.
+ *
+ * The string has to outlive the key.
+ */
+class Key {
+public:
+  constexpr Key(const char str[], const size_t len, const uint64_t hash) :
+      str_(str), len_(len), hash_(hash) {}
+
+  /**
+   * Prepares a key that is only known at runtime.
+   */
+  explicit Key(const char str[]) :
+      Key(str, strlen(str),
+          hash::fnv1a(hash::kFnvOffset, reinterpret_cast<const uint8_t *>(str),
+                      strlen(str))) {}
+
+  constexpr const char *str() const {
+    return this->str_;
+  }
+
+  constexpr size_t len() const {
+    return this->len_;
+  }
+
+  constexpr uint64_t hash() const {
+    return this->hash_;
+  }
+
+  /**
+   * Compares against a null-terminated name, reading at most `len() + 1`
+   * bytes of it.
+   */
+  bool equals(const char name[]) const {
+    return memcmp(name, this->str_, this->len_) == 0 &&
+           name[this->len_] == '\0';
+  }
+
+private:
+  const char *str_;
+  size_t len_;
+  uint64_t hash_;
+};
+
+} // namespace bson
+} // namespace pot
+
+/**
+ * A `Key` for a string literal, with the hash forced to be computed at
+ * compile time.
+ */
+#define POT_BSON_KEY(str)                                               \
+  ::pot::bson::Key(str, sizeof(str) - 1,                                \
+                   std::integral_constant<                              \
+                       uint64_t, ::pot::bson::hash::fnv1a_str(str)>::value)
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef POT_BSON_KEYDICT_KEYDICT_H_
+#define POT_BSON_KEYDICT_KEYDICT_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/array.hpp"
+#include "../deserializer/array_iter.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_iter.hpp"
+#include "../hash.hpp"
+#include "../key.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace keydict {
+
+/**
+ * A compact encoding for documents whose keys come from a dictionary shared
+ * by both peers ahead of time.
+ *
+ * A key in the dictionary is replaced by a reference: the marker byte 0xFF,
+ * followed by the key's id plus one, and the usual terminator. 0xFF never
+ * appears in UTF-8, so it can't start a real key, and the result is still
+ * well-formed BSON that the validators and iterators accept.
+ *
+ * A compact document starts with an Int32 element named by the marker alone,
+ * holding the dictionary's version, so that a peer with a different version
+ * can tell.
+ *
+ * Documents are built compact by appending with the `Key`s that
+ * `KeyDictionary::key` returns, and looked up with them, which only compares
+ * the two bytes of a reference. `compact` and `expand` convert to and from
+ * standard BSON.
+ */
+
+static constexpr uint8_t kKeyRefMarker = 0xFF;
+// The marker and the id, excluding the terminator.
+static constexpr size_t kKeyRefSize = 2;
+// Ids are stored plus one in a single byte, which mustn't be a terminator.
+static constexpr size_t kMaxDictKeys = 255;
+// Twice the most keys, so that probes stay short.
+static constexpr size_t kKeyDictSlots = 512;
+static constexpr size_t kKeyDictMaxDepth = 64;
+
+static constexpr char kVersionKey[] = { static_cast<char>(kKeyRefMarker), 0 };
+
+enum struct Status : uint8_t {
+  Ok,
+  BufferOverflow,
+  // A reference to an id that isn't in the dictionary.
+  UnknownKey,
+  // The document is missing its version, or it's for another dictionary.
+  VersionMismatch,
+  // A standard document has a key that starts with the marker byte.
+  Unsupported,
+  TooDeep,
+};
+
+/**
+ * Like `serializer::Result`, the length is the required length when the
+ * output buffer overflowed.
+ */
+struct Result {
+  Status status;
+  size_t len;
+};
+
+inline bool is_key_ref(const char name[]) {
+  return static_cast<uint8_t>(name[0]) == kKeyRefMarker && name[1] != '\0' &&
+         name[2] == '\0';
+}
+
+/**
+ * A versioned list of keys. The strings have to outlive the dictionary, and
+ * only the first `kMaxDictKeys` are used. Later duplicates are ignored.
+ */
+class KeyDictionary {
+public:
+  KeyDictionary(const uint32_t version, const char *const keys[],
+                const size_t count) :
+      version_(version) {
+    memset(this->slots_, 0, sizeof(this->slots_));
+
+    for (size_t i = 0; i < count && this->count_ < kMaxDictKeys; i++) {
+      size_t len = strlen(keys[i]);
+      uint8_t existing;
+      if (this->find(keys[i], len, existing)) {
+        continue;
+      }
+
+      size_t id = this->count_++;
+      this->names_[id] = keys[i];
+      this->lens_[id] = len;
+      this->refs_[id][0] = static_cast<char>(kKeyRefMarker);
+      this->refs_[id][1] = static_cast<char>(id + 1);
+      this->refs_[id][2] = '\0';
+
+      size_t slot = this->slotOf(keys[i], len);
+      while (this->slots_[slot] != 0) {
+        slot = (slot + 1) % kKeyDictSlots;
+      }
+      this->slots_[slot] = id + 1;
+    }
+  }
+
+  KeyDictionary(const KeyDictionary &) = delete;
+  void operator=(const KeyDictionary &) = delete;
+
+  uint32_t version() const {
+    return this->version_;
+  }
+
+  size_t size() const {
+    return this->count_;
+  }
+
+  const char *name(const uint8_t id) const {
+    return this->names_[id];
+  }
+
+  size_t nameLen(const uint8_t id) const {
+    return this->lens_[id];
+  }
+
+  bool find(const char name[], const size_t len, uint8_t &id) const {
+    size_t slot = this->slotOf(name, len);
+    while (this->slots_[slot] != 0) {
+      size_t candidate = this->slots_[slot] - 1;
+      if (this->lens_[candidate] == len &&
+          memcmp(this->names_[candidate], name, len) == 0) {
+        id = candidate;
+        return true;
+      }
+      slot = (slot + 1) % kKeyDictSlots;
+    }
+
+    return false;
+  }
+
+  /**
+   * Returns the reference for a key id. It points into the dictionary, so it
+   * has to outlive the key.
+   */
+  Key ref(const uint8_t id) const {
+    const char *ref = this->refs_[id];
+    return Key(ref, kKeyRefSize,
+               hash::fnv1a(hash::kFnvOffset,
+                           reinterpret_cast<const uint8_t *>(ref),
+                           kKeyRefSize));
+  }
+
+  /**
+   * Returns the reference for `name` if it's in the dictionary, or else
+   * `name` itself as a key.
+   */
+  Key key(const char name[]) const {
+    uint8_t id;
+    if (this->find(name, strlen(name), id)) {
+      return this->ref(id);
+    }
+
+    return Key(name);
+  }
+
+  /**
+   * Returns the id that a reference names, if it's in the dictionary.
+   */
+  bool refId(const char name[], uint8_t &id) const {
+    if (!is_key_ref(name)) {
+      return false;
+    }
+
+    size_t stored = static_cast<uint8_t>(name[1]);
+    if (stored > this->count_) {
+      return false;
+    }
+
+    id = stored - 1;
+    return true;
+  }
+
+private:
+  uint32_t version_;
+  size_t count_ = 0;
+  const char *names_[kMaxDictKeys];
+  size_t lens_[kMaxDictKeys];
+  char refs_[kMaxDictKeys][kKeyRefSize + 1];
+  // Ids plus one, so that zero is empty.
+  uint16_t slots_[kKeyDictSlots];
+
+  size_t slotOf(const char name[], const size_t len) const {
+    return hash::fnv1a(hash::kFnvOffset,
+                       reinterpret_cast<const uint8_t *>(name), len) %
+           kKeyDictSlots;
+  }
+};
+
+/**
+ * Returns an element's full name, expanding a reference. Names that aren't
+ * references, and references to unknown ids, are returned as they are.
+ */
+inline const char *element_name(const deserializer::DocumentElement &el,
+                                const KeyDictionary &dict) {
+  const char *name = el.getNameRef();
+  uint8_t id;
+  if (dict.refId(name, id)) {
+    return dict.name(id);
+  }
+
+  return name;
+}
+
+/**
+ * Reads the dictionary version of a compact document.
+ */
+inline bool compact_version(const deserializer::Document &doc,
+                            uint32_t &version) {
+  for (auto const &el : doc) {
+    int32_t value;
+    if (!el.nameEquals(kVersionKey) || !el.tryGetInt32(value)) {
+      return false;
+    }
+
+    version = static_cast<uint32_t>(value);
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * Rewrites the keys of a document's elements, recursively, after skipping
+ * the first `skip`. `Rename` writes an element's key and returns its status.
+ */
+template <typename Container, typename Rename>
+Status rewrite_keys(const Container &doc, BufferWriter &writer,
+                    const size_t depth, Rename &rename, size_t skip = 0) {
+  if (depth > kKeyDictMaxDepth) {
+    return Status::TooDeep;
+  }
+
+  for (auto const &el : doc) {
+    if (skip > 0) {
+      skip--;
+      continue;
+    }
+
+    Element type = el.type();
+    writer.writeByte(type);
+
+    Status status = rename(el, writer);
+    if (status != Status::Ok) {
+      return status;
+    }
+
+    if (type == Element::Document || type == Element::Array) {
+      size_t pos = writer.startDoc();
+      status = type == Element::Document
+                   ? rewrite_keys(el.getDoc(), writer, depth + 1, rename)
+                   : rewrite_keys(el.getArr(), writer, depth + 1, rename);
+      if (status != Status::Ok) {
+        return status;
+      }
+      writer.endDoc(pos);
+      continue;
+    }
+
+    writer.writeBuf(el.getDataRef(), el.dataSize());
+  }
+
+  return Status::Ok;
+}
+
+inline Result finish(const BufferWriter &writer, const Status status) {
+  if (status != Status::Ok) {
+    return { status, 0 };
+  }
+  if (writer.overflowed()) {
+    return { Status::BufferOverflow, writer.position() };
+  }
+
+  return { Status::Ok, writer.position() };
+}
+
+/**
+ * Converts a valid standard document to its compact form.
+ */
+inline Result compact(const uint8_t doc[], const size_t len, uint8_t out[],
+                      const size_t cap, const KeyDictionary &dict) {
+  BufferWriter writer(out, cap);
+  size_t pos = writer.startDoc();
+
+  writer.writeByte(Element::Int32);
+  writer.writeStr(kVersionKey, sizeof(kVersionKey) - 1);
+  writer.writeInt32(static_cast<int32_t>(dict.version()));
+
+  auto rename = [&dict](const deserializer::DocumentElement &el,
+                        BufferWriter &writer) {
+    const char *name = el.getNameRef();
+    size_t name_len = el.nameSize() - 1;
+    if (name_len > 0 && static_cast<uint8_t>(name[0]) == kKeyRefMarker) {
+      return Status::Unsupported;
+    }
+
+    uint8_t id;
+    if (dict.find(name, name_len, id)) {
+      Key ref = dict.ref(id);
+      writer.writeStr(ref.str(), ref.len());
+    } else {
+      writer.writeStr(name, name_len);
+    }
+    return Status::Ok;
+  };
+
+  Status status =
+      rewrite_keys(deserializer::Document(doc, len), writer, 0, rename);
+  writer.endDoc(pos);
+
+  return finish(writer, status);
+}
+
+/**
+ * Converts a valid compact document back to standard BSON, with the
+ * dictionary it was written with.
+ */
+inline Result expand(const uint8_t doc[], const size_t len, uint8_t out[],
+                     const size_t cap, const KeyDictionary &dict) {
+  deserializer::Document compact_doc(doc, len);
+  uint32_t version;
+  if (!compact_version(compact_doc, version) || version != dict.version()) {
+    return { Status::VersionMismatch, 0 };
+  }
+
+  BufferWriter writer(out, cap);
+  size_t pos = writer.startDoc();
+
+  auto rename = [&dict](const deserializer::DocumentElement &el,
+                        BufferWriter &writer) {
+    const char *name = el.getNameRef();
+    if (static_cast<uint8_t>(name[0]) != kKeyRefMarker) {
+      writer.writeStr(name, el.nameSize() - 1);
+      return Status::Ok;
+    }
+
+    uint8_t id;
+    if (!dict.refId(name, id)) {
+      return is_key_ref(name) ? Status::UnknownKey : Status::Unsupported;
+    }
+    writer.writeStr(dict.name(id), dict.nameLen(id));
+    return Status::Ok;
+  };
+
+  // Skip the version, which is always first.
+  Status status = rewrite_keys(compact_doc, writer, 0, rename, 1);
+  writer.endDoc(pos);
+
+  return finish(writer, status);
+}
+
+} // namespace keydict
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef POT_BSON_LITERAL_DOCUMENT_H_
+#define POT_BSON_LITERAL_DOCUMENT_H_
+
+#include "../consts.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace literal {
+
+/**
+ * Constant documents that are encoded entirely by the compiler, e.g.
+ *
+ *     static constexpr auto kAck = literal::to_array(literal::document(
+ *         literal::field("type", "ack"), literal::field("seq", 1),
+ *         literal::field("caps", literal::array("ota", "logs"))));
+ *
+ * which is a `std::array<uint8_t, N>` holding the BSON bytes, sized and laid
+ * out at compile time so that it can live in read-only memory.
+ *
+ * Values map onto elements by their C++ type: `int32_t`, `int64_t`,
+ * `double`, `bool`, string literals, `nullptr` for null, and nested
+ * `document`s and `array`s. A negative zero double is written as zero.
+ */
+
+constexpr uint8_t le_byte(const uint64_t value, const size_t i) {
+  return (value >> (8 * i)) & 0xFF;
+}
+
+constexpr size_t digits(const size_t n) {
+  return n < 10 ? 1 : 1 + digits(n / 10);
+}
+
+constexpr size_t pow10(const size_t n) {
+  return n == 0 ? 1 : 10 * pow10(n - 1);
+}
+
+// Powers of two are exact, so the double's bits can be worked out with
+// plain arithmetic, which is all a C++11 constant expression allows.
+constexpr double pow2(const int e) {
+  return e == 0 ? 1.0
+         : e > 0
+             ? (e % 2 ? 2.0 * pow2(e - 1) : pow2(e / 2) * pow2(e / 2))
+             : (e % 2 ? 0.5 * pow2(e + 1) : pow2(e / 2) * pow2(e / 2));
+}
+
+// The largest biased exponent in [lo, hi] whose power of two is <= value.
+constexpr int find_exponent(const double value, const int lo, const int hi) {
+  return lo == hi ? lo
+         : pow2((lo + hi + 1) / 2 - 1023) <= value
+             ? find_exponent(value, (lo + hi + 1) / 2, hi)
+             : find_exponent(value, lo, (lo + hi + 1) / 2 - 1);
+}
+
+constexpr uint64_t positive_double_bits(const double value, const int e) {
+  return e == 0
+             // Subnormal, scaled up in two steps so neither overflows.
+             ? static_cast<uint64_t>(value * pow2(1022) * pow2(52))
+             : static_cast<uint64_t>(e) << 52 |
+                   static_cast<uint64_t>((value / pow2(e - 1023) - 1) *
+                                         pow2(52));
+}
+
+constexpr uint64_t double_bits(const double value) {
+  return value != value ? 0x7FF8000000000000
+         : value == 0   ? 0
+         : value < 0    ? static_cast<uint64_t>(1) << 63 |
+                           double_bits(-value)
+         : value > 1.7976931348623157e308
+             ? 0x7FF0000000000000
+             : positive_double_bits(value,
+                                    value < pow2(-1022)
+                                        ? 0
+                                        : find_exponent(value, 1, 2046));
+}
+
+struct DoubleValue {
+  static constexpr uint8_t kType = static_cast<uint8_t>(Element::Double);
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Double);
+  uint64_t bits;
+
+  constexpr uint8_t byte(const size_t i) const {
+    return le_byte(this->bits, i);
+  }
+};
+
+template <size_t len> struct StrValue {
+  static constexpr uint8_t kType = static_cast<uint8_t>(Element::String);
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Int32) + len;
+  // Includes the literal's null-terminator.
+  const char *str;
+
+  constexpr uint8_t byte(const size_t i) const {
+    return i < static_cast<size_t>(TypeSize::Int32)
+               ? le_byte(len, i)
+               : this->str[i - static_cast<size_t>(TypeSize::Int32)];
+  }
+};
+
+struct BoolValue {
+  static constexpr uint8_t kType = static_cast<uint8_t>(Element::Boolean);
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Byte);
+  bool value;
+
+  constexpr uint8_t byte(const size_t) const {
+    return static_cast<uint8_t>(this->value ? BooleanElementValue::True
+                                            : BooleanElementValue::False);
+  }
+};
+
+struct NullValue {
+  static constexpr uint8_t kType = static_cast<uint8_t>(Element::Null);
+  static constexpr size_t kSize = 0;
+
+  constexpr uint8_t byte(const size_t) const {
+    return 0;
+  }
+};
+
+struct Int32Value {
+  static constexpr uint8_t kType = static_cast<uint8_t>(Element::Int32);
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Int32);
+  int32_t value;
+
+  constexpr uint8_t byte(const size_t i) const {
+    return le_byte(static_cast<uint32_t>(this->value), i);
+  }
+};
+
+struct Int64Value {
+  static constexpr uint8_t kType = static_cast<uint8_t>(Element::Int64);
+  static constexpr size_t kSize = static_cast<size_t>(TypeSize::Int64);
+  int64_t value;
+
+  constexpr uint8_t byte(const size_t i) const {
+    return le_byte(static_cast<uint64_t>(this->value), i);
+  }
+};
+
+/**
+ * A document or array value, wrapping the list of its elements.
+ */
+template <Element type, typename List> struct ContainerValue {
+  static constexpr uint8_t kType = static_cast<uint8_t>(type);
+  static constexpr size_t kSize =
+      static_cast<size_t>(TypeSize::Int32) + List::kSize + 1;
+  List list;
+
+  constexpr uint8_t byte(const size_t i) const {
+    return i < static_cast<size_t>(TypeSize::Int32)
+               ? le_byte(kSize, i)
+               : i < static_cast<size_t>(TypeSize::Int32) + List::kSize
+                     ? this->list.byte(i -
+                                       static_cast<size_t>(TypeSize::Int32))
+                     : static_cast<uint8_t>(Element::Terminator);
+  }
+};
+
+/**
+ * A named element. `key_size` includes the key's null-terminator.
+ */
+template <size_t key_size, typename Value> struct Field {
+  static constexpr size_t kSize = 1 + key_size + Value::kSize;
+  const char *key;
+  Value value;
+
+  constexpr uint8_t byte(const size_t i) const {
+    return i == 0          ? Value::kType
+           : i <= key_size ? this->key[i - 1]
+                           : this->value.byte(i - 1 - key_size);
+  }
+};
+
+template <typename... Fields> struct FieldList;
+
+template <> struct FieldList<> {
+  static constexpr size_t kSize = 0;
+
+  constexpr FieldList() {}
+
+  constexpr uint8_t byte(const size_t) const {
+    return 0;
+  }
+};
+
+template <typename Head, typename... Tail> struct FieldList<Head, Tail...> {
+  static constexpr size_t kSize = Head::kSize + FieldList<Tail...>::kSize;
+  Head head;
+  FieldList<Tail...> tail;
+
+  constexpr FieldList(const Head &head, const Tail &...tail) :
+      head(head), tail(tail...) {}
+
+  constexpr uint8_t byte(const size_t i) const {
+    return i < Head::kSize ? this->head.byte(i)
+                           : this->tail.byte(i - Head::kSize);
+  }
+};
+
+/**
+ * The values of an array, keyed by their position starting at `index`.
+ */
+template <size_t index, typename... Values> struct ItemList;
+
+template <size_t index> struct ItemList<index> {
+  static constexpr size_t kSize = 0;
+
+  constexpr ItemList() {}
+
+  constexpr uint8_t byte(const size_t) const {
+    return 0;
+  }
+};
+
+template <size_t index, typename Head, typename... Tail>
+struct ItemList<index, Head, Tail...> {
+  static constexpr size_t kDigits = digits(index);
+  static constexpr size_t kHeadSize = 1 + kDigits + 1 + Head::kSize;
+  static constexpr size_t kSize =
+      kHeadSize + ItemList<index + 1, Tail...>::kSize;
+  Head head;
+  ItemList<index + 1, Tail...> tail;
+
+  constexpr ItemList(const Head &head, const Tail &...tail) :
+      head(head), tail(tail...) {}
+
+  constexpr uint8_t byte(const size_t i) const {
+    return i >= kHeadSize ? this->tail.byte(i - kHeadSize)
+           : i == 0       ? Head::kType
+           : i <= kDigits ? '0' + index / pow10(kDigits - i) % 10
+           : i == kDigits + 1 ? 0
+                              : this->head.byte(i - kDigits - 2);
+  }
+};
+
+template <typename List>
+using DocumentValue = ContainerValue<Element::Document, List>;
+
+template <typename List>
+using ArrayValue = ContainerValue<Element::Array, List>;
+
+constexpr DoubleValue value(const double value) {
+  return { double_bits(value) };
+}
+
+template <size_t len> constexpr StrValue<len> value(const char (&str)[len]) {
+  return { str };
+}
+
+constexpr BoolValue value(const bool value) {
+  return { value };
+}
+
+constexpr NullValue value(std::nullptr_t) {
+  return {};
+}
+
+constexpr Int32Value value(const int32_t value) {
+  return { value };
+}
+
+constexpr Int64Value value(const int64_t value) {
+  return { value };
+}
+
+template <Element type, typename List>
+constexpr ContainerValue<type, List>
+value(const ContainerValue<type, List> &container) {
+  return container;
+}
+
+template <size_t key_size, typename T>
+constexpr auto field(const char (&key)[key_size], const T &val)
+    -> Field<key_size, decltype(value(val))> {
+  return { key, value(val) };
+}
+
+template <typename... Fields>
+constexpr DocumentValue<FieldList<Fields...>>
+document(const Fields &...fields) {
+  return { FieldList<Fields...>(fields...) };
+}
+
+template <typename... Ts>
+constexpr auto array(const Ts &...values)
+    -> ArrayValue<ItemList<0, decltype(value(values))...>> {
+  return { ItemList<0, decltype(value(values))...>(value(values)...) };
+}
+
+template <size_t... I> struct Indices {};
+
+template <typename A, typename B> struct ConcatIndices;
+
+template <size_t... A, size_t... B>
+struct ConcatIndices<Indices<A...>, Indices<B...>> {
+  using type = Indices<A..., (sizeof...(A) + B)...>;
+};
+
+// Built by halves to keep the template depth logarithmic in the size.
+template <size_t n> struct MakeIndices {
+  using type =
+      typename ConcatIndices<typename MakeIndices<n / 2>::type,
+                             typename MakeIndices<n - n / 2>::type>::type;
+};
+
+template <> struct MakeIndices<0> { using type = Indices<>; };
+
+template <> struct MakeIndices<1> { using type = Indices<0>; };
+
+template <typename List, size_t... I>
+constexpr std::array<uint8_t, DocumentValue<List>::kSize>
+to_array(const DocumentValue<List> &doc, Indices<I...>) {
+  return { { doc.byte(I)... } };
+}
+
+/**
+ * The encoded bytes of a document.
+ */
+template <typename List>
+constexpr std::array<uint8_t, DocumentValue<List>::kSize>
+to_array(const DocumentValue<List> &doc) {
+  return to_array(doc,
+                  typename MakeIndices<DocumentValue<List>::kSize>::type());
+}
+
+} // namespace literal
+} // namespace bson
+} // namespace pot
+
+#endif
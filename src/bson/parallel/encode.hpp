@@ -0,0 +1,109 @@
+#ifndef POT_BSON_PARALLEL_ENCODE_H_
+#define POT_BSON_PARALLEL_ENCODE_H_
+
+#include "../serializer/document.hpp"
+#include "../serializer/result.hpp"
+#include "./thread_pool.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace parallel {
+
+static constexpr size_t kEncodeGrain = 64;
+
+/**
+ * Serializes a batch of records into one buffer of concatenated documents.
+ *
+ * The builder runs twice per record: once against an empty buffer to measure
+ * the document, and once more to write it into its slot once the offsets are
+ * known from a prefix sum over the sizes. Both passes run on the pool, and
+ * each record is written in place, so the builder has to produce the same
+ * document every time it is called for a given index.
+ */
+class BatchEncoder {
+public:
+  using Builder = std::function<void(size_t, serializer::Document &)>;
+
+  explicit BatchEncoder(ThreadPool &pool, const size_t grain = kEncodeGrain) :
+      pool_(pool), grain_(grain) {}
+
+  /**
+   * Encodes `count` records. On `BufferOverflow` nothing has been written,
+   * and the result's `len` is the size the buffer needs to be. On
+   * `Inconsistent` a builder didn't reproduce its measured document, and the
+   * buffer is partly written.
+   */
+  serializer::Result encode(const size_t count, const Builder &builder,
+                            uint8_t buf[], const size_t len) {
+    this->offsets_.assign(count + 1, 0);
+
+    parallel_for(this->pool_, count, this->grain_,
+                 [&](size_t begin, size_t end) {
+                   for (size_t i = begin; i < end; i++) {
+                     this->offsets_[i + 1] =
+                         serializer::Document::build(
+                             nullptr, 0,
+                             [&](serializer::Document &doc) {
+                               builder(i, doc);
+                             })
+                             .len;
+                   }
+                 });
+
+    for (size_t i = 0; i < count; i++) {
+      this->offsets_[i + 1] += this->offsets_[i];
+    }
+
+    size_t total = this->offsets_[count];
+    if (total > len) {
+      return { serializer::Status::BufferOverflow, total };
+    }
+
+    // A builder that changes its output between passes would spill into the
+    // next record's slot, so every write is bounded by its measured size.
+    std::atomic<bool> ok(true);
+    parallel_for(this->pool_, count, this->grain_,
+                 [&](size_t begin, size_t end) {
+                   for (size_t i = begin; i < end; i++) {
+                     size_t slot = this->offsets_[i + 1] - this->offsets_[i];
+                     serializer::Result res = serializer::Document::build(
+                         &buf[this->offsets_[i]], slot,
+                         [&](serializer::Document &doc) { builder(i, doc); });
+
+                     if (res.status != serializer::Status::Ok ||
+                         res.len != slot) {
+                       ok.store(false, std::memory_order_relaxed);
+                     }
+                   }
+                 });
+
+    if (!ok.load()) {
+      return { serializer::Status::Inconsistent, total };
+    }
+
+    return { serializer::Status::Ok, total };
+  }
+
+  /**
+   * The offset of the document for record `index` in the last encoded batch.
+   * `offset(count)` is the total length.
+   */
+  size_t offset(const size_t index) const {
+    return this->offsets_[index];
+  }
+
+private:
+  ThreadPool &pool_;
+  size_t grain_;
+  std::vector<size_t> offsets_;
+};
+
+} // namespace parallel
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef POT_BSON_PARALLEL_THREAD_POOL_H_
+#define POT_BSON_PARALLEL_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace parallel {
+
+/**
+ * A fixed set of worker threads that all run the same task together. The
+ * calling thread takes part as worker 0, so a pool of size 1 spawns no
+ * threads at all.
+ */
+class ThreadPool {
+public:
+  explicit ThreadPool(const size_t size) : size_(size > 0 ? size : 1) {
+    for (size_t i = 1; i < this->size_; i++) {
+      this->threads_.emplace_back([this, i]() { this->work(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  void operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->stopping_ = true;
+    }
+    this->start_.notify_all();
+
+    for (auto &thread : this->threads_) {
+      thread.join();
+    }
+  }
+
+  size_t size() const {
+    return this->size_;
+  }
+
+  /**
+   * Runs `task(worker)` on every worker and returns once they have all
+   * finished. Not reentrant.
+   */
+  void run(const std::function<void(size_t)> &task) {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->task_ = &task;
+      this->pending_ = this->size_ - 1;
+      this->generation_++;
+    }
+    this->start_.notify_all();
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->done_.wait(lock, [this]() { return this->pending_ == 0; });
+    this->task_ = nullptr;
+  }
+
+private:
+  size_t size_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(size_t)> *task_ = nullptr;
+  size_t pending_ = 0;
+  size_t generation_ = 0;
+  bool stopping_ = false;
+
+  void work(const size_t worker) {
+    size_t seen = 0;
+
+    while (true) {
+      const std::function<void(size_t)> *task;
+      {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        this->start_.wait(lock, [this, seen]() {
+          return this->stopping_ || this->generation_ != seen;
+        });
+
+        if (this->stopping_) {
+          return;
+        }
+
+        seen = this->generation_;
+        task = this->task_;
+      }
+
+      (*task)(worker);
+
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      if (--this->pending_ == 0) {
+        this->done_.notify_one();
+      }
+    }
+  }
+};
+
+/**
+ * Calls `body(begin, end)` over `[0, count)` in chunks of `grain` items,
+ * spread across the pool. Each worker starts on its own contiguous share and
+ * steals chunks from the other workers' shares once it runs out, so uneven
+ * items still keep every core busy.
+ */
+inline void parallel_for(ThreadPool &pool, const size_t count, size_t grain,
+                         const std::function<void(size_t, size_t)> &body) {
+  if (count == 0) {
+    return;
+  }
+
+  if (grain == 0) {
+    grain = 1;
+  }
+
+  // Padded so that workers don't contend on each other's cache lines.
+  struct Share {
+    std::atomic<size_t> next;
+    size_t end;
+    uint8_t padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  };
+
+  size_t workers = pool.size();
+  std::unique_ptr<Share[]> shares(new Share[workers]);
+  size_t per_worker = (count + workers - 1) / workers;
+  for (size_t w = 0; w < workers; w++) {
+    size_t begin = w * per_worker < count ? w * per_worker : count;
+    size_t end = begin + per_worker < count ? begin + per_worker : count;
+    shares[w].next.store(begin, std::memory_order_relaxed);
+    shares[w].end = end;
+  }
+
+  pool.run([&](size_t worker) {
+    // Drain our own share first, then try everyone else's in turn.
+    for (size_t i = 0; i < workers; i++) {
+      Share &share = shares[(worker + i) % workers];
+
+      while (true) {
+        size_t begin = share.next.fetch_add(grain, std::memory_order_relaxed);
+        if (begin >= share.end) {
+          break;
+        }
+
+        size_t end = begin + grain < share.end ? begin + grain : share.end;
+        body(begin, end);
+      }
+    }
+  });
+}
+
+} // namespace parallel
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef POT_BSON_PARALLEL_VALIDATE_H_
+#define POT_BSON_PARALLEL_VALIDATE_H_
+
+#include "../consts.hpp"
+#include "../deserializer/array.hpp"
+#include "../deserializer/document.hpp"
+#include "../endian.hpp"
+#include "../io/document_stream.hpp"
+#include "./thread_pool.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace parallel {
+
+static constexpr size_t kValidateGrain = 64;
+static constexpr size_t kValidateSplitThreshold = 64 * 1024;
+
+/**
+ * Validates every document on the pool, storing each result in `results`.
+ * Returns the number of valid documents.
+ */
+inline size_t validate_batch(ThreadPool &pool,
+                             const deserializer::Document docs[],
+                             const size_t count, bool results[],
+                             const size_t grain = kValidateGrain) {
+  std::atomic<size_t> valid(0);
+
+  parallel_for(pool, count, grain, [&](size_t begin, size_t end) {
+    size_t chunk_valid = 0;
+    for (size_t i = begin; i < end; i++) {
+      results[i] = docs[i].valid();
+      chunk_valid += results[i];
+    }
+    valid.fetch_add(chunk_valid, std::memory_order_relaxed);
+  });
+
+  return valid.load();
+}
+
+/**
+ * Splits up to `max` documents off a stream of concatenated documents, then
+ * validates them on the pool. Splitting only reads the length headers, so it
+ * stays cheap compared to validation, and the stream itself shouldn't be
+ * validating. Returns the number of documents read
+ * into `docs`; check the stream's status to see whether it ended cleanly.
+ */
+inline size_t validate_batch(ThreadPool &pool, io::DocumentStream &stream,
+                             deserializer::Document docs[], bool results[],
+                             const size_t max,
+                             const size_t grain = kValidateGrain) {
+  size_t count = 0;
+  while (count < max && stream.next(docs[count])) {
+    count++;
+  }
+
+  validate_batch(pool, docs, count, results, grain);
+  return count;
+}
+
+/**
+ * Validates a single large document across the pool. A sequential skim walks
+ * the element headers, checking every scalar on the way, and collects nested
+ * documents and arrays as separate tasks. Containers larger than
+ * `split_threshold` bytes are skimmed in turn rather than queued whole, so a
+ * huge array of sub-documents is spread over many tasks. The result matches
+ * `Document::valid()`.
+ */
+template <size_t elm_name_buf_size = 50> class LargeDocumentValidator {
+public:
+  explicit LargeDocumentValidator(
+      const size_t split_threshold = kValidateSplitThreshold) :
+      split_threshold_(split_threshold) {}
+
+  bool valid(ThreadPool &pool, const uint8_t buf[], const size_t len) {
+    this->tasks_.clear();
+    if (!this->skim(buf, len, false)) {
+      return false;
+    }
+
+    std::atomic<bool> ok(true);
+    parallel_for(pool, this->tasks_.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end && ok.load(std::memory_order_relaxed);
+           i++) {
+        const Task &task = this->tasks_[i];
+        bool valid =
+            task.array
+                ? deserializer::Array(task.buf, task.len)
+                      .template valid<elm_name_buf_size>()
+                : deserializer::Document(task.buf, task.len)
+                      .template valid<elm_name_buf_size>();
+
+        if (!valid) {
+          ok.store(false, std::memory_order_relaxed);
+        }
+      }
+    });
+
+    return ok.load();
+  }
+
+  /**
+   * The number of nested containers that were validated as separate tasks by
+   * the last call to `valid`.
+   */
+  size_t tasks() const {
+    return this->tasks_.size();
+  }
+
+private:
+  struct Task {
+    const uint8_t *buf;
+    size_t len;
+    bool array;
+  };
+
+  size_t split_threshold_;
+  std::vector<Task> tasks_;
+
+  static bool fits(const size_t current, const size_t size, const size_t end) {
+    return size <= end - current;
+  }
+
+  static int32_t readInt32(const uint8_t buf[], const size_t current) {
+    return endian::buffer_to_primitive<int32_t, TypeSize::Int32>(buf, current);
+  }
+
+  bool skim(const uint8_t buf[], const size_t avail, const bool array) {
+    static constexpr size_t kInt32 = static_cast<uint8_t>(TypeSize::Int32);
+
+    if (avail < kInt32 + static_cast<uint8_t>(TypeSize::Byte)) {
+      return false;
+    }
+
+    int32_t doc_size = readInt32(buf, 0);
+    if (doc_size < static_cast<int32_t>(kInt32) + 1 ||
+        static_cast<size_t>(doc_size) > avail) {
+      return false;
+    }
+
+    size_t end = doc_size - static_cast<uint8_t>(TypeSize::Byte);
+    size_t current = kInt32;
+    size_t index = 0;
+    char index_str[kIntKeySize];
+
+    while (current < end) {
+      uint8_t type = buf[current++];
+
+      const uint8_t *name_end = static_cast<const uint8_t *>(
+          memchr(&buf[current], '\0', end - current));
+      if (name_end == nullptr) {
+        return false;
+      }
+
+      size_t name_size = name_end - &buf[current] + 1;
+      if (name_size > elm_name_buf_size) {
+        return false;
+      }
+
+      if (array) {
+        int index_len = convert_int_key_to_str(index, index_str);
+        if (static_cast<size_t>(index_len) + 1 != name_size ||
+            memcmp(index_str, &buf[current], index_len) != 0) {
+          return false;
+        }
+      }
+      current += name_size;
+
+      switch (type) {
+        case static_cast<uint8_t>(Element::Double):
+        case static_cast<uint8_t>(Element::Int64): {
+          if (!fits(current, static_cast<uint8_t>(TypeSize::Int64), end)) {
+            return false;
+          }
+          current += static_cast<uint8_t>(TypeSize::Int64);
+          break;
+        }
+        case static_cast<uint8_t>(Element::Int32): {
+          if (!fits(current, kInt32, end)) {
+            return false;
+          }
+          current += kInt32;
+          break;
+        }
+        case static_cast<uint8_t>(Element::String): {
+          if (!fits(current, kInt32, end)) {
+            return false;
+          }
+          int32_t str_len = readInt32(buf, current);
+          current += kInt32;
+
+          if (str_len < 1 || !fits(current, str_len, end) ||
+              buf[current + str_len - 1] != '\0') {
+            return false;
+          }
+          current += str_len;
+          break;
+        }
+        case static_cast<uint8_t>(Element::Document):
+        case static_cast<uint8_t>(Element::Array): {
+          if (!fits(current, kInt32, end)) {
+            return false;
+          }
+          int32_t child_len = readInt32(buf, current);
+          if (child_len < 0 || !fits(current, child_len, end)) {
+            return false;
+          }
+
+          bool child_array = type == static_cast<uint8_t>(Element::Array);
+          if (static_cast<size_t>(child_len) > this->split_threshold_) {
+            if (!this->skim(&buf[current], child_len, child_array)) {
+              return false;
+            }
+          } else {
+            this->tasks_.push_back({ &buf[current],
+                                     static_cast<size_t>(child_len),
+                                     child_array });
+          }
+          current += child_len;
+          break;
+        }
+        case static_cast<uint8_t>(Element::Binary): {
+          if (!fits(current, kInt32 + 1, end)) {
+            return false;
+          }
+          int32_t bin_len = readInt32(buf, current);
+          current += kInt32;
+
+          uint8_t subtype = buf[current];
+          current += static_cast<uint8_t>(TypeSize::Byte);
+
+          if (bin_len < 0 || !fits(current, bin_len, end) ||
+              !is_valid_binary(subtype, &buf[current], bin_len)) {
+            return false;
+          }
+          current += bin_len;
+          break;
+        }
+        case static_cast<uint8_t>(Element::Boolean): {
+          if (!fits(current, static_cast<uint8_t>(TypeSize::Byte), end) ||
+              (buf[current] !=
+                   static_cast<uint8_t>(BooleanElementValue::True) &&
+               buf[current] !=
+                   static_cast<uint8_t>(BooleanElementValue::False))) {
+            return false;
+          }
+          current += static_cast<uint8_t>(TypeSize::Byte);
+          break;
+        }
+        case static_cast<uint8_t>(Element::Null):
+          break;
+        default:
+          return false;
+      }
+
+      index++;
+    }
+
+    return current == end &&
+           buf[end] == static_cast<uint8_t>(Element::Terminator);
+  }
+};
+
+template <size_t elm_name_buf_size = 50>
+inline bool validate_large(ThreadPool &pool, const uint8_t buf[],
+                           const size_t len,
+                           const size_t split_threshold =
+                               kValidateSplitThreshold) {
+  LargeDocumentValidator<elm_name_buf_size> validator(split_threshold);
+  return validator.valid(pool, buf, len);
+}
+
+} // namespace parallel
+} // namespace bson
+} // namespace pot
+
+#endif
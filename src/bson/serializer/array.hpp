@@ -16,6 +16,8 @@ class Array : private Document {
 public:
   Array(const char key[], Document *parent) :
       Document(key, parent, Element::Array) {}
+  Array(const Key &key, Document *parent) :
+      Document(key, parent, Element::Array) {}
   Array(Array &parent) : Document(parent, Element::Array) {}
 
   Array(const Array &) = delete;
@@ -33,6 +35,12 @@ public:
     return *this;
   }
 
+  Array &appendStr(const char str[], size_t len) {
+    this->Document::appendStr(this->index_++, str, len);
+
+    return *this;
+  }
+
   Array &appendDoc(std::function<void(Document &)> builder) {
     this->Document::appendDoc(this->index_++, builder);
 
@@ -51,6 +59,36 @@ public:
     return *this;
   }
 
+  Array &appendVectorF32(const float values[], size_t count) {
+    this->Document::appendVectorF32(this->index_++, values, count);
+
+    return *this;
+  }
+
+  Array &appendVectorI8(const int8_t values[], size_t count) {
+    this->Document::appendVectorI8(this->index_++, values, count);
+
+    return *this;
+  }
+
+  Array &appendVectorPackedBits(const uint8_t bits[], size_t bit_count) {
+    this->Document::appendVectorPackedBits(this->index_++, bits, bit_count);
+
+    return *this;
+  }
+
+  Array &appendSeriesInt64(const int64_t values[], size_t count) {
+    this->Document::appendSeriesInt64(this->index_++, values, count);
+
+    return *this;
+  }
+
+  Array &appendSeriesDouble(const double values[], size_t count) {
+    this->Document::appendSeriesDouble(this->index_++, values, count);
+
+    return *this;
+  }
+
   Array &appendBool(bool value) {
     this->Document::appendBool(this->index_++, value);
 
@@ -75,6 +113,36 @@ public:
     return *this;
   }
 
+  Array &appendDoubleSlot(Slot &slot) {
+    this->Document::appendDoubleSlot(this->index_++, slot);
+
+    return *this;
+  }
+
+  Array &appendStrSlot(size_t capacity, Slot &slot) {
+    this->Document::appendStrSlot(this->index_++, capacity, slot);
+
+    return *this;
+  }
+
+  Array &appendBoolSlot(Slot &slot) {
+    this->Document::appendBoolSlot(this->index_++, slot);
+
+    return *this;
+  }
+
+  Array &appendInt32Slot(Slot &slot) {
+    this->Document::appendInt32Slot(this->index_++, slot);
+
+    return *this;
+  }
+
+  Array &appendInt64Slot(Slot &slot) {
+    this->Document::appendInt64Slot(this->index_++, slot);
+
+    return *this;
+  }
+
   Document *getWorkingDoc() {
     return this;
   }
@@ -113,6 +181,14 @@ Document &Document::appendArr(int32_t ikey,
   return appendArr(skey, builder);
 }
 
+Document &Document::appendArr(const Key &key,
+                              std::function<void(Array &)> builder) {
+  Array child(key, this);
+  builder(child);
+
+  return *this;
+}
+
 } // namespace serializer
 } // namespace bson
 } // namespace pot
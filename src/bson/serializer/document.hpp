@@ -3,7 +3,10 @@
 
 #include "../consts.hpp"
 #include "../endian.hpp"
+#include "../key.hpp"
+#include "../series/series.hpp"
 #include "./result.hpp"
+#include "./skeleton.hpp"
 #include <cstdlib>
 #include <cstring>
 #include <functional>
@@ -35,6 +38,9 @@ public:
   Document(const char key[], Document *parent) :
       Document(key, parent, Element::Document) {}
 
+  Document(const Key &key, Document *parent) :
+      Document(key, parent, Element::Document) {}
+
   Document(Array &parent) : Document(parent, Element::Document) {}
 
   Document(const Document &) = delete;
@@ -58,6 +64,14 @@ public:
     return this->appendDouble(skey, value);
   }
 
+  Document &appendDouble(const Key &key, double value) {
+    uint8_t buf[static_cast<size_t>(TypeSize::Double)];
+    endian::primitive_to_buffer<double, TypeSize::Double>(buf, value);
+    this->writeElement(Element::Double, key, buf, TypeSize::Double);
+
+    return *this;
+  }
+
   Document &appendStr(const char key[], const char str[]) {
     this->writeByte(Element::String);
     this->writeStr(key);
@@ -75,6 +89,38 @@ public:
     return this->appendStr(skey, str);
   }
 
+  Document &appendStr(const Key &key, const char str[]) {
+    this->writeByte(Element::String);
+    this->writeKey(key);
+
+    int32_t slen = strlen(str);
+    this->writeInt32(slen + 1);
+    this->writeStr(str);
+
+    return *this;
+  }
+
+  /**
+   * Appends the first `len` characters of `str`, which doesn't need to be
+   * null-terminated and may contain null characters.
+   */
+  Document &appendStr(const char key[], const char str[], size_t len) {
+    this->writeByte(Element::String);
+    this->writeStr(key);
+    this->writeInt32(len + 1);
+
+    this->writeBulk(reinterpret_cast<const uint8_t *>(str), len);
+    this->writeByte(0);
+
+    return *this;
+  }
+
+  Document &appendStr(int32_t ikey, const char str[], size_t len) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendStr(skey, str, len);
+  }
+
   Document &appendDoc(const char key[],
                       std::function<void(Document &)> builder) {
     Document child(key, this);
@@ -89,9 +135,18 @@ public:
     return this->appendDoc(skey, builder);
   }
 
+  Document &appendDoc(const Key &key,
+                      std::function<void(Document &)> builder) {
+    Document child(key, this);
+    builder(child);
+
+    return *this;
+  }
+
   // Implemented in array.hpp
   Document &appendArr(const char key[], std::function<void(Array &)> builder);
   Document &appendArr(int32_t ikey, std::function<void(Array &)> builder);
+  Document &appendArr(const Key &key, std::function<void(Array &)> builder);
 
   Document &appendBin(const char key[], const uint8_t buf[], int32_t len) {
     this->writeByte(Element::Binary);
@@ -110,6 +165,133 @@ public:
     return this->appendBin(skey, buf, len);
   }
 
+  Document &appendBin(const Key &key, const uint8_t buf[], int32_t len) {
+    this->writeByte(Element::Binary);
+    this->writeKey(key);
+
+    this->writeInt32(len);
+    this->writeByte(BinaryElementSubtype::Generic);
+    this->writeBuf(buf, len);
+
+    return *this;
+  }
+
+  /**
+   * Appends a Vector binary of 32-bit floats, stored little-endian.
+   */
+  Document &appendVectorF32(const char key[], const float values[],
+                            size_t count) {
+    size_t len = count * sizeof(float);
+    this->writeVectorHeader(key, VectorDType::Float32, 0, len);
+
+    if (!endian::is_big_endian()) {
+      this->writeBulk(reinterpret_cast<const uint8_t *>(values), len);
+      return *this;
+    }
+
+    uint8_t buf[static_cast<size_t>(TypeSize::Int32)];
+    for (size_t i = 0; i < count; i++) {
+      endian::primitive_to_buffer<float, TypeSize::Int32>(buf, values[i]);
+      this->writeBuf(buf, TypeSize::Int32);
+    }
+
+    return *this;
+  }
+
+  Document &appendVectorF32(int32_t ikey, const float values[],
+                            size_t count) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendVectorF32(skey, values, count);
+  }
+
+  Document &appendVectorI8(const char key[], const int8_t values[],
+                           size_t count) {
+    this->writeVectorHeader(key, VectorDType::Int8, 0, count);
+    this->writeBulk(reinterpret_cast<const uint8_t *>(values), count);
+
+    return *this;
+  }
+
+  Document &appendVectorI8(int32_t ikey, const int8_t values[], size_t count) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendVectorI8(skey, values, count);
+  }
+
+  /**
+   * Appends a Vector binary of `bit_count` bits, packed most significant bit
+   * first into `bits`. Unused bits in the last byte are written as zero.
+   */
+  Document &appendVectorPackedBits(const char key[], const uint8_t bits[],
+                                   size_t bit_count) {
+    size_t len = (bit_count + 7) / 8;
+    uint8_t padding = len * 8 - bit_count;
+    this->writeVectorHeader(key, VectorDType::PackedBit, padding, len);
+
+    if (len > 0) {
+      this->writeBulk(bits, len - 1);
+      this->writeByte(bits[len - 1] & (0xFF << padding));
+    }
+
+    return *this;
+  }
+
+  Document &appendVectorPackedBits(int32_t ikey, const uint8_t bits[],
+                                   size_t bit_count) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendVectorPackedBits(skey, bits, bit_count);
+  }
+
+  /**
+   * Appends a Series binary of integers, each stored as the varint of its
+   * difference from the previous one.
+   */
+  Document &appendSeriesInt64(const char key[], const int64_t values[],
+                              size_t count) {
+    size_t len_pos =
+        this->writeSeriesHeader(key, SeriesEncoding::DeltaInt64, count);
+
+    size_t cap = this->remaining();
+    size_t len = series::encode_int64(values, count, this->tail(), cap);
+    this->advance(len);
+    this->patchInt32(len_pos, len + kSeriesHeaderSize);
+
+    return *this;
+  }
+
+  Document &appendSeriesInt64(int32_t ikey, const int64_t values[],
+                              size_t count) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendSeriesInt64(skey, values, count);
+  }
+
+  /**
+   * Appends a Series binary of doubles, each stored as its XOR with the
+   * previous one.
+   */
+  Document &appendSeriesDouble(const char key[], const double values[],
+                               size_t count) {
+    size_t len_pos =
+        this->writeSeriesHeader(key, SeriesEncoding::XorDouble, count);
+
+    size_t cap = this->remaining();
+    size_t len = series::encode_double(values, count, this->tail(), cap);
+    this->advance(len);
+    this->patchInt32(len_pos, len + kSeriesHeaderSize);
+
+    return *this;
+  }
+
+  Document &appendSeriesDouble(int32_t ikey, const double values[],
+                               size_t count) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendSeriesDouble(skey, values, count);
+  }
+
   Document &appendBool(const char key[], bool value) {
     this->writeByte(Element::Boolean);
     this->writeStr(key);
@@ -129,6 +311,19 @@ public:
     return this->appendBool(skey, value);
   }
 
+  Document &appendBool(const Key &key, bool value) {
+    this->writeByte(Element::Boolean);
+    this->writeKey(key);
+
+    if (value) {
+      this->writeByte(static_cast<uint8_t>(BooleanElementValue::True));
+    } else {
+      this->writeByte(static_cast<uint8_t>(BooleanElementValue::False));
+    }
+
+    return *this;
+  }
+
   Document &appendNull(const char key[]) {
     this->writeByte(Element::Null);
     this->writeStr(key);
@@ -142,6 +337,13 @@ public:
     return this->appendNull(skey);
   }
 
+  Document &appendNull(const Key &key) {
+    this->writeByte(Element::Null);
+    this->writeKey(key);
+
+    return *this;
+  }
+
   Document &appendInt32(const char key[], int32_t value) {
     this->writeByte(Element::Int32);
     this->writeStr(key);
@@ -156,6 +358,14 @@ public:
     return this->appendInt32(skey, value);
   }
 
+  Document &appendInt32(const Key &key, int32_t value) {
+    this->writeByte(Element::Int32);
+    this->writeKey(key);
+    this->writeInt32(value);
+
+    return *this;
+  }
+
   Document &appendInt64(const char key[], int64_t value) {
     uint8_t buf[static_cast<size_t>(TypeSize::Int64)];
     endian::primitive_to_buffer<int64_t, TypeSize::Int64>(buf, value);
@@ -170,6 +380,90 @@ public:
     return this->appendInt64(skey, value);
   }
 
+  Document &appendInt64(const Key &key, int64_t value) {
+    uint8_t buf[static_cast<size_t>(TypeSize::Int64)];
+    endian::primitive_to_buffer<int64_t, TypeSize::Int64>(buf, value);
+    this->writeElement(Element::Int64, key, buf, TypeSize::Int64);
+
+    return *this;
+  }
+
+  /**
+   * The `append*Slot` members write a placeholder value and return a handle to
+   * it, which can later be filled in on any copy of the finished buffer. See
+   * `Skeleton`.
+   */
+  Document &appendDoubleSlot(const char key[], Slot &slot) {
+    this->writeSlot(Element::Double, key, TypeSize::Double, slot);
+
+    return *this;
+  }
+
+  Document &appendDoubleSlot(int32_t ikey, Slot &slot) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendDoubleSlot(skey, slot);
+  }
+
+  /**
+   * Reserves room for a string of up to `capacity` bytes. Until the slot is
+   * set, the value is `capacity` null bytes.
+   */
+  Document &appendStrSlot(const char key[], size_t capacity, Slot &slot) {
+    this->writeByte(Element::String);
+    this->writeStr(key);
+    slot = Slot(Element::String, this->current_, capacity);
+    for (Document *doc = this; doc != nullptr; doc = doc->parent_) {
+      slot.parents_.push_back(doc->start_);
+    }
+    this->writeInt32(capacity + 1);
+    this->writeZeros(capacity + 1);
+
+    return *this;
+  }
+
+  Document &appendStrSlot(int32_t ikey, size_t capacity, Slot &slot) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendStrSlot(skey, capacity, slot);
+  }
+
+  Document &appendBoolSlot(const char key[], Slot &slot) {
+    this->writeSlot(Element::Boolean, key, TypeSize::Byte, slot);
+
+    return *this;
+  }
+
+  Document &appendBoolSlot(int32_t ikey, Slot &slot) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendBoolSlot(skey, slot);
+  }
+
+  Document &appendInt32Slot(const char key[], Slot &slot) {
+    this->writeSlot(Element::Int32, key, TypeSize::Int32, slot);
+
+    return *this;
+  }
+
+  Document &appendInt32Slot(int32_t ikey, Slot &slot) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendInt32Slot(skey, slot);
+  }
+
+  Document &appendInt64Slot(const char key[], Slot &slot) {
+    this->writeSlot(Element::Int64, key, TypeSize::Int64, slot);
+
+    return *this;
+  }
+
+  Document &appendInt64Slot(int32_t ikey, Slot &slot) {
+    char skey[kIntKeySize];
+    convert_int_key_to_str(ikey, skey);
+    return this->appendInt64Slot(skey, slot);
+  }
+
   Result end() {
     int32_t len;
     if (!ended_) {
@@ -221,6 +515,13 @@ protected:
     this->start();
   }
 
+  Document(const Key &key, Document *parent, Element type) {
+    this->fromParent(parent, type);
+    this->writeKey(key);
+    this->start_ = parent->current_;
+    this->start();
+  }
+
   Document(Array &parent, Element type) {
     Document *docParent = array_get_working_doc_(parent);
     fromParent(docParent, type);
@@ -262,6 +563,26 @@ protected:
     this->writeBuf(buf, len);
   }
 
+  void writeElement(Element type, const Key &key, uint8_t buf[],
+                    TypeSize size) {
+    this->writeByte(type);
+    this->writeKey(key);
+    this->writeBuf(buf, size);
+  }
+
+  void writeSlot(Element type, const char key[], TypeSize size, Slot &slot) {
+    this->writeByte(type);
+    this->writeStr(key);
+    slot = Slot(type, this->current_, 0);
+    this->writeZeros(static_cast<size_t>(size));
+  }
+
+  void writeZeros(size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      this->writeByte(0);
+    }
+  }
+
   void writeStr(const char str[]) {
     size_t i = 0;
     char chr;
@@ -271,6 +592,23 @@ protected:
     } while (chr != '\0');
   }
 
+  /**
+   * Writes a key and its terminator. The length is already known, so when it
+   * fits it's copied in one go and the position is moved once.
+   */
+  void writeKey(const Key &key) {
+    size_t len = key.len();
+    if (this->current_ + len < this->buffer_length_) {
+      memcpy(&this->buffer_[this->current_], key.str(), len);
+      this->buffer_[this->current_ + len] = 0;
+      this->advance(len + 1);
+      return;
+    }
+
+    this->writeBuf(reinterpret_cast<const uint8_t *>(key.str()), len);
+    this->writeByte(0);
+  }
+
   void writeInt32(int32_t value) {
     uint8_t len_buf[static_cast<size_t>(TypeSize::Int32)];
     endian::primitive_to_buffer<int32_t, TypeSize::Int32>(len_buf, value);
@@ -288,6 +626,73 @@ protected:
     }
   }
 
+  /**
+   * Writes a run of bytes, copied in one go and moving the position once
+   * when it fits. An empty run may come with a null `buf`.
+   */
+  void writeBulk(const uint8_t buf[], size_t len) {
+    if (len == 0) {
+      return;
+    }
+
+    if (this->buffer_ != nullptr &&
+        this->current_ + len <= this->buffer_length_) {
+      memcpy(&this->buffer_[this->current_], buf, len);
+      this->advance(len);
+      return;
+    }
+
+    this->writeBuf(buf, len);
+  }
+
+  void writeVectorHeader(const char key[], VectorDType dtype, uint8_t padding,
+                         size_t len) {
+    this->writeByte(Element::Binary);
+    this->writeStr(key);
+
+    this->writeInt32(len + kVectorHeaderSize);
+    this->writeByte(BinaryElementSubtype::Vector);
+    this->writeByte(static_cast<uint8_t>(dtype));
+    this->writeByte(padding);
+  }
+
+  /**
+   * Writes a Series binary's header with a placeholder length, returning the
+   * length's position to be patched once the data is encoded.
+   */
+  size_t writeSeriesHeader(const char key[], SeriesEncoding encoding,
+                           size_t count) {
+    this->writeByte(Element::Binary);
+    this->writeStr(key);
+
+    size_t len_pos = this->current_;
+    this->writeInt32(0);
+    this->writeByte(BinaryElementSubtype::Series);
+    this->writeByte(static_cast<uint8_t>(encoding));
+    this->writeInt32(count);
+
+    return len_pos;
+  }
+
+  void patchInt32(size_t pos, int32_t value) {
+    if (pos + static_cast<size_t>(TypeSize::Int32) <= this->buffer_length_) {
+      endian::primitive_to_buffer<int32_t, TypeSize::Int32>(
+          &this->buffer_[pos], value);
+    }
+  }
+
+  size_t remaining() const {
+    return this->current_ < this->buffer_length_
+               ? this->buffer_length_ - this->current_
+               : 0;
+  }
+
+  // Where the space left starts, which is only safe to write to when there's
+  // some.
+  uint8_t *tail() const {
+    return this->buffer_ + (this->remaining() > 0 ? this->current_ : 0);
+  }
+
   void writeByte(Element type) {
     this->writeByte(static_cast<uint8_t>(type));
   }
@@ -310,6 +715,13 @@ protected:
     }
   }
 
+  void advance(size_t len) {
+    this->current_ += len;
+    if (this->parent_) {
+      this->parent_->advance(len);
+    }
+  }
+
   void setCurrent(size_t cur) {
     this->current_ = cur;
     if (this->parent_) {
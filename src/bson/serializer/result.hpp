@@ -18,6 +18,12 @@ enum struct Status {
    * state, and the document will have to be reconstructed from the beginning.
    */
   BufferOverflow,
+  /**
+   * A builder that's run more than once, such as by `parallel::BatchEncoder`,
+   * produced a different document the second time. Part of the buffer has
+   * been written, and retrying with a larger buffer won't help.
+   */
+  Inconsistent,
 };
 
 struct Result {
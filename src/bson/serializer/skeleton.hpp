@@ -0,0 +1,183 @@
+#ifndef POT_BSON_SERIALIZER_SKELETON_H_
+#define POT_BSON_SERIALIZER_SKELETON_H_
+
+#include "../consts.hpp"
+#include "../endian.hpp"
+#include "./result.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace pot {
+namespace bson {
+namespace serializer {
+
+class Document;
+
+/**
+ * A handle to a fixed-width value inside a serialized skeleton document.
+ * Slots are created with the `append*Slot` members of `Document` and `Array`,
+ * and can then be written into any copy of the skeleton buffer.
+ */
+class Slot {
+  friend class Document;
+
+public:
+  Slot() {}
+
+  Element type() const {
+    return this->type_;
+  }
+
+  /**
+   * The offset of the value bytes from the start of the root document.
+   */
+  size_t offset() const {
+    return this->offset_;
+  }
+
+  /**
+   * The maximum string length (excluding the null terminator) that can be
+   * stored in a string slot. Zero for all other slot types.
+   */
+  size_t capacity() const {
+    return this->capacity_;
+  }
+
+  bool setDouble(uint8_t msg[], const double value) const {
+    if (this->type_ != Element::Double) {
+      return false;
+    }
+
+    endian::primitive_to_buffer<double, TypeSize::Double>(&msg[this->offset_],
+                                                          value);
+    return true;
+  }
+
+  /**
+   * Writes the string with its real length, then moves the rest of the message
+   * back over the unused capacity and shortens the enclosing documents, so
+   * `len` (the message length) goes down by `capacity() - strlen(str)`.
+   *
+   * Everything after the slot moves, so string slots are set after all other
+   * slots, latest created first. Each string slot can only be set once per
+   * copy of the skeleton.
+   */
+  bool setStr(uint8_t msg[], size_t &len, const char str[]) const {
+    if (this->type_ != Element::String) {
+      return false;
+    }
+
+    size_t str_len = strlen(str);
+    size_t value = this->offset_ + static_cast<size_t>(TypeSize::Int32);
+    size_t tail = value + this->capacity_ + 1;
+    if (str_len > this->capacity_ || tail > len) {
+      return false;
+    }
+
+    // Any other length means the slot was already set on this copy.
+    size_t reserved = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(
+        msg, this->offset_);
+    if (reserved != this->capacity_ + 1) {
+      return false;
+    }
+
+    int32_t slack = this->capacity_ - str_len;
+    endian::primitive_to_buffer<int32_t, TypeSize::Int32>(&msg[this->offset_],
+                                                          str_len + 1);
+    memcpy(&msg[value], str, str_len);
+    msg[value + str_len] = 0;
+    memmove(&msg[value + str_len + 1], &msg[tail], len - tail);
+
+    for (size_t parent : this->parents_) {
+      int32_t doc_len =
+          endian::buffer_to_primitive<int32_t, TypeSize::Int32>(msg, parent);
+      endian::primitive_to_buffer<int32_t, TypeSize::Int32>(&msg[parent],
+                                                            doc_len - slack);
+    }
+    len -= slack;
+    return true;
+  }
+
+  bool setBool(uint8_t msg[], const bool value) const {
+    if (this->type_ != Element::Boolean) {
+      return false;
+    }
+
+    msg[this->offset_] = static_cast<uint8_t>(
+        value ? BooleanElementValue::True : BooleanElementValue::False);
+    return true;
+  }
+
+  bool setInt32(uint8_t msg[], const int32_t value) const {
+    if (this->type_ != Element::Int32) {
+      return false;
+    }
+
+    endian::primitive_to_buffer<int32_t, TypeSize::Int32>(&msg[this->offset_],
+                                                          value);
+    return true;
+  }
+
+  bool setInt64(uint8_t msg[], const int64_t value) const {
+    if (this->type_ != Element::Int64) {
+      return false;
+    }
+
+    endian::primitive_to_buffer<int64_t, TypeSize::Int64>(&msg[this->offset_],
+                                                          value);
+    return true;
+  }
+
+private:
+  Element type_ = Element::Terminator;
+  size_t offset_ = 0;
+  size_t capacity_ = 0;
+  // The length offsets of the documents around a string slot.
+  std::vector<size_t> parents_;
+
+  Slot(Element type, size_t offset, size_t capacity) :
+      type_(type), offset_(offset), capacity_(capacity) {}
+};
+
+/**
+ * A pre-serialized document with a fixed shape. Sending a message from a
+ * skeleton costs a single copy of the skeleton bytes plus one store per slot,
+ * rather than re-serializing every key and value.
+ */
+class Skeleton {
+public:
+  Skeleton(const uint8_t buf[], const size_t len) :
+      buffer_(buf), buffer_length_(len) {}
+
+  size_t len() const {
+    return this->buffer_length_;
+  }
+
+  /**
+   * Copies the skeleton into `out`, ready for its slots to be written.
+   */
+  Result copyTo(uint8_t out[], const size_t len) const {
+    Result res;
+    res.len = this->buffer_length_;
+
+    if (this->buffer_length_ > len) {
+      res.status = Status::BufferOverflow;
+      return res;
+    }
+
+    memcpy(out, this->buffer_, this->buffer_length_);
+    res.status = Status::Ok;
+    return res;
+  }
+
+private:
+  const uint8_t *buffer_;
+  size_t buffer_length_;
+};
+
+} // namespace serializer
+} // namespace bson
+} // namespace pot
+
+#endif
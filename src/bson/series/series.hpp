@@ -0,0 +1,404 @@
+#ifndef POT_BSON_SERIES_SERIES_H_
+#define POT_BSON_SERIES_SERIES_H_
+
+#include "../consts.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace series {
+
+/**
+ * Compact encodings for a series of numbers, stored as the data of a Series
+ * binary after its header (see `SeriesEncoding`).
+ *
+ * Integers are stored as the zigzag varint of their difference from the
+ * previous value, so timestamps at a steady rate or slowly changing counters
+ * take a byte or two each. Doubles use the XOR scheme from Facebook's Gorilla:
+ * an unchanged value is a single bit, and a changed one only stores the bits
+ * between the leading and trailing zeros of its XOR with the previous value.
+ *
+ * The encoders take an output capacity and keep counting past it, returning
+ * the full length, so that a too small buffer can be reallocated.
+ */
+
+static constexpr size_t kMaxVarintSize = 10;
+
+// The top bit of every byte, which marks a varint as continuing.
+static constexpr uint64_t kContinuationBits = 0x8080808080808080;
+
+inline uint64_t zigzag(const int64_t value) {
+  uint64_t bits = static_cast<uint64_t>(value);
+  return (bits << 1) ^ (0 - (bits >> 63));
+}
+
+inline int64_t unzigzag(const uint64_t value) {
+  return static_cast<int64_t>((value >> 1) ^ (0 - (value & 1)));
+}
+
+inline uint64_t double_to_bits(const double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline double bits_to_double(const uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline unsigned leading_zeros(const uint64_t value) {
+  return value == 0 ? 64 : __builtin_clzll(value);
+}
+
+inline unsigned trailing_zeros(const uint64_t value) {
+  return value == 0 ? 64 : __builtin_ctzll(value);
+}
+
+/**
+ * Appends bytes to a buffer of fixed capacity, counting the ones that don't
+ * fit.
+ */
+class ByteOutput {
+public:
+  ByteOutput(uint8_t buf[], const size_t cap) : buf_(buf), cap_(cap) {}
+
+  void put(const uint8_t byte) {
+    if (this->pos_ < this->cap_) {
+      this->buf_[this->pos_] = byte;
+    }
+    this->pos_++;
+  }
+
+  void putVarint(uint64_t value) {
+    while (value >= 0x80) {
+      this->put(static_cast<uint8_t>(value) | 0x80);
+      value >>= 7;
+    }
+    this->put(static_cast<uint8_t>(value));
+  }
+
+  size_t position() const {
+    return this->pos_;
+  }
+
+private:
+  uint8_t *buf_;
+  size_t cap_;
+  size_t pos_ = 0;
+};
+
+/**
+ * Writes bit fields most significant bit first.
+ */
+class BitWriter {
+public:
+  BitWriter(uint8_t buf[], const size_t cap) : out_(buf, cap) {}
+
+  // Writes the low `bits` bits of `value`, where `bits` is at most 64.
+  void write(const uint64_t value, unsigned bits) {
+    while (bits > 0) {
+      unsigned space = 8 - this->fill_;
+      unsigned take = bits < space ? bits : space;
+      uint8_t chunk = (value >> (bits - take)) & ((1u << take) - 1);
+
+      this->acc_ = (this->acc_ << take) | chunk;
+      this->fill_ += take;
+      bits -= take;
+
+      if (this->fill_ == 8) {
+        this->out_.put(this->acc_);
+        this->acc_ = 0;
+        this->fill_ = 0;
+      }
+    }
+  }
+
+  /**
+   * Pads the last byte with zeros and returns the length in bytes.
+   */
+  size_t finish() {
+    if (this->fill_ > 0) {
+      this->out_.put(this->acc_ << (8 - this->fill_));
+      this->acc_ = 0;
+      this->fill_ = 0;
+    }
+
+    return this->out_.position();
+  }
+
+private:
+  ByteOutput out_;
+  uint8_t acc_ = 0;
+  unsigned fill_ = 0;
+};
+
+/**
+ * Reads bit fields written by `BitWriter`, refilling a 64-bit window so that
+ * most fields are a shift and a mask.
+ */
+class BitReader {
+public:
+  BitReader(const uint8_t buf[], const size_t len) : buf_(buf), len_(len) {}
+
+  // Reads `bits` bits, at most 64, into `out`.
+  bool read(unsigned bits, uint64_t &out) {
+    uint64_t value = 0;
+    while (bits > 0) {
+      if (this->avail_ == 0 && !this->refill()) {
+        return false;
+      }
+
+      unsigned take = bits < this->avail_ ? bits : this->avail_;
+      uint64_t chunk = this->window_ >> (64 - take);
+      value = take == 64 ? chunk : (value << take) | chunk;
+      this->window_ = take == 64 ? 0 : this->window_ << take;
+      this->avail_ -= take;
+      bits -= take;
+    }
+
+    out = value;
+    return true;
+  }
+
+  bool readBit(bool &out) {
+    if (this->avail_ == 0 && !this->refill()) {
+      return false;
+    }
+
+    out = this->window_ >> 63;
+    this->window_ <<= 1;
+    this->avail_--;
+    return true;
+  }
+
+  /**
+   * Whether everything but the zero padding of the last byte was read.
+   */
+  bool done() const {
+    return this->pos_ == this->len_ && this->avail_ < 8 &&
+           this->window_ == 0;
+  }
+
+private:
+  const uint8_t *buf_;
+  size_t len_;
+  size_t pos_ = 0;
+  uint64_t window_ = 0;
+  unsigned avail_ = 0;
+
+  bool refill() {
+    if (this->pos_ == this->len_) {
+      return false;
+    }
+
+    while (this->avail_ <= 56 && this->pos_ < this->len_) {
+      this->window_ |= static_cast<uint64_t>(this->buf_[this->pos_++])
+                       << (56 - this->avail_);
+      this->avail_ += 8;
+    }
+    return true;
+  }
+};
+
+/**
+ * Encodes `count` integers into `out`, writing at most `cap` bytes, and
+ * returns the encoded length.
+ */
+inline size_t encode_int64(const int64_t values[], const size_t count,
+                           uint8_t out[], const size_t cap) {
+  ByteOutput output(out, cap);
+  uint64_t prev = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    uint64_t value = static_cast<uint64_t>(values[i]);
+    output.putVarint(zigzag(static_cast<int64_t>(value - prev)));
+    prev = value;
+  }
+
+  return output.position();
+}
+
+inline bool read_varint(const uint8_t data[], const size_t len, size_t &pos,
+                        uint64_t &out) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < kMaxVarintSize && pos < len; i++) {
+    uint8_t byte = data[pos++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+
+    if (!(byte & 0x80)) {
+      out = value;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Decodes exactly `count` integers from the `len` bytes of `data`.
+ *
+ * The varints are read first, eight single-byte ones at a time where no byte
+ * in a word has its continuation bit set, and the deltas are then summed in a
+ * separate branch-free pass that the compiler can keep in registers.
+ */
+inline bool decode_int64(const uint8_t data[], const size_t len,
+                         int64_t out[], const size_t count) {
+  uint64_t *raw = reinterpret_cast<uint64_t *>(out);
+  size_t pos = 0;
+  size_t i = 0;
+
+  while (i < count) {
+    if (count - i >= 8 && len - pos >= 8) {
+      uint64_t word;
+      memcpy(&word, &data[pos], sizeof(word));
+
+      if ((word & kContinuationBits) == 0) {
+        for (size_t k = 0; k < 8; k++) {
+          raw[i + k] = data[pos + k];
+        }
+        i += 8;
+        pos += 8;
+        continue;
+      }
+    }
+
+    if (!read_varint(data, len, pos, raw[i])) {
+      return false;
+    }
+    i++;
+  }
+
+  uint64_t prev = 0;
+  for (i = 0; i < count; i++) {
+    prev += static_cast<uint64_t>(unzigzag(raw[i]));
+    raw[i] = prev;
+  }
+
+  return pos == len;
+}
+
+/**
+ * Encodes `count` doubles into `out`, writing at most `cap` bytes, and
+ * returns the encoded length.
+ *
+ * After the first value, which is stored whole, each value is:
+ * - `0` when it's equal to the previous one,
+ * - `10` and its meaningful bits when they fit in the previous value's window
+ *   of leading and trailing zeros,
+ * - `11`, 6 bits of leading zeros, 6 bits of the meaningful length minus one,
+ *   and the meaningful bits otherwise.
+ */
+inline size_t encode_double(const double values[], const size_t count,
+                            uint8_t out[], const size_t cap) {
+  BitWriter writer(out, cap);
+  if (count == 0) {
+    return writer.finish();
+  }
+
+  uint64_t prev = double_to_bits(values[0]);
+  writer.write(prev, 64);
+
+  // An impossible window, so that the first change always writes its own.
+  unsigned leading = 65;
+  unsigned trailing = 0;
+
+  for (size_t i = 1; i < count; i++) {
+    uint64_t bits = double_to_bits(values[i]);
+    uint64_t x = bits ^ prev;
+    prev = bits;
+
+    if (x == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+
+    unsigned lz = leading_zeros(x);
+    unsigned tz = trailing_zeros(x);
+    if (lz >= leading && tz >= trailing) {
+      writer.write(0x2, 2);
+      writer.write(x >> trailing, 64 - leading - trailing);
+      continue;
+    }
+
+    leading = lz;
+    trailing = tz;
+    unsigned meaningful = 64 - lz - tz;
+    writer.write(0x3, 2);
+    writer.write(lz, 6);
+    writer.write(meaningful - 1, 6);
+    writer.write(x >> tz, meaningful);
+  }
+
+  return writer.finish();
+}
+
+/**
+ * Decodes exactly `count` doubles from the `len` bytes of `data`.
+ */
+inline bool decode_double(const uint8_t data[], const size_t len,
+                          double out[], const size_t count) {
+  if (count == 0) {
+    return len == 0;
+  }
+
+  BitReader reader(data, len);
+  uint64_t prev;
+  if (!reader.read(64, prev)) {
+    return false;
+  }
+  out[0] = bits_to_double(prev);
+
+  unsigned leading = 0;
+  unsigned trailing = 0;
+  bool window = false;
+
+  for (size_t i = 1; i < count; i++) {
+    bool changed;
+    if (!reader.readBit(changed)) {
+      return false;
+    }
+
+    if (changed) {
+      bool new_window;
+      if (!reader.readBit(new_window)) {
+        return false;
+      }
+
+      if (new_window) {
+        uint64_t lz, meaningful;
+        if (!reader.read(6, lz) || !reader.read(6, meaningful)) {
+          return false;
+        }
+        meaningful++;
+        if (lz + meaningful > 64) {
+          return false;
+        }
+
+        leading = lz;
+        trailing = 64 - lz - meaningful;
+        window = true;
+      } else if (!window) {
+        return false;
+      }
+
+      uint64_t x;
+      if (!reader.read(64 - leading - trailing, x)) {
+        return false;
+      }
+      prev ^= x << trailing;
+    }
+
+    out[i] = bits_to_double(prev);
+  }
+
+  return reader.done();
+}
+
+} // namespace series
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,433 @@
+#ifndef POT_BSON_TRANSCODE_CBOR_H_
+#define POT_BSON_TRANSCODE_CBOR_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include "./common.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace transcode {
+
+namespace cbor {
+
+enum struct Major : uint8_t {
+  Uint = 0,
+  NegInt = 1,
+  Bytes = 2,
+  Text = 3,
+  Array = 4,
+  Map = 5,
+  Tag = 6,
+  Simple = 7,
+};
+
+static constexpr uint8_t kFalse = 0xF4;
+static constexpr uint8_t kTrue = 0xF5;
+static constexpr uint8_t kNull = 0xF6;
+static constexpr uint8_t kFloat64 = 0xFB;
+static constexpr uint8_t kBreak = 0xFF;
+
+// Additional information values of an item's initial byte.
+static constexpr uint8_t kInfo8 = 24;
+static constexpr uint8_t kInfo16 = 25;
+static constexpr uint8_t kInfo32 = 26;
+static constexpr uint8_t kInfo64 = 27;
+static constexpr uint8_t kInfoIndefinite = 31;
+
+/**
+ * Writes an item's head with the shortest argument, or always 8 bytes long
+ * with `wide`.
+ */
+inline void write_head(BufferWriter &writer, const Major major,
+                       const uint64_t arg, const bool wide = false) {
+  uint8_t initial = static_cast<uint8_t>(major) << 5;
+  if (wide) {
+    writer.writeByte(initial | kInfo64);
+    write_be(writer, arg, 8);
+  } else if (arg < kInfo8) {
+    writer.writeByte(initial | static_cast<uint8_t>(arg));
+  } else if (arg <= UINT8_MAX) {
+    writer.writeByte(initial | kInfo8);
+    writer.writeByte(static_cast<uint8_t>(arg));
+  } else if (arg <= UINT16_MAX) {
+    writer.writeByte(initial | kInfo16);
+    write_be(writer, arg, 2);
+  } else if (arg <= UINT32_MAX) {
+    writer.writeByte(initial | kInfo32);
+    write_be(writer, arg, 4);
+  } else {
+    writer.writeByte(initial | kInfo64);
+    write_be(writer, arg, 8);
+  }
+}
+
+inline double half_to_double(const uint16_t half) {
+  int exp = (half >> 10) & 0x1F;
+  double mant = half & 0x3FF;
+  double value = exp == 0    ? std::ldexp(mant, -24)
+                 : exp == 31 ? (mant == 0 ? INFINITY : NAN)
+                             : std::ldexp(mant + 1024, exp - 25);
+  return half & 0x8000 ? -value : value;
+}
+
+} // namespace cbor
+
+/**
+ * Writes a BSON document as CBOR, in one pass plus a skim over each document
+ * or array to count its elements for the head.
+ *
+ * Documents become maps with text keys, arrays become arrays, and every other
+ * element maps to its direct CBOR equivalent. Doubles are always written as
+ * 64-bit floats. Int64 values always take an 8 byte argument and Int32 values
+ * at most 4, so that `cbor_to_bson` gives back the same types. Only generic
+ * binaries can be written. Documents should already have been validated.
+ */
+class BsonToCbor {
+public:
+  BsonToCbor(uint8_t buf[], const size_t len) : writer_(buf, len) {}
+
+  Result transcode(const deserializer::Document &doc) {
+    this->container(doc.getRef(), false);
+    return { this->status_ != Status::Ok ? this->status_
+             : this->writer_.overflowed() ? Status::BufferOverflow
+                                          : Status::Ok,
+             this->writer_.position() };
+  }
+
+private:
+  BufferWriter writer_;
+  Status status_ = Status::Ok;
+
+  void container(const uint8_t doc[], const bool array) {
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);
+    const uint8_t *end = doc + len - static_cast<uint8_t>(TypeSize::Byte);
+    const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);
+
+    cbor::write_head(this->writer_,
+                     array ? cbor::Major::Array : cbor::Major::Map,
+                     count_elements(doc));
+
+    while (cur < end && this->status_ == Status::Ok) {
+      deserializer::DocumentElement el(cur, 0, end - cur);
+      if (!array) {
+        size_t name_len = el.nameSize() - 1;
+        cbor::write_head(this->writer_, cbor::Major::Text, name_len);
+        this->writer_.writeBuf(
+            reinterpret_cast<const uint8_t *>(el.getNameRef()), name_len);
+      }
+
+      this->value(el);
+      cur += el.size();
+    }
+  }
+
+  void value(const deserializer::DocumentElement &el) {
+    switch (el.type()) {
+      case Element::Double:
+        this->writer_.writeByte(cbor::kFloat64);
+        write_be(this->writer_, double_to_bits(el.getDouble()), 8);
+        break;
+      case Element::String:
+        cbor::write_head(this->writer_, cbor::Major::Text, el.getStrLen());
+        this->writer_.writeBuf(
+            reinterpret_cast<const uint8_t *>(el.getStrRef()), el.getStrLen());
+        break;
+      case Element::Document:
+        this->container(el.getDataRef(), false);
+        break;
+      case Element::Array:
+        this->container(el.getDataRef(), true);
+        break;
+      case Element::Binary:
+        if (el.getBinRef()[-1] !=
+            static_cast<uint8_t>(BinaryElementSubtype::Generic)) {
+          this->status_ = Status::Unsupported;
+          return;
+        }
+        cbor::write_head(this->writer_, cbor::Major::Bytes, el.getBinLen());
+        this->writer_.writeBuf(el.getBinRef(), el.getBinLen());
+        break;
+      case Element::Boolean:
+        this->writer_.writeByte(el.getBool() ? cbor::kTrue : cbor::kFalse);
+        break;
+      case Element::Null:
+        this->writer_.writeByte(cbor::kNull);
+        break;
+      case Element::Int32:
+      case Element::Int64: {
+        int64_t value = el.getInt();
+        bool wide = el.type() == Element::Int64;
+        if (value < 0) {
+          cbor::write_head(this->writer_, cbor::Major::NegInt,
+                           static_cast<uint64_t>(-1 - value), wide);
+        } else {
+          cbor::write_head(this->writer_, cbor::Major::Uint,
+                           static_cast<uint64_t>(value), wide);
+        }
+        break;
+      }
+      default:
+        this->status_ = Status::Unsupported;
+        break;
+    }
+  }
+};
+
+/**
+ * Reads CBOR into a BSON document in one pass. The top-level item must be a
+ * map with text keys. Each document's length is written as a placeholder and
+ * patched once its contents are known, as `serializer::Document::end()` does.
+ *
+ * Integers with an 8 byte argument become Int64, and any other integer is an
+ * Int32 if it fits and an Int64 otherwise. Floats of every width become
+ * doubles, and indefinite-length maps and arrays are accepted. Tags,
+ * `undefined`, other simple values and indefinite-length strings aren't
+ * supported.
+ */
+class CborToBson {
+public:
+  CborToBson(uint8_t buf[], const size_t len) : writer_(buf, len) {}
+
+  Result transcode(const uint8_t cbor[], const size_t cbor_len) {
+    Input in(cbor, cbor_len);
+    Head head;
+    if (!this->head(in, head)) {
+      return this->result();
+    }
+
+    if (head.major != cbor::Major::Map) {
+      this->fail(Status::Unsupported);
+    } else if (this->container(in, head, false, 1) && !in.done()) {
+      this->fail(Status::Malformed);
+    }
+    return this->result();
+  }
+
+private:
+  struct Head {
+    cbor::Major major;
+    uint8_t info;
+    uint64_t arg;
+  };
+
+  BufferWriter writer_;
+  Status status_ = Status::Ok;
+
+  bool fail(const Status status) {
+    if (this->status_ == Status::Ok) {
+      this->status_ = status;
+    }
+    return false;
+  }
+
+  Result result() const {
+    return { this->status_ != Status::Ok ? this->status_
+             : this->writer_.overflowed() ? Status::BufferOverflow
+                                          : Status::Ok,
+             this->writer_.position() };
+  }
+
+  bool head(Input &in, Head &head) {
+    if (!in.has(1)) {
+      return this->fail(Status::Malformed);
+    }
+
+    uint8_t initial = *in.take(1);
+    head.major = static_cast<cbor::Major>(initial >> 5);
+    head.info = initial & 0x1F;
+    head.arg = head.info;
+
+    if (head.info == cbor::kInfoIndefinite) {
+      // Only strings and containers have an indefinite length. The break
+      // code is consumed by `container`, so anywhere else it's malformed.
+      return head.major == cbor::Major::Bytes ||
+             head.major == cbor::Major::Text ||
+             head.major == cbor::Major::Array ||
+             head.major == cbor::Major::Map || this->fail(Status::Malformed);
+    } else if (head.info < cbor::kInfo8) {
+      return true;
+    } else if (head.info > cbor::kInfo64) {
+      return this->fail(Status::Malformed);
+    }
+
+    size_t len = static_cast<size_t>(1) << (head.info - cbor::kInfo8);
+    return in.readBE(len, head.arg) || this->fail(Status::Malformed);
+  }
+
+  /**
+   * Reads a map or an array's items into a document whose header has
+   * already been written.
+   */
+  bool container(Input &in, const Head &head, const bool array,
+                 const size_t depth) {
+    if (depth > kTranscodeMaxDepth) {
+      return this->fail(Status::TooDeep);
+    }
+
+    bool indefinite = head.info == cbor::kInfoIndefinite;
+    size_t start = this->writer_.startDoc();
+    char index[kIntKeySize];
+
+    for (uint64_t i = 0; indefinite || i < head.arg; i++) {
+      if (indefinite) {
+        if (!in.has(1)) {
+          return this->fail(Status::Malformed);
+        } else if (in.peek() == cbor::kBreak) {
+          in.take(1);
+          break;
+        }
+      }
+
+      const char *key = index;
+      size_t key_len;
+      if (array) {
+        key_len = format_index(i, index);
+      } else {
+        Head key_head;
+        if (!this->head(in, key_head)) {
+          return false;
+        } else if (key_head.major != cbor::Major::Text ||
+                   key_head.info == cbor::kInfoIndefinite) {
+          return this->fail(Status::Unsupported);
+        } else if (!in.has(key_head.arg)) {
+          return this->fail(Status::Malformed);
+        }
+
+        key = reinterpret_cast<const char *>(in.take(key_head.arg));
+        key_len = key_head.arg;
+        if (!valid_key(key, key_len)) {
+          return this->fail(Status::Unsupported);
+        }
+      }
+
+      if (!this->value(in, key, key_len, depth)) {
+        return false;
+      }
+    }
+
+    this->writer_.endDoc(start);
+    return true;
+  }
+
+  bool value(Input &in, const char key[], const size_t key_len,
+             const size_t depth) {
+    Head head;
+    if (!this->head(in, head)) {
+      return false;
+    }
+
+    bool wide = head.info == cbor::kInfo64;
+    switch (head.major) {
+      case cbor::Major::Uint:
+        if (head.arg > INT64_MAX) {
+          return this->fail(Status::Unsupported);
+        }
+        write_int(this->writer_, key, key_len, static_cast<int64_t>(head.arg),
+                  wide);
+        return true;
+      case cbor::Major::NegInt:
+        if (head.arg > INT64_MAX) {
+          return this->fail(Status::Unsupported);
+        }
+        write_int(this->writer_, key, key_len,
+                  -1 - static_cast<int64_t>(head.arg), wide);
+        return true;
+      case cbor::Major::Bytes:
+      case cbor::Major::Text: {
+        if (head.info == cbor::kInfoIndefinite) {
+          return this->fail(Status::Unsupported);
+        } else if (!in.has(head.arg) || head.arg >= INT32_MAX) {
+          return this->fail(Status::Malformed);
+        }
+
+        const uint8_t *data = in.take(head.arg);
+        if (head.major == cbor::Major::Text) {
+          write_element_header(this->writer_, Element::String, key, key_len);
+          this->writer_.writeInt32(static_cast<int32_t>(head.arg) + 1);
+          this->writer_.writeStr(reinterpret_cast<const char *>(data),
+                                 head.arg);
+        } else {
+          write_element_header(this->writer_, Element::Binary, key, key_len);
+          this->writer_.writeInt32(static_cast<int32_t>(head.arg));
+          this->writer_.writeByte(BinaryElementSubtype::Generic);
+          this->writer_.writeBuf(data, head.arg);
+        }
+        return true;
+      }
+      case cbor::Major::Array:
+      case cbor::Major::Map: {
+        bool array = head.major == cbor::Major::Array;
+        write_element_header(this->writer_,
+                             array ? Element::Array : Element::Document, key,
+                             key_len);
+        return this->container(in, head, array, depth + 1);
+      }
+      case cbor::Major::Simple:
+        return this->simple(head, key, key_len);
+      default:
+        return this->fail(Status::Unsupported);
+    }
+  }
+
+  bool simple(const Head &head, const char key[], const size_t key_len) {
+    uint8_t initial = static_cast<uint8_t>(head.major) << 5 | head.info;
+    switch (initial) {
+      case cbor::kFalse:
+      case cbor::kTrue:
+        write_element_header(this->writer_, Element::Boolean, key, key_len);
+        this->writer_.writeByte(static_cast<uint8_t>(
+            initial == cbor::kTrue ? BooleanElementValue::True
+                                   : BooleanElementValue::False));
+        return true;
+      case cbor::kNull:
+        write_element_header(this->writer_, Element::Null, key, key_len);
+        return true;
+      default:
+        break;
+    }
+
+    double value;
+    switch (head.info) {
+      case cbor::kInfo16:
+        value = cbor::half_to_double(static_cast<uint16_t>(head.arg));
+        break;
+      case cbor::kInfo32:
+        value = bits_to_float(static_cast<uint32_t>(head.arg));
+        break;
+      case cbor::kInfo64:
+        value = bits_to_double(head.arg);
+        break;
+      case cbor::kInfoIndefinite:
+        return this->fail(Status::Malformed);
+      default:
+        return this->fail(Status::Unsupported);
+    }
+
+    write_element_header(this->writer_, Element::Double, key, key_len);
+    this->writer_.writeDouble(value);
+    return true;
+  }
+};
+
+inline Result bson_to_cbor(const deserializer::Document &doc, uint8_t buf[],
+                           const size_t len) {
+  return BsonToCbor(buf, len).transcode(doc);
+}
+
+inline Result cbor_to_bson(const uint8_t cbor[], const size_t cbor_len,
+                           uint8_t buf[], const size_t len) {
+  return CborToBson(buf, len).transcode(cbor, cbor_len);
+}
+
+} // namespace transcode
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef POT_BSON_TRANSCODE_COMMON_H_
+#define POT_BSON_TRANSCODE_COMMON_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace pot {
+namespace bson {
+namespace transcode {
+
+/**
+ * How deeply maps and arrays may be nested in CBOR and MessagePack input.
+ */
+static constexpr size_t kTranscodeMaxDepth = 64;
+
+enum struct Status : uint8_t {
+  Ok,
+  BufferOverflow,
+  // The input is truncated or not well-formed.
+  Malformed,
+  // The input is well-formed but has no BSON equivalent here, e.g. a tag, an
+  // extension type, a non-string key or a binary subtype other than generic.
+  Unsupported,
+  TooDeep,
+};
+
+/**
+ * Like `serializer::Result`, the length is the required length when the
+ * output buffer overflowed.
+ */
+struct Result {
+  Status status;
+  size_t len;
+};
+
+/**
+ * Bounds-checked reads over CBOR or MessagePack input.
+ */
+class Input {
+public:
+  Input(const uint8_t buf[], const size_t len) : cur_(buf), end_(buf + len) {}
+
+  bool done() const {
+    return this->cur_ == this->end_;
+  }
+
+  bool has(const size_t len) const {
+    return static_cast<size_t>(this->end_ - this->cur_) >= len;
+  }
+
+  uint8_t peek() const {
+    return *this->cur_;
+  }
+
+  /**
+   * Returns the next `len` bytes and moves past them. Check `has` first.
+   */
+  const uint8_t *take(const size_t len) {
+    const uint8_t *start = this->cur_;
+    this->cur_ += len;
+    return start;
+  }
+
+  /**
+   * Reads a big-endian unsigned integer of `len` bytes.
+   */
+  bool readBE(const size_t len, uint64_t &out) {
+    if (!this->has(len)) {
+      return false;
+    }
+
+    out = 0;
+    for (size_t i = 0; i < len; i++) {
+      out = out << 8 | this->cur_[i];
+    }
+    this->cur_ += len;
+    return true;
+  }
+
+private:
+  const uint8_t *cur_;
+  const uint8_t *end_;
+};
+
+inline void write_be(BufferWriter &writer, const uint64_t value,
+                     const size_t len) {
+  uint8_t buf[static_cast<size_t>(TypeSize::Uint64)];
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = static_cast<uint8_t>(value >> (8 * (len - 1 - i)));
+  }
+  writer.writeBuf(buf, len);
+}
+
+inline uint64_t double_to_bits(const double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline double bits_to_double(const uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline double bits_to_float(const uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * The number of elements in a BSON document or array, found by skipping
+ * over them.
+ */
+inline size_t count_elements(const uint8_t doc[]) {
+  int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);
+  const uint8_t *end = doc + len - static_cast<uint8_t>(TypeSize::Byte);
+  const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);
+
+  size_t count = 0;
+  while (cur < end) {
+    cur += deserializer::DocumentElement(cur, 0, end - cur).size();
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Whether a CBOR or MessagePack key can be a BSON key, which can't hold null
+ * characters.
+ */
+inline bool valid_key(const char key[], const size_t key_len) {
+  return memchr(key, '\0', key_len) == nullptr;
+}
+
+/**
+ * Writes the type and key of a BSON element.
+ */
+inline void write_element_header(BufferWriter &writer, const Element type,
+                                 const char key[], const size_t key_len) {
+  writer.writeByte(type);
+  writer.writeStr(key, key_len);
+}
+
+/**
+ * Formats an array index as its BSON key. Returns the key's length.
+ */
+inline size_t format_index(size_t index, char key[]) {
+  char tmp[kIntKeySize];
+  size_t pos = kIntKeySize;
+  do {
+    tmp[--pos] = static_cast<char>('0' + index % 10);
+    index /= 10;
+  } while (index > 0);
+
+  memcpy(key, &tmp[pos], kIntKeySize - pos);
+  return kIntKeySize - pos;
+}
+
+inline void write_int(BufferWriter &writer, const char key[],
+                      const size_t key_len, const int64_t value,
+                      const bool int64) {
+  if (!int64 && value >= INT32_MIN && value <= INT32_MAX) {
+    write_element_header(writer, Element::Int32, key, key_len);
+    writer.writeInt32(static_cast<int32_t>(value));
+  } else {
+    write_element_header(writer, Element::Int64, key, key_len);
+    writer.writeInt64(value);
+  }
+}
+
+} // namespace transcode
+} // namespace bson
+} // namespace pot
+
+#endif
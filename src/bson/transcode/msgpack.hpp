@@ -0,0 +1,454 @@
+#ifndef POT_BSON_TRANSCODE_MSGPACK_H_
+#define POT_BSON_TRANSCODE_MSGPACK_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_element.hpp"
+#include "../endian.hpp"
+#include "./common.hpp"
+#include <cstdint>
+#include <cstdlib>
+
+namespace pot {
+namespace bson {
+namespace transcode {
+
+namespace msgpack {
+
+static constexpr uint8_t kFixMap = 0x80;
+static constexpr uint8_t kFixArray = 0x90;
+static constexpr uint8_t kFixStr = 0xA0;
+static constexpr uint8_t kNil = 0xC0;
+static constexpr uint8_t kFalse = 0xC2;
+static constexpr uint8_t kTrue = 0xC3;
+static constexpr uint8_t kBin8 = 0xC4;
+static constexpr uint8_t kBin16 = 0xC5;
+static constexpr uint8_t kBin32 = 0xC6;
+static constexpr uint8_t kFloat32 = 0xCA;
+static constexpr uint8_t kFloat64 = 0xCB;
+static constexpr uint8_t kUint8 = 0xCC;
+static constexpr uint8_t kUint16 = 0xCD;
+static constexpr uint8_t kUint32 = 0xCE;
+static constexpr uint8_t kUint64 = 0xCF;
+static constexpr uint8_t kInt8 = 0xD0;
+static constexpr uint8_t kInt16 = 0xD1;
+static constexpr uint8_t kInt32 = 0xD2;
+static constexpr uint8_t kInt64 = 0xD3;
+static constexpr uint8_t kStr8 = 0xD9;
+static constexpr uint8_t kStr16 = 0xDA;
+static constexpr uint8_t kStr32 = 0xDB;
+static constexpr uint8_t kArray16 = 0xDC;
+static constexpr uint8_t kArray32 = 0xDD;
+static constexpr uint8_t kMap16 = 0xDE;
+static constexpr uint8_t kMap32 = 0xDF;
+static constexpr uint8_t kNegFixInt = 0xE0;
+
+/**
+ * Writes a length with the shortest of the fix form, the 8, 16 or 32-bit
+ * form. `fix` and `type8` are 0 for types without those forms, and the
+ * 32-bit form always follows `type16`.
+ */
+inline void write_len(BufferWriter &writer, const size_t len,
+                      const uint8_t fix, const size_t fix_max,
+                      const uint8_t type8, const uint8_t type16) {
+  if (fix != 0 && len <= fix_max) {
+    writer.writeByte(static_cast<uint8_t>(fix | len));
+  } else if (type8 != 0 && len <= UINT8_MAX) {
+    writer.writeByte(type8);
+    writer.writeByte(static_cast<uint8_t>(len));
+  } else if (len <= UINT16_MAX) {
+    writer.writeByte(type16);
+    write_be(writer, len, 2);
+  } else {
+    writer.writeByte(type16 + 1);
+    write_be(writer, len, 4);
+  }
+}
+
+} // namespace msgpack
+
+/**
+ * Writes a BSON document as MessagePack, in one pass plus a skim over each
+ * document or array to count its elements for the header.
+ *
+ * Documents become maps with string keys, arrays become arrays, and every
+ * other element maps to its direct MessagePack equivalent. Doubles are
+ * always written as float 64. Int64 values are always written as int 64 and
+ * Int32 values in the shortest signed form, so that `msgpack_to_bson` gives
+ * back the same types. Only generic binaries can be written. Documents
+ * should already have been validated.
+ */
+class BsonToMsgPack {
+public:
+  BsonToMsgPack(uint8_t buf[], const size_t len) : writer_(buf, len) {}
+
+  Result transcode(const deserializer::Document &doc) {
+    this->container(doc.getRef(), false);
+    return { this->status_ != Status::Ok ? this->status_
+             : this->writer_.overflowed() ? Status::BufferOverflow
+                                          : Status::Ok,
+             this->writer_.position() };
+  }
+
+private:
+  BufferWriter writer_;
+  Status status_ = Status::Ok;
+
+  void container(const uint8_t doc[], const bool array) {
+    int32_t len = endian::buffer_to_primitive<int32_t, TypeSize::Int32>(doc, 0);
+    const uint8_t *end = doc + len - static_cast<uint8_t>(TypeSize::Byte);
+    const uint8_t *cur = doc + static_cast<uint8_t>(TypeSize::Int32);
+
+    if (array) {
+      msgpack::write_len(this->writer_, count_elements(doc),
+                         msgpack::kFixArray, 15, 0, msgpack::kArray16);
+    } else {
+      msgpack::write_len(this->writer_, count_elements(doc), msgpack::kFixMap,
+                         15, 0, msgpack::kMap16);
+    }
+
+    while (cur < end && this->status_ == Status::Ok) {
+      deserializer::DocumentElement el(cur, 0, end - cur);
+      if (!array) {
+        this->str(el.getNameRef(), el.nameSize() - 1);
+      }
+
+      this->value(el);
+      cur += el.size();
+    }
+  }
+
+  void str(const char str[], const size_t len) {
+    msgpack::write_len(this->writer_, len, msgpack::kFixStr, 31,
+                       msgpack::kStr8, msgpack::kStr16);
+    this->writer_.writeBuf(reinterpret_cast<const uint8_t *>(str), len);
+  }
+
+  void value(const deserializer::DocumentElement &el) {
+    switch (el.type()) {
+      case Element::Double:
+        this->writer_.writeByte(msgpack::kFloat64);
+        write_be(this->writer_, double_to_bits(el.getDouble()), 8);
+        break;
+      case Element::String:
+        this->str(el.getStrRef(), el.getStrLen());
+        break;
+      case Element::Document:
+        this->container(el.getDataRef(), false);
+        break;
+      case Element::Array:
+        this->container(el.getDataRef(), true);
+        break;
+      case Element::Binary:
+        if (el.getBinRef()[-1] !=
+            static_cast<uint8_t>(BinaryElementSubtype::Generic)) {
+          this->status_ = Status::Unsupported;
+          return;
+        }
+        msgpack::write_len(this->writer_, el.getBinLen(), 0, 0,
+                           msgpack::kBin8, msgpack::kBin16);
+        this->writer_.writeBuf(el.getBinRef(), el.getBinLen());
+        break;
+      case Element::Boolean:
+        this->writer_.writeByte(el.getBool() ? msgpack::kTrue
+                                             : msgpack::kFalse);
+        break;
+      case Element::Null:
+        this->writer_.writeByte(msgpack::kNil);
+        break;
+      case Element::Int32:
+        this->int32(el.getInt32());
+        break;
+      case Element::Int64:
+        this->writer_.writeByte(msgpack::kInt64);
+        write_be(this->writer_, static_cast<uint64_t>(el.getInt64()), 8);
+        break;
+      default:
+        this->status_ = Status::Unsupported;
+        break;
+    }
+  }
+
+  void int32(const int32_t value) {
+    if (value >= -32 && value <= INT8_MAX) {
+      this->writer_.writeByte(static_cast<uint8_t>(value));
+    } else if (value >= INT8_MIN && value <= INT8_MAX) {
+      this->writer_.writeByte(msgpack::kInt8);
+      this->writer_.writeByte(static_cast<uint8_t>(value));
+    } else if (value >= INT16_MIN && value <= INT16_MAX) {
+      this->writer_.writeByte(msgpack::kInt16);
+      write_be(this->writer_, static_cast<uint16_t>(value), 2);
+    } else {
+      this->writer_.writeByte(msgpack::kInt32);
+      write_be(this->writer_, static_cast<uint32_t>(value), 4);
+    }
+  }
+};
+
+/**
+ * Reads MessagePack into a BSON document in one pass. The top-level value
+ * must be a map with string keys. Each document's length is written as a
+ * placeholder and patched once its contents are known, as
+ * `serializer::Document::end()` does.
+ *
+ * int 64 and uint 64 values become Int64, and any other integer is an Int32
+ * if it fits and an Int64 otherwise. float 32 values become doubles.
+ * Extension types aren't supported.
+ */
+class MsgPackToBson {
+public:
+  MsgPackToBson(uint8_t buf[], const size_t len) : writer_(buf, len) {}
+
+  Result transcode(const uint8_t msgpack[], const size_t msgpack_len) {
+    Input in(msgpack, msgpack_len);
+    if (!in.has(1)) {
+      this->fail(Status::Malformed);
+      return this->result();
+    }
+
+    uint8_t type = *in.take(1);
+    size_t count;
+    if (!this->mapLen(in, type, count)) {
+      this->fail(Status::Unsupported);
+    } else if (this->container(in, count, false, 1) && !in.done()) {
+      this->fail(Status::Malformed);
+    }
+    return this->result();
+  }
+
+private:
+  BufferWriter writer_;
+  Status status_ = Status::Ok;
+
+  bool fail(const Status status) {
+    if (this->status_ == Status::Ok) {
+      this->status_ = status;
+    }
+    return false;
+  }
+
+  Result result() const {
+    return { this->status_ != Status::Ok ? this->status_
+             : this->writer_.overflowed() ? Status::BufferOverflow
+                                          : Status::Ok,
+             this->writer_.position() };
+  }
+
+  /**
+   * Reads the length of a map whose type byte was `type`. Returns false,
+   * without failing, if it isn't a map.
+   */
+  bool mapLen(Input &in, const uint8_t type, size_t &count) {
+    uint64_t len = type & 0x0F;
+    if (type == msgpack::kMap16 && !in.readBE(2, len)) {
+      return this->fail(Status::Malformed);
+    } else if (type == msgpack::kMap32 && !in.readBE(4, len)) {
+      return this->fail(Status::Malformed);
+    } else if ((type & 0xF0) != msgpack::kFixMap && type != msgpack::kMap16 &&
+               type != msgpack::kMap32) {
+      return false;
+    }
+
+    count = len;
+    return true;
+  }
+
+  /**
+   * Reads `count` entries of a map or items of an array into a document
+   * whose header has already been written.
+   */
+  bool container(Input &in, const size_t count, const bool array,
+                 const size_t depth) {
+    if (depth > kTranscodeMaxDepth) {
+      return this->fail(Status::TooDeep);
+    }
+
+    size_t start = this->writer_.startDoc();
+    char index[kIntKeySize];
+
+    for (size_t i = 0; i < count; i++) {
+      const char *key = index;
+      size_t key_len;
+      if (array) {
+        key_len = format_index(i, index);
+      } else if (!this->key(in, key, key_len)) {
+        return false;
+      }
+
+      if (!this->value(in, key, key_len, depth)) {
+        return false;
+      }
+    }
+
+    this->writer_.endDoc(start);
+    return true;
+  }
+
+  bool key(Input &in, const char *&key, size_t &key_len) {
+    if (!in.has(1)) {
+      return this->fail(Status::Malformed);
+    }
+
+    uint8_t type = *in.take(1);
+    uint64_t len;
+    if ((type & 0xE0) == msgpack::kFixStr) {
+      len = type & 0x1F;
+    } else if (type >= msgpack::kStr8 && type <= msgpack::kStr32) {
+      if (!in.readBE(static_cast<size_t>(1) << (type - msgpack::kStr8), len)) {
+        return this->fail(Status::Malformed);
+      }
+    } else {
+      return this->fail(Status::Unsupported);
+    }
+
+    if (!in.has(len)) {
+      return this->fail(Status::Malformed);
+    }
+
+    key = reinterpret_cast<const char *>(in.take(len));
+    key_len = len;
+    return valid_key(key, key_len) || this->fail(Status::Unsupported);
+  }
+
+  bool value(Input &in, const char key[], const size_t key_len,
+             const size_t depth) {
+    if (!in.has(1)) {
+      return this->fail(Status::Malformed);
+    }
+
+    uint8_t type = *in.take(1);
+    if (type <= INT8_MAX || type >= msgpack::kNegFixInt) {
+      write_int(this->writer_, key, key_len, static_cast<int8_t>(type), false);
+      return true;
+    } else if ((type & 0xE0) == msgpack::kFixStr) {
+      return this->bytes(in, type & 0x1F, true, key, key_len);
+    } else if ((type & 0xF0) == msgpack::kFixArray) {
+      write_element_header(this->writer_, Element::Array, key, key_len);
+      return this->container(in, type & 0x0F, true, depth + 1);
+    }
+
+    size_t count;
+    if (this->mapLen(in, type, count)) {
+      write_element_header(this->writer_, Element::Document, key, key_len);
+      return this->container(in, count, false, depth + 1);
+    } else if (this->status_ != Status::Ok) {
+      return false;
+    }
+
+    uint64_t arg;
+    switch (type) {
+      case msgpack::kNil:
+        write_element_header(this->writer_, Element::Null, key, key_len);
+        return true;
+      case msgpack::kFalse:
+      case msgpack::kTrue:
+        write_element_header(this->writer_, Element::Boolean, key, key_len);
+        this->writer_.writeByte(static_cast<uint8_t>(
+            type == msgpack::kTrue ? BooleanElementValue::True
+                                   : BooleanElementValue::False));
+        return true;
+      case msgpack::kBin8:
+      case msgpack::kBin16:
+      case msgpack::kBin32:
+      case msgpack::kStr8:
+      case msgpack::kStr16:
+      case msgpack::kStr32: {
+        bool str = type >= msgpack::kStr8;
+        uint8_t width = type - (str ? msgpack::kStr8 : msgpack::kBin8);
+        if (!in.readBE(static_cast<size_t>(1) << width, arg)) {
+          return this->fail(Status::Malformed);
+        }
+        return this->bytes(in, arg, str, key, key_len);
+      }
+      case msgpack::kArray16:
+      case msgpack::kArray32:
+        if (!in.readBE(type == msgpack::kArray16 ? 2 : 4, arg)) {
+          return this->fail(Status::Malformed);
+        }
+        write_element_header(this->writer_, Element::Array, key, key_len);
+        return this->container(in, arg, true, depth + 1);
+      case msgpack::kFloat32:
+      case msgpack::kFloat64: {
+        bool wide = type == msgpack::kFloat64;
+        if (!in.readBE(wide ? 8 : 4, arg)) {
+          return this->fail(Status::Malformed);
+        }
+        write_element_header(this->writer_, Element::Double, key, key_len);
+        this->writer_.writeDouble(
+            wide ? bits_to_double(arg)
+                 : bits_to_float(static_cast<uint32_t>(arg)));
+        return true;
+      }
+      case msgpack::kUint8:
+      case msgpack::kUint16:
+      case msgpack::kUint32:
+      case msgpack::kUint64:
+        if (!in.readBE(static_cast<size_t>(1) << (type - msgpack::kUint8),
+                       arg)) {
+          return this->fail(Status::Malformed);
+        } else if (arg > INT64_MAX) {
+          return this->fail(Status::Unsupported);
+        }
+        write_int(this->writer_, key, key_len, static_cast<int64_t>(arg),
+                  type == msgpack::kUint64);
+        return true;
+      case msgpack::kInt8:
+      case msgpack::kInt16:
+      case msgpack::kInt32:
+      case msgpack::kInt64: {
+        size_t width = static_cast<size_t>(1) << (type - msgpack::kInt8);
+        if (!in.readBE(width, arg)) {
+          return this->fail(Status::Malformed);
+        }
+        // Sign-extend from the value's width.
+        size_t shift = 64 - 8 * width;
+        int64_t value = static_cast<int64_t>(arg << shift) >> shift;
+        write_int(this->writer_, key, key_len, value,
+                  type == msgpack::kInt64);
+        return true;
+      }
+      default:
+        // 0xC1 is never used, the rest are extension types.
+        return this->fail(type == 0xC1 ? Status::Malformed
+                                       : Status::Unsupported);
+    }
+  }
+
+  bool bytes(Input &in, const uint64_t len, const bool str, const char key[],
+             const size_t key_len) {
+    if (!in.has(len) || len >= INT32_MAX) {
+      return this->fail(Status::Malformed);
+    }
+
+    const uint8_t *data = in.take(len);
+    if (str) {
+      write_element_header(this->writer_, Element::String, key, key_len);
+      this->writer_.writeInt32(static_cast<int32_t>(len) + 1);
+      this->writer_.writeStr(reinterpret_cast<const char *>(data), len);
+    } else {
+      write_element_header(this->writer_, Element::Binary, key, key_len);
+      this->writer_.writeInt32(static_cast<int32_t>(len));
+      this->writer_.writeByte(BinaryElementSubtype::Generic);
+      this->writer_.writeBuf(data, len);
+    }
+    return true;
+  }
+};
+
+inline Result bson_to_msgpack(const deserializer::Document &doc,
+                              uint8_t buf[], const size_t len) {
+  return BsonToMsgPack(buf, len).transcode(doc);
+}
+
+inline Result msgpack_to_bson(const uint8_t msgpack[],
+                              const size_t msgpack_len, uint8_t buf[],
+                              const size_t len) {
+  return MsgPackToBson(buf, len).transcode(msgpack, msgpack_len);
+}
+
+} // namespace transcode
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,628 @@
+#ifndef POT_BSON_UPDATE_UPDATE_H_
+#define POT_BSON_UPDATE_UPDATE_H_
+
+#include "../buffer_writer.hpp"
+#include "../consts.hpp"
+#include "../deserializer/array.hpp"
+#include "../deserializer/array_iter.hpp"
+#include "../deserializer/document.hpp"
+#include "../deserializer/document_iter.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace pot {
+namespace bson {
+namespace update {
+
+enum struct Status {
+  /**
+   * The update was applied without errors.
+   */
+  Ok,
+  /**
+   * The updated document would have overflowed the output buffer. The length
+   * in the result is still accurate and can be used to size a new buffer.
+   */
+  BufferOverflow,
+  /**
+   * One of the operations could not be applied to the source document, e.g.
+   * incrementing a string, an integer increment that overflows Int64, pushing
+   * to a non-array or two operations on overlapping paths. The output buffer
+   * is left in an invalid state.
+   */
+  InvalidOperation,
+};
+
+struct Result {
+  Status status;
+  size_t len;
+};
+
+enum struct Operator : uint8_t {
+  Set,
+  Unset,
+  Inc,
+  Push,
+};
+
+/**
+ * A value to be written by an operation. Strings, binaries, documents and
+ * arrays reference caller-owned data, which has to outlive the call to
+ * `apply`.
+ */
+struct Value {
+  Element type;
+  double dbl;
+  int64_t integer;
+  const uint8_t *data;
+  size_t len;
+
+  static Value ofDouble(const double value) {
+    return { Element::Double, value, 0, nullptr, 0 };
+  }
+
+  static Value ofStr(const char str[]) {
+    return { Element::String, 0, 0, reinterpret_cast<const uint8_t *>(str),
+             strlen(str) };
+  }
+
+  static Value ofDoc(const deserializer::Document &doc) {
+    return { Element::Document, 0, 0, doc.getRef(),
+             static_cast<size_t>(doc.len()) };
+  }
+
+  static Value ofArr(const deserializer::Array &arr) {
+    return { Element::Array, 0, 0, arr.getRef(),
+             static_cast<size_t>(arr.len()) };
+  }
+
+  static Value ofBin(const uint8_t buf[], const size_t len) {
+    return { Element::Binary, 0, 0, buf, len };
+  }
+
+  static Value ofBool(const bool value) {
+    return { Element::Boolean, 0, value ? 1 : 0, nullptr, 0 };
+  }
+
+  static Value ofNull() {
+    return { Element::Null, 0, 0, nullptr, 0 };
+  }
+
+  static Value ofInt32(const int32_t value) {
+    return { Element::Int32, 0, value, nullptr, 0 };
+  }
+
+  static Value ofInt64(const int64_t value) {
+    return { Element::Int64, 0, value, nullptr, 0 };
+  }
+
+  bool isNumber() const {
+    return this->type == Element::Int32 || this->type == Element::Int64 ||
+           this->type == Element::Double;
+  }
+};
+
+/**
+ * A single update operation. Paths are dot separated, e.g. "state.led.on",
+ * and array elements are addressed by their index.
+ *
+ * - Set replaces the value at the path, creating it (and any missing parent
+ *   documents) if it doesn't exist.
+ * - Unset removes the element at the path. Array elements are set to null
+ *   instead so that the remaining indices stay intact.
+ * - Inc adds a numeric value to the element at the path, promoting to Int64
+ *   on Int32 overflow and to Double if either side is a double. A missing
+ *   element is set to the value.
+ * - Push appends a value to the array at the path, creating the array if it
+ *   doesn't exist.
+ */
+struct Operation {
+  Operator op;
+  const char *path;
+  Value value;
+
+  static Operation set(const char path[], const Value value) {
+    return { Operator::Set, path, value };
+  }
+
+  static Operation unset(const char path[]) {
+    return { Operator::Unset, path, Value::ofNull() };
+  }
+
+  static Operation inc(const char path[], const Value value) {
+    return { Operator::Inc, path, value };
+  }
+
+  static Operation push(const char path[], const Value value) {
+    return { Operator::Push, path, value };
+  }
+};
+
+inline size_t path_component_len(const char path[]) {
+  size_t len = 0;
+  while (path[len] != '\0' && path[len] != '.') {
+    len++;
+  }
+
+  return len;
+}
+
+/**
+ * Applies a list of operations to a source document, writing the result to
+ * `out` in a single forward pass. Untouched runs of elements are copied as-is
+ * and the length of every document along a modified path is rewritten.
+ */
+class Updater {
+public:
+  Updater(const Operation ops[], const size_t ops_len, uint8_t out[],
+          const size_t out_len) :
+      ops_(ops),
+      ops_len_(ops_len), writer_(out, out_len) {}
+
+  Result apply(const deserializer::Document &src) {
+    Result res;
+
+    if (!this->validOps() || !this->writeDoc(&src, "", 0, false)) {
+      res.status = Status::InvalidOperation;
+      res.len = 0;
+      return res;
+    }
+
+    res.len = this->writer_.position();
+    res.status =
+        this->writer_.overflowed() ? Status::BufferOverflow : Status::Ok;
+    return res;
+  }
+
+private:
+  const Operation *ops_;
+  size_t ops_len_;
+  BufferWriter writer_;
+
+  static bool validValue(const Value &value) {
+    switch (value.type) {
+      case Element::Double:
+      case Element::String:
+      case Element::Document:
+      case Element::Array:
+      case Element::Binary:
+      case Element::Boolean:
+      case Element::Null:
+      case Element::Int32:
+      case Element::Int64:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  static bool validPath(const char path[]) {
+    size_t i = 0;
+    while (true) {
+      size_t len = path_component_len(&path[i]);
+      if (len == 0) {
+        return false;
+      }
+
+      i += len;
+      if (path[i] == '\0') {
+        return true;
+      }
+      i++;
+    }
+  }
+
+  /**
+   * Checks that every path is well formed and that no path is equal to, or a
+   * parent of, another one.
+   */
+  bool validOps() const {
+    for (size_t i = 0; i < this->ops_len_; i++) {
+      const Operation &op = this->ops_[i];
+      if (!validPath(op.path)) {
+        return false;
+      }
+
+      if (op.op != Operator::Unset && !validValue(op.value)) {
+        return false;
+      }
+
+      if (op.op == Operator::Inc && !op.value.isNumber()) {
+        return false;
+      }
+
+      size_t len = strlen(op.path);
+      for (size_t j = i + 1; j < this->ops_len_; j++) {
+        const char *other = this->ops_[j].path;
+        size_t other_len = strlen(other);
+        size_t common = len < other_len ? len : other_len;
+
+        if (strncmp(op.path, other, common) != 0) {
+          continue;
+        }
+
+        if (len == other_len || (len < other_len && other[len] == '.') ||
+            (other_len < len && op.path[other_len] == '.')) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  bool isRelevant(const Operation &op, const char prefix[],
+                  const size_t prefix_len) const {
+    return strncmp(op.path, prefix, prefix_len) == 0;
+  }
+
+  /**
+   * Whether every operation at or below the first `len` characters of `path`
+   * is an unset.
+   */
+  bool unsetsOnly(const char path[], const size_t len) const {
+    for (size_t i = 0; i < this->ops_len_; i++) {
+      const Operation &op = this->ops_[i];
+      if (this->isRelevant(op, path, len) &&
+          (op.path[len] == '.' || op.path[len] == '\0') &&
+          op.op != Operator::Unset) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Returns the first operation whose next path component is the element's
+   * name, and counts how many operations share that component.
+   */
+  const Operation *match(const deserializer::DocumentElement &el,
+                         const char prefix[], const size_t prefix_len,
+                         size_t &count) const {
+    const Operation *found = nullptr;
+    const char *name = el.getNameRef();
+    size_t name_len = el.nameSize() - 1;
+
+    for (size_t i = 0; i < this->ops_len_; i++) {
+      const Operation &op = this->ops_[i];
+      if (!this->isRelevant(op, prefix, prefix_len)) {
+        continue;
+      }
+
+      const char *rest = op.path + prefix_len;
+      if (path_component_len(rest) != name_len ||
+          memcmp(rest, name, name_len) != 0) {
+        continue;
+      }
+
+      count++;
+      if (found == nullptr) {
+        found = &op;
+      }
+    }
+
+    return found;
+  }
+
+  size_t relevantCount(const char prefix[], const size_t prefix_len) const {
+    size_t count = 0;
+    for (size_t i = 0; i < this->ops_len_; i++) {
+      if (this->isRelevant(this->ops_[i], prefix, prefix_len)) {
+        count++;
+      }
+    }
+
+    return count;
+  }
+
+  void flush(const uint8_t *&run, size_t &run_len) {
+    if (run_len > 0) {
+      this->writer_.writeBuf(run, run_len);
+    }
+
+    run = nullptr;
+    run_len = 0;
+  }
+
+  bool writeDoc(const deserializer::Document *src, const char prefix[],
+                const size_t prefix_len, const bool is_array) {
+    size_t pos = this->writer_.startDoc();
+    size_t index = 0;
+    size_t matched = 0;
+
+    if (src != nullptr) {
+      const uint8_t *run = nullptr;
+      size_t run_len = 0;
+
+      for (auto const &el : *src) {
+        index++;
+
+        const Operation *op = this->match(el, prefix, prefix_len, matched);
+        if (op == nullptr) {
+          if (run == nullptr) {
+            run = el.getRef();
+          }
+          run_len += el.size();
+          continue;
+        }
+
+        this->flush(run, run_len);
+        if (!this->writeMatched(el, *op, prefix_len, is_array)) {
+          return false;
+        }
+      }
+
+      this->flush(run, run_len);
+    }
+
+    if (matched < this->relevantCount(prefix, prefix_len) &&
+        !this->writeMissing(src, prefix, prefix_len, is_array, index)) {
+      return false;
+    }
+
+    this->writer_.endDoc(pos);
+    return true;
+  }
+
+  bool writeMatched(const deserializer::DocumentElement &el,
+                    const Operation &op, const size_t prefix_len,
+                    const bool is_array) {
+    const char *name = el.getNameRef();
+    size_t name_len = el.nameSize() - 1;
+    Element type = el.type();
+
+    if (op.path[prefix_len + name_len] == '.') {
+      // The operation targets a descendant of this element.
+      if (type != Element::Document && type != Element::Array) {
+        // Nothing below a scalar to unset, so that's a no-op like a missing
+        // path, but anything else through it can't be applied.
+        if (!this->unsetsOnly(op.path, prefix_len + name_len)) {
+          return false;
+        }
+
+        this->writer_.writeBuf(el.getRef(), el.size());
+        return true;
+      }
+
+      this->writer_.writeByte(type);
+      this->writer_.writeStr(name, name_len);
+
+      deserializer::Document child =
+          type == Element::Document ? el.getDoc() : el.getArr();
+      return this->writeDoc(&child, op.path, prefix_len + name_len + 1,
+                            type == Element::Array);
+    }
+
+    switch (op.op) {
+      case Operator::Set: {
+        this->writeElement(op.value, name, name_len);
+        return true;
+      }
+      case Operator::Unset: {
+        if (is_array) {
+          this->writeElement(Value::ofNull(), name, name_len);
+        }
+        return true;
+      }
+      case Operator::Inc: {
+        if (!el.isNumber()) {
+          return false;
+        }
+
+        Value sum;
+        if (!this->add(el, op.value, sum)) {
+          return false;
+        }
+        this->writeElement(sum, name, name_len);
+        return true;
+      }
+      case Operator::Push: {
+        if (type != Element::Array) {
+          return false;
+        }
+
+        this->writer_.writeByte(Element::Array);
+        this->writer_.writeStr(name, name_len);
+        this->writePush(el.getArr(), op.value);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool hasComponent(const deserializer::Document *src, const char name[],
+                    const size_t name_len) const {
+    if (src == nullptr) {
+      return false;
+    }
+
+    for (auto const &el : *src) {
+      if (el.nameSize() - 1 == name_len &&
+          memcmp(el.getNameRef(), name, name_len) == 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool createdBefore(const size_t index, const char prefix[],
+                     const size_t prefix_len, const char name[],
+                     const size_t name_len) const {
+    for (size_t i = 0; i < index; i++) {
+      const Operation &op = this->ops_[i];
+      if (op.op == Operator::Unset ||
+          !this->isRelevant(op, prefix, prefix_len)) {
+        continue;
+      }
+
+      const char *rest = op.path + prefix_len;
+      if (path_component_len(rest) == name_len &&
+          memcmp(rest, name, name_len) == 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * Appends elements for operations whose paths don't exist in the source.
+   * Unsetting a missing path is a no-op, so it never creates anything.
+   */
+  bool writeMissing(const deserializer::Document *src, const char prefix[],
+                    const size_t prefix_len, const bool is_array,
+                    size_t index) {
+    for (size_t i = 0; i < this->ops_len_; i++) {
+      const Operation &op = this->ops_[i];
+      if (op.op == Operator::Unset ||
+          !this->isRelevant(op, prefix, prefix_len)) {
+        continue;
+      }
+
+      const char *name = op.path + prefix_len;
+      size_t name_len = path_component_len(name);
+      if (this->hasComponent(src, name, name_len) ||
+          this->createdBefore(i, prefix, prefix_len, name, name_len)) {
+        continue;
+      }
+
+      if (is_array) {
+        // Arrays can only grow by one element at a time.
+        char key[kIntKeySize];
+        size_t key_len = convert_int_key_to_str(index++, key);
+        if (key_len != name_len || memcmp(key, name, name_len) != 0) {
+          return false;
+        }
+      }
+
+      if (name[name_len] == '.') {
+        this->writer_.writeByte(Element::Document);
+        this->writer_.writeStr(name, name_len);
+        if (!this->writeDoc(nullptr, op.path, prefix_len + name_len + 1,
+                            false)) {
+          return false;
+        }
+      } else if (op.op == Operator::Push) {
+        this->writer_.writeByte(Element::Array);
+        this->writer_.writeStr(name, name_len);
+        size_t pos = this->writer_.startDoc();
+        this->writeElement(op.value, "0", 1);
+        this->writer_.endDoc(pos);
+      } else {
+        this->writeElement(op.value, name, name_len);
+      }
+    }
+
+    return true;
+  }
+
+  void writePush(const deserializer::Array &arr, const Value &value) {
+    size_t count = 0;
+    for (auto const &el : arr) {
+      (void)el;
+      count++;
+    }
+
+    size_t pos = this->writer_.startDoc();
+
+    // Copy the existing elements, excluding the length and terminator.
+    this->writer_.writeBuf(arr.getRef() + static_cast<uint8_t>(TypeSize::Int32),
+                           arr.len() - static_cast<uint8_t>(TypeSize::Int32) -
+                               static_cast<uint8_t>(TypeSize::Byte));
+
+    char key[kIntKeySize];
+    size_t key_len = convert_int_key_to_str(count, key);
+    this->writeElement(value, key, key_len);
+
+    this->writer_.endDoc(pos);
+  }
+
+  /**
+   * Returns false if an integer sum doesn't fit in an Int64, like MongoDB,
+   * rather than silently wrapping or losing precision as a Double.
+   */
+  bool add(const deserializer::DocumentElement &el, const Value &inc,
+           Value &out) const {
+    if (el.type() == Element::Double || inc.type == Element::Double) {
+      double rhs = inc.type == Element::Double ? inc.dbl : inc.integer;
+      out = Value::ofDouble(el.getNumber() + rhs);
+      return true;
+    }
+
+    int64_t sum;
+    if (__builtin_add_overflow(el.getInt(), inc.integer, &sum)) {
+      return false;
+    }
+
+    if (el.type() == Element::Int32 && inc.type == Element::Int32 &&
+        sum >= std::numeric_limits<int32_t>::min() &&
+        sum <= std::numeric_limits<int32_t>::max()) {
+      out = Value::ofInt32(sum);
+    } else {
+      out = Value::ofInt64(sum);
+    }
+    return true;
+  }
+
+  void writeElement(const Value &value, const char name[],
+                    const size_t name_len) {
+    this->writer_.writeByte(value.type);
+    this->writer_.writeStr(name, name_len);
+
+    switch (value.type) {
+      case Element::Double: {
+        this->writer_.writeDouble(value.dbl);
+        break;
+      }
+      case Element::String: {
+        this->writer_.writeInt32(value.len + 1);
+        this->writer_.writeStr(reinterpret_cast<const char *>(value.data),
+                               value.len);
+        break;
+      }
+      case Element::Document:
+      case Element::Array: {
+        this->writer_.writeBuf(value.data, value.len);
+        break;
+      }
+      case Element::Binary: {
+        this->writer_.writeInt32(value.len);
+        this->writer_.writeByte(BinaryElementSubtype::Generic);
+        this->writer_.writeBuf(value.data, value.len);
+        break;
+      }
+      case Element::Boolean: {
+        this->writer_.writeByte(static_cast<uint8_t>(
+            value.integer ? BooleanElementValue::True
+                          : BooleanElementValue::False));
+        break;
+      }
+      case Element::Int32: {
+        this->writer_.writeInt32(value.integer);
+        break;
+      }
+      case Element::Int64: {
+        this->writer_.writeInt64(value.integer);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+};
+
+inline Result apply(const deserializer::Document &src, const Operation ops[],
+                    const size_t ops_len, uint8_t out[], const size_t out_len) {
+  Updater updater(ops, ops_len, out, out_len);
+  return updater.apply(src);
+}
+
+} // namespace update
+} // namespace bson
+} // namespace pot
+
+#endif
@@ -0,0 +1,197 @@
+#include "../src/bson/aggregate/aggregate.hpp"
+#include "../src/bson/bson.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <limits>
+
+namespace bsona = pot::bson::aggregate;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kAggregateBufSize = 32 * 1024;
+
+class AggregateTests : public CxxTest::TestSuite {
+  uint8_t buf[kAggregateBufSize];
+
+  bsond::Array buildArr(std::function<void(bsons::Array &)> builder) {
+    bsons::Result res = bsons::Document::build(
+        buf, kAggregateBufSize,
+        [&builder](bsons::Document &doc) { doc.appendArr("values", builder); });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::DocumentElement el;
+    bsond::Document(buf, res.len).getElByName("values", el);
+    return el.getArr();
+  }
+
+  // Folds one element at a time, as the reference for the block kernels.
+  static bsona::Stats reference(const bsond::Array &arr) {
+    bsona::Stats stats;
+    for (auto el : arr) {
+      stats.add(el);
+    }
+    return stats;
+  }
+
+  static void assertSame(const bsona::Stats &a, const bsona::Stats &b) {
+    TS_ASSERT_EQUALS(a.count(), b.count());
+    TS_ASSERT_EQUALS(a.skipped(), b.skipped());
+    TS_ASSERT_EQUALS(a.integral(), b.integral());
+    TS_ASSERT_EQUALS(a.getSum(), b.getSum());
+    TS_ASSERT_EQUALS(a.getIntSum(), b.getIntSum());
+    TS_ASSERT_EQUALS(a.getMin(), b.getMin());
+    TS_ASSERT_EQUALS(a.getMax(), b.getMax());
+    TS_ASSERT_EQUALS(a.getMean(), b.getMean());
+  }
+
+public:
+  void testUniformDoubles() {
+    // Crosses the one, two and three digit index keys.
+    bsond::Array arr = buildArr([](bsons::Array &arr) {
+      for (int32_t i = 0; i < 1200; i++) {
+        arr.appendDouble((i % 37) * 0.1 - (i % 11) * 1e-3);
+      }
+    });
+
+    double sum = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -min;
+    for (auto el : arr) {
+      double value = el.getDouble();
+      sum += value;
+      min = value < min ? value : min;
+      max = value > max ? value : max;
+    }
+
+    bsona::Stats stats = bsona::aggregate(arr, bsona::kAll);
+    TS_ASSERT_EQUALS(stats.count(), 1200);
+    TS_ASSERT(!stats.integral());
+    TS_ASSERT_EQUALS(stats.getSum(), sum);
+    TS_ASSERT_EQUALS(stats.getMin(), min);
+    TS_ASSERT_EQUALS(stats.getMax(), max);
+    TS_ASSERT_EQUALS(stats.getMean(), sum / 1200);
+    assertSame(stats, reference(arr));
+  }
+
+  void testUniformInt32s() {
+    bsond::Array arr = buildArr([](bsons::Array &arr) {
+      for (int32_t i = 0; i < 500; i++) {
+        arr.appendInt32(i % 2 ? std::numeric_limits<int32_t>::max() : -i);
+      }
+    });
+
+    bsona::Stats stats = bsona::aggregate(arr, bsona::kAll);
+    TS_ASSERT(stats.integral());
+    TS_ASSERT_EQUALS(stats.getIntSum(),
+                     250 * static_cast<int64_t>(
+                               std::numeric_limits<int32_t>::max()) -
+                         249 * 250);
+    TS_ASSERT_EQUALS(stats.getIntMin(), -498);
+    TS_ASSERT_EQUALS(stats.getIntMax(), std::numeric_limits<int32_t>::max());
+    assertSame(stats, reference(arr));
+  }
+
+  void testMixed() {
+    bsond::Array arr = buildArr([](bsons::Array &arr) {
+      for (int32_t i = 0; i < 300; i++) {
+        switch (i % 7) {
+          case 0:
+            arr.appendStr("skip");
+            break;
+          case 1:
+            arr.appendNull();
+            break;
+          case 2:
+          case 3:
+            arr.appendInt64(static_cast<int64_t>(i) << 40);
+            break;
+          case 4:
+            arr.appendDouble(i / 3.0);
+            break;
+          default:
+            arr.appendInt32(-i);
+            break;
+        }
+      }
+    });
+
+    bsona::Stats stats = bsona::aggregate(arr, bsona::kAll);
+    TS_ASSERT_EQUALS(stats.skipped(), 86);
+    TS_ASSERT(!stats.integral());
+    assertSame(stats, reference(arr));
+  }
+
+  void testOverflow() {
+    // Large enough to overflow the Int64 sum partway through, and then to
+    // push the Int32 blocks onto the careful path.
+    bsond::Array arr = buildArr([](bsons::Array &arr) {
+      for (int32_t i = 0; i < 40; i++) {
+        arr.appendInt64(std::numeric_limits<int64_t>::max() / 3);
+      }
+      for (int32_t i = 0; i < 200; i++) {
+        arr.appendInt32(std::numeric_limits<int32_t>::max());
+      }
+    });
+
+    bsona::Stats stats = bsona::aggregate(arr, bsona::kAll);
+    TS_ASSERT(!stats.integral());
+    assertSame(stats, reference(arr));
+  }
+
+  void testOps() {
+    bsond::Array arr = buildArr([](bsons::Array &arr) {
+      arr.appendInt32(4).appendInt32(-2).appendDouble(1.5);
+    });
+
+    bsona::Stats stats = bsona::aggregate(arr, bsona::kCount | bsona::kMin);
+    TS_ASSERT_EQUALS(stats.count(), 3);
+    TS_ASSERT_EQUALS(stats.getMin(), -2);
+    TS_ASSERT_EQUALS(stats.getMax(), 0);
+    TS_ASSERT_EQUALS(stats.getSum(), 0);
+
+    stats = bsona::aggregate(arr, bsona::kAll);
+    TS_ASSERT_EQUALS(stats.getSum(), 3.5);
+    TS_ASSERT_EQUALS(stats.getMax(), 4);
+
+    stats = bsona::aggregate(buildArr([](bsons::Array &) {}), bsona::kAll);
+    TS_ASSERT_EQUALS(stats.count(), 0);
+    TS_ASSERT_EQUALS(stats.getMin(), 0);
+    TS_ASSERT_EQUALS(stats.getMean(), 0);
+  }
+
+  void testBatch() {
+    bsond::Document docs[10];
+    size_t len = 0;
+    for (int32_t i = 0; i < 10; i++) {
+      bsons::Result res = bsons::Document::build(
+          &buf[len], kAggregateBufSize - len, [i](bsons::Document &doc) {
+            doc.appendInt32("seq", i).appendDoc(
+                "state", [i](bsons::Document &sdoc) {
+                  if (i == 3) {
+                    sdoc.appendStr("temp", "n/a");
+                  } else if (i % 2) {
+                    sdoc.appendDouble("temp", i * 0.5);
+                  } else if (i != 8) {
+                    sdoc.appendInt32("temp", i);
+                  }
+                });
+          });
+      docs[i] = bsond::Document(&buf[len], res.len);
+      len += res.len;
+    }
+
+    bsona::Stats stats = bsona::aggregate(docs, 10, "state.temp", bsona::kAll);
+    TS_ASSERT_EQUALS(stats.count(), 8);
+    TS_ASSERT_EQUALS(stats.skipped(), 2);
+    TS_ASSERT_EQUALS(stats.getSum(), 12 + 11.0);
+    TS_ASSERT_EQUALS(stats.getMin(), 0);
+    TS_ASSERT_EQUALS(stats.getMax(), 6);
+
+    stats = bsona::aggregate(docs, 10, "seq", bsona::kAll);
+    TS_ASSERT(stats.integral());
+    TS_ASSERT_EQUALS(stats.getIntSum(), 45);
+
+    stats = bsona::aggregate(docs, 10, "seq.value", bsona::kAll);
+    TS_ASSERT_EQUALS(stats.skipped(), 10);
+  }
+};
@@ -0,0 +1,155 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/codec/codec.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+
+namespace bsoncd = pot::bson::codec;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+struct CodecPosition {
+  double lat;
+  double lon;
+};
+
+#define CODEC_POSITION_FIELDS(F) F(lat) F(lon)
+POT_BSON_CODEC(CodecPosition, CODEC_POSITION_FIELDS)
+
+struct CodecReading {
+  int64_t ts;
+  int32_t seq;
+  double temp;
+  bool alarm;
+  CodecPosition gps;
+};
+
+#define CODEC_READING_FIELDS(F) F(ts) F(seq) F(temp) F(alarm) F(gps)
+POT_BSON_CODEC(CodecReading, CODEC_READING_FIELDS)
+
+struct CodecStatus {
+  const char *device;
+  int32_t code;
+  const char *message;
+};
+
+#define CODEC_STATUS_FIELDS(F) F(device) F(code) F(message)
+POT_BSON_CODEC(CodecStatus, CODEC_STATUS_FIELDS)
+
+static_assert(bsoncd::Codec<CodecReading>::kFixed, "");
+static_assert(!bsoncd::Codec<CodecStatus>::kFixed, "");
+static_assert(bsoncd::Codec<CodecReading>::kSize == 84, "");
+
+static constexpr size_t kCodecBufSize = 128;
+
+class CodecTests : public CxxTest::TestSuite {
+public:
+  void testEncodeMatchesBuilder() {
+    CodecReading reading = { 1700000000000, 42, 21.5, true, { 51.5, -0.12 } };
+
+    uint8_t buf[kCodecBufSize];
+    bsons::Result res = bsoncd::encode(reading, buf, kCodecBufSize);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, 84);
+
+    uint8_t expected[kCodecBufSize];
+    bsons::Result expected_res = bsons::Document::build(
+        expected, kCodecBufSize, [](bsons::Document &doc) {
+          doc.appendInt64("ts", 1700000000000)
+              .appendInt32("seq", 42)
+              .appendDouble("temp", 21.5)
+              .appendBool("alarm", true)
+              .appendDoc("gps", [](bsons::Document &gdoc) {
+                gdoc.appendDouble("lat", 51.5).appendDouble("lon", -0.12);
+              });
+        });
+    TS_ASSERT_EQUALS(res.len, expected_res.len);
+    TS_ASSERT_SAME_DATA(buf, expected, res.len);
+
+    // Overflow still reports the full length.
+    res = bsoncd::encode(reading, buf, 10);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, expected_res.len);
+  }
+
+  void testDecode() {
+    // Out of order, with an extra key and an Int32 for a double.
+    uint8_t buf[kCodecBufSize];
+    bsons::Result res = bsons::Document::build(
+        buf, kCodecBufSize, [](bsons::Document &doc) {
+          doc.appendDoc("gps",
+                        [](bsons::Document &gdoc) {
+                          gdoc.appendInt32("lon", 3).appendDouble("lat", 1.25);
+                        })
+              .appendStr("extra", "ignored")
+              .appendBool("alarm", false)
+              .appendInt32("temp", 20)
+              .appendInt32("seq", 7)
+              .appendInt32("ts", 1000);
+        });
+
+    CodecReading reading;
+    TS_ASSERT(bsoncd::decode(bsond::Document(buf, res.len), reading));
+    TS_ASSERT_EQUALS(reading.ts, 1000);
+    TS_ASSERT_EQUALS(reading.seq, 7);
+    TS_ASSERT_EQUALS(reading.temp, 20);
+    TS_ASSERT_EQUALS(reading.alarm, false);
+    TS_ASSERT_EQUALS(reading.gps.lat, 1.25);
+    TS_ASSERT_EQUALS(reading.gps.lon, 3);
+  }
+
+  void testDecodeMissingOrMismatched() {
+    uint8_t buf[kCodecBufSize];
+    bsons::Result res = bsons::Document::build(
+        buf, kCodecBufSize, [](bsons::Document &doc) {
+          doc.appendStr("device", "gw-1").appendDouble("code", 1.5);
+        });
+
+    CodecStatus status = { nullptr, 0, "unset" };
+    TS_ASSERT(!bsoncd::decode(bsond::Document(buf, res.len), status));
+    TS_ASSERT_EQUALS(strcmp(status.device, "gw-1"), 0);
+    TS_ASSERT_EQUALS(strcmp(status.message, "unset"), 0);
+  }
+
+  void testDecodeDuplicate() {
+    // Three keys for three members, but one is repeated and one missing.
+    uint8_t buf[kCodecBufSize];
+    bsons::Result res = bsons::Document::build(
+        buf, kCodecBufSize, [](bsons::Document &doc) {
+          doc.appendStr("device", "gw-1")
+              .appendInt32("code", 1)
+              .appendInt32("code", 2);
+        });
+
+    CodecStatus status = { nullptr, 0, "unset" };
+    TS_ASSERT(!bsoncd::decode(bsond::Document(buf, res.len), status));
+
+    res = bsons::Document::build(buf, kCodecBufSize,
+                                 [](bsons::Document &doc) {
+                                   doc.appendStr("device", "gw-1")
+                                       .appendInt32("code", 1)
+                                       .appendNull("message")
+                                       .appendInt32("code", 2);
+                                 });
+    TS_ASSERT(!bsoncd::decode(bsond::Document(buf, res.len), status));
+  }
+
+  void testStrings() {
+    CodecStatus status = { "gw-1", 503, nullptr };
+
+    uint8_t buf[kCodecBufSize];
+    bsons::Result res = bsoncd::encode(status, buf, kCodecBufSize);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, 41);
+    TS_ASSERT(res.len > bsoncd::Codec<CodecStatus>::kSize + 0);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    CodecStatus decoded = { nullptr, 0, "unset" };
+    TS_ASSERT(bsoncd::decode(doc, decoded));
+    TS_ASSERT_EQUALS(strcmp(decoded.device, "gw-1"), 0);
+    TS_ASSERT_EQUALS(decoded.code, 503);
+    TS_ASSERT(decoded.message == nullptr);
+  }
+};
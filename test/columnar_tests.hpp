@@ -0,0 +1,219 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/columnar/column.hpp"
+#include "../src/bson/columnar/rows.hpp"
+#include "../src/bson/columnar/transpose.hpp"
+#include "../src/bson/parallel/thread_pool.hpp"
+#include "../src/bson/deserializer/array_iter.hpp"
+#include "../src/bson/deserializer/document_iter.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+
+namespace bsonc = pot::bson::columnar;
+namespace bsond = pot::bson::deserializer;
+namespace bsonp = pot::bson::parallel;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kColumnarRows = 100;
+static constexpr size_t kColumnarDocSize = 128;
+
+class ColumnarTests : public CxxTest::TestSuite {
+  uint8_t buf[kColumnarRows * kColumnarDocSize];
+  bsond::Document docs[kColumnarRows];
+
+  int64_t ts[kColumnarRows];
+  double temp[kColumnarRows];
+  double lat[kColumnarRows];
+  bsond::data_type::Str status[kColumnarRows];
+  bool alarm[kColumnarRows];
+  int32_t first[kColumnarRows];
+
+  uint8_t ts_present[kColumnarRows / 8 + 1];
+  uint8_t temp_present[kColumnarRows / 8 + 1];
+  uint8_t temp_nulls[kColumnarRows / 8 + 1];
+  uint8_t lat_present[kColumnarRows / 8 + 1];
+  uint8_t status_present[kColumnarRows / 8 + 1];
+  uint8_t alarm_present[kColumnarRows / 8 + 1];
+  uint8_t first_present[kColumnarRows / 8 + 1];
+
+  bsonc::Column columns[6];
+
+  void check() {
+    for (size_t i = 0; i < kColumnarRows; i++) {
+      TS_ASSERT(bsonc::bitmap_get(ts_present, i));
+      TS_ASSERT_EQUALS(ts[i], 1000 + static_cast<int64_t>(i));
+
+      // Temperatures alternate between Int32 and Double, with the odd null.
+      if (i % 10 == 0) {
+        TS_ASSERT(!bsonc::bitmap_get(temp_present, i));
+        TS_ASSERT(!bsonc::bitmap_get(temp_nulls, i));
+      } else if (i % 5 == 0) {
+        TS_ASSERT(!bsonc::bitmap_get(temp_present, i));
+        TS_ASSERT(bsonc::bitmap_get(temp_nulls, i));
+        TS_ASSERT_EQUALS(temp[i], 0);
+      } else {
+        TS_ASSERT(bsonc::bitmap_get(temp_present, i));
+        TS_ASSERT(!bsonc::bitmap_get(temp_nulls, i));
+        TS_ASSERT_EQUALS(temp[i], i % 2 ? i * 0.5 : i);
+      }
+
+      TS_ASSERT_EQUALS(bsonc::bitmap_get(lat_present, i), i % 3 == 0);
+      if (i % 3 == 0) {
+        TS_ASSERT_EQUALS(lat[i], i * 0.25);
+      }
+
+      TS_ASSERT(bsonc::bitmap_get(status_present, i));
+      TS_ASSERT_EQUALS(status[i].len, i % 2 ? 2 : 8);
+      TS_ASSERT_EQUALS(strcmp(status[i].str, i % 2 ? "ok" : "degraded"), 0);
+
+      TS_ASSERT(bsonc::bitmap_get(alarm_present, i));
+      TS_ASSERT_EQUALS(alarm[i], i % 7 == 0);
+
+      TS_ASSERT(bsonc::bitmap_get(first_present, i));
+      TS_ASSERT_EQUALS(first[i], static_cast<int32_t>(i * 2));
+    }
+  }
+
+public:
+  void setUp() {
+    size_t len = 0;
+    for (size_t i = 0; i < kColumnarRows; i++) {
+      bsons::Result res = bsons::Document::build(
+          &buf[len], sizeof(buf) - len, [i](bsons::Document &doc) {
+            doc.appendInt32("ts", 1000 + i);
+
+            if (i % 10 == 0) {
+              doc.appendStr("temp", "n/a");
+            } else if (i % 5 == 0) {
+              doc.appendNull("temp");
+            } else if (i % 2) {
+              doc.appendDouble("temp", i * 0.5);
+            } else {
+              doc.appendInt32("temp", i);
+            }
+
+            doc.appendStr("status", i % 2 ? "ok" : "degraded")
+                .appendArr("readings",
+                           [i](bsons::Array &arr) {
+                             arr.appendInt32(i * 2).appendInt32(i * 3);
+                           })
+                .appendDoc("state", [i](bsons::Document &sdoc) {
+                  sdoc.appendBool("alarm", i % 7 == 0);
+                  if (i % 3 == 0) {
+                    sdoc.appendDoc("gps", [i](bsons::Document &gdoc) {
+                      gdoc.appendDouble("lat", i * 0.25);
+                    });
+                  }
+                });
+          });
+      docs[i] = bsond::Document(&buf[len], res.len);
+      len += res.len;
+    }
+
+    columns[0] = bsonc::Column::ofInt64("ts", ts, ts_present);
+    columns[1] =
+        bsonc::Column::ofDouble("temp", temp, temp_present, temp_nulls);
+    columns[2] = bsonc::Column::ofDouble("state.gps.lat", lat, lat_present);
+    columns[3] = bsonc::Column::ofBool("state.alarm", alarm, alarm_present);
+    columns[4] = bsonc::Column::ofStr("status", status, status_present);
+    columns[5] = bsonc::Column::ofInt32("readings.0", first, first_present);
+
+    // Poison the outputs to check that every row is written.
+    memset(temp, 0xFF, sizeof(temp));
+    memset(temp_nulls, 0xFF, sizeof(temp_nulls));
+    memset(lat_present, 0xFF, sizeof(lat_present));
+  }
+
+  void testTranspose() {
+    bsonc::Transposer<> transposer(columns, 6);
+    // Every 10th row has a string temperature.
+    TS_ASSERT_EQUALS(transposer.transpose(docs, kColumnarRows),
+                     kColumnarRows / 10);
+    check();
+  }
+
+  void testTransposeParallel() {
+    bsonp::ThreadPool pool(4);
+    bsonc::Transposer<> transposer(columns, 6);
+    TS_ASSERT_EQUALS(transposer.transpose(pool, docs, kColumnarRows, 8),
+                     kColumnarRows / 10);
+    check();
+  }
+
+  void testPathThroughScalar() {
+    bsonc::Column column =
+        bsonc::Column::ofDouble("ts.value", lat, lat_present);
+    bsonc::Transposer<> transposer(&column, 1);
+
+    TS_ASSERT_EQUALS(transposer.row(docs[3], 3), 0);
+    TS_ASSERT(!bsonc::bitmap_get(lat_present, 3));
+  }
+
+  void testEncodeRows() {
+    bsonc::Transposer<> transposer(columns, 6);
+    transposer.transpose(docs, kColumnarRows);
+
+    // The mismatched temperatures are dropped, so transposing the encoded
+    // rows gives the same columns without any mismatches.
+    static uint8_t out[kColumnarRows * kColumnarDocSize];
+    bsonc::RowEncoder encoder(columns, 6);
+    bsons::Result res = encoder.encodeRows(kColumnarRows, out, 100);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    size_t total = res.len;
+
+    res = encoder.encodeRows(kColumnarRows, out, sizeof(out));
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, total);
+
+    size_t len = 0;
+    for (size_t i = 0; i < kColumnarRows; i++) {
+      docs[i] = bsond::Document(&out[len], res.len - len);
+      TS_ASSERT(docs[i].valid());
+      len += docs[i].len();
+    }
+    TS_ASSERT_EQUALS(len, res.len);
+
+    TS_ASSERT_EQUALS(transposer.transpose(docs, kColumnarRows), 0);
+    check();
+  }
+
+  void testEncodeColumns() {
+    bsonc::Transposer<> transposer(columns, 6);
+    transposer.transpose(docs, kColumnarRows);
+
+    static uint8_t out[kColumnarRows * kColumnarDocSize];
+    bsonc::RowEncoder encoder(columns, 6);
+    bsons::Result res = encoder.encodeColumns(kColumnarRows, out, sizeof(out));
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(out, res.len);
+    TS_ASSERT(doc.valid());
+
+    // The two state columns share a single parent document.
+    const char *keys[] = { "ts", "temp", "state", "status", "readings" };
+    size_t key = 0;
+    for (auto el : doc) {
+      TS_ASSERT(key < 5);
+      TS_ASSERT(el.nameEquals(keys[key++]));
+    }
+    TS_ASSERT_EQUALS(key, 5);
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("temp", el));
+    size_t row = 0;
+    for (auto item : el.getArr()) {
+      if (row % 5 == 0) {
+        TS_ASSERT_EQUALS(item.type(), pot::bson::Element::Null);
+      } else {
+        TS_ASSERT_EQUALS(item.getDouble(), row % 2 ? row * 0.5 : row);
+      }
+      row++;
+    }
+    TS_ASSERT_EQUALS(row, kColumnarRows);
+
+    TS_ASSERT(doc.getElByName("state", el));
+    TS_ASSERT(el.getDoc().getElByName("gps", el));
+    TS_ASSERT(el.getDoc().getElByName("lat", el));
+    TS_ASSERT_EQUALS(el.type(), pot::bson::Element::Array);
+  }
+};
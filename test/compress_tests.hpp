@@ -0,0 +1,235 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/compress/dictionary.hpp"
+#include "../src/bson/compress/frame.hpp"
+#include "../src/bson/compress/lz.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonz = pot::bson::compress;
+
+static constexpr size_t kCompressBufSize = 2048;
+
+size_t build_reading(uint8_t buf[], size_t n) {
+  return bsons::Document::build(
+             buf, kCompressBufSize,
+             [n](bsons::Document &doc) {
+               doc.appendStr("deviceId", "edge-gw-0042")
+                   .appendInt64("timestamp", 1700000000000 + n * 1000)
+                   .appendDouble("temperature", 21.0 + n * 0.1)
+                   .appendStr("status", n % 2 ? "ok" : "idle")
+                   .appendArr("readings", [n](bsons::Array &arr) {
+                     for (size_t i = 0; i < 8; i++) {
+                       arr.appendInt32(n * i);
+                     }
+                   });
+             })
+      .len;
+}
+
+class CompressTests : public CxxTest::TestSuite {
+public:
+  void testLzRoundTrip() {
+    uint8_t src[kCompressBufSize];
+    // A repeating pattern, then noise, then a long run.
+    for (size_t i = 0; i < 600; i++) {
+      src[i] = "abcdefgh"[i % 7];
+    }
+    uint32_t x = 12345;
+    for (size_t i = 600; i < 1200; i++) {
+      x = x * 1103515245 + 12345;
+      src[i] = x >> 16;
+    }
+    memset(&src[1200], 'z', 800);
+
+    size_t lens[] = { 0, 1, 3, 4, 5, 17, 600, 1200, 2000 };
+    for (size_t len : lens) {
+      uint8_t packed[kCompressBufSize * 2];
+      uint8_t out[kCompressBufSize];
+      size_t packed_len = bsonz::lz_compress(src, len, packed, sizeof(packed));
+      TS_ASSERT(packed_len <= bsonz::lz_bound(len));
+      TS_ASSERT(bsonz::lz_decompress(packed, packed_len, out, len));
+      TS_ASSERT_SAME_DATA(out, src, len);
+
+      // It has to decompress to exactly the given length.
+      TS_ASSERT(!bsonz::lz_decompress(packed, packed_len, out, len + 1));
+      if (len > 0) {
+        TS_ASSERT(!bsonz::lz_decompress(packed, packed_len, out, len - 1));
+      }
+    }
+
+    // The pattern and run compress well.
+    uint8_t packed[kCompressBufSize];
+    TS_ASSERT_LESS_THAN(
+        bsonz::lz_compress(&src[1200], 800, packed, sizeof(packed)), 20u);
+  }
+
+  void testLzOverflow() {
+    uint8_t src[256];
+    for (size_t i = 0; i < sizeof(src); i++) {
+      src[i] = i;
+    }
+
+    uint8_t packed[512];
+    size_t full = bsonz::lz_compress(src, sizeof(src), packed, sizeof(packed));
+    uint8_t small[16];
+    TS_ASSERT_EQUALS(bsonz::lz_compress(src, sizeof(src), small, sizeof(small)),
+                     full);
+  }
+
+  void testLzMalformed() {
+    uint8_t out[64];
+
+    // A match before the start of the output.
+    uint8_t bad_offset[] = { 0x10, 'a', 0x02, 0x00 };
+    TS_ASSERT(!bsonz::lz_decompress(bad_offset, sizeof(bad_offset), out, 5));
+
+    // Literals past the end of the input.
+    uint8_t short_lits[] = { 0x50, 'a', 'b' };
+    TS_ASSERT(!bsonz::lz_decompress(short_lits, sizeof(short_lits), out, 5));
+
+    // A truncated offset and run.
+    uint8_t short_offset[] = { 0x10, 'a', 0x01 };
+    TS_ASSERT(!bsonz::lz_decompress(short_offset, sizeof(short_offset), out,
+                                    5));
+    uint8_t short_run[] = { 0xF0, 0xFF };
+    TS_ASSERT(!bsonz::lz_decompress(short_run, sizeof(short_run), out, 64));
+
+    // A zero offset.
+    uint8_t zero_offset[] = { 0x10, 'a', 0x00, 0x00 };
+    TS_ASSERT(!bsonz::lz_decompress(zero_offset, sizeof(zero_offset), out, 5));
+
+    // A valid overlapping match: "a" then 4 more copies of it.
+    uint8_t run[] = { 0x10, 'a', 0x01, 0x00 };
+    TS_ASSERT(bsonz::lz_decompress(run, sizeof(run), out, 5));
+    TS_ASSERT_SAME_DATA(out, "aaaaa", 5);
+  }
+
+  void testDictionary() {
+    bsonz::DictionaryTrainer trainer;
+    uint8_t doc[kCompressBufSize];
+    for (size_t n = 0; n < 20; n++) {
+      size_t len = build_reading(doc, n);
+      trainer.add(doc, len);
+    }
+
+    uint8_t dict_buf[512];
+    size_t dict_len = trainer.build(dict_buf, sizeof(dict_buf));
+    TS_ASSERT(dict_len > 0);
+    TS_ASSERT(memmem(dict_buf, dict_len, "\x12timestamp", 11) != nullptr);
+    TS_ASSERT(memmem(dict_buf, dict_len, "edge-gw-0042", 12) != nullptr);
+    bsonz::Dictionary dict = bsonz::make_dictionary(dict_buf, dict_len);
+
+    // Capped to the given size.
+    uint8_t tiny[16];
+    TS_ASSERT(trainer.build(tiny, sizeof(tiny)) <= sizeof(tiny));
+
+    size_t len = build_reading(doc, 1000);
+    uint8_t plain[kCompressBufSize];
+    uint8_t with_dict[kCompressBufSize];
+    size_t plain_len = bsonz::lz_compress(doc, len, plain, sizeof(plain));
+    size_t dict_packed =
+        bsonz::lz_compress(doc, len, with_dict, sizeof(with_dict), &dict);
+    TS_ASSERT_LESS_THAN(dict_packed, plain_len);
+
+    uint8_t out[kCompressBufSize];
+    TS_ASSERT(bsonz::lz_decompress(with_dict, dict_packed, out, len, &dict));
+    TS_ASSERT_SAME_DATA(out, doc, len);
+    TS_ASSERT(!bsonz::lz_decompress(with_dict, dict_packed, out, len));
+  }
+
+  void testFrame() {
+    uint8_t doc[kCompressBufSize];
+    size_t len = build_reading(doc, 7);
+
+    uint8_t frame[kCompressBufSize];
+    bsonz::Result res = bsonz::write_frame(doc, len, frame, sizeof(frame));
+    TS_ASSERT_EQUALS(res.status, bsonz::Status::Ok);
+    TS_ASSERT_EQUALS(frame[0], bsonz::Lz::kId);
+    TS_ASSERT_LESS_THAN(res.len, bsonz::kFrameHeaderSize + len);
+    TS_ASSERT_EQUALS(bsonz::frame_doc_len(frame, res.len), len);
+
+    uint8_t out[kCompressBufSize];
+    bsond::Document read;
+    bsonz::Result read_res =
+        bsonz::read_frame(frame, res.len, out, sizeof(out), read);
+    TS_ASSERT_EQUALS(read_res.status, bsonz::Status::Ok);
+    TS_ASSERT_EQUALS(read_res.len, len);
+    TS_ASSERT_EQUALS(read.getRef(), out);
+    TS_ASSERT(read.valid());
+    TS_ASSERT_SAME_DATA(out, doc, len);
+
+    // Too small for the frame, or for the document.
+    bsonz::Result small = bsonz::write_frame(doc, len, frame, 10);
+    TS_ASSERT_EQUALS(small.status, bsonz::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(small.len, res.len);
+    read_res = bsonz::read_frame(frame, res.len, out, len - 1, read);
+    TS_ASSERT_EQUALS(read_res.status, bsonz::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(read_res.len, len);
+
+    // Truncated.
+    read_res = bsonz::read_frame(frame, res.len - 1, out, sizeof(out), read);
+    TS_ASSERT_EQUALS(read_res.status, bsonz::Status::Malformed);
+  }
+
+  void testStoredFrame() {
+    // Too small to compress, so it's stored and read in place.
+    uint8_t doc[] = { 0x05, 0x00, 0x00, 0x00, 0x00 };
+    uint8_t frame[64];
+    bsonz::Result res = bsonz::write_frame(doc, sizeof(doc), frame,
+                                           sizeof(frame));
+    TS_ASSERT_EQUALS(res.status, bsonz::Status::Ok);
+    TS_ASSERT_EQUALS(frame[0], bsonz::Stored::kId);
+    TS_ASSERT_EQUALS(res.len, bsonz::kFrameHeaderSize + sizeof(doc));
+
+    bsond::Document read;
+    bsonz::Result read_res =
+        bsonz::read_frame(frame, res.len, nullptr, 0, read);
+    TS_ASSERT_EQUALS(read_res.status, bsonz::Status::Ok);
+    TS_ASSERT_EQUALS(read.getRef(), frame + bsonz::kFrameHeaderSize);
+    TS_ASSERT(read.valid());
+  }
+
+  void testFrameDictionary() {
+    bsonz::DictionaryTrainer trainer;
+    uint8_t doc[kCompressBufSize];
+    for (size_t n = 0; n < 10; n++) {
+      trainer.add(doc, build_reading(doc, n));
+    }
+    uint8_t dict_buf[512];
+    bsonz::Dictionary dict = bsonz::make_dictionary(
+        dict_buf, trainer.build(dict_buf, sizeof(dict_buf)));
+    uint8_t other_buf[] = "something else";
+    bsonz::Dictionary other =
+        bsonz::make_dictionary(other_buf, sizeof(other_buf));
+
+    size_t len = build_reading(doc, 99);
+    uint8_t frame[kCompressBufSize];
+    bsonz::Result res =
+        bsonz::write_frame(doc, len, frame, sizeof(frame), &dict);
+    TS_ASSERT_EQUALS(res.status, bsonz::Status::Ok);
+
+    uint8_t out[kCompressBufSize];
+    bsond::Document read;
+    TS_ASSERT_EQUALS(
+        bsonz::read_frame(frame, res.len, out, sizeof(out), read).status,
+        bsonz::Status::DictionaryMismatch);
+    TS_ASSERT_EQUALS(
+        bsonz::read_frame(frame, res.len, out, sizeof(out), read, &other)
+            .status,
+        bsonz::Status::DictionaryMismatch);
+    TS_ASSERT_EQUALS(
+        bsonz::read_frame(frame, res.len, out, sizeof(out), read, &dict)
+            .status,
+        bsonz::Status::Ok);
+    TS_ASSERT_SAME_DATA(out, doc, len);
+
+    frame[0] = 0x42;
+    TS_ASSERT_EQUALS(
+        bsonz::read_frame(frame, res.len, out, sizeof(out), read, &dict)
+            .status,
+        bsonz::Status::UnknownCodec);
+  }
+};
@@ -0,0 +1,139 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/delta/delta.hpp"
+#include "./utils.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <functional>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsondelta = pot::bson::delta;
+
+static constexpr size_t kDeltaBufSize = 256;
+
+class DeltaTests : public CxxTest::TestSuite {
+  uint8_t prev[kDeltaBufSize];
+  uint8_t next[kDeltaBufSize];
+  uint8_t patch[kDeltaBufSize];
+  uint8_t out[kDeltaBufSize];
+
+  static void base(bsons::Document &doc) {
+    doc.appendStr("id", "dev-1")
+        .appendInt64("ts", 1000)
+        .appendDouble("temp", 20.5)
+        .appendDoc("gps",
+                   [](bsons::Document &ndoc) {
+                     ndoc.appendDouble("lat", 51.5).appendDouble("lon", -0.1);
+                   })
+        .appendArr("readings", [](bsons::Array &arr) {
+          arr.appendInt32(1).appendInt32(2).appendInt32(3).appendInt32(4);
+        });
+  }
+
+  /**
+   * Diffs prev against next, then checks that applying the patch to prev
+   * reproduces next exactly. Returns the length of the patch.
+   */
+  size_t roundTrip(std::function<void(bsons::Document &)> prev_builder,
+                   std::function<void(bsons::Document &)> next_builder) {
+    clear_buf(out, kDeltaBufSize);
+    size_t prev_len =
+        bsons::Document::build(prev, kDeltaBufSize, prev_builder).len;
+    size_t next_len =
+        bsons::Document::build(next, kDeltaBufSize, next_builder).len;
+
+    bsond::Document prev_doc(prev, prev_len);
+    bsond::Document next_doc(next, next_len);
+
+    bsondelta::Result diff_res =
+        bsondelta::diff(prev_doc, next_doc, patch, kDeltaBufSize);
+    TS_ASSERT_EQUALS(diff_res.status, bsondelta::Status::Ok);
+
+    bsond::Document patch_doc(patch, diff_res.len);
+    TS_ASSERT(patch_doc.valid());
+
+    bsondelta::Result apply_res =
+        bsondelta::apply(prev_doc, patch_doc, out, kDeltaBufSize);
+    TS_ASSERT_EQUALS(apply_res.status, bsondelta::Status::Ok);
+    TS_ASSERT_EQUALS(apply_res.len, next_len);
+    TS_ASSERT_SAME_DATA(out, next, next_len);
+
+    return diff_res.len;
+  }
+
+public:
+  void testIdenticalDocuments() {
+    TS_ASSERT_EQUALS(roundTrip(base, base), 5);
+  }
+
+  void testChangedFields() {
+    size_t len = roundTrip(base, [](bsons::Document &doc) {
+      doc.appendStr("id", "dev-1")
+          .appendInt64("ts", 1010)
+          .appendDouble("temp", 20.5)
+          .appendDoc("gps",
+                     [](bsons::Document &ndoc) {
+                       ndoc.appendDouble("lat", 51.5).appendDouble("lon", -0.2);
+                     })
+          .appendArr("readings", [](bsons::Array &arr) {
+            arr.appendInt32(1).appendInt32(2).appendInt32(3).appendInt32(5);
+          });
+    });
+
+    // Only the timestamp, longitude and last reading are sent.
+    TS_ASSERT_EQUALS(len, 67);
+  }
+
+  void testAddedAndRemovedFields() {
+    roundTrip(base, [](bsons::Document &doc) {
+      doc.appendStr("id", "dev-1")
+          .appendBool("alarm", true)
+          .appendDouble("temp", 20.5)
+          .appendDoc("gps",
+                     [](bsons::Document &ndoc) {
+                       ndoc.appendDouble("lat", 51.5)
+                           .appendDouble("lon", -0.1)
+                           .appendDouble("alt", 12);
+                     })
+          .appendArr("readings",
+                     [](bsons::Array &arr) { arr.appendInt32(1); })
+          .appendNull("extra");
+    });
+  }
+
+  void testTypeChanges() {
+    roundTrip(base, [](bsons::Document &doc) {
+      doc.appendStr("id", "dev-1")
+          .appendInt64("ts", 1000)
+          .appendStr("temp", "n/a")
+          .appendArr("gps", [](bsons::Array &arr) { arr.appendInt32(1); })
+          .appendDoc("readings", [](bsons::Document &ndoc) {});
+    });
+  }
+
+  void testReorderedFields() {
+    roundTrip(base, [](bsons::Document &doc) {
+      doc.appendDouble("temp", 20.5)
+          .appendStr("id", "dev-1")
+          .appendInt64("ts", 1000);
+    });
+  }
+
+  void testEmptyDocuments() {
+    roundTrip([](bsons::Document &doc) {}, base);
+    roundTrip(base, [](bsons::Document &doc) {});
+  }
+
+  void testInvalidPatch() {
+    size_t prev_len = bsons::Document::build(prev, kDeltaBufSize, base).len;
+    size_t patch_len =
+        bsons::Document::build(patch, kDeltaBufSize, [](bsons::Document &doc) {
+          doc.appendNull("-missing");
+        }).len;
+
+    bsondelta::Result res =
+        bsondelta::apply(bsond::Document(prev, prev_len),
+                         bsond::Document(patch, patch_len), out, kDeltaBufSize);
+    TS_ASSERT_EQUALS(res.status, bsondelta::Status::InvalidPatch);
+  }
+};
@@ -0,0 +1,112 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/io/document_stream.hpp"
+#include "../src/bson/io/mapped_file.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+
+static constexpr size_t kStreamBufSize = 256;
+
+class DocumentStreamTests : public CxxTest::TestSuite {
+  uint8_t buf[kStreamBufSize];
+  size_t len;
+
+public:
+  void setUp() {
+    len = 0;
+    for (int32_t i = 0; i < 3; i++) {
+      bsons::Result res = bsons::Document::build(
+          &buf[len], kStreamBufSize - len,
+          [i](bsons::Document &doc) { doc.appendInt32("seq", i); });
+      len += res.len;
+    }
+  }
+
+  void testIterate() {
+    bsonio::DocumentStream stream(buf, len, true);
+    bsond::Document doc;
+    bsond::DocumentElement el;
+
+    for (int32_t i = 0; i < 3; i++) {
+      TS_ASSERT(stream.next(doc));
+      TS_ASSERT(doc.getElByName("seq", el));
+      TS_ASSERT_EQUALS(el.getInt32(), i);
+    }
+
+    TS_ASSERT(!stream.next(doc));
+    TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::End);
+    TS_ASSERT_EQUALS(stream.count(), 3);
+    TS_ASSERT_EQUALS(stream.offset(), len);
+  }
+
+  void testTruncatedTail() {
+    bsond::Document doc;
+
+    for (size_t cut = 1; cut < 14; cut++) {
+      bsonio::DocumentStream stream(buf, len - cut);
+      TS_ASSERT(stream.next(doc));
+      TS_ASSERT(stream.next(doc));
+      TS_ASSERT(!stream.next(doc));
+      TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::Truncated);
+      TS_ASSERT_EQUALS(stream.offset(), len / 3 * 2);
+    }
+  }
+
+  void testInvalid() {
+    bsond::Document doc;
+
+    // Corrupt the type of the second document's element.
+    buf[len / 3 + 4] = 0x7F;
+    {
+      bsonio::DocumentStream stream(buf, len, true);
+      TS_ASSERT(stream.next(doc));
+      TS_ASSERT(!stream.next(doc));
+      TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::Invalid);
+    }
+
+    // Without validation, only the lengths are checked.
+    {
+      bsonio::DocumentStream stream(buf, len);
+      TS_ASSERT(stream.next(doc));
+      TS_ASSERT(stream.next(doc));
+    }
+
+    buf[len / 3] = 0x02;
+    {
+      bsonio::DocumentStream stream(buf, len);
+      TS_ASSERT(stream.next(doc));
+      TS_ASSERT(!stream.next(doc));
+      TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::Invalid);
+    }
+  }
+
+  void testMappedFile() {
+    char path[] = "/tmp/pot_bson_stream_XXXXXX";
+    int fd = mkstemp(path);
+    TS_ASSERT(fd >= 0);
+    TS_ASSERT_EQUALS(write(fd, buf, len), static_cast<ssize_t>(len));
+    close(fd);
+
+    bsonio::MappedFile file;
+    TS_ASSERT(file.open(path));
+    TS_ASSERT_EQUALS(file.size(), len);
+
+    bsonio::DocumentStream stream(file.data(), file.size(), true);
+    bsond::Document doc;
+    while (stream.next(doc)) {
+    }
+    TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::End);
+    TS_ASSERT_EQUALS(stream.count(), 3);
+
+    file.close();
+    unlink(path);
+
+    TS_ASSERT(!file.open(path));
+  }
+};
@@ -0,0 +1,170 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/io/frame.hpp"
+#include "../src/bson/io/ring.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+
+static constexpr size_t kFrameRingSize = 4096;
+static constexpr size_t kFrameMax = 1024;
+
+// Long enough for the largest pad in testRoundTripWrapping.
+static const char kFramePad[] =
+    "................................................................"
+    "................................................................"
+    "................................................................"
+    "................................................................"
+    "................................................................";
+
+class FrameTests : public CxxTest::TestSuite {
+public:
+  void testMirrored() {
+    bsonio::MirroredRing ring;
+    TS_ASSERT(ring.open(100));
+    size_t cap = ring.capacity();
+    TS_ASSERT(cap >= 100);
+
+    // A write across the end shows up at the start.
+    ring.commit(cap - 2);
+    ring.consume(cap - 2);
+    uint8_t *ptr = ring.writePtr();
+    memcpy(ptr, "wrap", 4);
+    ring.commit(4);
+    TS_ASSERT_EQUALS(ring.readable(), 4u);
+    TS_ASSERT_SAME_DATA(ring.readPtr(), "wrap", 4);
+    TS_ASSERT_EQUALS(ring.readPtr(), ptr);
+    TS_ASSERT_SAME_DATA(ring.writePtr() - 2, "ap", 2);
+    TS_ASSERT_EQUALS(ring.writable(), cap - 4);
+  }
+
+  void testRoundTripWrapping() {
+    bsonio::MirroredRing ring;
+    TS_ASSERT(ring.open(kFrameRingSize));
+    bsonio::FrameWriter writer(ring, kFrameMax);
+    bsonio::FrameReader reader(ring, kFrameMax, true);
+
+    // Odd sizes, so frames straddle the end of the ring on later laps.
+    int32_t next_read = 0;
+    for (int32_t seq = 0; seq < 200; seq++) {
+      bsons::Result res = writer.write([seq](bsons::Document &doc) {
+        doc.appendInt32("seq", seq).appendStr("pad", kFramePad,
+                                              1 + (seq * 37) % 300);
+      });
+
+      if (res.status != bsons::Status::Ok) {
+        // Full, so drain what's there and retry.
+        bsond::Document doc;
+        while (reader.next(doc)) {
+          bsond::DocumentElement el;
+          TS_ASSERT(doc.getElByName("seq", el));
+          TS_ASSERT_EQUALS(el.getInt32(), next_read++);
+        }
+        TS_ASSERT_EQUALS(reader.status(), bsonio::FrameStatus::NeedMore);
+        seq--;
+      }
+    }
+
+    bsond::Document doc;
+    while (reader.next(doc)) {
+      next_read++;
+    }
+    TS_ASSERT_EQUALS(next_read, 200);
+    TS_ASSERT_EQUALS(reader.count(), 200u);
+    TS_ASSERT_EQUALS(ring.readable(), 0u);
+  }
+
+  void testPartialAndLimits() {
+    bsonio::MirroredRing ring;
+    TS_ASSERT(ring.open(kFrameRingSize));
+    bsonio::FrameReader reader(ring, 64);
+    TS_ASSERT_EQUALS(reader.maxFrameSize(), 64u);
+
+    uint8_t doc_buf[] = { 0x0C, 0x00, 0x00, 0x00, 0x08, 'a',
+                          0x00, 0x01, 0x00, 0x10, 0x00, 0x00 };
+    bsond::Document doc;
+
+    // Arrives a byte at a time.
+    for (size_t i = 0; i < sizeof(doc_buf); i++) {
+      TS_ASSERT(!reader.next(doc));
+      TS_ASSERT_EQUALS(reader.status(), bsonio::FrameStatus::NeedMore);
+      *reader.space() = doc_buf[i];
+      reader.commit(1);
+    }
+    TS_ASSERT(reader.next(doc));
+    TS_ASSERT_EQUALS(doc.len(), 12);
+
+    // Larger than the limit.
+    uint8_t big[] = { 0x00, 0x01, 0x00, 0x00 };
+    memcpy(reader.space(), big, sizeof(big));
+    reader.commit(sizeof(big));
+    TS_ASSERT(!reader.next(doc));
+    TS_ASSERT_EQUALS(reader.status(), bsonio::FrameStatus::TooLarge);
+    TS_ASSERT(!reader.next(doc));
+
+    bsonio::MirroredRing other;
+    TS_ASSERT(other.open(kFrameRingSize));
+    bsonio::FrameReader invalid(other, 64);
+    uint8_t tiny[] = { 0x03, 0x00, 0x00, 0x00 };
+    memcpy(invalid.space(), tiny, sizeof(tiny));
+    invalid.commit(sizeof(tiny));
+    TS_ASSERT(!invalid.next(doc));
+    TS_ASSERT_EQUALS(invalid.status(), bsonio::FrameStatus::Invalid);
+  }
+
+  void testWriterLimit() {
+    bsonio::MirroredRing ring;
+    TS_ASSERT(ring.open(kFrameRingSize));
+    bsonio::FrameWriter writer(ring, 32);
+
+    bsons::Result res = writer.write([](bsons::Document &doc) {
+      doc.appendStr("text", "longer than thirty-two bytes in all");
+    });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT(res.len > 32);
+    TS_ASSERT_EQUALS(writer.pending(), 0u);
+
+    uint8_t empty[] = { 0x05, 0x00, 0x00, 0x00, 0x00 };
+    TS_ASSERT_EQUALS(writer.write(empty, sizeof(empty)).status,
+                     bsons::Status::Ok);
+    TS_ASSERT_EQUALS(writer.pending(), sizeof(empty));
+  }
+
+  void testSocket() {
+    int fds[2];
+    TS_ASSERT_EQUALS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    bsonio::MirroredRing out_ring;
+    bsonio::MirroredRing in_ring;
+    TS_ASSERT(out_ring.open(kFrameRingSize));
+    TS_ASSERT(in_ring.open(kFrameRingSize));
+    bsonio::FrameWriter writer(out_ring, kFrameMax);
+    bsonio::FrameReader reader(in_ring, kFrameMax, true);
+
+    for (int32_t i = 0; i < 3; i++) {
+      writer.write([i](bsons::Document &doc) { doc.appendInt32("seq", i); });
+    }
+    size_t pending = writer.pending();
+    TS_ASSERT_EQUALS(writer.flush(fds[0]), static_cast<ssize_t>(pending));
+    TS_ASSERT_EQUALS(writer.pending(), 0u);
+
+    TS_ASSERT_EQUALS(reader.fill(fds[1]), static_cast<ssize_t>(pending));
+    bsond::Document doc;
+    bsond::DocumentElement el;
+    for (int32_t i = 0; i < 3; i++) {
+      TS_ASSERT(reader.next(doc));
+      TS_ASSERT(doc.getElByName("seq", el));
+      TS_ASSERT_EQUALS(el.getInt32(), i);
+    }
+    TS_ASSERT(!reader.next(doc));
+
+    close(fds[0]);
+    TS_ASSERT_EQUALS(reader.fill(fds[1]), 0);
+    close(fds[1]);
+  }
+};
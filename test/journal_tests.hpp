@@ -0,0 +1,193 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/io/journal.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+
+// Small, so that a few hundred documents wrap the ring many times.
+static constexpr size_t kJournalTestChunk = 4096;
+static constexpr size_t kJournalTestDepth = 4;
+static constexpr int32_t kJournalTestDocs = 500;
+
+static const char kJournalPad[] =
+    "................................................................"
+    "................................................................";
+
+void append_seq(bsonio::JournalWriter &writer, const int32_t seq) {
+  // Sizes from 20 bytes to several kilobytes, to straddle slots.
+  size_t pad = (seq * 61) % 97;
+  size_t repeat = seq % 50 == 0 ? 40 : 1;
+  bsons::Result res = writer.append([seq, pad, repeat](bsons::Document &doc) {
+    doc.appendInt32("seq", seq).appendArr("pad", [pad,
+                                                   repeat](bsons::Array &arr) {
+      for (size_t i = 0; i < repeat; i++) {
+        arr.appendStr(kJournalPad, pad);
+      }
+    });
+  });
+  TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+}
+
+class JournalTests : public CxxTest::TestSuite {
+  char dir[32];
+  std::string path;
+
+  std::vector<bsonio::JournalBackend> backends() {
+    std::vector<bsonio::JournalBackend> backends = {
+      bsonio::JournalBackend::Sync
+    };
+    bsonio::Uring uring;
+    if (uring.open(1)) {
+      backends.push_back(bsonio::JournalBackend::Uring);
+    }
+    return backends;
+  }
+
+  int32_t readAll(bsonio::JournalReader &reader) {
+    bsond::Document doc;
+    bsond::DocumentElement el;
+    int32_t seq = 0;
+    while (reader.next(doc)) {
+      TS_ASSERT(doc.getElByName("seq", el));
+      TS_ASSERT_EQUALS(el.getInt32(), seq);
+      seq++;
+    }
+    return seq;
+  }
+
+public:
+  void setUp() {
+    strcpy(dir, "/tmp/pot_bson_journal_XXXXXX");
+    TS_ASSERT(mkdtemp(dir) != nullptr);
+    path = std::string(dir) + "/journal.bson";
+  }
+
+  void tearDown() {
+    unlink(path.c_str());
+    rmdir(dir);
+  }
+
+  void testRoundTrip() {
+    for (auto write_backend : backends()) {
+      for (auto read_backend : backends()) {
+        bsonio::JournalWriter writer(kJournalTestChunk, kJournalTestDepth);
+        TS_ASSERT(writer.open(path.c_str(), write_backend));
+        TS_ASSERT_EQUALS(writer.backend(), write_backend);
+        for (int32_t i = 0; i < kJournalTestDocs; i++) {
+          append_seq(writer, i);
+        }
+        size_t size = writer.size();
+        TS_ASSERT(writer.close());
+
+        bsonio::JournalReader reader(kJournalTestChunk, kJournalTestDepth,
+                                     true);
+        TS_ASSERT(reader.open(path.c_str(), read_backend));
+        TS_ASSERT_EQUALS(reader.backend(), read_backend);
+        TS_ASSERT_EQUALS(reader.size(), size);
+        TS_ASSERT_EQUALS(readAll(reader), kJournalTestDocs);
+        TS_ASSERT_EQUALS(reader.status(), bsonio::StreamStatus::End);
+        TS_ASSERT_EQUALS(reader.offset(), size);
+      }
+    }
+  }
+
+  void testFlush() {
+    bsonio::JournalWriter writer(kJournalTestChunk, kJournalTestDepth);
+    TS_ASSERT(writer.open(path.c_str()));
+    TS_ASSERT(writer.backend() != bsonio::JournalBackend::Auto);
+    append_seq(writer, 0);
+    append_seq(writer, 1);
+    TS_ASSERT(writer.flush());
+
+    // Visible to a reader without closing.
+    bsonio::JournalReader reader(kJournalTestChunk, kJournalTestDepth);
+    TS_ASSERT(reader.open(path.c_str()));
+    TS_ASSERT_EQUALS(readAll(reader), 2);
+
+    append_seq(writer, 2);
+    TS_ASSERT(writer.close());
+    TS_ASSERT(reader.open(path.c_str()));
+    TS_ASSERT_EQUALS(readAll(reader), 3);
+  }
+
+  void testLimits() {
+    bsonio::JournalWriter writer(kJournalTestChunk, kJournalTestDepth);
+    TS_ASSERT(writer.open(path.c_str()));
+    size_t max = writer.maxDocumentSize();
+    TS_ASSERT_EQUALS(max, kJournalTestDepth * kJournalTestChunk);
+
+    // The largest document fits, however full the ring is.
+    std::vector<uint8_t> big(max, 0);
+    big[0] = max & 0xFF;
+    big[1] = (max >> 8) & 0xFF;
+    for (int i = 0; i < 3; i++) {
+      append_seq(writer, i);
+      TS_ASSERT_EQUALS(writer.append(big.data(), max).status,
+                       bsons::Status::Ok);
+    }
+    bsons::Result res = writer.append(big.data(), max + 1);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, max + 1);
+    TS_ASSERT(writer.close());
+
+    bsonio::JournalReader reader(kJournalTestChunk, kJournalTestDepth);
+    TS_ASSERT(reader.open(path.c_str()));
+    TS_ASSERT_EQUALS(reader.maxDocumentSize(), max);
+    bsond::Document doc;
+    size_t count = 0;
+    while (reader.next(doc)) {
+      count++;
+    }
+    TS_ASSERT_EQUALS(count, 6u);
+    TS_ASSERT_EQUALS(reader.status(), bsonio::StreamStatus::End);
+
+    // Too large for a smaller reader.
+    bsonio::JournalReader small(kJournalTestChunk, 1);
+    TS_ASSERT(small.open(path.c_str()));
+    TS_ASSERT(small.next(doc));
+    TS_ASSERT(!small.next(doc));
+    TS_ASSERT_EQUALS(small.status(), bsonio::StreamStatus::Invalid);
+  }
+
+  void testTruncated() {
+    bsonio::JournalWriter writer(kJournalTestChunk, kJournalTestDepth);
+    TS_ASSERT(writer.open(path.c_str()));
+    for (int32_t i = 0; i < 10; i++) {
+      append_seq(writer, i);
+    }
+    size_t size = writer.size();
+    TS_ASSERT(writer.close());
+    TS_ASSERT_EQUALS(truncate(path.c_str(), size - 3), 0);
+
+    for (auto backend : backends()) {
+      bsonio::JournalReader reader(kJournalTestChunk, kJournalTestDepth);
+      TS_ASSERT(reader.open(path.c_str(), backend));
+      TS_ASSERT_EQUALS(readAll(reader), 9);
+      TS_ASSERT_EQUALS(reader.status(), bsonio::StreamStatus::Truncated);
+      TS_ASSERT(reader.offset() < size - 3);
+    }
+  }
+
+  void testEmpty() {
+    bsonio::JournalReader reader;
+    TS_ASSERT(!reader.open(path.c_str()));
+
+    bsonio::JournalWriter writer;
+    TS_ASSERT(writer.open(path.c_str()));
+    TS_ASSERT(writer.close());
+
+    TS_ASSERT(reader.open(path.c_str()));
+    bsond::Document doc;
+    TS_ASSERT(!reader.next(doc));
+    TS_ASSERT_EQUALS(reader.status(), bsonio::StreamStatus::End);
+    TS_ASSERT_EQUALS(reader.error(), 0);
+  }
+};
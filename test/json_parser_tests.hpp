@@ -0,0 +1,169 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/json/parser.hpp"
+#include "../src/bson/json/writer.hpp"
+#include "cxxtest/TestSuite.h"
+#include <cstring>
+#include <string>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsonj = pot::bson::json;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kJsonParseBufSize = 1024;
+
+class JsonParserTests : public CxxTest::TestSuite {
+  uint8_t buf[kJsonParseBufSize];
+
+  bsonj::ParseResult parse(const std::string &json) {
+    return bsonj::parse(json.data(), json.size(), buf, kJsonParseBufSize);
+  }
+
+public:
+  void testMatchesSerializer() {
+    bsonj::ParseResult res = parse(
+        " { \"name\" : \"sensor\", \"temp\": 21.5, \"count\": -42,\n"
+        "\"on\": true, \"off\": false, \"none\": null,\n"
+        "\"state\": {\"mode\": \"auto\", \"empty\": {}},\n"
+        "\"list\": [1, \"a\", [], [0.5], {\"x\": 2}] }\n");
+    TS_ASSERT_EQUALS(res.status, bsonj::ParseStatus::Ok);
+
+    uint8_t expected[kJsonParseBufSize];
+    bsons::Result exp = bsons::Document::build(
+        expected, kJsonParseBufSize, [](bsons::Document &doc) {
+          doc.appendStr("name", "sensor")
+              .appendDouble("temp", 21.5)
+              .appendInt32("count", -42)
+              .appendBool("on", true)
+              .appendBool("off", false)
+              .appendNull("none")
+              .appendDoc("state",
+                         [](bsons::Document &sdoc) {
+                           sdoc.appendStr("mode", "auto")
+                               .appendDoc("empty", [](bsons::Document &) {});
+                         })
+              .appendArr("list", [](bsons::Array &arr) {
+                arr.appendInt32(1)
+                    .appendStr("a")
+                    .appendArr([](bsons::Array &) {})
+                    .appendArr([](bsons::Array &inner) {
+                      inner.appendDouble(0.5);
+                    })
+                    .appendDoc([](bsons::Document &doc) {
+                      doc.appendInt32("x", 2);
+                    });
+              });
+        });
+
+    TS_ASSERT_EQUALS(res.len, exp.len);
+    TS_ASSERT_EQUALS(memcmp(buf, expected, exp.len), 0);
+  }
+
+  void testNumbers() {
+    bsonj::ParseResult res = parse(
+        "{\"i32\": 2147483647, \"min32\": -2147483648, \"i64\": 2147483648,"
+        "\"min64\": -9223372036854775808, \"big\": 9223372036854775808,"
+        "\"one\": 1.0, \"exp\": 1e2, \"neg0\": -0.0, \"tiny\": 5e-324,"
+        "\"long\": 0.30000000000000004441, \"pi\": 3.141592653589793}");
+    TS_ASSERT_EQUALS(res.status, bsonj::ParseStatus::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("i32", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int32);
+    TS_ASSERT_EQUALS(el.getInt32(), INT32_MAX);
+    TS_ASSERT(doc.getElByName("min32", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int32);
+    TS_ASSERT_EQUALS(el.getInt32(), INT32_MIN);
+    TS_ASSERT(doc.getElByName("i64", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int64);
+    TS_ASSERT_EQUALS(el.getInt64(), 2147483648);
+    TS_ASSERT(doc.getElByName("min64", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int64);
+    TS_ASSERT_EQUALS(el.getInt64(), INT64_MIN);
+    TS_ASSERT(doc.getElByName("big", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Double);
+    TS_ASSERT_EQUALS(el.getDouble(), 9223372036854775808.0);
+
+    TS_ASSERT(doc.getElByName("one", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Double);
+    TS_ASSERT_EQUALS(el.getDouble(), 1.0);
+    TS_ASSERT(doc.getElByName("exp", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 100.0);
+    TS_ASSERT(doc.getElByName("neg0", el));
+    TS_ASSERT(std::signbit(el.getDouble()));
+    TS_ASSERT(doc.getElByName("tiny", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 5e-324);
+    TS_ASSERT(doc.getElByName("long", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 0.1 + 0.2);
+    TS_ASSERT(doc.getElByName("pi", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 3.141592653589793);
+  }
+
+  void testEscapes() {
+    bsonj::ParseResult res =
+        parse("{\"k\\\"ey\": \"a\\\"b\\\\c\\/d\\n\\u00e9\\ud83d\\ude00\\u0000"
+              "end\"}");
+    TS_ASSERT_EQUALS(res.status, bsonj::ParseStatus::Ok);
+
+    bsond::Document doc(buf, res.len);
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("k\"ey", el));
+
+    const char expected[] = "a\"b\\c/d\n\xC3\xA9\xF0\x9F\x98\x80\0end";
+    TS_ASSERT_EQUALS(el.getStrLen(), sizeof(expected) - 1);
+    TS_ASSERT_EQUALS(memcmp(el.getStrRef(), expected, sizeof(expected)), 0);
+  }
+
+  void testRoundTrip() {
+    std::string json =
+        "{\"name\":\"a \\\"quoted\\\" name\",\"temp\":-0.1,\"whole\":3.0,"
+        "\"ts\":1700000000000,\"list\":[1,true,null,{\"x\":1e+300}]}";
+    bsonj::ParseResult res = parse(json);
+    TS_ASSERT_EQUALS(res.status, bsonj::ParseStatus::Ok);
+
+    char out[kJsonParseBufSize];
+    bsons::Result written =
+        bsonj::to_json(bsond::Document(buf, res.len), out, kJsonParseBufSize);
+    TS_ASSERT_EQUALS(std::string(out, written.len), json);
+  }
+
+  void testOverflow() {
+    std::string json = "{\"a\": \"a fairly long string value\", \"b\": [1,2]}";
+    bsonj::ParseResult full = parse(json);
+
+    uint8_t small[16];
+    bsonj::ParseResult res =
+        bsonj::parse(json.data(), json.size(), small, sizeof(small));
+    TS_ASSERT_EQUALS(res.status, bsonj::ParseStatus::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, full.len);
+  }
+
+  void testErrors() {
+    const char *invalid[] = { "",           "[1]",         "{",
+                              "{\"a\"}",    "{\"a\":}",    "{\"a\":1,}",
+                              "{\"a\":01}", "{\"a\":1.}",  "{\"a\":-}",
+                              "{\"a\":tru}", "{\"a\":\"x}", "{\"a\":1} x",
+                              "{\"a\":\"\\x\"}", "{\"a\":\"\\ud800\"}",
+                              "{\"a\":\"\x01\"}" };
+
+    for (const char *json : invalid) {
+      TS_ASSERT_EQUALS(parse(json).status, bsonj::ParseStatus::Syntax);
+    }
+
+    bsonj::ParseResult res = parse("{\"a\": [1, 2,, 3]}");
+    TS_ASSERT_EQUALS(res.status, bsonj::ParseStatus::Syntax);
+    TS_ASSERT_EQUALS(res.offset, 12);
+
+    std::string deep(100, '[');
+    TS_ASSERT_EQUALS(parse("{\"a\":" + deep).status,
+                     bsonj::ParseStatus::TooDeep);
+
+    TS_ASSERT_EQUALS(parse("{\"" + std::string(100, 'k') + "\":1}").status,
+                     bsonj::ParseStatus::TooLong);
+    TS_ASSERT_EQUALS(parse("{\"\\u0000\":1}").status,
+                     bsonj::ParseStatus::TooLong);
+  }
+};
@@ -0,0 +1,166 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/json/writer.hpp"
+#include "cxxtest/TestSuite.h"
+#include <cstring>
+#include <string>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsonj = pot::bson::json;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kJsonBufSize = 4096;
+
+class JsonWriterTests : public CxxTest::TestSuite {
+  uint8_t buf[kJsonBufSize];
+  size_t len;
+
+  std::string json(const bsonj::Mode mode) {
+    char out[kJsonBufSize];
+    bsons::Result res =
+        bsonj::to_json(bsond::Document(buf, len), out, kJsonBufSize, mode);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    return std::string(out, res.len);
+  }
+
+public:
+  void setUp() {
+    static const uint8_t bin[] = { 0xDE, 0xAD, 0xBE, 0xEF };
+    bsons::Result res = bsons::Document::build(
+        buf, kJsonBufSize, [](bsons::Document &doc) {
+          doc.appendStr("name", "sensor")
+              .appendDouble("temp", 21.5)
+              .appendDouble("whole", 3)
+              .appendInt32("count", -42)
+              .appendInt64("ts", 1700000000000)
+              .appendBool("on", true)
+              .appendNull("none")
+              .appendBin("raw", bin, 4)
+              .appendDoc("state",
+                         [](bsons::Document &sdoc) {
+                           sdoc.appendBool("off", false);
+                         })
+              .appendArr("list", [](bsons::Array &arr) {
+                arr.appendInt32(1).appendStr("a").appendDouble(0.1);
+              });
+        });
+    len = res.len;
+  }
+
+  void testRelaxed() {
+    TS_ASSERT_EQUALS(
+        json(bsonj::Mode::Relaxed),
+        "{\"name\":\"sensor\",\"temp\":21.5,\"whole\":3.0,\"count\":-42,"
+        "\"ts\":1700000000000,\"on\":true,\"none\":null,"
+        "\"raw\":{\"$binary\":{\"base64\":\"3q2+7w==\",\"subType\":\"00\"}},"
+        "\"state\":{\"off\":false},\"list\":[1,\"a\",0.1]}");
+  }
+
+  void testCanonical() {
+    TS_ASSERT_EQUALS(
+        json(bsonj::Mode::Canonical),
+        "{\"name\":\"sensor\",\"temp\":{\"$numberDouble\":\"21.5\"},"
+        "\"whole\":{\"$numberDouble\":\"3.0\"},"
+        "\"count\":{\"$numberInt\":\"-42\"},"
+        "\"ts\":{\"$numberLong\":\"1700000000000\"},\"on\":true,"
+        "\"none\":null,"
+        "\"raw\":{\"$binary\":{\"base64\":\"3q2+7w==\",\"subType\":\"00\"}},"
+        "\"state\":{\"off\":false},"
+        "\"list\":[{\"$numberInt\":\"1\"},\"a\",{\"$numberDouble\":\"0.1\"}]}");
+  }
+
+  void testOverflow() {
+    char out[16];
+    bsons::Result res = bsonj::to_json(bsond::Document(buf, len), out, 16);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, json(bsonj::Mode::Relaxed).size());
+    TS_ASSERT_EQUALS(memcmp(out, "{\"name\":\"sensor\"", 16), 0);
+  }
+
+  void testSink() {
+    // Enough strings to span several chunks.
+    len = bsons::Document::build(buf, kJsonBufSize, [](bsons::Document &doc) {
+            doc.appendArr("lines", [](bsons::Array &arr) {
+              for (size_t i = 0; i < 100; i++) {
+                arr.appendStr("a line of \"quoted\" log output");
+              }
+            });
+          }).len;
+
+    std::string out;
+    size_t calls = 0;
+    size_t total = bsonj::to_json(bsond::Document(buf, len),
+                                  [&](const char str[], size_t n) {
+                                    out.append(str, n);
+                                    calls++;
+                                  });
+
+    TS_ASSERT_EQUALS(total, out.size());
+    TS_ASSERT_EQUALS(out, json(bsonj::Mode::Relaxed));
+    TS_ASSERT(calls > 1);
+  }
+
+  void testEscape() {
+    len = bsons::Document::build(buf, kJsonBufSize, [](bsons::Document &doc) {
+            doc.appendStr("k\"ey", "plain text, then \"quotes\" \\ and\n\t\x01"
+                                   "\xC3\xA9t\xC3\xA9 and a long clean tail");
+          }).len;
+
+    TS_ASSERT_EQUALS(json(bsonj::Mode::Relaxed),
+                     "{\"k\\\"ey\":\"plain text, then \\\"quotes\\\" \\\\ "
+                     "and\\n\\t\\u0001\xC3\xA9t\xC3\xA9 and a long clean "
+                     "tail\"}");
+  }
+
+  void testBase64() {
+    static const uint8_t bin[] = "Many hands make light work.";
+    const char *expected[] = { "",         "TQ==",     "TWE=",    "TWFu",
+                               "TWFueQ==", "TWFueSA=", "TWFueSBo" };
+
+    for (size_t n = 0; n < 7; n++) {
+      len = bsons::Document::build(buf, kJsonBufSize,
+                                   [n](bsons::Document &doc) {
+                                     doc.appendBin("b", bin, n);
+                                   })
+                .len;
+      TS_ASSERT_EQUALS(json(bsonj::Mode::Relaxed),
+                       std::string("{\"b\":{\"$binary\":{\"base64\":\"") +
+                           expected[n] + "\",\"subType\":\"00\"}}}");
+    }
+
+    len = bsons::Document::build(buf, kJsonBufSize, [](bsons::Document &doc) {
+            doc.appendBin("b", bin, 27);
+          }).len;
+    TS_ASSERT_EQUALS(json(bsonj::Mode::Relaxed),
+                     "{\"b\":{\"$binary\":{\"base64\":\""
+                     "TWFueSBoYW5kcyBtYWtlIGxpZ2h0IHdvcmsu"
+                     "\",\"subType\":\"00\"}}}");
+  }
+
+  void testFormatDouble() {
+    const double values[] = { 0.1,    -0.0,   1e300, 5e-324,
+                              1e21,   1e-5,   0.0001, 100,
+                              -3.25,  1.7976931348623157e308 };
+    const char *expected[] = { "0.1",   "-0.0",   "1e+300", "5e-324",
+                               "1e+21", "1e-5",   "0.0001", "100.0",
+                               "-3.25", "1.7976931348623157e+308" };
+
+    for (size_t i = 0; i < 10; i++) {
+      char out[bsonj::kDoubleBufSize];
+      size_t n = bsonj::format_double(values[i], out);
+      TS_ASSERT_EQUALS(std::string(out, n), expected[i]);
+      TS_ASSERT_EQUALS(strtod(std::string(out, n).c_str(), nullptr),
+                       values[i]);
+    }
+  }
+
+  void testNonFinite() {
+    len = bsons::Document::build(buf, kJsonBufSize, [](bsons::Document &doc) {
+            doc.appendDouble("inf", -INFINITY).appendDouble("nan", NAN);
+          }).len;
+
+    TS_ASSERT_EQUALS(json(bsonj::Mode::Relaxed),
+                     "{\"inf\":{\"$numberDouble\":\"-Infinity\"},"
+                     "\"nan\":{\"$numberDouble\":\"NaN\"}}");
+  }
+};
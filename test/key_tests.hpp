@@ -0,0 +1,134 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/deserializer/shape_index.hpp"
+#include "../src/bson/deserializer/tape.hpp"
+#include "../src/bson/key.hpp"
+#include "cxxtest/TestSuite.h"
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kKeyBufSize = 128;
+
+static constexpr bson::Key kTempKey = POT_BSON_KEY("temp");
+static_assert(kTempKey.len() == 4, "");
+static_assert(kTempKey.hash() == bson::hash::fnv1a_str("temp"), "");
+
+class KeyTests : public CxxTest::TestSuite {
+  uint8_t buf[kKeyBufSize];
+  size_t len;
+
+public:
+  void setUp() {
+    bsons::Result res = bsons::Document::build(
+        buf, kKeyBufSize, [](bsons::Document &doc) {
+          doc.appendStr("name", "sensor")
+              .appendDouble("temperature", 1.5)
+              .appendDouble("temp", 21.5)
+              .appendDoc("state", [](bsons::Document &sdoc) {
+                sdoc.appendBool("on", true);
+              });
+        });
+    len = res.len;
+  }
+
+  void testRuntimeKey() {
+    bson::Key key("temp");
+    TS_ASSERT_EQUALS(key.len(), kTempKey.len());
+    TS_ASSERT_EQUALS(key.hash(), kTempKey.hash());
+    TS_ASSERT(key.equals("temp"));
+    TS_ASSERT(!key.equals("tempe"));
+    TS_ASSERT(!key.equals("tem"));
+  }
+
+  void testGetElByName() {
+    bsond::Document doc(buf, len);
+    bsond::DocumentElement el;
+
+    // "temperature" shares the prefix but not the length.
+    TS_ASSERT(doc.getElByName(kTempKey, el));
+    TS_ASSERT_EQUALS(el.getDouble(), 21.5);
+
+    TS_ASSERT(doc.getElByName(POT_BSON_KEY("name"), el));
+    TS_ASSERT(el.strEquals("sensor"));
+
+    TS_ASSERT(!doc.getElByName(POT_BSON_KEY("te"), el));
+    // Longer than every name it shares a prefix with.
+    TS_ASSERT(!doc.getElByName(POT_BSON_KEY("temperatures"), el));
+    TS_ASSERT(!doc.getElByName(POT_BSON_KEY("missing"), el));
+  }
+
+  void testAppendMatchesStrings() {
+    uint8_t keyed[kKeyBufSize];
+    uint8_t data[] = { 1, 2, 3 };
+
+    auto build = [&data](uint8_t out[], size_t out_len, bool keys) {
+      return bsons::Document::build(
+          out, out_len, [keys, &data](bsons::Document &doc) {
+            if (keys) {
+              doc.appendDouble(POT_BSON_KEY("d"), 1.5)
+                  .appendStr(POT_BSON_KEY("s"), "str")
+                  .appendBin(POT_BSON_KEY("b"), data, 3)
+                  .appendBool(POT_BSON_KEY("t"), true)
+                  .appendNull(POT_BSON_KEY("n"))
+                  .appendInt32(POT_BSON_KEY("i"), 32)
+                  .appendInt64(POT_BSON_KEY("l"), 64)
+                  .appendDoc(POT_BSON_KEY("doc"),
+                             [](bsons::Document &child) {
+                               child.appendInt32(POT_BSON_KEY("x"), 1);
+                             })
+                  .appendArr(POT_BSON_KEY("arr"), [](bsons::Array &arr) {
+                    arr.appendInt32(1).appendInt32(2);
+                  });
+            } else {
+              doc.appendDouble("d", 1.5)
+                  .appendStr("s", "str")
+                  .appendBin("b", data, 3)
+                  .appendBool("t", true)
+                  .appendNull("n")
+                  .appendInt32("i", 32)
+                  .appendInt64("l", 64)
+                  .appendDoc("doc",
+                             [](bsons::Document &child) {
+                               child.appendInt32("x", 1);
+                             })
+                  .appendArr("arr", [](bsons::Array &arr) {
+                    arr.appendInt32(1).appendInt32(2);
+                  });
+            }
+          });
+    };
+
+    bsons::Result res = build(keyed, kKeyBufSize, true);
+    bsons::Result expected = build(buf, kKeyBufSize, false);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, expected.len);
+    TS_ASSERT_SAME_DATA(keyed, buf, res.len);
+
+    // Keys that don't fit still count towards the length.
+    for (size_t cut = 1; cut < 10; cut++) {
+      res = build(keyed, cut, true);
+      TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+      TS_ASSERT_EQUALS(res.len, expected.len);
+    }
+  }
+
+  void testIndices() {
+    const char *keys[] = { "temp", "state" };
+    bsond::ShapeIndex<> index(keys, 2);
+    index.bind(bsond::Document(buf, len));
+
+    bsond::DocumentElement el;
+    TS_ASSERT(index.getElByName(kTempKey, el));
+    TS_ASSERT_EQUALS(el.getDouble(), 21.5);
+    TS_ASSERT(index.getElByName(POT_BSON_KEY("temperature"), el));
+    TS_ASSERT_EQUALS(el.getDouble(), 1.5);
+
+    bsond::TapeEntry entries[8];
+    bsond::Tape tape(entries, 8);
+    TS_ASSERT(tape.parse(bsond::Document(buf, len)));
+    size_t state = tape.find(0, POT_BSON_KEY("state"));
+    TS_ASSERT(tape[tape.find(state, POT_BSON_KEY("on"))].getBool());
+    TS_ASSERT_EQUALS(tape[tape.find(0, kTempKey)].getDouble(), 21.5);
+  }
+};
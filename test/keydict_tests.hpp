@@ -0,0 +1,164 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/keydict/keydict.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonk = pot::bson::keydict;
+
+static constexpr size_t kKeyDictBufSize = 512;
+
+static const char *const kDictKeys[] = { "timestamp", "deviceId", "value",
+                                         "readings",  "unit",     "value" };
+
+size_t build_standard(uint8_t buf[]) {
+  return bsons::Document::build(
+             buf, kKeyDictBufSize,
+             [](bsons::Document &doc) {
+               doc.appendStr("deviceId", "edge-gw-0042")
+                   .appendInt64("timestamp", 1700000000000)
+                   .appendStr("site", "north")
+                   .appendArr("readings", [](bsons::Array &arr) {
+                     for (int i = 0; i < 3; i++) {
+                       arr.appendDoc([i](bsons::Document &reading) {
+                         reading.appendDouble("value", i * 1.5)
+                             .appendStr("unit", "C")
+                             .appendBool("calibrated", i % 2);
+                       });
+                     }
+                   });
+             })
+      .len;
+}
+
+class KeyDictTests : public CxxTest::TestSuite {
+public:
+  void testDictionary() {
+    bsonk::KeyDictionary dict(3, kDictKeys, 6);
+    TS_ASSERT_EQUALS(dict.version(), 3u);
+    // The repeated "value" is dropped.
+    TS_ASSERT_EQUALS(dict.size(), 5u);
+
+    uint8_t id;
+    TS_ASSERT(dict.find("value", 5, id));
+    TS_ASSERT_EQUALS(id, 2);
+    TS_ASSERT_EQUALS(strcmp(dict.name(id), "value"), 0);
+    TS_ASSERT(!dict.find("valu", 4, id));
+    TS_ASSERT(!dict.find("site", 4, id));
+
+    pot::bson::Key ref = dict.key("unit");
+    TS_ASSERT_EQUALS(ref.len(), bsonk::kKeyRefSize);
+    TS_ASSERT(bsonk::is_key_ref(ref.str()));
+    TS_ASSERT(dict.refId(ref.str(), id));
+    TS_ASSERT_EQUALS(id, 4);
+
+    pot::bson::Key plain = dict.key("site");
+    TS_ASSERT_EQUALS(plain.len(), 4u);
+    TS_ASSERT(plain.equals("site"));
+  }
+
+  void testRoundTrip() {
+    bsonk::KeyDictionary dict(7, kDictKeys, 6);
+    uint8_t standard[kKeyDictBufSize];
+    size_t len = build_standard(standard);
+
+    uint8_t compact[kKeyDictBufSize];
+    bsonk::Result res =
+        bsonk::compact(standard, len, compact, sizeof(compact), dict);
+    TS_ASSERT_EQUALS(res.status, bsonk::Status::Ok);
+    TS_ASSERT_LESS_THAN(res.len, len);
+
+    bsond::Document doc(compact, res.len);
+    TS_ASSERT(doc.valid());
+    uint32_t version;
+    TS_ASSERT(bsonk::compact_version(doc, version));
+    TS_ASSERT_EQUALS(version, 7u);
+
+    // Looked up by reference, or expanded lazily.
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName(dict.key("timestamp"), el));
+    TS_ASSERT_EQUALS(el.getInt64(), 1700000000000);
+    TS_ASSERT_EQUALS(strcmp(bsonk::element_name(el, dict), "timestamp"), 0);
+    TS_ASSERT(!doc.getElByName("timestamp", el));
+    TS_ASSERT(doc.getElByName(dict.key("site"), el));
+    TS_ASSERT_EQUALS(strcmp(bsonk::element_name(el, dict), "site"), 0);
+
+    uint8_t expanded[kKeyDictBufSize];
+    bsonk::Result back =
+        bsonk::expand(compact, res.len, expanded, sizeof(expanded), dict);
+    TS_ASSERT_EQUALS(back.status, bsonk::Status::Ok);
+    TS_ASSERT_EQUALS(back.len, len);
+    TS_ASSERT_SAME_DATA(expanded, standard, len);
+  }
+
+  void testBuildCompact() {
+    bsonk::KeyDictionary dict(1, kDictKeys, 6);
+
+    // Built directly with references, after the version.
+    uint8_t built[kKeyDictBufSize];
+    bsons::Result res = bsons::Document::build(
+        built, kKeyDictBufSize, [&dict](bsons::Document &doc) {
+          doc.appendInt32(pot::bson::Key(bsonk::kVersionKey), dict.version())
+              .appendStr(dict.key("deviceId"), "edge-gw-0042")
+              .appendInt64(dict.key("timestamp"), 1700000000000)
+              .appendStr(dict.key("site"), "north");
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    uint8_t standard[kKeyDictBufSize];
+    bsonk::Result back =
+        bsonk::expand(built, res.len, standard, sizeof(standard), dict);
+    TS_ASSERT_EQUALS(back.status, bsonk::Status::Ok);
+
+    bsond::Document doc(standard, back.len);
+    TS_ASSERT(doc.valid());
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("deviceId", el));
+    TS_ASSERT(el.strEquals("edge-gw-0042"));
+    TS_ASSERT(doc.getElByName("site", el));
+
+    // And compacts back to the same bytes.
+    uint8_t compact[kKeyDictBufSize];
+    bsonk::Result again =
+        bsonk::compact(standard, back.len, compact, sizeof(compact), dict);
+    TS_ASSERT_EQUALS(again.len, res.len);
+    TS_ASSERT_SAME_DATA(compact, built, res.len);
+  }
+
+  void testErrors() {
+    bsonk::KeyDictionary dict(1, kDictKeys, 6);
+    bsonk::KeyDictionary other(2, kDictKeys, 6);
+    bsonk::KeyDictionary smaller(1, kDictKeys, 2);
+
+    uint8_t standard[kKeyDictBufSize];
+    size_t len = build_standard(standard);
+    uint8_t compact[kKeyDictBufSize];
+    bsonk::Result res =
+        bsonk::compact(standard, len, compact, sizeof(compact), dict);
+
+    uint8_t out[kKeyDictBufSize];
+    TS_ASSERT_EQUALS(
+        bsonk::expand(compact, res.len, out, sizeof(out), other).status,
+        bsonk::Status::VersionMismatch);
+    TS_ASSERT_EQUALS(
+        bsonk::expand(standard, len, out, sizeof(out), dict).status,
+        bsonk::Status::VersionMismatch);
+    TS_ASSERT_EQUALS(
+        bsonk::expand(compact, res.len, out, sizeof(out), smaller).status,
+        bsonk::Status::UnknownKey);
+
+    // A compact document isn't standard BSON.
+    TS_ASSERT_EQUALS(
+        bsonk::compact(compact, res.len, out, sizeof(out), dict).status,
+        bsonk::Status::Unsupported);
+
+    bsonk::Result small = bsonk::compact(standard, len, out, 16, dict);
+    TS_ASSERT_EQUALS(small.status, bsonk::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(small.len, res.len);
+    small = bsonk::expand(compact, res.len, out, 16, dict);
+    TS_ASSERT_EQUALS(small.status, bsonk::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(small.len, len);
+  }
+};
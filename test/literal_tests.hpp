@@ -0,0 +1,76 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/literal/document.hpp"
+#include "cxxtest/TestSuite.h"
+#include <cstring>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace lit = pot::bson::literal;
+
+static constexpr size_t kLiteralBufSize = 256;
+
+static constexpr auto kHeartbeat =
+    lit::to_array(lit::document(lit::field("type", "hb"),
+                                lit::field("seq", 7)));
+static_assert(kHeartbeat.size() == 27, "");
+static_assert(kHeartbeat[0] == 27 && kHeartbeat[26] == 0, "");
+
+static constexpr auto kCaps = lit::to_array(lit::document(
+    lit::field("name", "sensor"), lit::field("ts", INT64_C(1700000000000)),
+    lit::field("temp", 21.5), lit::field("cold", -0.1),
+    lit::field("tiny", 1e-310), lit::field("huge", 1e300),
+    lit::field("on", true), lit::field("off", false),
+    lit::field("none", nullptr), lit::field("offset", -40),
+    lit::field("state", lit::document(lit::field("mode", "auto"))),
+    lit::field("caps", lit::array("ota", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                  lit::document()))));
+
+class LiteralTests : public CxxTest::TestSuite {
+public:
+  void testHeartbeat() {
+    uint8_t buf[kLiteralBufSize];
+    bsons::Result res =
+        bsons::Document::build(buf, kLiteralBufSize, [](bsons::Document &doc) {
+          doc.appendStr("type", "hb").appendInt32("seq", 7);
+        });
+
+    TS_ASSERT_EQUALS(res.len, kHeartbeat.size());
+    TS_ASSERT_EQUALS(memcmp(buf, kHeartbeat.data(), res.len), 0);
+  }
+
+  void testAllTypes() {
+    uint8_t buf[kLiteralBufSize];
+    bsons::Result res =
+        bsons::Document::build(buf, kLiteralBufSize, [](bsons::Document &doc) {
+          doc.appendStr("name", "sensor")
+              .appendInt64("ts", 1700000000000)
+              .appendDouble("temp", 21.5)
+              .appendDouble("cold", -0.1)
+              .appendDouble("tiny", 1e-310)
+              .appendDouble("huge", 1e300)
+              .appendBool("on", true)
+              .appendBool("off", false)
+              .appendNull("none")
+              .appendInt32("offset", -40)
+              .appendDoc("state",
+                         [](bsons::Document &sdoc) {
+                           sdoc.appendStr("mode", "auto");
+                         })
+              .appendArr("caps", [](bsons::Array &arr) {
+                arr.appendStr("ota");
+                for (int32_t i = 1; i <= 10; i++) {
+                  arr.appendInt32(i);
+                }
+                arr.appendDoc([](bsons::Document &) {});
+              });
+        });
+
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, kCaps.size());
+    TS_ASSERT_EQUALS(memcmp(buf, kCaps.data(), res.len), 0);
+
+    bsond::Document doc(kCaps.data(), kCaps.size());
+    TS_ASSERT(doc.valid());
+  }
+};
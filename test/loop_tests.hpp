@@ -0,0 +1,188 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/io/document_stream.hpp"
+#include "../src/bson/io/loop.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+
+static constexpr size_t kLoopRingSize = 64 * 1024;
+static constexpr size_t kLoopFrameMax = 4096;
+
+size_t write_seq(uint8_t buf[], const size_t cap, const int32_t seq) {
+  return bsons::Document::build(buf, cap,
+                                [seq](bsons::Document &doc) {
+                                  doc.appendInt32("seq", seq);
+                                })
+      .len;
+}
+
+class LoopTests : public CxxTest::TestSuite {
+public:
+  void testEchoBatch() {
+    int fds[2];
+    TS_ASSERT_EQUALS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    bsonio::Loop loop(kLoopRingSize, kLoopFrameMax, true);
+    TS_ASSERT(loop.open());
+    TS_ASSERT(loop.add(fds[0], [](bsonio::Loop &loop, int fd,
+                                  const bsond::Document &doc) {
+      bsond::DocumentElement el;
+      TS_ASSERT(doc.getElByName("seq", el));
+      int32_t seq = el.getInt32();
+      loop.send(fd, [seq](bsons::Document &reply) {
+        reply.appendInt32("seq", seq + 100);
+      });
+    }));
+    TS_ASSERT_EQUALS(loop.size(), 1u);
+
+    // Three documents arrive together, and the last one split.
+    uint8_t buf[256];
+    size_t len = 0;
+    for (int32_t i = 0; i < 3; i++) {
+      len += write_seq(&buf[len], sizeof(buf) - len, i);
+    }
+    TS_ASSERT_EQUALS(write(fds[1], buf, len - 3),
+                     static_cast<ssize_t>(len - 3));
+    TS_ASSERT_EQUALS(loop.poll(1000), 1);
+    TS_ASSERT_EQUALS(write(fds[1], &buf[len - 3], 3), 3);
+    TS_ASSERT_EQUALS(loop.poll(1000), 1);
+
+    // The replies were coalesced, and all went out.
+    uint8_t in[256];
+    TS_ASSERT_EQUALS(read(fds[1], in, sizeof(in)), static_cast<ssize_t>(len));
+    bsonio::DocumentStream stream(in, len, true);
+    bsond::Document reply;
+    for (int32_t i = 0; i < 3; i++) {
+      TS_ASSERT(stream.next(reply));
+      bsond::DocumentElement el;
+      TS_ASSERT(reply.getElByName("seq", el));
+      TS_ASSERT_EQUALS(el.getInt32(), i + 100);
+    }
+
+    const bsonio::ConnectionStats *stats = loop.stats(fds[0]);
+    TS_ASSERT(stats != nullptr);
+    TS_ASSERT_EQUALS(stats->docs_in, 3u);
+    TS_ASSERT_EQUALS(stats->docs_out, 3u);
+    TS_ASSERT_EQUALS(stats->bytes_in, len);
+    TS_ASSERT_EQUALS(stats->bytes_out, len);
+    TS_ASSERT_EQUALS(stats->batches, 2u);
+    TS_ASSERT(stats->latency_ns_max >= stats->meanLatencyNs());
+
+    close(fds[1]);
+  }
+
+  void testClose() {
+    bsonio::Loop loop(kLoopRingSize, kLoopFrameMax);
+    TS_ASSERT(loop.open());
+
+    std::vector<bsonio::CloseReason> reasons;
+    uint64_t docs = 0;
+    loop.onClose([&reasons, &docs](int, bsonio::CloseReason reason,
+                                   const bsonio::ConnectionStats &stats) {
+      reasons.push_back(reason);
+      docs += stats.docs_in;
+    });
+
+    auto ignore = [](bsonio::Loop &, int, const bsond::Document &) {};
+    int peer[2];
+    int bad[2];
+    int mine[2];
+    TS_ASSERT_EQUALS(socketpair(AF_UNIX, SOCK_STREAM, 0, peer), 0);
+    TS_ASSERT_EQUALS(socketpair(AF_UNIX, SOCK_STREAM, 0, bad), 0);
+    TS_ASSERT_EQUALS(socketpair(AF_UNIX, SOCK_STREAM, 0, mine), 0);
+    TS_ASSERT(loop.add(peer[0], ignore));
+    TS_ASSERT(loop.add(bad[0], ignore));
+    TS_ASSERT(loop.add(mine[0], ignore));
+    TS_ASSERT(!loop.add(mine[0], ignore));
+
+    // A final document, then the peer hangs up.
+    uint8_t buf[64];
+    size_t len = write_seq(buf, sizeof(buf), 1);
+    TS_ASSERT_EQUALS(write(peer[1], buf, len), static_cast<ssize_t>(len));
+    close(peer[1]);
+    TS_ASSERT(loop.poll(1000) >= 1);
+    TS_ASSERT_EQUALS(reasons.size(), 1u);
+    TS_ASSERT_EQUALS(reasons[0], bsonio::CloseReason::PeerClosed);
+    TS_ASSERT_EQUALS(docs, 1u);
+
+    // Larger than the maximum frame.
+    uint8_t huge[] = { 0x00, 0x00, 0x01, 0x00 };
+    TS_ASSERT_EQUALS(write(bad[1], huge, sizeof(huge)), 4);
+    TS_ASSERT(loop.poll(1000) >= 1);
+    TS_ASSERT_EQUALS(reasons.size(), 2u);
+    TS_ASSERT_EQUALS(reasons[1], bsonio::CloseReason::BadFrame);
+
+    loop.close(mine[0]);
+    TS_ASSERT_EQUALS(reasons.size(), 3u);
+    TS_ASSERT_EQUALS(reasons[2], bsonio::CloseReason::Requested);
+    TS_ASSERT_EQUALS(loop.size(), 0u);
+    TS_ASSERT(loop.stats(mine[0]) == nullptr);
+    // The loop closed its end.
+    TS_ASSERT_EQUALS(read(mine[1], buf, sizeof(buf)), 0);
+
+    close(bad[1]);
+    close(mine[1]);
+  }
+
+  void testBackpressure() {
+    int fds[2];
+    TS_ASSERT_EQUALS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    int small = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+    bsonio::Loop loop(kLoopRingSize, kLoopFrameMax);
+    TS_ASSERT(loop.open());
+    TS_ASSERT(loop.add(fds[0], [](bsonio::Loop &, int,
+                                  const bsond::Document &) {}));
+
+    // More than the socket takes at once.
+    int32_t sent = 0;
+    while (loop.send(fds[0], [sent](bsons::Document &doc) {
+                 doc.appendInt32("seq", sent).appendStr(
+                     "pad", "................................................");
+               }).status == bsons::Status::Ok) {
+      sent++;
+    }
+    TS_ASSERT(sent > 100);
+    loop.poll(0);
+    TS_ASSERT(loop.pending(fds[0]) > 0);
+
+    // Drained as the peer reads.
+    std::vector<uint8_t> received;
+    uint8_t buf[4096];
+    for (int i = 0; i < 10000 && loop.pending(fds[0]) > 0; i++) {
+      ssize_t n = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT);
+      if (n > 0) {
+        received.insert(received.end(), buf, buf + n);
+      }
+      loop.poll(10);
+    }
+    TS_ASSERT_EQUALS(loop.pending(fds[0]), 0u);
+
+    ssize_t n;
+    while ((n = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+      received.insert(received.end(), buf, buf + n);
+    }
+
+    bsonio::DocumentStream stream(received.data(), received.size(), true);
+    bsond::Document doc;
+    int32_t seq = 0;
+    while (stream.next(doc)) {
+      bsond::DocumentElement el;
+      TS_ASSERT(doc.getElByName("seq", el));
+      TS_ASSERT_EQUALS(el.getInt32(), seq++);
+    }
+    TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::End);
+    TS_ASSERT_EQUALS(seq, sent);
+    TS_ASSERT_EQUALS(loop.stats(fds[0])->bytes_out, received.size());
+
+    close(fds[1]);
+  }
+};
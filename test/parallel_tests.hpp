@@ -0,0 +1,207 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/parallel/encode.hpp"
+#include "../src/bson/parallel/thread_pool.hpp"
+#include "../src/bson/parallel/validate.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <atomic>
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonio = pot::bson::io;
+namespace bsonp = pot::bson::parallel;
+
+static constexpr size_t kParallelDocs = 300;
+static constexpr size_t kParallelDocSize = 32;
+
+class ParallelTests : public CxxTest::TestSuite {
+  uint8_t buf[kParallelDocs * kParallelDocSize];
+  size_t len;
+
+public:
+  void setUp() {
+    len = 0;
+    for (size_t i = 0; i < kParallelDocs; i++) {
+      bsons::Result res = bsons::Document::build(
+          &buf[len], sizeof(buf) - len,
+          [i](bsons::Document &doc) { doc.appendInt32("seq", i); });
+      len += res.len;
+    }
+  }
+
+  void testRunOnEveryWorker() {
+    bsonp::ThreadPool pool(4);
+    std::atomic<size_t> mask(0);
+
+    for (size_t round = 0; round < 3; round++) {
+      mask = 0;
+      pool.run([&](size_t worker) { mask |= 1 << worker; });
+      TS_ASSERT_EQUALS(mask.load(), 0xF);
+    }
+  }
+
+  void testParallelForCoversRange() {
+    bsonp::ThreadPool pool(3);
+    std::atomic<uint8_t> seen[1000];
+    for (auto &s : seen) {
+      s = 0;
+    }
+
+    bsonp::parallel_for(pool, 1000, 7, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        seen[i]++;
+      }
+    });
+
+    for (auto &s : seen) {
+      TS_ASSERT_EQUALS(s.load(), 1);
+    }
+  }
+
+  void testValidateBatch() {
+    // Corrupt the type of the element in the 10th and 200th documents.
+    size_t doc_len = len / kParallelDocs;
+    buf[10 * doc_len + 4] = 0x7F;
+    buf[200 * doc_len + 4] = 0x7F;
+
+    bsonp::ThreadPool pool(4);
+    bsonio::DocumentStream stream(buf, len);
+    bsond::Document docs[kParallelDocs];
+    bool results[kParallelDocs];
+
+    size_t count =
+        bsonp::validate_batch(pool, stream, docs, results, kParallelDocs, 16);
+    TS_ASSERT_EQUALS(count, kParallelDocs);
+    TS_ASSERT(!stream.next(docs[0]));
+    TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::End);
+
+    for (size_t i = 0; i < count; i++) {
+      TS_ASSERT_EQUALS(results[i], i != 10 && i != 200);
+    }
+
+    // Validating with the default grain gives the same results.
+    TS_ASSERT_EQUALS(bsonp::validate_batch(pool, docs, count, results), 298);
+  }
+
+  void testValidateLarge() {
+    static constexpr size_t kLargeSize = 16 * 1024;
+    static uint8_t large[kLargeSize];
+
+    bsons::Result res = bsons::Document::build(
+        large, kLargeSize, [](bsons::Document &doc) {
+          doc.appendStr("name", "batch")
+              .appendArr("readings",
+                         [](bsons::Array &arr) {
+                           for (int32_t i = 0; i < 200; i++) {
+                             arr.appendDoc([i](bsons::Document &rdoc) {
+                               rdoc.appendInt32("seq", i)
+                                   .appendDouble("temp", i * 0.25)
+                                   .appendBool("alarm", i % 7 == 0);
+                             });
+                           }
+                         })
+              .appendDoc("meta", [](bsons::Document &mdoc) {
+                mdoc.appendInt64("ts", 1000).appendNull("extra");
+              });
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsonp::ThreadPool pool(4);
+    bsonp::LargeDocumentValidator<> validator(1024);
+    TS_ASSERT(validator.valid(pool, large, res.len));
+    // The readings array is split into its documents, meta is kept whole.
+    TS_ASSERT_EQUALS(validator.tasks(), 201);
+    TS_ASSERT(bsonp::validate_large(pool, large, res.len));
+
+    // Corrupt a boolean deep inside the array.
+    uint8_t *alarm = static_cast<uint8_t *>(
+        memmem(&large[res.len / 2], res.len / 2, "alarm", 6));
+    TS_ASSERT(alarm != nullptr);
+    alarm[6] = 2;
+    TS_ASSERT(!bsond::Document(large, res.len).valid());
+    TS_ASSERT(!validator.valid(pool, large, res.len));
+    alarm[6] = 0;
+
+    // Break the array's index keys.
+    uint8_t *index = static_cast<uint8_t *>(
+        memmem(large, res.len, "readings", 9));
+    TS_ASSERT(index != nullptr);
+    index[9 + 4 + 1] = '9';
+    TS_ASSERT(!bsond::Document(large, res.len).valid());
+    TS_ASSERT(!validator.valid(pool, large, res.len));
+    index[9 + 4 + 1] = '0';
+
+    // A truncated buffer fails before any task is queued.
+    TS_ASSERT(validator.valid(pool, large, res.len));
+    TS_ASSERT(!validator.valid(pool, large, res.len - 1));
+  }
+
+  void testEncodeBatch() {
+    bsonp::ThreadPool pool(4);
+    bsonp::BatchEncoder encoder(pool, 16);
+    // Records of varying size, so every offset depends on the ones before.
+    auto builder = [](size_t i, bsons::Document &doc) {
+      doc.appendInt32("seq", i).appendStr("pad", &"abcdefgh"[i % 8]);
+    };
+
+    static uint8_t out[kParallelDocs * kParallelDocSize];
+    bsons::Result res = encoder.encode(kParallelDocs, builder, out, 100);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    size_t total = res.len;
+
+    res = encoder.encode(kParallelDocs, builder, out, sizeof(out));
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, total);
+    TS_ASSERT_EQUALS(encoder.offset(kParallelDocs), total);
+
+    // Matches encoding each record in turn.
+    static uint8_t expected[kParallelDocs * kParallelDocSize];
+    size_t expected_len = 0;
+    for (size_t i = 0; i < kParallelDocs; i++) {
+      TS_ASSERT_EQUALS(encoder.offset(i), expected_len);
+      expected_len += bsons::Document::build(
+                          &expected[expected_len],
+                          sizeof(expected) - expected_len,
+                          [&](bsons::Document &doc) { builder(i, doc); })
+                          .len;
+    }
+    TS_ASSERT_EQUALS(expected_len, total);
+    TS_ASSERT_SAME_DATA(out, expected, total);
+
+    bsonio::DocumentStream stream(out, res.len, true);
+    bsond::Document doc;
+    size_t count = 0;
+    while (stream.next(doc)) {
+      count++;
+    }
+    TS_ASSERT_EQUALS(stream.status(), bsonio::StreamStatus::End);
+    TS_ASSERT_EQUALS(count, kParallelDocs);
+
+    res = encoder.encode(0, builder, out, 0);
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, 0);
+  }
+
+  void testEncodeInconsistent() {
+    bsonp::ThreadPool pool(2);
+    bsonp::BatchEncoder encoder(pool, 16);
+
+    // Grows on its second call for a record, so never fits what was measured.
+    std::atomic<int> calls[kParallelDocs];
+    for (auto &count : calls) {
+      count.store(0);
+    }
+    auto builder = [&calls](size_t i, bsons::Document &doc) {
+      doc.appendInt32("seq", i);
+      if (calls[i].fetch_add(1) > 0) {
+        doc.appendBool("again", true);
+      }
+    };
+
+    static uint8_t out[kParallelDocs * kParallelDocSize];
+    bsons::Result res =
+        encoder.encode(kParallelDocs, builder, out, sizeof(out));
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Inconsistent);
+    TS_ASSERT(res.len <= sizeof(out));
+  }
+};
@@ -0,0 +1,190 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/series/series.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonseries = pot::bson::series;
+
+static constexpr size_t kSeriesBufSize = 4096;
+static constexpr size_t kSeriesLen = 200;
+
+class SeriesTests : public CxxTest::TestSuite {
+public:
+  void testZigzag() {
+    TS_ASSERT_EQUALS(bsonseries::zigzag(0), 0u);
+    TS_ASSERT_EQUALS(bsonseries::zigzag(-1), 1u);
+    TS_ASSERT_EQUALS(bsonseries::zigzag(1), 2u);
+    TS_ASSERT_EQUALS(bsonseries::zigzag(-2), 3u);
+
+    int64_t edges[] = { std::numeric_limits<int64_t>::min(),
+                        std::numeric_limits<int64_t>::max(), 0, -1 };
+    for (int64_t v : edges) {
+      TS_ASSERT_EQUALS(bsonseries::unzigzag(bsonseries::zigzag(v)), v);
+    }
+  }
+
+  void testIntRoundTrip() {
+    int64_t values[kSeriesLen];
+    for (size_t i = 0; i < kSeriesLen; i++) {
+      // Steady timestamps with an occasional jump backwards.
+      values[i] = 1700000000000 + i * 1000 - (i % 37 == 0 ? 5000 : 0);
+    }
+    values[3] = std::numeric_limits<int64_t>::min();
+    values[4] = std::numeric_limits<int64_t>::max();
+
+    uint8_t buf[kSeriesBufSize];
+    bsons::Result res =
+        bsons::Document::build(buf, kSeriesBufSize, [&](bsons::Document &doc) {
+          doc.appendSeriesInt64("ts", values, kSeriesLen);
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("ts", el));
+    TS_ASSERT(el.isSeries());
+    TS_ASSERT_EQUALS(el.getSeriesEncoding(), bson::SeriesEncoding::DeltaInt64);
+    TS_ASSERT_EQUALS(el.getSeriesSize(), kSeriesLen);
+
+    int64_t out[kSeriesLen];
+    TS_ASSERT(el.tryGetSeriesInt64(out, kSeriesLen));
+    TS_ASSERT_SAME_DATA(out, values, sizeof(values));
+
+    // The output has to fit and the encoding has to match.
+    double dbl[kSeriesLen];
+    TS_ASSERT(!el.tryGetSeriesInt64(out, kSeriesLen - 1));
+    TS_ASSERT(!el.tryGetSeriesDouble(dbl, kSeriesLen));
+  }
+
+  void testIntSize() {
+    // Small deltas are one byte each, and decode through the word at a time
+    // path.
+    int64_t values[kSeriesLen];
+    for (size_t i = 0; i < kSeriesLen; i++) {
+      values[i] = 100 + (i % 5);
+    }
+
+    uint8_t out[kSeriesBufSize];
+    size_t len = bsonseries::encode_int64(values, kSeriesLen, out,
+                                          kSeriesBufSize);
+    TS_ASSERT_EQUALS(len, 2 + kSeriesLen - 1);
+
+    int64_t decoded[kSeriesLen];
+    TS_ASSERT(bsonseries::decode_int64(out, len, decoded, kSeriesLen));
+    TS_ASSERT_SAME_DATA(decoded, values, sizeof(values));
+
+    // Truncated or with trailing bytes.
+    TS_ASSERT(!bsonseries::decode_int64(out, len - 1, decoded, kSeriesLen));
+    TS_ASSERT(!bsonseries::decode_int64(out, len, decoded, kSeriesLen - 1));
+  }
+
+  void testDoubleRoundTrip() {
+    double values[kSeriesLen];
+    for (size_t i = 0; i < kSeriesLen; i++) {
+      values[i] = 21.0 + (i / 10) * 0.1;
+    }
+    values[50] = -0.0;
+    values[51] = std::numeric_limits<double>::infinity();
+    values[52] = std::numeric_limits<double>::quiet_NaN();
+    values[53] = std::numeric_limits<double>::denorm_min();
+    values[54] = 1e300;
+
+    uint8_t buf[kSeriesBufSize];
+    bsons::Result res =
+        bsons::Document::build(buf, kSeriesBufSize, [&](bsons::Document &doc) {
+          doc.appendArr("temps", [&](bsons::Array &arr) {
+            arr.appendSeriesDouble(values, kSeriesLen)
+                .appendSeriesDouble(values, 0);
+          });
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("temps", el));
+
+    size_t i = 0;
+    for (auto const &item : el.getArr()) {
+      double out[kSeriesLen];
+      TS_ASSERT(item.tryGetSeriesDouble(out, kSeriesLen));
+
+      if (i == 0) {
+        // Bitwise, for the NaN and the negative zero.
+        TS_ASSERT_SAME_DATA(out, values, sizeof(values));
+      } else {
+        TS_ASSERT_EQUALS(item.getSeriesSize(), 0u);
+      }
+      i++;
+    }
+    TS_ASSERT_EQUALS(i, 2u);
+  }
+
+  void testDoubleSize() {
+    double values[kSeriesLen];
+    for (size_t i = 0; i < kSeriesLen; i++) {
+      values[i] = 40.0;
+    }
+
+    // The first value whole, then a bit for each repeat.
+    uint8_t out[kSeriesBufSize];
+    size_t len = bsonseries::encode_double(values, kSeriesLen, out,
+                                           kSeriesBufSize);
+    TS_ASSERT_EQUALS(len, 8 + (kSeriesLen - 1 + 7) / 8);
+
+    double decoded[kSeriesLen];
+    TS_ASSERT(bsonseries::decode_double(out, len, decoded, kSeriesLen));
+    TS_ASSERT_SAME_DATA(decoded, values, sizeof(values));
+    TS_ASSERT(!bsonseries::decode_double(out, len - 1, decoded, kSeriesLen));
+  }
+
+  void testOverflow() {
+    int64_t values[kSeriesLen];
+    for (size_t i = 0; i < kSeriesLen; i++) {
+      values[i] = i * 1000;
+    }
+
+    uint8_t big[kSeriesBufSize];
+    bsons::Result full =
+        bsons::Document::build(big, kSeriesBufSize, [&](bsons::Document &doc) {
+          doc.appendSeriesInt64("v", values, kSeriesLen);
+        });
+
+    uint8_t small[64];
+    bsons::Result res =
+        bsons::Document::build(small, sizeof(small), [&](bsons::Document &doc) {
+          doc.appendSeriesInt64("v", values, kSeriesLen);
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, full.len);
+  }
+
+  void testInvalid() {
+    // { "v": Binary(0x80, <encoding> <count>) } with no values.
+    uint8_t buf[] = { 0x12, 0x00, 0x00, 0x00, 0x05, 'v',  0x00,
+                      0x05, 0x00, 0x00, 0x00, 0x80, 0x01, 0x00,
+                      0x00, 0x00, 0x00, 0x00 };
+    TS_ASSERT(bsond::Document(buf, 0x12).valid());
+
+    buf[12] = 0x07;
+    TS_ASSERT(!bsond::Document(buf, 0x12).valid());
+
+    // A count with no data behind it passes validation, but not decoding.
+    buf[12] = 0x01;
+    buf[13] = 0x02;
+    bsond::Document counted(buf, 0x12);
+    bsond::DocumentElement el;
+    TS_ASSERT(counted.getElByName("v", el));
+    int64_t out[2];
+    TS_ASSERT(!el.tryGetSeriesInt64(out, 2));
+  }
+};
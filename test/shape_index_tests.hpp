@@ -0,0 +1,84 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/deserializer/shape_index.hpp"
+#include "cxxtest/TestSuite.h"
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kShapeBufSize = 128;
+
+class ShapeIndexTests : public CxxTest::TestSuite {
+  static size_t reading(uint8_t buf[], int32_t seq, const char status[]) {
+    bsons::Result res = bsons::Document::build(
+        buf, kShapeBufSize, [seq, status](bsons::Document &doc) {
+          doc.appendInt64("ts", 1000 + seq)
+              .appendInt32("seq", seq)
+              .appendDouble("temp", seq * 0.5)
+              .appendStr("status", status)
+              .appendBool("alarm", seq % 2);
+        });
+    return res.len;
+  }
+
+public:
+  void testReusesShape() {
+    const char *keys[] = { "seq", "temp", "alarm", "missing" };
+    bsond::ShapeIndex<> index(keys, 4);
+    uint8_t buf[kShapeBufSize];
+
+    for (int32_t seq = 0; seq < 4; seq++) {
+      size_t len = reading(buf, seq, seq % 2 ? "ok" : "degraded");
+      TS_ASSERT_EQUALS(index.bind(bsond::Document(buf, len)), seq > 0);
+
+      bsond::DocumentElement el;
+      TS_ASSERT(index.getElByKey(0, el));
+      TS_ASSERT_EQUALS(el.getInt32(), seq);
+
+      TS_ASSERT(index.getElByKey(1, el));
+      TS_ASSERT_EQUALS(el.getDouble(), seq * 0.5);
+
+      // Past the variable-width status, so resolved from the tail.
+      TS_ASSERT(index.getElByKey(2, el));
+      TS_ASSERT_EQUALS(el.getBool(), seq % 2 == 1);
+
+      TS_ASSERT(!index.getElByKey(3, el));
+
+      TS_ASSERT(index.getElByName("status", el));
+      TS_ASSERT(el.strEquals(seq % 2 ? "ok" : "degraded"));
+    }
+
+    TS_ASSERT_EQUALS(index.hits(), 3);
+    TS_ASSERT_EQUALS(index.misses(), 1);
+  }
+
+  void testShapeChange() {
+    const char *keys[] = { "temp" };
+    bsond::ShapeIndex<> index(keys, 1);
+    uint8_t buf[kShapeBufSize];
+
+    size_t len = reading(buf, 1, "ok");
+    TS_ASSERT(!index.bind(bsond::Document(buf, len)));
+
+    // Same keys, but seq is now an Int64 so every following offset moves.
+    len = bsons::Document::build(buf, kShapeBufSize, [](bsons::Document &doc) {
+            doc.appendInt64("ts", 1000)
+                .appendInt64("seq", 2)
+                .appendDouble("temp", 3.5);
+          }).len;
+    TS_ASSERT(!index.bind(bsond::Document(buf, len)));
+
+    bsond::DocumentElement el;
+    TS_ASSERT(index.getElByKey(0, el));
+    TS_ASSERT_EQUALS(el.getDouble(), 3.5);
+
+    // A shorter document can't match the cached shape.
+    len = bsons::Document::build(buf, kShapeBufSize, [](bsons::Document &doc) {
+            doc.appendInt64("ts", 1000);
+          }).len;
+    TS_ASSERT(!index.bind(bsond::Document(buf, len)));
+    TS_ASSERT(!index.getElByKey(0, el));
+
+    TS_ASSERT_EQUALS(index.hits(), 0);
+    TS_ASSERT_EQUALS(index.misses(), 3);
+  }
+};
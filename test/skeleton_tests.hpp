@@ -0,0 +1,114 @@
+#include "../src/bson/bson.hpp"
+#include "./utils.hpp"
+#include "cxxtest/TestSuite.h"
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+class SkeletonTests : public CxxTest::TestSuite {
+public:
+  void testSlotsMatchSerializer() {
+    uint8_t skel_buf[128];
+    bsons::Slot temp, count, on, name, id;
+
+    bsons::Result skel_res = bsons::Document::build(
+        skel_buf, sizeof(skel_buf), [&](bsons::Document &doc) {
+          doc.appendStr("type", "reading")
+              .appendDoubleSlot("temp", temp)
+              .appendInt32Slot("count", count)
+              .appendDoc("meta", [&](bsons::Document &ndoc) {
+                ndoc.appendBoolSlot("on", on).appendInt64Slot("id", id);
+              });
+        });
+    TS_ASSERT_EQUALS(skel_res.status, bsons::Status::Ok);
+
+    bsons::Skeleton skel(skel_buf, skel_res.len);
+
+    uint8_t msg[128];
+    clear_buf(msg, sizeof(msg));
+    bsons::Result res = skel.copyTo(msg, sizeof(msg));
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, skel_res.len);
+
+    TS_ASSERT(temp.setDouble(msg, 21.5));
+    TS_ASSERT(count.setInt32(msg, 42));
+    TS_ASSERT(on.setBool(msg, true));
+    TS_ASSERT(id.setInt64(msg, 1234567890123));
+
+    // Type mismatches are rejected.
+    TS_ASSERT(!temp.setInt32(msg, 1));
+    size_t len = res.len;
+    TS_ASSERT(!name.setStr(msg, len, "unset"));
+
+    uint8_t expected[128];
+    clear_buf(expected, sizeof(expected));
+    bsons::Document::build(
+        expected, sizeof(expected), [](bsons::Document &doc) {
+          doc.appendStr("type", "reading")
+              .appendDouble("temp", 21.5)
+              .appendInt32("count", 42)
+              .appendDoc("meta", [](bsons::Document &ndoc) {
+                ndoc.appendBool("on", true).appendInt64("id", 1234567890123);
+              });
+        });
+
+    TS_ASSERT_SAME_DATA(msg, expected, sizeof(msg));
+  }
+
+  void testStringSlot() {
+    uint8_t skel_buf[64];
+    bsons::Slot name, first, unit;
+
+    bsons::Result skel_res = bsons::Document::build(
+        skel_buf, sizeof(skel_buf), [&](bsons::Document &doc) {
+          doc.appendStrSlot("name", 8, name)
+              .appendArr("arr", [&](bsons::Array &arr) {
+                arr.appendInt32Slot(first)
+                    .appendStrSlot(4, unit)
+                    .appendInt32(2);
+              });
+        });
+    TS_ASSERT_EQUALS(skel_res.status, bsons::Status::Ok);
+
+    uint8_t msg[64];
+    bsons::Skeleton skel(skel_buf, skel_res.len);
+    skel.copyTo(msg, sizeof(msg));
+    size_t len = skel_res.len;
+
+    // Other slots first, then strings from the last one back.
+    TS_ASSERT(first.setInt32(msg, 1));
+    TS_ASSERT(!unit.setStr(msg, len, "hours"));
+    TS_ASSERT(unit.setStr(msg, len, "h"));
+    TS_ASSERT(name.setStr(msg, len, "abc"));
+    TS_ASSERT(!name.setStr(msg, len, "abc"));
+    TS_ASSERT_EQUALS(len, skel_res.len - 5 - 3);
+
+    uint8_t expected[64];
+    bsons::Result exp_res = bsons::Document::build(
+        expected, sizeof(expected), [](bsons::Document &doc) {
+          doc.appendStr("name", "abc").appendArr("arr", [](bsons::Array &arr) {
+            arr.appendInt32(1).appendStr("h").appendInt32(2);
+          });
+        });
+    TS_ASSERT_EQUALS(exp_res.len, len);
+    TS_ASSERT_SAME_DATA(msg, expected, len);
+
+    bsond::Document doc(msg, len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("name", el));
+    TS_ASSERT(el.strEquals("abc"));
+    TS_ASSERT_EQUALS(el.getStrLen(), 3);
+  }
+
+  void testCopyOverflow() {
+    uint8_t skel_buf[] = { 0x05, 0x00, 0x00, 0x00, 0x00 };
+    bsons::Skeleton skel(skel_buf, sizeof(skel_buf));
+
+    uint8_t msg[4];
+    bsons::Result res = skel.copyTo(msg, sizeof(msg));
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, 5);
+  }
+};
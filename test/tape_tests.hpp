@@ -0,0 +1,83 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/deserializer/tape.hpp"
+#include "cxxtest/TestSuite.h"
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+
+static constexpr size_t kTapeBufSize = 256;
+
+class TapeTests : public CxxTest::TestSuite {
+  uint8_t buf[kTapeBufSize];
+  size_t len;
+
+public:
+  void setUp() {
+    bsons::Result res = bsons::Document::build(
+        buf, kTapeBufSize, [](bsons::Document &doc) {
+          doc.appendStr("name", "sensor")
+              .appendDoc("net",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendDoc("wifi",
+                                          [](bsons::Document &nndoc) {
+                                            nndoc.appendStr("ssid", "home")
+                                                .appendInt32("channel", 6);
+                                          })
+                               .appendBool("dhcp", true);
+                         })
+              .appendArr("thresholds",
+                         [](bsons::Array &arr) {
+                           arr.appendDouble(1.5).appendInt64(20).appendInt32(3);
+                         })
+              .appendNull("extra");
+        });
+    len = res.len;
+  }
+
+  void testParse() {
+    bsond::TapeEntry entries[16];
+    bsond::Tape tape(entries, 16);
+
+    TS_ASSERT(tape.parse(bsond::Document(buf, len)));
+    TS_ASSERT_EQUALS(tape.size(), 12);
+
+    // The root spans the whole tape.
+    TS_ASSERT_EQUALS(tape[0].type, pot::bson::Element::Document);
+    TS_ASSERT_EQUALS(tape[0].next, 12);
+
+    size_t name = tape.find(0, "name");
+    TS_ASSERT_EQUALS(name, 1);
+    TS_ASSERT_EQUALS(tape[name].getStrLen(), 6);
+    TS_ASSERT_EQUALS(strcmp(tape[name].getStrRef(), "sensor"), 0);
+
+    // Skipping the net subtree is a single hop.
+    size_t net = tape.find(0, "net");
+    TS_ASSERT_EQUALS(tape[net].next, 7);
+    TS_ASSERT_EQUALS(tape.find(0, "thresholds"), 7);
+
+    size_t channel = tape.path("net.wifi.channel");
+    TS_ASSERT(channel != bsond::kTapeNone);
+    TS_ASSERT_EQUALS(tape[channel].getInt32(), 6);
+
+    size_t dhcp = tape.path("net.dhcp");
+    TS_ASSERT(tape[dhcp].getBool());
+
+    size_t thresholds = tape.path("thresholds");
+    TS_ASSERT_EQUALS(tape[tape.at(thresholds, 0)].getDouble(), 1.5);
+    TS_ASSERT_EQUALS(tape[tape.at(thresholds, 1)].getInt(), 20);
+    TS_ASSERT_EQUALS(tape[tape.at(thresholds, 2)].getNumber(), 3);
+    TS_ASSERT(tape.at(thresholds, 3) == bsond::kTapeNone);
+
+    TS_ASSERT_EQUALS(tape[tape.path("extra")].type, pot::bson::Element::Null);
+    TS_ASSERT(tape.path("net.wifi.missing") == bsond::kTapeNone);
+    TS_ASSERT(tape.path("name.nested") == bsond::kTapeNone);
+  }
+
+  void testCapacityExceeded() {
+    bsond::TapeEntry entries[4];
+    bsond::Tape tape(entries, 4);
+
+    TS_ASSERT(!tape.parse(bsond::Document(buf, len)));
+    TS_ASSERT_EQUALS(tape.size(), 12);
+  }
+};
@@ -0,0 +1,229 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/transcode/cbor.hpp"
+#include "../src/bson/transcode/msgpack.hpp"
+#include "cxxtest/TestSuite.h"
+#include <cstring>
+#include <vector>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsont = pot::bson::transcode;
+
+static constexpr size_t kTranscodeBufSize = 256;
+static constexpr size_t kTranscodeBinSize = 100000;
+
+class TranscodeTests : public CxxTest::TestSuite {
+  uint8_t buf[kTranscodeBufSize];
+  size_t len;
+
+public:
+  void setUp() {
+    len = bsons::Document::build(buf, kTranscodeBufSize,
+                                 [](bsons::Document &doc) {
+                                   doc.appendInt32("a", 1)
+                                       .appendArr("b",
+                                                  [](bsons::Array &arr) {
+                                                    arr.appendBool(true)
+                                                        .appendNull();
+                                                  })
+                                       .appendStr("c", "hi");
+                                 })
+              .len;
+  }
+
+  void testToCbor() {
+    const uint8_t expected[] = { 0xA3, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82,
+                                 0xF5, 0xF6, 0x61, 0x63, 0x62, 0x68, 0x69 };
+    uint8_t out[kTranscodeBufSize];
+    bsont::Result res =
+        bsont::bson_to_cbor(bsond::Document(buf, len), out, kTranscodeBufSize);
+
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, sizeof(expected));
+    TS_ASSERT_EQUALS(memcmp(out, expected, sizeof(expected)), 0);
+  }
+
+  void testToMsgPack() {
+    const uint8_t expected[] = { 0x83, 0xA1, 0x61, 0x01, 0xA1, 0x62, 0x92,
+                                 0xC3, 0xC0, 0xA1, 0x63, 0xA2, 0x68, 0x69 };
+    uint8_t out[kTranscodeBufSize];
+    bsont::Result res = bsont::bson_to_msgpack(bsond::Document(buf, len), out,
+                                               kTranscodeBufSize);
+
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, sizeof(expected));
+    TS_ASSERT_EQUALS(memcmp(out, expected, sizeof(expected)), 0);
+  }
+
+  void testRoundTrip() {
+    std::vector<uint8_t> bin(kTranscodeBinSize);
+    for (size_t i = 0; i < bin.size(); i++) {
+      bin[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    std::vector<uint8_t> doc_buf(kTranscodeBinSize + kTranscodeBufSize * 4);
+    const uint8_t *bin_data = bin.data();
+    size_t doc_len =
+        bsons::Document::build(
+            doc_buf.data(), doc_buf.size(), [bin_data](bsons::Document &doc) {
+              doc.appendDouble("temp", -21.5)
+                  .appendInt32("min32", INT32_MIN)
+                  .appendInt32("max32", INT32_MAX)
+                  .appendInt32("small", -3)
+                  .appendInt32("byte", 200)
+                  .appendInt64("one64", 1)
+                  .appendInt64("min64", INT64_MIN)
+                  .appendStr("long", "a string that is longer than thirty "
+                                     "two characters")
+                  .appendBin("empty", bin_data, 0)
+                  .appendBin("payload", bin_data, kTranscodeBinSize)
+                  .appendDoc("state",
+                             [](bsons::Document &sdoc) {
+                               sdoc.appendBool("on", false).appendNull("x");
+                             })
+                  .appendArr("list", [](bsons::Array &arr) {
+                    for (int32_t i = 0; i < 20; i++) {
+                      arr.appendInt32(i * 1000);
+                    }
+                  });
+            })
+            .len;
+    bsond::Document doc(doc_buf.data(), doc_len);
+
+    std::vector<uint8_t> mid(doc_buf.size());
+    std::vector<uint8_t> back(doc_buf.size());
+
+    bsont::Result res = bsont::bson_to_cbor(doc, mid.data(), mid.size());
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+    res = bsont::cbor_to_bson(mid.data(), res.len, back.data(), back.size());
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, doc_len);
+    TS_ASSERT_EQUALS(memcmp(back.data(), doc_buf.data(), doc_len), 0);
+
+    res = bsont::bson_to_msgpack(doc, mid.data(), mid.size());
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+    res = bsont::msgpack_to_bson(mid.data(), res.len, back.data(), back.size());
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, doc_len);
+    TS_ASSERT_EQUALS(memcmp(back.data(), doc_buf.data(), doc_len), 0);
+  }
+
+  void testForeignCbor() {
+    // {_ "h": 1.0 as a half, "f": 1.5 as a single, "u": 2^32, "n": -1,
+    //   "x": [_ 1]}
+    const uint8_t cbor[] = { 0xBF, 0x61, 0x68, 0xF9, 0x3C, 0x00, 0x61, 0x66,
+                             0xFA, 0x3F, 0xC0, 0x00, 0x00, 0x61, 0x75, 0x1B,
+                             0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+                             0x61, 0x6E, 0x20, 0x61, 0x78, 0x9F, 0x01, 0xFF,
+                             0xFF };
+    uint8_t out[kTranscodeBufSize];
+    bsont::Result res =
+        bsont::cbor_to_bson(cbor, sizeof(cbor), out, kTranscodeBufSize);
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+
+    bsond::Document doc(out, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("h", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 1.0);
+    TS_ASSERT(doc.getElByName("f", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 1.5);
+    TS_ASSERT(doc.getElByName("u", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int64);
+    TS_ASSERT_EQUALS(el.getInt64(), 4294967296);
+    TS_ASSERT(doc.getElByName("n", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int32);
+    TS_ASSERT_EQUALS(el.getInt32(), -1);
+    TS_ASSERT(doc.getElByName("x", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Array);
+    TS_ASSERT_EQUALS(el.getArrLen(), 12);
+  }
+
+  void testForeignMsgPack() {
+    // {"u": uint 32 0xFFFFFFFF, "f": float 32 0.5, "n": int 8 -100}
+    const uint8_t msgpack[] = { 0x83, 0xA1, 0x75, 0xCE, 0xFF, 0xFF, 0xFF,
+                                0xFF, 0xA1, 0x66, 0xCA, 0x3F, 0x00, 0x00,
+                                0x00, 0xA1, 0x6E, 0xD0, 0x9C };
+    uint8_t out[kTranscodeBufSize];
+    bsont::Result res = bsont::msgpack_to_bson(msgpack, sizeof(msgpack), out,
+                                               kTranscodeBufSize);
+    TS_ASSERT_EQUALS(res.status, bsont::Status::Ok);
+
+    bsond::Document doc(out, res.len);
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("u", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int64);
+    TS_ASSERT_EQUALS(el.getInt64(), 4294967295);
+    TS_ASSERT(doc.getElByName("f", el));
+    TS_ASSERT_EQUALS(el.getDouble(), 0.5);
+    TS_ASSERT(doc.getElByName("n", el));
+    TS_ASSERT_EQUALS(el.type(), bson::Element::Int32);
+    TS_ASSERT_EQUALS(el.getInt32(), -100);
+  }
+
+  void testErrors() {
+    uint8_t out[kTranscodeBufSize];
+
+    const uint8_t truncated[] = { 0xA1, 0x61, 0x61, 0x19, 0x01 };
+    TS_ASSERT_EQUALS(
+        bsont::cbor_to_bson(truncated, sizeof(truncated), out, 256).status,
+        bsont::Status::Malformed);
+    const uint8_t tagged[] = { 0xA1, 0x61, 0x61, 0xC1, 0x01 };
+    TS_ASSERT_EQUALS(
+        bsont::cbor_to_bson(tagged, sizeof(tagged), out, 256).status,
+        bsont::Status::Unsupported);
+    const uint8_t int_key[] = { 0xA1, 0x01, 0x01 };
+    TS_ASSERT_EQUALS(
+        bsont::cbor_to_bson(int_key, sizeof(int_key), out, 256).status,
+        bsont::Status::Unsupported);
+    const uint8_t array[] = { 0x81, 0x01 };
+    TS_ASSERT_EQUALS(bsont::cbor_to_bson(array, sizeof(array), out, 256).status,
+                     bsont::Status::Unsupported);
+    const uint8_t trailing[] = { 0xA0, 0x00 };
+    TS_ASSERT_EQUALS(
+        bsont::cbor_to_bson(trailing, sizeof(trailing), out, 256).status,
+        bsont::Status::Malformed);
+
+    // Indefinite lengths are only for strings and containers, and a break
+    // only ends an indefinite container.
+    const uint8_t indefinite[] = { 0x1F, 0x3F, 0xDF, 0xFF };
+    for (uint8_t initial : indefinite) {
+      const uint8_t scalar[] = { 0xA1, 0x61, 0x61, initial };
+      TS_ASSERT_EQUALS(
+          bsont::cbor_to_bson(scalar, sizeof(scalar), out, 256).status,
+          bsont::Status::Malformed);
+    }
+
+    const uint8_t ext[] = { 0x81, 0xA1, 0x61, 0xD4, 0x01, 0x00 };
+    TS_ASSERT_EQUALS(bsont::msgpack_to_bson(ext, sizeof(ext), out, 256).status,
+                     bsont::Status::Unsupported);
+    const uint8_t short_str[] = { 0x81, 0xA1, 0x61, 0xA5, 0x61 };
+    TS_ASSERT_EQUALS(
+        bsont::msgpack_to_bson(short_str, sizeof(short_str), out, 256).status,
+        bsont::Status::Malformed);
+
+    std::vector<uint8_t> deep(200, 0x81);
+    for (size_t i = 1; i < deep.size(); i += 2) {
+      deep[i] = 0xA0;
+    }
+    TS_ASSERT_EQUALS(
+        bsont::msgpack_to_bson(deep.data(), deep.size(), out, 256).status,
+        bsont::Status::TooDeep);
+  }
+
+  void testOverflow() {
+    uint8_t full[kTranscodeBufSize];
+    bsont::Result res =
+        bsont::bson_to_cbor(bsond::Document(buf, len), full, kTranscodeBufSize);
+    uint8_t out[4];
+    TS_ASSERT_EQUALS(
+        bsont::bson_to_cbor(bsond::Document(buf, len), out, sizeof(out)).len,
+        res.len);
+
+    bsont::Result back = bsont::cbor_to_bson(full, res.len, out, sizeof(out));
+    TS_ASSERT_EQUALS(back.status, bsont::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(back.len, len);
+  }
+};
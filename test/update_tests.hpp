@@ -0,0 +1,289 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/update/update.hpp"
+#include "./utils.hpp"
+#include "cxxtest/TestSuite.h"
+
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonu = pot::bson::update;
+
+static constexpr size_t kUpdateBufSize = 256;
+
+class UpdateTests : public CxxTest::TestSuite {
+  uint8_t src[kUpdateBufSize];
+  uint8_t out[kUpdateBufSize];
+  uint8_t expected[kUpdateBufSize];
+  size_t src_len;
+
+public:
+  void setUp() {
+    clear_buf(out, kUpdateBufSize);
+    clear_buf(expected, kUpdateBufSize);
+
+    bsons::Result res = bsons::Document::build(
+        src, kUpdateBufSize, [](bsons::Document &doc) {
+          doc.appendStr("id", "dev-1")
+              .appendInt32("count", 1)
+              .appendDoc("state",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendBool("on", false)
+                               .appendDouble("temp", 1.5)
+                               .appendStr("mode", "a");
+                         })
+              .appendArr("log", [](bsons::Array &arr) {
+                arr.appendInt32(1).appendInt32(2);
+              });
+        });
+    src_len = res.len;
+  }
+
+  bsonu::Result apply(const bsonu::Operation ops[], size_t ops_len) {
+    bsond::Document doc(src, src_len);
+    return bsonu::apply(doc, ops, ops_len, out, kUpdateBufSize);
+  }
+
+  void testNoOperationsCopiesSource() {
+    bsonu::Result res = apply(nullptr, 0);
+
+    TS_ASSERT_EQUALS(res.status, bsonu::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, src_len);
+    TS_ASSERT_SAME_DATA(out, src, src_len);
+  }
+
+  void testSetNestedAndVariableLength() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::set("state.mode", bsonu::Value::ofStr("longer")),
+      bsonu::Operation::set("id", bsonu::Value::ofInt64(7)),
+      bsonu::Operation::unset("count"),
+    };
+    bsonu::Result res = apply(ops, 3);
+
+    bsons::Result exp = bsons::Document::build(
+        expected, kUpdateBufSize, [](bsons::Document &doc) {
+          doc.appendInt64("id", 7)
+              .appendDoc("state",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendBool("on", false)
+                               .appendDouble("temp", 1.5)
+                               .appendStr("mode", "longer");
+                         })
+              .appendArr("log", [](bsons::Array &arr) {
+                arr.appendInt32(1).appendInt32(2);
+              });
+        });
+
+    TS_ASSERT_EQUALS(res.status, bsonu::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, exp.len);
+    TS_ASSERT_SAME_DATA(out, expected, kUpdateBufSize);
+  }
+
+  void testIncAndPush() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::inc("count", bsonu::Value::ofInt32(2)),
+      bsonu::Operation::inc("state.temp", bsonu::Value::ofInt32(1)),
+      bsonu::Operation::push("log", bsonu::Value::ofStr("x")),
+    };
+    bsonu::Result res = apply(ops, 3);
+
+    bsons::Result exp = bsons::Document::build(
+        expected, kUpdateBufSize, [](bsons::Document &doc) {
+          doc.appendStr("id", "dev-1")
+              .appendInt32("count", 3)
+              .appendDoc("state",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendBool("on", false)
+                               .appendDouble("temp", 2.5)
+                               .appendStr("mode", "a");
+                         })
+              .appendArr("log", [](bsons::Array &arr) {
+                arr.appendInt32(1).appendInt32(2).appendStr("x");
+              });
+        });
+
+    TS_ASSERT_EQUALS(res.status, bsonu::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, exp.len);
+    TS_ASSERT_SAME_DATA(out, expected, kUpdateBufSize);
+  }
+
+  void testIncPromotesOnOverflow() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::inc("count", bsonu::Value::ofInt32(2147483647)),
+    };
+    TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::Ok);
+
+    bsond::Document doc(out, kUpdateBufSize);
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("count", el));
+    TS_ASSERT_EQUALS(el.type(), pot::bson::Element::Int64);
+    TS_ASSERT_EQUALS(el.getInt64(), 2147483648);
+  }
+
+  void testIncInt64Overflow() {
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::inc(
+            "count",
+            bsonu::Value::ofInt64(std::numeric_limits<int64_t>::max())),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::InvalidOperation);
+    }
+
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::inc(
+            "count",
+            bsonu::Value::ofInt64(std::numeric_limits<int64_t>::min())),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::Ok);
+
+      bsond::DocumentElement el;
+      TS_ASSERT(bsond::Document(out, kUpdateBufSize).getElByName("count", el));
+      TS_ASSERT_EQUALS(el.getInt64(), std::numeric_limits<int64_t>::min() + 1);
+    }
+  }
+
+  void testCreateMissingPaths() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::set("cfg.net.ip", bsonu::Value::ofStr("1.2.3.4")),
+      bsonu::Operation::set("cfg.net.port", bsonu::Value::ofInt32(80)),
+      bsonu::Operation::push("tags", bsonu::Value::ofBool(true)),
+      bsonu::Operation::set("log.2", bsonu::Value::ofInt32(3)),
+      bsonu::Operation::unset("missing.path"),
+    };
+    bsonu::Result res = apply(ops, 5);
+
+    bsons::Result exp = bsons::Document::build(
+        expected, kUpdateBufSize, [](bsons::Document &doc) {
+          doc.appendStr("id", "dev-1")
+              .appendInt32("count", 1)
+              .appendDoc("state",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendBool("on", false)
+                               .appendDouble("temp", 1.5)
+                               .appendStr("mode", "a");
+                         })
+              .appendArr("log",
+                         [](bsons::Array &arr) {
+                           arr.appendInt32(1).appendInt32(2).appendInt32(3);
+                         })
+              .appendDoc("cfg",
+                         [](bsons::Document &ndoc) {
+                           ndoc.appendDoc("net", [](bsons::Document &nndoc) {
+                             nndoc.appendStr("ip", "1.2.3.4")
+                                 .appendInt32("port", 80);
+                           });
+                         })
+              .appendArr("tags",
+                         [](bsons::Array &arr) { arr.appendBool(true); });
+        });
+
+    TS_ASSERT_EQUALS(res.status, bsonu::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, exp.len);
+    TS_ASSERT_SAME_DATA(out, expected, kUpdateBufSize);
+  }
+
+  void testUnsetBelowScalar() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::unset("count.x"),
+      bsonu::Operation::unset("state.temp.y"),
+    };
+    bsonu::Result res = apply(ops, 2);
+
+    TS_ASSERT_EQUALS(res.status, bsonu::Status::Ok);
+    TS_ASSERT_EQUALS(res.len, src_len);
+    TS_ASSERT_SAME_DATA(out, src, src_len);
+
+    // Still invalid alongside anything that isn't an unset.
+    bsonu::Operation mixed[] = {
+      bsonu::Operation::unset("count.x"),
+      bsonu::Operation::set("count.y", bsonu::Value::ofInt32(1)),
+    };
+    TS_ASSERT_EQUALS(apply(mixed, 2).status,
+                     bsonu::Status::InvalidOperation);
+  }
+
+  void testUnsetArrayElementSetsNull() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::unset("log.0"),
+    };
+    TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::Ok);
+
+    bsond::Document doc(out, kUpdateBufSize);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("log", el));
+    TS_ASSERT(el.getArr().containsNull());
+    TS_ASSERT(el.getArr().containsInt32(2));
+  }
+
+  void testSetSubdocument() {
+    uint8_t sub[32];
+    size_t sub_len =
+        bsons::Document::build(sub, sizeof(sub), [](bsons::Document &doc) {
+          doc.appendInt32("x", 1);
+        }).len;
+
+    bsonu::Operation ops[] = {
+      bsonu::Operation::set(
+          "state", bsonu::Value::ofDoc(bsond::Document(sub, sub_len))),
+    };
+    TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::Ok);
+
+    bsond::Document doc(out, kUpdateBufSize);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("state", el));
+    TS_ASSERT_EQUALS(el.getDocLen(), sub_len);
+  }
+
+  void testInvalidOperations() {
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::inc("id", bsonu::Value::ofInt32(1)),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::InvalidOperation);
+    }
+
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::push("count", bsonu::Value::ofInt32(1)),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::InvalidOperation);
+    }
+
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::set("id.x", bsonu::Value::ofInt32(1)),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::InvalidOperation);
+    }
+
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::set("state", bsonu::Value::ofInt32(1)),
+        bsonu::Operation::set("state.on", bsonu::Value::ofBool(true)),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 2).status, bsonu::Status::InvalidOperation);
+    }
+
+    {
+      bsonu::Operation ops[] = {
+        bsonu::Operation::set("log.5", bsonu::Value::ofInt32(1)),
+      };
+      TS_ASSERT_EQUALS(apply(ops, 1).status, bsonu::Status::InvalidOperation);
+    }
+  }
+
+  void testBufferOverflow() {
+    bsonu::Operation ops[] = {
+      bsonu::Operation::set("id", bsonu::Value::ofStr("a longer id")),
+    };
+    bsond::Document doc(src, src_len);
+    bsonu::Result res = bsonu::apply(doc, ops, 1, out, 10);
+
+    TS_ASSERT_EQUALS(res.status, bsonu::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, src_len + 6);
+  }
+};
@@ -0,0 +1,238 @@
+#include "../src/bson/bson.hpp"
+#include "../src/bson/parallel/thread_pool.hpp"
+#include "../src/bson/parallel/validate.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+
+namespace bson = pot::bson;
+namespace bsond = pot::bson::deserializer;
+namespace bsons = pot::bson::serializer;
+namespace bsonp = pot::bson::parallel;
+
+static constexpr size_t kVectorBufSize = 256;
+
+class VectorTests : public CxxTest::TestSuite {
+public:
+  void testSpecExamples() {
+    uint8_t buf[kVectorBufSize];
+    float floats[] = { 127.0f, 7.0f };
+    int8_t ints[] = { 127, 7 };
+    uint8_t bits[] = { 127, 7 };
+
+    bsons::Result res =
+        bsons::Document::build(buf, kVectorBufSize, [&](bsons::Document &doc) {
+          doc.appendVectorF32("f", floats, 2)
+              .appendVectorI8("i", ints, 2)
+              .appendVectorPackedBits("b", bits, 16);
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("f", el));
+    uint8_t f_expected[] = { 0x09, 0x27, 0x00, 0x00, 0x00, 0xFE,
+                             0x42, 0x00, 0x00, 0xE0, 0x40 };
+    TS_ASSERT_EQUALS(el.getBinLen(), 10);
+    TS_ASSERT_SAME_DATA(el.getBinRef() - 1, f_expected, sizeof(f_expected));
+
+    TS_ASSERT(doc.getElByName("i", el));
+    uint8_t i_expected[] = { 0x09, 0x03, 0x00, 0x7F, 0x07 };
+    TS_ASSERT_SAME_DATA(el.getBinRef() - 1, i_expected, sizeof(i_expected));
+
+    TS_ASSERT(doc.getElByName("b", el));
+    uint8_t b_expected[] = { 0x09, 0x10, 0x00, 0x7F, 0x07 };
+    TS_ASSERT_SAME_DATA(el.getBinRef() - 1, b_expected, sizeof(b_expected));
+  }
+
+  void testReadBack() {
+    uint8_t buf[kVectorBufSize];
+    float floats[] = { 1.5f, -2.25f, 0.0f, 3e10f, -1e-7f };
+    int8_t ints[] = { -128, -1, 0, 1, 127 };
+    uint8_t bits[] = { 0xA5, 0xFF };
+
+    bsons::Result res =
+        bsons::Document::build(buf, kVectorBufSize, [&](bsons::Document &doc) {
+          doc.appendVectorF32("f", floats, 5)
+              .appendVectorI8("i", ints, 5)
+              // The low 5 bits of the last byte are padding.
+              .appendVectorPackedBits("b", bits, 11)
+              .appendBin("g", bits, 2);
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    bsond::data_type::Vector vec;
+    float out[16];
+
+    TS_ASSERT(doc.getElByName("f", el));
+    TS_ASSERT(el.tryGetVector(vec));
+    TS_ASSERT_EQUALS(vec.dtype, bson::VectorDType::Float32);
+    TS_ASSERT_EQUALS(vec.len, 20);
+    TS_ASSERT_EQUALS(el.getVectorSize(), 5);
+    TS_ASSERT_EQUALS(el.getVectorF32(out, 16), 5u);
+    TS_ASSERT_SAME_DATA(out, floats, sizeof(floats));
+    // Truncated to the output buffer.
+    TS_ASSERT_EQUALS(el.getVectorF32(out, 2), 2u);
+
+    TS_ASSERT(doc.getElByName("i", el));
+    TS_ASSERT(el.tryGetVector(vec));
+    TS_ASSERT_EQUALS(vec.dtype, bson::VectorDType::Int8);
+    TS_ASSERT_SAME_DATA(el.getVectorI8Ref(), ints, sizeof(ints));
+    TS_ASSERT_EQUALS(el.getVectorF32(out, 16), 5u);
+    TS_ASSERT_EQUALS(out[0], -128.0f);
+    TS_ASSERT_EQUALS(out[4], 127.0f);
+
+    TS_ASSERT(doc.getElByName("b", el));
+    TS_ASSERT(el.tryGetVector(vec));
+    TS_ASSERT_EQUALS(vec.dtype, bson::VectorDType::PackedBit);
+    TS_ASSERT_EQUALS(vec.padding, 5);
+    TS_ASSERT_EQUALS(vec.data[1], 0xE0);
+    TS_ASSERT_EQUALS(el.getVectorSize(), 11);
+
+    uint8_t unpacked[16];
+    uint8_t unpacked_expected[] = { 1, 0, 1, 0, 0, 1, 0, 1, 1, 1, 1 };
+    TS_ASSERT_EQUALS(el.getVectorBits(unpacked, 16), 11u);
+    TS_ASSERT_SAME_DATA(unpacked, unpacked_expected, 11);
+    TS_ASSERT_EQUALS(el.getVectorF32(out, 16), 11u);
+    TS_ASSERT_EQUALS(out[0], 1.0f);
+    TS_ASSERT_EQUALS(out[1], 0.0f);
+
+    TS_ASSERT(doc.getElByName("g", el));
+    TS_ASSERT(!el.isVector());
+    TS_ASSERT(!el.tryGetVector(vec));
+  }
+
+  void testArrayAndEmpty() {
+    uint8_t buf[kVectorBufSize];
+    float floats[] = { 1.0f };
+
+    bsons::Result res =
+        bsons::Document::build(buf, kVectorBufSize, [&](bsons::Document &doc) {
+          doc.appendArr("vs", [&](bsons::Array &arr) {
+            arr.appendVectorF32(floats, 1)
+                .appendVectorI8(nullptr, 0)
+                .appendVectorPackedBits(nullptr, 0);
+          });
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("vs", el));
+
+    size_t count = 0;
+    for (auto const &item : el.getArr()) {
+      TS_ASSERT(item.isVector());
+      count++;
+    }
+    TS_ASSERT_EQUALS(count, 3u);
+  }
+
+  void testEmptyVectors() {
+    uint8_t buf[kVectorBufSize];
+
+    bsons::Result res =
+        bsons::Document::build(buf, kVectorBufSize, [&](bsons::Document &doc) {
+          doc.appendVectorF32("f", nullptr, 0)
+              .appendVectorI8("i", nullptr, 0)
+              .appendVectorPackedBits("b", nullptr, 0);
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::Ok);
+
+    bsond::Document doc(buf, res.len);
+    TS_ASSERT(doc.valid());
+
+    bsond::DocumentElement el;
+    TS_ASSERT(doc.getElByName("f", el));
+    TS_ASSERT(el.isVector());
+    TS_ASSERT_EQUALS(el.getBinLen(), 2);
+
+    // Sizing with no buffer at all.
+    bsons::Result size =
+        bsons::Document::build(nullptr, 0, [&](bsons::Document &doc) {
+          doc.appendVectorF32("f", nullptr, 0)
+              .appendVectorI8("i", nullptr, 0)
+              .appendVectorPackedBits("b", nullptr, 0);
+        });
+    TS_ASSERT_EQUALS(size.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(size.len, res.len);
+  }
+
+  void testOverflow() {
+    uint8_t buf[32];
+    float floats[8] = {};
+
+    bsons::Result res =
+        bsons::Document::build(buf, sizeof(buf), [&](bsons::Document &doc) {
+          doc.appendVectorF32("f", floats, 8);
+        });
+    TS_ASSERT_EQUALS(res.status, bsons::Status::BufferOverflow);
+    TS_ASSERT_EQUALS(res.len, 4u + 1 + 2 + 4 + 1 + 2 + 32 + 1);
+  }
+
+  void testInvalidVectors() {
+    // { "v": Binary(0x09, <dtype> <padding> <data>) } with a 4-byte payload.
+    uint8_t base[] = { 0x11, 0x00, 0x00, 0x00, 0x05, 'v',  0x00,
+                       0x04, 0x00, 0x00, 0x00, 0x09, 0x03, 0x00,
+                       0x01, 0x02, 0x00 };
+    TS_ASSERT(valid(base, sizeof(base)));
+
+    struct Case {
+      uint8_t dtype;
+      uint8_t padding;
+    } cases[] = {
+      { 0x01, 0x00 }, // Unknown dtype
+      { 0x03, 0x01 }, // Padding on int8
+      { 0x27, 0x00 }, // Float32 not a multiple of 4 bytes
+      { 0x10, 0x08 }, // Padding of a whole byte
+    };
+
+    for (auto c : cases) {
+      uint8_t buf[sizeof(base)];
+      memcpy(buf, base, sizeof(base));
+      buf[12] = c.dtype;
+      buf[13] = c.padding;
+      TS_ASSERT(!valid(buf, sizeof(buf)));
+    }
+
+    // Packed bits with padding but no data.
+    uint8_t empty[] = { 0x0F, 0x00, 0x00, 0x00, 0x05, 'v',  0x00,
+                        0x02, 0x00, 0x00, 0x00, 0x09, 0x10, 0x03,
+                        0x00 };
+    TS_ASSERT(!valid(empty, sizeof(empty)));
+    empty[13] = 0x00;
+    TS_ASSERT(valid(empty, sizeof(empty)));
+
+    // Too short for the header.
+    uint8_t short_buf[] = { 0x0E, 0x00, 0x00, 0x00, 0x05, 'v',  0x00,
+                            0x01, 0x00, 0x00, 0x00, 0x09, 0x03, 0x00 };
+    TS_ASSERT(!valid(short_buf, sizeof(short_buf)));
+
+    // Other subtypes are still rejected.
+    uint8_t other[sizeof(base)];
+    memcpy(other, base, sizeof(base));
+    other[11] = 0x04;
+    TS_ASSERT(!valid(other, sizeof(other)));
+  }
+
+private:
+  bool valid(const uint8_t buf[], size_t len) {
+    bsond::Document doc(buf, len);
+    bool serial = doc.valid();
+
+    // The parallel validator checks top-level elements itself.
+    bsonp::ThreadPool pool(2);
+    bool parallel = bsonp::validate_large(pool, buf, len, 0);
+    TS_ASSERT_EQUALS(serial, parallel);
+
+    return serial;
+  }
+};